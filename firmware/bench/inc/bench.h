@@ -0,0 +1,85 @@
+/*
+ * BLE throughput benchmark
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include "ble.h"
+
+#define APP_TIMER_PRESCALER	0
+
+/**
+ * The bench service shares the vendor base UUID of the pressure
+ * application
+ */
+#define BENCH_VENDOR_BASE_UUID	{{0x9D, 0x5F, 0xDD, 0x7D, 0xDB, 0x2A, 0xD6, 0x92, \
+                                  0xB2, 0xA0, 0x2E, 0x0B, 0x00, 0x00, 0xC3, 0x77}}
+#define BENCH_UUID_SERVICE	0x0200
+#define BENCH_UUID_DATA_CHAR	0x0201	/* Notifications, subscribe to start */
+#define BENCH_UUID_RESULTS_CHAR	0x0202	/* struct bench_results */
+
+/**
+ * Every connection interval is run with every TX buffer limit, and
+ * every limit with every payload size.
+ */
+#define BENCH_INTERVALS		5
+#define BENCH_TX_BUFFERS	4
+#define BENCH_PAYLOADS		2
+#define BENCH_RUNS		(BENCH_INTERVALS * BENCH_TX_BUFFERS * BENCH_PAYLOADS)
+#define BENCH_RUN_MS		2000
+
+#define BENCH_PAYLOAD_MAX	(BLE_GATT_ATT_MTU_DEFAULT - 3)
+
+enum bench_state {
+  BENCH_IDLE,
+  BENCH_UPDATING,		/* Waiting for the connection interval */
+  BENCH_RUNNING,
+  BENCH_DONE,
+};
+
+/**
+ * One run, laid out as it appears in the characteristic
+ */
+struct bench_result {
+  uint16_t conn_interval;	/* 1.25ms units, as granted by the central */
+  uint8_t tx_buffers;		/* Most notifications let in flight */
+  uint8_t payload;		/* Bytes per notification */
+  uint16_t bytes_per_s;		/* Payload acknowledged */
+  uint16_t packets_per_event;	/* 1/100ths */
+  uint16_t events;		/* Connection events */
+  uint16_t errors;		/* Anything but a full TX queue */
+};
+
+struct bench_results {
+  uint8_t state;		/* enum bench_state */
+  uint8_t runs;			/* Completed */
+  uint16_t reserved;
+  struct bench_result run[BENCH_RUNS];
+};
+
+void bench_init(void);
+void bench_on_ble_evt(ble_evt_t* p_ble_evt);
+
+#endif /* BENCH_H */
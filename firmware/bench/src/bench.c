@@ -0,0 +1,358 @@
+/*
+ * BLE throughput benchmark
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Measures how fast notifications really get through the S110 on a
+ * given board and central.
+ *
+ * Subscribing to the data characteristic starts a sequence of runs.
+ * Each asks the central for a connection interval, then for
+ * BENCH_RUN_MS keeps up to a given number of notifications of a given
+ * size in flight, refilling as BLE_EVT_TX_COMPLETE frees buffers. Each
+ * notification starts with a counter so the client can check nothing
+ * was lost or reordered.
+ *
+ * Connection events are counted with the radio notification, and the
+ * results for every run can be read from the results characteristic
+ * once state reads BENCH_DONE. Unsubscribing stops early.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "nordic_common.h"
+#include "ble.h"
+#include "ble_srv_common.h"
+#include "bench.h"
+
+#define UPDATE_TIMEOUT		APP_TIMER_TICKS(5000, APP_TIMER_PRESCALER)
+#define RUN_TICKS		APP_TIMER_TICKS(BENCH_RUN_MS, APP_TIMER_PRESCALER)
+#define CONN_SUP_TIMEOUT	MSEC_TO_UNITS(4000, UNIT_10_MS)
+
+/**
+ * Run matrix. A TX buffer limit of 0 means as many as the stack has.
+ */
+static const uint16_t intervals[BENCH_INTERVALS] = {
+  MSEC_TO_UNITS(7.5, UNIT_1_25_MS), MSEC_TO_UNITS(15, UNIT_1_25_MS),
+  MSEC_TO_UNITS(30, UNIT_1_25_MS), MSEC_TO_UNITS(50, UNIT_1_25_MS),
+  MSEC_TO_UNITS(100, UNIT_1_25_MS)
+};
+static const uint8_t tx_buffers[BENCH_TX_BUFFERS] = { 1, 2, 4, 0 };
+static const uint8_t payloads[BENCH_PAYLOADS] = { sizeof(uint32_t), BENCH_PAYLOAD_MAX };
+
+static uint8_t uuid_type;
+static uint16_t service_handle;
+static ble_gatts_char_handles_t data_handles, results_handles;
+static struct bench_results results;	/* Read straight from RAM */
+
+static uint16_t conn_handle = BLE_CONN_HANDLE_INVALID;
+static uint16_t conn_interval;
+static uint8_t stack_buffers;	/* TX buffers the stack has */
+static app_timer_id_t timer_id;
+
+/**
+ * The run in progress
+ */
+static uint8_t current;
+static uint8_t limit;
+static uint8_t in_flight;
+static uint32_t counter;
+static uint32_t acked;
+static volatile uint16_t events;
+static uint16_t errors;
+
+/* -----------------------------------------------------------------------------
+ * Service
+ */
+
+static uint32_t char_add(uint16_t uuid, bool notify, uint8_t* p_value,
+                         uint16_t len, ble_gatts_char_handles_t* p_handles) {
+  ble_gatts_char_md_t char_md;
+  ble_gatts_attr_md_t cccd_md;
+  ble_gatts_attr_t attr_char_value;
+  ble_gatts_attr_md_t attr_md;
+  ble_uuid_t ble_uuid;
+
+  memset(&cccd_md, 0, sizeof(cccd_md));
+  BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.read_perm);
+  BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.write_perm);
+  cccd_md.vloc = BLE_GATTS_VLOC_STACK;
+
+  memset(&char_md, 0, sizeof(char_md));
+  char_md.char_props.read = notify ? 0 : 1;
+  char_md.char_props.notify = notify ? 1 : 0;
+  char_md.p_cccd_md = notify ? &cccd_md : NULL;
+
+  ble_uuid.type = uuid_type;
+  ble_uuid.uuid = uuid;
+
+  memset(&attr_md, 0, sizeof(attr_md));
+  BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.read_perm);
+  BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&attr_md.write_perm);
+  attr_md.vloc = p_value ? BLE_GATTS_VLOC_USER : BLE_GATTS_VLOC_STACK;
+  attr_md.vlen = 1;
+
+  memset(&attr_char_value, 0, sizeof(attr_char_value));
+  attr_char_value.p_uuid = &ble_uuid;
+  attr_char_value.p_attr_md = &attr_md;
+  attr_char_value.init_len = len;
+  attr_char_value.max_len = p_value ? len : BENCH_PAYLOAD_MAX;
+  attr_char_value.p_value = p_value;
+
+  return sd_ble_gatts_characteristic_add(service_handle, &char_md,
+                                         &attr_char_value, p_handles);
+}
+
+/* -----------------------------------------------------------------------------
+ * Runs
+ */
+
+static struct bench_result* result(void) {
+  return &results.run[current];
+}
+/**
+ * Keeps as many notifications in flight as the run allows
+ */
+static void fill(void) {
+  uint8_t data[BENCH_PAYLOAD_MAX];
+  ble_gatts_hvx_params_t hvx_params;
+  uint16_t len;
+  uint32_t err_code;
+
+  while (results.state == BENCH_RUNNING && in_flight < limit) {
+    len = result()->payload;
+    memset(data, (uint8_t)counter, len);
+    (void)uint32_encode(counter, data);
+
+    memset(&hvx_params, 0, sizeof(hvx_params));
+    hvx_params.handle = data_handles.value_handle;
+    hvx_params.type = BLE_GATT_HVX_NOTIFICATION;
+    hvx_params.p_len = &len;
+    hvx_params.p_data = data;
+
+    err_code = sd_ble_gatts_hvx(conn_handle, &hvx_params);
+    if (err_code == BLE_ERROR_NO_TX_BUFFERS) {
+      break;			/* Fewer than the stack said, try on the next */
+    }
+    if (err_code != NRF_SUCCESS) {
+      errors++;
+      break;
+    }
+
+    counter++;
+    in_flight++;
+  }
+}
+/**
+ * Sends for BENCH_RUN_MS at the interval we have
+ */
+static void run_begin(void) {
+  results.state = BENCH_RUNNING;
+  result()->conn_interval = conn_interval;
+  acked = 0;
+  events = 0;
+  APP_ERROR_CHECK(app_timer_start(timer_id, RUN_TICKS, NULL));
+  fill();
+}
+/**
+ * Starts the next run, asking for a new connection interval first if
+ * it needs one.
+ */
+static void run_next(void) {
+  ble_gap_conn_params_t conn_params;
+  uint32_t err_code;
+
+  if (current >= BENCH_RUNS) {
+    results.state = BENCH_DONE;
+    /* Back to the preferred connection parameters */
+    (void)sd_ble_gap_conn_param_update(conn_handle, NULL);
+    return;
+  }
+
+  result()->conn_interval = 0;
+  result()->tx_buffers = tx_buffers[(current / BENCH_PAYLOADS) % BENCH_TX_BUFFERS];
+  result()->payload = payloads[current % BENCH_PAYLOADS];
+  if (result()->tx_buffers == 0) result()->tx_buffers = stack_buffers;
+  limit = result()->tx_buffers;
+  errors = 0;
+
+  if (current % (BENCH_TX_BUFFERS * BENCH_PAYLOADS) == 0 &&
+      conn_interval != intervals[current / (BENCH_TX_BUFFERS * BENCH_PAYLOADS)]) {
+    memset(&conn_params, 0, sizeof(conn_params));
+    conn_params.min_conn_interval = intervals[current / (BENCH_TX_BUFFERS * BENCH_PAYLOADS)];
+    conn_params.max_conn_interval = conn_params.min_conn_interval;
+    conn_params.slave_latency = 0;
+    conn_params.conn_sup_timeout = CONN_SUP_TIMEOUT;
+
+    err_code = sd_ble_gap_conn_param_update(conn_handle, &conn_params);
+    if (err_code == NRF_SUCCESS) {
+      results.state = BENCH_UPDATING;
+      APP_ERROR_CHECK(app_timer_start(timer_id, UPDATE_TIMEOUT, NULL));
+      return;
+    }
+    errors++;			/* Run at whatever we have */
+  }
+
+  run_begin();
+}
+static void run_end(void) {
+  uint16_t n = events;
+
+  result()->bytes_per_s = (acked * result()->payload * 1000) / BENCH_RUN_MS;
+  result()->packets_per_event = n ? (acked * 100) / n : 0;
+  result()->events = n;
+  result()->errors = errors;
+
+  current++;
+  results.runs = current;
+  run_next();
+}
+static void timeout_handler(void* p_context) {
+  (void)p_context;
+
+  switch (results.state) {
+    case BENCH_UPDATING:	/* The central never answered */
+      errors++;
+      run_begin();
+      break;
+    case BENCH_RUNNING:
+      run_end();
+      break;
+    default:
+      break;
+  }
+}
+
+static void start(void) {
+  memset(&results, 0, sizeof(results));
+  current = 0;
+  counter = 0;
+  run_next();
+}
+static void stop(void) {
+  APP_ERROR_CHECK(app_timer_stop(timer_id));
+  if (results.state != BENCH_DONE) results.state = BENCH_IDLE;
+}
+
+/**
+ * Radio notification interrupt. Fires before every connection event.
+ */
+void SWI1_IRQHandler(void) {
+  events++;
+}
+
+/* -----------------------------------------------------------------------------
+ * Events
+ */
+
+void bench_on_ble_evt(ble_evt_t* p_ble_evt) {
+  ble_gap_evt_t* p_gap_evt = &p_ble_evt->evt.gap_evt;
+  ble_gatts_evt_write_t* p_write = &p_ble_evt->evt.gatts_evt.params.write;
+
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+      conn_handle = p_gap_evt->conn_handle;
+      conn_interval = p_gap_evt->params.connected.conn_params.max_conn_interval;
+      in_flight = 0;
+      break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+      conn_handle = BLE_CONN_HANDLE_INVALID;
+      stop();
+      break;
+
+    case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+      conn_interval = p_gap_evt->params.conn_param_update.conn_params.max_conn_interval;
+      if (results.state == BENCH_UPDATING) {
+        APP_ERROR_CHECK(app_timer_stop(timer_id));
+        run_begin();
+      }
+      break;
+
+    case BLE_EVT_TX_COMPLETE:
+      in_flight -= MIN(in_flight, p_ble_evt->evt.common_evt.params.tx_complete.count);
+      if (results.state == BENCH_RUNNING) {
+        acked += p_ble_evt->evt.common_evt.params.tx_complete.count;
+        fill();
+      }
+      break;
+
+    case BLE_GATTS_EVT_WRITE:
+      if (p_write->handle == data_handles.cccd_handle && p_write->len == 2) {
+        if (ble_srv_is_notification_enabled(p_write->data)) {
+          start();
+        } else {
+          stop();
+        }
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+void bench_init(void) {
+  ble_uuid128_t base_uuid = BENCH_VENDOR_BASE_UUID;
+  ble_uuid_t ble_uuid;
+  uint32_t err_code;
+
+  err_code = sd_ble_tx_buffer_count_get(&stack_buffers);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = sd_ble_uuid_vs_add(&base_uuid, &uuid_type);
+  APP_ERROR_CHECK(err_code);
+
+  ble_uuid.type = uuid_type;
+  ble_uuid.uuid = BENCH_UUID_SERVICE;
+  err_code = sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &ble_uuid, &service_handle);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = char_add(BENCH_UUID_DATA_CHAR, true, NULL, 0, &data_handles);
+  APP_ERROR_CHECK(err_code);
+  err_code = char_add(BENCH_UUID_RESULTS_CHAR, false, (uint8_t*)&results,
+                      sizeof(results), &results_handles);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = app_timer_create(&timer_id, APP_TIMER_MODE_SINGLE_SHOT, timeout_handler);
+  APP_ERROR_CHECK(err_code);
+
+  /* Radio notifications, same priority as the app_timer handlers */
+  err_code = sd_radio_notification_cfg_set(NRF_RADIO_NOTIFICATION_TYPE_INT_ON_ACTIVE,
+                                           NRF_RADIO_NOTIFICATION_DISTANCE_800US);
+  APP_ERROR_CHECK(err_code);
+  err_code = sd_nvic_ClearPendingIRQ(SWI1_IRQn);
+  APP_ERROR_CHECK(err_code);
+  err_code = sd_nvic_SetPriority(SWI1_IRQn, NRF_APP_PRIORITY_LOW);
+  APP_ERROR_CHECK(err_code);
+  err_code = sd_nvic_EnableIRQ(SWI1_IRQn);
+  APP_ERROR_CHECK(err_code);
+}
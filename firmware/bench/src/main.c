@@ -0,0 +1,163 @@
+/*
+ * BLE throughput benchmark
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Just enough of a peripheral to run the benchmark: advertises as
+ * "pressure-bench", accepts one connection without bonding and
+ * advertises again when it goes. Built in place of the application
+ * with the config.mk in examples/s110/ble_bench.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nordic_common.h"
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "ble.h"
+#include "ble_hci.h"
+#include "ble_advdata.h"
+#include "softdevice_handler.h"
+#include "bench.h"
+
+#define DEVICE_NAME		"pressure-bench"
+
+#define APP_TIMER_MAX_TIMERS	1
+#define APP_TIMER_OP_QUEUE_SIZE	4
+
+#define ADV_INTERVAL		MSEC_TO_UNITS(100, UNIT_0_625_MS)
+
+/**
+ * Where the central starts. The runs ask for their own intervals
+ */
+#define MIN_CONN_INTERVAL	MSEC_TO_UNITS(20, UNIT_1_25_MS)
+#define MAX_CONN_INTERVAL	MSEC_TO_UNITS(100, UNIT_1_25_MS)
+#define CONN_SUP_TIMEOUT	MSEC_TO_UNITS(4000, UNIT_10_MS)
+
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t* p_file_name) {
+  (void)error_code;
+  (void)line_num;
+  (void)p_file_name;
+
+  NVIC_SystemReset();
+}
+void assert_nrf_callback(uint16_t line_num, const uint8_t* p_file_name) {
+  app_error_handler(0xDEADBEEF, line_num, p_file_name);
+}
+
+static void advertising_start(void) {
+  ble_gap_adv_params_t adv_params;
+
+  memset(&adv_params, 0, sizeof(adv_params));
+  adv_params.type = BLE_GAP_ADV_TYPE_ADV_IND;
+  adv_params.fp = BLE_GAP_ADV_FP_ANY;
+  adv_params.interval = ADV_INTERVAL;
+  adv_params.timeout = 0;
+
+  APP_ERROR_CHECK(sd_ble_gap_adv_start(&adv_params));
+}
+
+static void on_ble_evt(ble_evt_t* p_ble_evt) {
+  uint32_t err_code;
+
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_DISCONNECTED:
+      advertising_start();
+      break;
+
+    case BLE_GAP_EVT_SEC_PARAMS_REQUEST:
+      err_code = sd_ble_gap_sec_params_reply(p_ble_evt->evt.gap_evt.conn_handle,
+                                             BLE_GAP_SEC_STATUS_PAIRING_NOT_SUPP,
+                                             NULL);
+      APP_ERROR_CHECK(err_code);
+      break;
+
+    case BLE_GATTS_EVT_SYS_ATTR_MISSING:
+      err_code = sd_ble_gatts_sys_attr_set(p_ble_evt->evt.gatts_evt.conn_handle, NULL, 0);
+      APP_ERROR_CHECK(err_code);
+      break;
+
+    default:
+      break;
+  }
+}
+static void ble_evt_dispatch(ble_evt_t* p_ble_evt) {
+  bench_on_ble_evt(p_ble_evt);
+  on_ble_evt(p_ble_evt);
+}
+
+static void ble_stack_init(void) {
+  ble_enable_params_t ble_enable_params;
+
+  SOFTDEVICE_HANDLER_INIT(NRF_CLOCK_LFCLKSRC_XTAL_20_PPM, false);
+
+  memset(&ble_enable_params, 0, sizeof(ble_enable_params));
+  APP_ERROR_CHECK(sd_ble_enable(&ble_enable_params));
+
+  APP_ERROR_CHECK(softdevice_ble_evt_handler_set(ble_evt_dispatch));
+}
+static void gap_params_init(void) {
+  ble_gap_conn_params_t gap_conn_params;
+  ble_gap_conn_sec_mode_t sec_mode;
+
+  BLE_GAP_CONN_SEC_MODE_SET_OPEN(&sec_mode);
+  APP_ERROR_CHECK(sd_ble_gap_device_name_set(&sec_mode, (const uint8_t*)DEVICE_NAME,
+                                             strlen(DEVICE_NAME)));
+
+  memset(&gap_conn_params, 0, sizeof(gap_conn_params));
+  gap_conn_params.min_conn_interval = MIN_CONN_INTERVAL;
+  gap_conn_params.max_conn_interval = MAX_CONN_INTERVAL;
+  gap_conn_params.slave_latency = 0;
+  gap_conn_params.conn_sup_timeout = CONN_SUP_TIMEOUT;
+  APP_ERROR_CHECK(sd_ble_gap_ppcp_set(&gap_conn_params));
+}
+static void advertising_init(void) {
+  ble_advdata_t advdata;
+  uint8_t flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+
+  memset(&advdata, 0, sizeof(advdata));
+  advdata.name_type = BLE_ADVDATA_FULL_NAME;
+  advdata.flags.size = sizeof(flags);
+  advdata.flags.p_data = &flags;
+
+  APP_ERROR_CHECK(ble_advdata_set(&advdata, NULL));
+}
+
+int main(void) {
+  APP_TIMER_INIT(APP_TIMER_PRESCALER, APP_TIMER_MAX_TIMERS, APP_TIMER_OP_QUEUE_SIZE, false);
+
+  ble_stack_init();
+  gap_params_init();
+  advertising_init();
+  bench_init();
+  advertising_start();
+
+  for (;;) {
+    APP_ERROR_CHECK(sd_app_evt_wait());
+  }
+}
@@ -22,7 +22,9 @@
 
 # Project Name
 #
-# This is used to define the name of the build artifact
+# This is used to define the name of the build artifact. The BLE
+# throughput benchmark, ble_bench, has its own config.mk in
+# examples/s110/ble_bench.
 #
 PROJECT_NAME		:= ble_app_hrs
 
@@ -74,6 +76,30 @@ BLACKMAGIC_PATH		:=
 #
 BOARD			:= BOARD_PCA10001
 
+# The power profile used on a power-on reset. Optional
+#
+# Can be POWER_PROFILE_FLIGHT, POWER_PROFILE_BENCH or
+# POWER_PROFILE_STORAGE. Defaults to POWER_PROFILE_FLIGHT when left
+# blank. The profile can also be changed over GATT at runtime.
+#
+POWER_PROFILE		:= POWER_PROFILE_FLIGHT
+
+# Execution time profiling. Optional
+#
+# Set to 1 to time the main handlers against TIMER2. The table can be
+# read from a debug characteristic, or written to print it over
+# app_trace. Keeps the HFCLK running, so leave blank for flight.
+#
+PROF_ENABLED		:=
+
+# Synthetic data source. Optional
+#
+# Set to 1 to add a characteristic that replaces the barometer with
+# generated samples at up to 1000/s, for load testing the pipeline and
+# BLE link. Leave blank for flight.
+#
+SYNTH_ENABLED		:=
+
 # INCLUDEPATHS
 #
 # Folders from the SDK Include Directory. Copy this from the example
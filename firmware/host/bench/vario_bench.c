@@ -0,0 +1,300 @@
+/*
+ * Variometer benchmark
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Runs the fixed point variometer in vario.c over simulated flights,
+ * alongside the same filter in double precision fed with the exact
+ * standard atmosphere. The difference between the two is the cost of
+ * doing it in fixed point, and the error of both against the flight
+ * is how good the filter is.
+ *
+ * Each flight is then run again to time the filter stage. The time
+ * here is the host's; the time on the M0 is in the FILTER line of a
+ * PROF_ENABLED build's profile.
+ *
+ * Exits non-zero if the fixed point filter strays too far from the
+ * reference.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES()	__rdtsc()
+#endif
+
+#include "pipeline.h"
+#include "vario.h"
+
+#define TICKS_PER_SECOND	32768
+#define RTC_COUNTER_MASK	0xFFFFFF
+#define TIMING_RUNS		20
+
+/**
+ * How far the fixed point filter may be from the reference, RMS
+ */
+#define ALTITUDE_LIMIT		0.5	/* m */
+#define CLIMB_LIMIT		0.05	/* m/s */
+
+#define MAX_SAMPLES		20000
+
+static const double pressure_sigma[] = { 6, 5, 4, 3 };
+
+struct flight {
+  const char* name;
+  double rate;			/* Hz */
+  uint8_t oss;
+  double (*climb)(double t, double h, double* v);	/* Vertical speed wanted */
+  double duration;		/* s */
+};
+
+/* -----------------------------------------------------------------------------
+ * Standard atmosphere
+ */
+
+static double isa_pressure(double h) {
+  if (h < 11000) return 101325 * pow(1 - 2.25577e-5 * h, 5.25588);
+  if (h < 20000) return 22632.06 * exp(-0.000157688 * (h - 11000));
+  return 5474.889 * pow(1 + (h - 20000) / 216650, -34.1632);
+}
+static double isa_altitude(double p) {
+  if (p > 22632.06) return 44330.77 * (1 - pow(p / 101325, 0.190263));
+  if (p > 5474.889) return 11000 - log(p / 22632.06) / 0.000157688;
+  return 20000 + 216650 * (pow(p / 5474.889, -1 / 34.1632) - 1);
+}
+static double isa_density_ratio(double h) {
+  double t = (h < 11000) ? 288.15 - 0.0065 * h : (h < 20000) ? 216.65 : 216.65 + 0.001 * (h - 20000);
+
+  return (isa_pressure(h) / 101325) * (288.15 / t);
+}
+
+/* -----------------------------------------------------------------------------
+ * Flights. Each returns the vertical speed wanted at time t and
+ * altitude h, and the speed follows it with a time constant.
+ */
+
+/**
+ * Latex balloon: up at 5m/s, burst at 30km, and down under a
+ * parachute that falls faster where the air is thin
+ */
+static double balloon(double t, double h, double* v) {
+  static bool burst;
+  (void)v;
+
+  if (t == 0) burst = false;
+  if (h >= 30000) burst = true;
+
+  return burst ? -5 / sqrt(isa_density_ratio(h)) : 5;
+}
+/**
+ * Model rocket: 10g for 3s, coast to apogee, then drogue and main
+ */
+static double rocket(double t, double h, double* v) {
+  static bool apogee;
+
+  if (t == 0) apogee = false;
+  if (t < 3) {
+    *v += 100 / 20.0;		/* Speed set directly, at the sample rate */
+    return *v;
+  }
+  if (!apogee) {
+    *v -= 9.81 / 20.0;
+    if (*v <= 0) apogee = true;
+    return *v;
+  }
+  return (h > 300) ? -25 : -6;
+}
+
+static const struct flight flights[] = {
+  { "balloon", 1, 3, balloon, 8000 },
+  { "rocket", 20, 1, rocket, 400 },
+};
+
+/* -----------------------------------------------------------------------------
+ * Reference filter
+ */
+
+static struct {
+  bool running;
+  uint32_t timestamp;
+  double h, v, p00, p01, p11;
+} ref;
+
+static void reference(uint32_t timestamp, int32_t pressure, uint8_t oss) {
+  double q = pow(VARIO_ACCEL_SIGMA / 1000.0, 2);
+  double z = isa_altitude(pressure);
+  double dhdp = (isa_altitude(pressure - 0.5) - isa_altitude(pressure + 0.5));
+  double r = pow(pressure_sigma[oss] * dhdp, 2);
+  double dt = (double)((timestamp - ref.timestamp) & RTC_COUNTER_MASK) / TICKS_PER_SECOND;
+  double s, k0, k1, y;
+
+  if (!ref.running || dt > VARIO_DT_MAX) {
+    ref.h = z;
+    ref.v = 0;
+    ref.p00 = r;
+    ref.p01 = 0;
+    ref.p11 = pow(VARIO_CLIMB_SIGMA / 1000.0, 2);
+    ref.running = true;
+  } else {
+    ref.h += ref.v * dt;
+    ref.p00 += dt * (2 * ref.p01 + dt * ref.p11) + q * pow(dt, 4) / 4;
+    ref.p01 += dt * ref.p11 + q * pow(dt, 3) / 2;
+    ref.p11 += q * dt * dt;
+
+    s = ref.p00 + r;
+    k0 = ref.p00 / s;
+    k1 = ref.p01 / s;
+    y = z - ref.h;
+    ref.h += k0 * y;
+    ref.v += k1 * y;
+    ref.p11 -= k1 * ref.p01;
+    ref.p01 -= k0 * ref.p01;
+    ref.p00 -= k0 * ref.p00;
+  }
+  ref.timestamp = timestamp;
+}
+
+/* -----------------------------------------------------------------------------
+ * Runs
+ */
+
+static struct sample samples[MAX_SAMPLES];
+static double truth_h[MAX_SAMPLES], truth_v[MAX_SAMPLES];
+
+/**
+ * Gaussian noise, from a fixed seed so that runs compare
+ */
+static double gaussian(void) {
+  double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+  double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+  return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+static uint32_t fly(const struct flight* f) {
+  double dt = 1 / f->rate, t, h = 0, v = 0, target;
+  uint32_t n;
+
+  srand(1);
+  for (n = 0, t = 0; n < MAX_SAMPLES && t < f->duration && h >= 0; n++, t += dt) {
+    target = f->climb(t, h, &v);
+    v += (target - v) * (1 - exp(-dt / 2.0));	/* 2s to settle */
+
+    truth_h[n] = h;
+    truth_v[n] = v;
+    samples[n].timestamp = (uint32_t)llround(t * TICKS_PER_SECOND) & RTC_COUNTER_MASK;
+    samples[n].pressure = (int32_t)lround(isa_pressure(h) + pressure_sigma[f->oss] * gaussian());
+    samples[n].oss = f->oss;
+    samples[n].flags = SAMPLE_FLAG_COMPENSATED;
+
+    h += v * dt;
+  }
+
+  return n;
+}
+static bool run(const struct flight* f) {
+  uint32_t n = fly(f), i;
+  double dh, dv, diff_h = 0, diff_v = 0, max_h = 0, max_v = 0;
+  double fixed_h = 0, fixed_v = 0, ref_h = 0, ref_v = 0;
+  double h, v, ns;
+  struct timespec start, end;
+  struct sample s;
+  bool ok;
+#ifdef CYCLES
+  uint64_t cycles;
+#endif
+
+  vario_reset();
+  ref.running = false;
+
+  for (i = 0; i < n; i++) {
+    s = samples[i];
+    vario_filter_stage(&s);
+    reference(s.timestamp, s.pressure, s.oss);
+
+    h = s.altitude / 100.0;
+    v = s.climb / 100.0;
+    dh = h - ref.h;
+    dv = v - ref.v;
+    diff_h += dh * dh;
+    diff_v += dv * dv;
+    if (fabs(dh) > max_h) max_h = fabs(dh);
+    if (fabs(dv) > max_v) max_v = fabs(dv);
+
+    fixed_h += pow(h - truth_h[i], 2);
+    fixed_v += pow(v - truth_v[i], 2);
+    ref_h += pow(ref.h - truth_h[i], 2);
+    ref_v += pow(ref.v - truth_v[i], 2);
+  }
+
+  diff_h = sqrt(diff_h / n);
+  diff_v = sqrt(diff_v / n);
+  ok = (diff_h < ALTITUDE_LIMIT) && (diff_v < CLIMB_LIMIT);
+
+  printf("%s: %u samples at %gHz, oss %u\n", f->name, n, f->rate, f->oss);
+  printf("  fixed - reference  altitude %.3fm RMS %.3fm max, climb %.3fm/s RMS %.3fm/s max\n",
+         diff_h, max_h, diff_v, max_v);
+  printf("  fixed - flight     altitude %.2fm RMS, climb %.3fm/s RMS\n",
+         sqrt(fixed_h / n), sqrt(fixed_v / n));
+  printf("  reference - flight altitude %.2fm RMS, climb %.3fm/s RMS\n",
+         sqrt(ref_h / n), sqrt(ref_v / n));
+
+  /* Timing */
+#ifdef CYCLES
+  cycles = CYCLES();
+#endif
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < TIMING_RUNS * n; i++) {
+    if (i % n == 0) vario_reset();
+    s = samples[i % n];
+    vario_filter_stage(&s);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / (TIMING_RUNS * n);
+#ifdef CYCLES
+  printf("  %.1fns, %.0f cycles per update\n", ns, (double)(CYCLES() - cycles) / (TIMING_RUNS * n));
+#else
+  printf("  %.1fns per update\n", ns);
+#endif
+
+  if (!ok) printf("  FAIL: fixed point is more than %gm or %gm/s RMS from the reference\n",
+                  ALTITUDE_LIMIT, CLIMB_LIMIT);
+  return ok;
+}
+
+int main(void) {
+  uint8_t i;
+  bool ok = true;
+
+  printf("vario: accel sigma %dmm/s^2\n", VARIO_ACCEL_SIGMA);
+  for (i = 0; i < sizeof(flights) / sizeof(flights[0]); i++) {
+    ok &= run(&flights[i]);
+  }
+  printf("vario: %s\n", ok ? "passed" : "FAILED");
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
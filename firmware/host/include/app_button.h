@@ -0,0 +1,53 @@
+/*
+ * Host mock of the SDK button handler
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_APP_BUTTON_H
+#define MOCK_APP_BUTTON_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf_gpio.h"
+#include "nrf_error.h"
+
+#define APP_BUTTON_PUSH		1
+#define APP_BUTTON_RELEASE	0
+
+typedef void (*app_button_handler_t)(uint8_t pin_no, uint8_t button_action);
+
+typedef struct {
+  uint8_t pin_no;
+  bool active_high;
+  nrf_gpio_pin_pull_t pull_cfg;
+  app_button_handler_t button_handler;
+} app_button_cfg_t;
+
+void mock_app_button_init(app_button_cfg_t* p_buttons, uint8_t button_count);
+
+#define APP_BUTTON_INIT(BUTTONS, BUTTON_COUNT, DETECTION_DELAY, USE_SCHEDULER) \
+  mock_app_button_init(BUTTONS, BUTTON_COUNT)
+
+uint32_t app_button_enable(void);
+uint32_t app_button_disable(void);
+
+#endif /* MOCK_APP_BUTTON_H */
@@ -0,0 +1,64 @@
+/*
+ * Host mock of the SDK application timer
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_APP_TIMER_H
+#define MOCK_APP_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf_error.h"
+
+/**
+ * Timers run against a virtual RTC1 clock that only advances when the
+ * host test driver says so. See mock_app_timer.c
+ */
+#define APP_TIMER_CLOCK_FREQ		32768
+#define APP_TIMER_MIN_TIMEOUT_TICKS	5
+
+#define APP_TIMER_TICKS(MS, PRESCALER)					\
+  ((uint32_t)(((MS) * (uint64_t)APP_TIMER_CLOCK_FREQ) / (((PRESCALER) + 1) * 1000)))
+
+#define APP_TIMER_INIT(PRESCALER, MAX_TIMERS, OP_QUEUES_SIZE, USE_SCHEDULER) \
+  app_timer_init(PRESCALER, MAX_TIMERS, OP_QUEUES_SIZE + 1, NULL, NULL)
+
+typedef uint32_t app_timer_id_t;
+typedef void (*app_timer_timeout_handler_t)(void* p_context);
+
+typedef enum {
+  APP_TIMER_MODE_SINGLE_SHOT,
+  APP_TIMER_MODE_REPEATED
+} app_timer_mode_t;
+
+uint32_t app_timer_init(uint32_t prescaler, uint8_t max_timers, uint8_t op_queues_size,
+                        void* p_buffer, void* evt_schedule_func);
+uint32_t app_timer_create(app_timer_id_t* p_timer_id, app_timer_mode_t mode,
+                          app_timer_timeout_handler_t timeout_handler);
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void* p_context);
+uint32_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_stop_all(void);
+uint32_t app_timer_cnt_get(uint32_t* p_ticks);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from,
+                                    uint32_t* p_ticks_diff);
+
+#endif /* MOCK_APP_TIMER_H */
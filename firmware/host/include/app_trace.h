@@ -0,0 +1,41 @@
+/*
+ * Host mock of the SDK trace output
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_APP_TRACE_H
+#define MOCK_APP_TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef ENABLE_DEBUG_LOG_SUPPORT
+#define app_trace_init()		do { } while (0)
+#define app_trace_log			printf
+#define app_trace_dump(p, len)		do { } while (0)
+#else
+#define app_trace_init()		do { } while (0)
+#define app_trace_log(...)		do { } while (0)
+#define app_trace_dump(p, len)		do { } while (0)
+#endif
+
+#endif /* MOCK_APP_TRACE_H */
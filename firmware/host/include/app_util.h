@@ -0,0 +1,93 @@
+/*
+ * Host mock of the SDK utilities
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_APP_UTIL_H
+#define MOCK_APP_UTIL_H
+
+#include <stdint.h>
+
+enum {
+  UNIT_0_625_MS = 625,
+  UNIT_1_25_MS  = 1250,
+  UNIT_10_MS    = 10000
+};
+
+#define MSEC_TO_UNITS(TIME, RESOLUTION) (((TIME) * 1000) / (RESOLUTION))
+
+#define ROUNDED_DIV(A, B) (((A) + ((B) / 2)) / (B))
+#define CEIL_DIV(A, B) (((A) - 1) / (B) + 1)
+#define IS_POWER_OF_TWO(A) (((A) != 0) && ((((A) - 1) & (A)) == 0))
+
+static inline uint8_t uint16_encode(uint16_t value, uint8_t* p_encoded_data)
+{
+  p_encoded_data[0] = (uint8_t)((value & 0x00FF) >> 0);
+  p_encoded_data[1] = (uint8_t)((value & 0xFF00) >> 8);
+  return sizeof(uint16_t);
+}
+
+static inline uint8_t uint32_encode(uint32_t value, uint8_t* p_encoded_data)
+{
+  p_encoded_data[0] = (uint8_t)((value & 0x000000FF) >> 0);
+  p_encoded_data[1] = (uint8_t)((value & 0x0000FF00) >> 8);
+  p_encoded_data[2] = (uint8_t)((value & 0x00FF0000) >> 16);
+  p_encoded_data[3] = (uint8_t)((value & 0xFF000000) >> 24);
+  return sizeof(uint32_t);
+}
+
+static inline uint16_t uint16_decode(const uint8_t* p_encoded_data)
+{
+  return ((((uint16_t)((uint8_t*)p_encoded_data)[0])) |
+          (((uint16_t)((uint8_t*)p_encoded_data)[1]) << 8 ));
+}
+
+static inline uint32_t uint32_decode(const uint8_t* p_encoded_data)
+{
+  return ((((uint32_t)((uint8_t*)p_encoded_data)[0]) << 0)  |
+          (((uint32_t)((uint8_t*)p_encoded_data)[1]) << 8)  |
+          (((uint32_t)((uint8_t*)p_encoded_data)[2]) << 16) |
+          (((uint32_t)((uint8_t*)p_encoded_data)[3]) << 24 ));
+}
+
+static inline uint8_t battery_level_in_percent(const uint16_t mvolts)
+{
+  uint8_t battery_level;
+
+  if (mvolts >= 3000) {
+    battery_level = 100;
+  } else if (mvolts > 2900) {
+    battery_level = 100 - ((3000 - mvolts) * 58) / 100;
+  } else if (mvolts > 2740) {
+    battery_level = 42 - ((2900 - mvolts) * 24) / 160;
+  } else if (mvolts > 2440) {
+    battery_level = 18 - ((2740 - mvolts) * 12) / 300;
+  } else if (mvolts > 2100) {
+    battery_level = 6 - ((2440 - mvolts) * 6) / 340;
+  } else {
+    battery_level = 0;
+  }
+
+  return battery_level;
+}
+
+#endif /* MOCK_APP_UTIL_H */
@@ -0,0 +1,40 @@
+/*
+ * Host mock of the SDK platform utilities
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_APP_UTIL_PLATFORM_H
+#define MOCK_APP_UTIL_PLATFORM_H
+
+#include <stdint.h>
+#include "nrf_soc.h"
+
+#define CRITICAL_REGION_ENTER()						\
+  {									\
+    uint8_t IS_NESTED_CRITICAL_REGION = 0;				\
+    sd_nvic_critical_region_enter(&IS_NESTED_CRITICAL_REGION);
+
+#define CRITICAL_REGION_EXIT()						\
+    sd_nvic_critical_region_exit(IS_NESTED_CRITICAL_REGION);		\
+  }
+
+#endif /* MOCK_APP_UTIL_PLATFORM_H */
@@ -0,0 +1,465 @@
+/*
+ * Host mock of the S110 SoftDevice BLE API
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Follows the layout of the s110_nrf51822_7.x headers closely enough
+ * that the application compiles unchanged. Only the parts the
+ * application uses are present.
+ */
+
+#ifndef MOCK_BLE_H
+#define MOCK_BLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf_error.h"
+
+/* -----------------------------------------------------------------------------
+ * Errors
+ */
+
+#define BLE_ERROR_NOT_ENABLED			(0x3001)
+#define BLE_ERROR_INVALID_CONN_HANDLE		(0x3002)
+#define BLE_ERROR_INVALID_ATTR_HANDLE		(0x3003)
+#define BLE_ERROR_NO_TX_BUFFERS			(0x3004)
+#define BLE_ERROR_GATTS_INVALID_ATTR_TYPE	(0x3400)
+#define BLE_ERROR_GATTS_SYS_ATTR_MISSING	(0x3401)
+
+#define BLE_CONN_HANDLE_INVALID			0xFFFF
+#define BLE_GATT_HANDLE_INVALID			0x0000
+
+#define BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION	0x13
+#define BLE_HCI_CONN_INTERVAL_UNACCEPTABLE		0x3B
+
+/* -----------------------------------------------------------------------------
+ * UUIDs
+ */
+
+#define BLE_UUID_TYPE_UNKNOWN			0x00
+#define BLE_UUID_TYPE_BLE			0x01
+#define BLE_UUID_TYPE_VENDOR_BEGIN		0x02
+
+#define BLE_UUID_HEART_RATE_SERVICE		0x180D
+#define BLE_UUID_BATTERY_SERVICE		0x180F
+#define BLE_UUID_DEVICE_INFORMATION_SERVICE	0x180A
+
+#define BLE_APPEARANCE_UNKNOWN			0
+
+typedef struct {
+  uint16_t uuid;
+  uint8_t  type;
+} ble_uuid_t;
+
+typedef struct {
+  uint8_t uuid128[16];
+} ble_uuid128_t;
+
+#define BLE_UUID_BLE_ASSIGN(instance, value) do {	\
+    instance.type = BLE_UUID_TYPE_BLE;			\
+    instance.uuid = value;				\
+  } while (0)
+
+/* -----------------------------------------------------------------------------
+ * GAP
+ */
+
+#define BLE_GAP_ADDR_LEN			6
+#define BLE_GAP_ADDR_TYPE_PUBLIC		0x00
+#define BLE_GAP_ADDR_TYPE_RANDOM_STATIC		0x01
+
+#define BLE_GAP_ADV_TYPE_ADV_IND		0x00
+#define BLE_GAP_ADV_TYPE_ADV_DIRECT_IND		0x01
+#define BLE_GAP_ADV_TYPE_ADV_SCAN_IND		0x02
+#define BLE_GAP_ADV_TYPE_ADV_NONCONN_IND	0x03
+
+#define BLE_GAP_ADV_FP_ANY			0x00
+
+#define BLE_GAP_ADV_FLAG_LE_LIMITED_DISC_MODE	(0x01)
+#define BLE_GAP_ADV_FLAG_LE_GENERAL_DISC_MODE	(0x02)
+#define BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED	(0x04)
+#define BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE \
+  (BLE_GAP_ADV_FLAG_LE_LIMITED_DISC_MODE | BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED)
+#define BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE \
+  (BLE_GAP_ADV_FLAG_LE_GENERAL_DISC_MODE | BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED)
+
+#define BLE_GAP_ADV_INTERVAL_MIN		0x0020
+#define BLE_GAP_ADV_NONCON_INTERVAL_MIN		0x00A0
+#define BLE_GAP_ADV_INTERVAL_MAX		0x4000
+#define BLE_GAP_ADV_TIMEOUT_LIMITED_MAX		180
+#define BLE_GAP_ADV_TIMEOUT_GENERAL_UNLIMITED	0
+
+#define BLE_GAP_TIMEOUT_SRC_ADVERTISEMENT	0x00
+#define BLE_GAP_TIMEOUT_SRC_SECURITY_REQUEST	0x01
+#define BLE_GAP_TIMEOUT_SRC_SCAN		0x02
+#define BLE_GAP_TIMEOUT_SRC_CONN		0x03
+
+#define BLE_GAP_IO_CAPS_NONE			0x03
+
+#define BLE_GAP_SEC_STATUS_PAIRING_NOT_SUPP	0x85
+
+#define BLE_GAP_CP_MIN_CONN_INTVL_MIN		0x0006
+#define BLE_GAP_CP_MAX_CONN_INTVL_MAX		0x0C80
+#define BLE_GAP_CP_SLAVE_LATENCY_MAX		0x01F3
+#define BLE_GAP_CP_CONN_SUP_TIMEOUT_MIN		0x000A
+#define BLE_GAP_CP_CONN_SUP_TIMEOUT_MAX		0x0C80
+
+#define BLE_GAP_ADDR_TYPE_PUBLIC			0x00
+#define BLE_GAP_ADDR_TYPE_RANDOM_STATIC			0x01
+#define BLE_GAP_ADDR_TYPE_RANDOM_PRIVATE_RESOLVABLE	0x02
+#define BLE_GAP_ADDR_TYPE_RANDOM_PRIVATE_NON_RESOLVABLE	0x03
+
+typedef struct {
+  uint8_t addr_type;
+  uint8_t addr[BLE_GAP_ADDR_LEN];
+} ble_gap_addr_t;
+
+typedef struct {
+  uint16_t min_conn_interval;
+  uint16_t max_conn_interval;
+  uint16_t slave_latency;
+  uint16_t conn_sup_timeout;
+} ble_gap_conn_params_t;
+
+typedef struct {
+  uint8_t sm : 4;
+  uint8_t lv : 4;
+} ble_gap_conn_sec_mode_t;
+
+#define BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(ptr)	do {(ptr)->sm = 0; (ptr)->lv = 0;} while(0)
+#define BLE_GAP_CONN_SEC_MODE_SET_OPEN(ptr)		do {(ptr)->sm = 1; (ptr)->lv = 1;} while(0)
+
+typedef struct {
+  uint8_t type;
+  ble_gap_addr_t* p_peer_addr;
+  uint8_t fp;
+  void* p_whitelist;
+  uint16_t interval;
+  uint16_t timeout;
+} ble_gap_adv_params_t;
+
+typedef struct {
+  uint16_t timeout;
+  uint8_t bond : 1;
+  uint8_t mitm : 1;
+  uint8_t io_caps : 3;
+  uint8_t oob : 1;
+  uint8_t min_key_size;
+  uint8_t max_key_size;
+} ble_gap_sec_params_t;
+
+enum BLE_GAP_EVTS {
+  BLE_GAP_EVT_CONNECTED = 0x10,
+  BLE_GAP_EVT_DISCONNECTED,
+  BLE_GAP_EVT_CONN_PARAM_UPDATE,
+  BLE_GAP_EVT_SEC_PARAMS_REQUEST,
+  BLE_GAP_EVT_SEC_INFO_REQUEST,
+  BLE_GAP_EVT_PASSKEY_DISPLAY,
+  BLE_GAP_EVT_AUTH_KEY_REQUEST,
+  BLE_GAP_EVT_AUTH_STATUS,
+  BLE_GAP_EVT_CONN_SEC_UPDATE,
+  BLE_GAP_EVT_TIMEOUT,
+  BLE_GAP_EVT_RSSI_CHANGED,
+};
+
+typedef struct {
+  ble_gap_addr_t peer_addr;
+  uint8_t irk_match :1;
+  uint8_t irk_match_idx  :7;
+  ble_gap_conn_params_t conn_params;
+} ble_gap_evt_connected_t;
+
+typedef struct {
+  uint8_t reason;
+} ble_gap_evt_disconnected_t;
+
+typedef struct {
+  ble_gap_conn_params_t conn_params;
+} ble_gap_evt_conn_param_update_t;
+
+typedef struct {
+  uint8_t src;
+} ble_gap_evt_timeout_t;
+
+typedef struct {
+  int8_t rssi;
+} ble_gap_evt_rssi_changed_t;
+
+typedef struct {
+  uint16_t conn_handle;
+  union {
+    ble_gap_evt_connected_t		connected;
+    ble_gap_evt_disconnected_t		disconnected;
+    ble_gap_evt_conn_param_update_t	conn_param_update;
+    ble_gap_evt_timeout_t		timeout;
+    ble_gap_evt_rssi_changed_t		rssi_changed;
+  } params;
+} ble_gap_evt_t;
+
+/* -----------------------------------------------------------------------------
+ * GATT / GATTS
+ */
+
+#define BLE_GATT_HVX_INVALID			0x00
+#define BLE_GATT_HVX_NOTIFICATION		0x01
+#define BLE_GATT_HVX_INDICATION			0x02
+
+#define BLE_GATT_STATUS_SUCCESS			0x0000
+#define BLE_GATT_STATUS_ATTERR_INVALID_HANDLE	0x0101
+#define BLE_GATT_STATUS_ATTERR_READ_NOT_PERMITTED 0x0102
+#define BLE_GATT_STATUS_ATTERR_WRITE_NOT_PERMITTED 0x0103
+#define BLE_GATT_STATUS_ATTERR_INVALID_ATT_VAL_LENGTH 0x010D
+#define BLE_GATT_STATUS_ATTERR_APP_BEGIN	0x0180
+
+#define BLE_GATT_ATT_MTU_DEFAULT		23
+
+#define BLE_GATTS_SRVC_TYPE_PRIMARY		0x01
+#define BLE_GATTS_VLOC_STACK			0x01
+#define BLE_GATTS_VLOC_USER			0x02
+#define BLE_GATTS_VAR_ATTR_LEN_MAX		512
+
+#define BLE_GATTS_OP_WRITE_REQ			0x01
+#define BLE_GATTS_OP_WRITE_CMD			0x02
+
+#define BLE_GATTS_AUTHORIZE_TYPE_INVALID	0x00
+#define BLE_GATTS_AUTHORIZE_TYPE_READ		0x01
+#define BLE_GATTS_AUTHORIZE_TYPE_WRITE		0x02
+
+#define BLE_GATTS_ATTR_TAB_SIZE_DEFAULT		0x0000
+
+typedef struct {
+  uint8_t broadcast :1;
+  uint8_t read :1;
+  uint8_t write_wo_resp :1;
+  uint8_t write :1;
+  uint8_t notify :1;
+  uint8_t indicate :1;
+  uint8_t auth_signed_wr :1;
+} ble_gatt_char_props_t;
+
+typedef struct {
+  uint8_t reliable_wr :1;
+  uint8_t wr_aux :1;
+} ble_gatt_char_ext_props_t;
+
+typedef struct {
+  ble_gap_conn_sec_mode_t read_perm;
+  ble_gap_conn_sec_mode_t write_perm;
+  uint8_t vlen :1;
+  uint8_t vloc :2;
+  uint8_t rd_auth :1;
+  uint8_t wr_auth :1;
+} ble_gatts_attr_md_t;
+
+typedef struct {
+  ble_uuid_t* p_uuid;
+  ble_gatts_attr_md_t* p_attr_md;
+  uint16_t init_len;
+  uint16_t init_offs;
+  uint16_t max_len;
+  uint8_t* p_value;
+} ble_gatts_attr_t;
+
+typedef struct {
+  ble_gatt_char_props_t char_props;
+  ble_gatt_char_ext_props_t char_ext_props;
+  uint8_t* p_char_user_desc;
+  uint16_t char_user_desc_max_size;
+  uint16_t char_user_desc_size;
+  void* p_char_pf;
+  ble_gatts_attr_md_t* p_user_desc_md;
+  ble_gatts_attr_md_t* p_cccd_md;
+  ble_gatts_attr_md_t* p_sccd_md;
+} ble_gatts_char_md_t;
+
+typedef struct {
+  uint16_t value_handle;
+  uint16_t user_desc_handle;
+  uint16_t cccd_handle;
+  uint16_t sccd_handle;
+} ble_gatts_char_handles_t;
+
+typedef struct {
+  uint16_t handle;
+  uint8_t type;
+  uint16_t offset;
+  uint16_t* p_len;
+  uint8_t* p_data;
+} ble_gatts_hvx_params_t;
+
+typedef struct {
+  uint8_t service_changed:1;
+  uint32_t attr_tab_size;
+} ble_gatts_enable_params_t;
+
+typedef struct {
+  uint16_t gatt_status;
+  uint8_t update : 1;
+  uint16_t offset;
+  uint16_t len;
+  uint8_t* p_data;
+} ble_gatts_read_authorize_params_t;
+
+typedef struct {
+  uint16_t gatt_status;
+} ble_gatts_write_authorize_params_t;
+
+typedef struct {
+  uint8_t type;
+  union {
+    ble_gatts_read_authorize_params_t read;
+    ble_gatts_write_authorize_params_t write;
+  } params;
+} ble_gatts_rw_authorize_reply_params_t;
+
+enum BLE_GATTS_EVTS {
+  BLE_GATTS_EVT_WRITE = 0x50,
+  BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST,
+  BLE_GATTS_EVT_SYS_ATTR_MISSING,
+  BLE_GATTS_EVT_HVC,
+  BLE_GATTS_EVT_SC_CONFIRM,
+  BLE_GATTS_EVT_TIMEOUT,
+};
+
+typedef struct {
+  uint16_t handle;
+  uint8_t op;
+  uint16_t offset;
+  uint16_t len;
+  uint8_t data[20];
+} ble_gatts_evt_write_t;
+
+typedef struct {
+  uint16_t handle;
+  uint16_t offset;
+} ble_gatts_evt_read_t;
+
+typedef struct {
+  uint8_t type;
+  union {
+    ble_gatts_evt_read_t read;
+    ble_gatts_evt_write_t write;
+  } request;
+} ble_gatts_evt_rw_authorize_request_t;
+
+typedef struct {
+  uint16_t handle;
+} ble_gatts_evt_hvc_t;
+
+typedef struct {
+  uint8_t hint;
+} ble_gatts_evt_sys_attr_missing_t;
+
+typedef struct {
+  uint16_t conn_handle;
+  union {
+    ble_gatts_evt_write_t			write;
+    ble_gatts_evt_rw_authorize_request_t	authorize_request;
+    ble_gatts_evt_sys_attr_missing_t		sys_attr_missing;
+    ble_gatts_evt_hvc_t				hvc;
+  } params;
+} ble_gatts_evt_t;
+
+/* -----------------------------------------------------------------------------
+ * Common
+ */
+
+enum BLE_COMMON_EVTS {
+  BLE_EVT_TX_COMPLETE = 0x01,
+  BLE_EVT_USER_MEM_REQUEST,
+  BLE_EVT_USER_MEM_RELEASE,
+};
+
+typedef struct {
+  uint8_t count;
+} ble_evt_tx_complete_t;
+
+typedef struct {
+  uint16_t conn_handle;
+  union {
+    ble_evt_tx_complete_t tx_complete;
+  } params;
+} ble_common_evt_t;
+
+typedef struct {
+  uint16_t evt_id;
+  uint16_t evt_len;
+} ble_evt_hdr_t;
+
+typedef struct {
+  ble_evt_hdr_t header;
+  union {
+    ble_common_evt_t	common_evt;
+    ble_gap_evt_t	gap_evt;
+    ble_gatts_evt_t	gatts_evt;
+  } evt;
+} ble_evt_t;
+
+typedef struct {
+  ble_gatts_enable_params_t gatts_enable_params;
+} ble_enable_params_t;
+
+/* -----------------------------------------------------------------------------
+ * SoftDevice calls, implemented by the mock SoftDevice
+ */
+
+uint32_t sd_ble_enable(ble_enable_params_t* p_ble_enable_params);
+uint32_t sd_ble_tx_buffer_count_get(uint8_t* p_count);
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const* p_vs_uuid, uint8_t* p_uuid_type);
+
+uint32_t sd_ble_gap_device_name_set(ble_gap_conn_sec_mode_t const* p_write_perm,
+                                    uint8_t const* p_dev_name, uint16_t len);
+uint32_t sd_ble_gap_appearance_set(uint16_t appearance);
+uint32_t sd_ble_gap_ppcp_set(ble_gap_conn_params_t const* p_conn_params);
+uint32_t sd_ble_gap_ppcp_get(ble_gap_conn_params_t* p_conn_params);
+uint32_t sd_ble_gap_adv_data_set(uint8_t const* p_data, uint8_t dlen,
+                                 uint8_t const* p_sr_data, uint8_t srdlen);
+uint32_t sd_ble_gap_adv_start(ble_gap_adv_params_t const* p_adv_params);
+uint32_t sd_ble_gap_adv_stop(void);
+uint32_t sd_ble_gap_conn_param_update(uint16_t conn_handle,
+                                      ble_gap_conn_params_t const* p_conn_params);
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code);
+uint32_t sd_ble_gap_sec_params_reply(uint16_t conn_handle, uint8_t sec_status,
+                                     ble_gap_sec_params_t const* p_sec_params);
+uint32_t sd_ble_gap_tx_power_set(int8_t tx_power);
+uint32_t sd_ble_gap_rssi_start(uint16_t conn_handle);
+uint32_t sd_ble_gap_rssi_stop(uint16_t conn_handle);
+
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const* p_uuid,
+                                  uint16_t* p_handle);
+uint32_t sd_ble_gatts_characteristic_add(uint16_t service_handle,
+                                         ble_gatts_char_md_t const* p_char_md,
+                                         ble_gatts_attr_t const* p_attr_char_value,
+                                         ble_gatts_char_handles_t* p_handles);
+uint32_t sd_ble_gatts_value_set(uint16_t handle, uint16_t offset,
+                                uint16_t* p_len, uint8_t const* p_value);
+uint32_t sd_ble_gatts_value_get(uint16_t handle, uint16_t offset,
+                                uint16_t* p_len, uint8_t* p_data);
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle,
+                          ble_gatts_hvx_params_t const* p_hvx_params);
+uint32_t sd_ble_gatts_rw_authorize_reply(uint16_t conn_handle,
+                                         ble_gatts_rw_authorize_reply_params_t const* p_rw_authorize_reply_params);
+uint32_t sd_ble_gatts_sys_attr_set(uint16_t conn_handle,
+                                   uint8_t const* p_sys_attr_data, uint16_t len);
+
+#endif /* MOCK_BLE_H */
@@ -0,0 +1,71 @@
+/*
+ * Host mock of the SDK advertising data encoder
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_BLE_ADVDATA_H
+#define MOCK_BLE_ADVDATA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "ble_srv_common.h"
+
+typedef enum {
+  BLE_ADVDATA_NO_NAME,
+  BLE_ADVDATA_SHORT_NAME,
+  BLE_ADVDATA_FULL_NAME
+} ble_advdata_name_type_t;
+
+typedef struct {
+  uint16_t uuid_cnt;
+  ble_uuid_t* p_uuids;
+} ble_advdata_uuid_list_t;
+
+typedef struct {
+  uint16_t min_conn_interval;
+  uint16_t max_conn_interval;
+} ble_advdata_conn_int_t;
+
+typedef struct {
+  uint16_t company_identifier;
+  uint8_array_t data;
+} ble_advdata_manuf_data_t;
+
+typedef struct {
+  ble_advdata_name_type_t name_type;
+  uint8_t short_name_len;
+  bool include_appearance;
+  uint8_array_t flags;
+  int8_t* p_tx_power_level;
+  ble_advdata_uuid_list_t uuids_more_available;
+  ble_advdata_uuid_list_t uuids_complete;
+  ble_advdata_uuid_list_t uuids_solicited;
+  ble_advdata_conn_int_t* p_slave_conn_int;
+  ble_advdata_manuf_data_t* p_manuf_specific_data;
+  void* p_service_data_array;
+  uint8_t service_data_count;
+} ble_advdata_t;
+
+uint32_t ble_advdata_set(const ble_advdata_t* p_advdata, const ble_advdata_t* p_srdata);
+
+#endif /* MOCK_BLE_ADVDATA_H */
@@ -0,0 +1,63 @@
+/*
+ * Host mock of the SDK Battery Service
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_BLE_BAS_H
+#define MOCK_BLE_BAS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "ble_srv_common.h"
+
+typedef struct ble_bas_s ble_bas_t;
+
+typedef struct {
+  int evt_type;
+} ble_bas_evt_t;
+
+typedef void (*ble_bas_evt_handler_t)(ble_bas_t* p_bas, ble_bas_evt_t* p_evt);
+
+typedef struct {
+  ble_bas_evt_handler_t evt_handler;
+  bool support_notification;
+  void* p_report_ref;
+  uint8_t initial_batt_level;
+  ble_srv_cccd_security_mode_t battery_level_char_attr_md;
+  ble_gap_conn_sec_mode_t battery_level_report_read_perm;
+} ble_bas_init_t;
+
+struct ble_bas_s {
+  ble_bas_evt_handler_t evt_handler;
+  uint16_t service_handle;
+  ble_gatts_char_handles_t battery_level_handles;
+  uint8_t battery_level_last;
+  uint16_t conn_handle;
+  bool is_notification_supported;
+};
+
+uint32_t ble_bas_init(ble_bas_t* p_bas, const ble_bas_init_t* p_bas_init);
+void ble_bas_on_ble_evt(ble_bas_t* p_bas, ble_evt_t* p_ble_evt);
+uint32_t ble_bas_battery_level_update(ble_bas_t* p_bas, uint8_t battery_level);
+
+#endif /* MOCK_BLE_BAS_H */
@@ -0,0 +1,43 @@
+/*
+ * Host mock of the SDK Device Information Service
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_BLE_DIS_H
+#define MOCK_BLE_DIS_H
+
+#include <stdint.h>
+#include "ble_srv_common.h"
+
+typedef struct {
+  ble_srv_utf8_str_t manufact_name_str;
+  ble_srv_utf8_str_t model_num_str;
+  ble_srv_utf8_str_t serial_num_str;
+  ble_srv_utf8_str_t hw_rev_str;
+  ble_srv_utf8_str_t fw_rev_str;
+  ble_srv_utf8_str_t sw_rev_str;
+  ble_srv_security_mode_t dis_attr_md;
+} ble_dis_init_t;
+
+uint32_t ble_dis_init(const ble_dis_init_t* p_dis_init);
+
+#endif /* MOCK_BLE_DIS_H */
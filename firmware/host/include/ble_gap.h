@@ -0,0 +1,2 @@
+/* Part of the host mock SoftDevice, see ble.h */
+#include "ble.h"
@@ -0,0 +1,46 @@
+/*
+ * Host mock of the SDK sensor simulator
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_BLE_SENSORSIM_H
+#define MOCK_BLE_SENSORSIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+  uint32_t min;
+  uint32_t max;
+  uint32_t incr;
+  bool start_at_max;
+} ble_sensorsim_cfg_t;
+
+typedef struct {
+  uint32_t current_val;
+  bool is_increasing;
+} ble_sensorsim_state_t;
+
+void ble_sensorsim_init(ble_sensorsim_state_t* p_state, const ble_sensorsim_cfg_t* p_cfg);
+uint32_t ble_sensorsim_measure(ble_sensorsim_state_t* p_state, const ble_sensorsim_cfg_t* p_cfg);
+
+#endif /* MOCK_BLE_SENSORSIM_H */
@@ -0,0 +1,75 @@
+/*
+ * Host mock of the SDK service helpers
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_BLE_SRV_COMMON_H
+#define MOCK_BLE_SRV_COMMON_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "ble.h"
+#include "app_util.h"
+
+#define BLE_CCCD_VALUE_LEN	2
+#define BLE_GATT_HVX_NOTIFICATION_BIT	(1 << 0)
+#define BLE_GATT_HVX_INDICATION_BIT	(1 << 1)
+
+typedef struct {
+  ble_gap_conn_sec_mode_t cccd_write_perm;
+  ble_gap_conn_sec_mode_t read_perm;
+  ble_gap_conn_sec_mode_t write_perm;
+} ble_srv_cccd_security_mode_t;
+
+typedef struct {
+  ble_gap_conn_sec_mode_t read_perm;
+  ble_gap_conn_sec_mode_t write_perm;
+} ble_srv_security_mode_t;
+
+typedef struct {
+  uint16_t length;
+  uint8_t* p_str;
+} ble_srv_utf8_str_t;
+
+typedef struct {
+  uint16_t size;
+  uint8_t* p_data;
+} uint8_array_t;
+
+static inline bool ble_srv_is_notification_enabled(uint8_t* p_encoded_data)
+{
+  return ((p_encoded_data[0] | (p_encoded_data[1] << 8)) & BLE_GATT_HVX_NOTIFICATION_BIT) != 0;
+}
+
+static inline bool ble_srv_is_indication_enabled(uint8_t* p_encoded_data)
+{
+  return ((p_encoded_data[0] | (p_encoded_data[1] << 8)) & BLE_GATT_HVX_INDICATION_BIT) != 0;
+}
+
+static inline void ble_srv_ascii_to_utf8(ble_srv_utf8_str_t* p_utf8, char* p_ascii)
+{
+  p_utf8->length = (uint16_t)strlen(p_ascii);
+  p_utf8->p_str  = (uint8_t*)p_ascii;
+}
+
+#endif /* MOCK_BLE_SRV_COMMON_H */
@@ -0,0 +1,64 @@
+/*
+ * Simulated BMP180
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef BMP180_SIM_H
+#define BMP180_SIM_H
+
+/**
+ * A BMP180 behind twi_master_transfer, for builds without the
+ * sensor. Only depends on the clock below, so it doesn't pull in the
+ * rest of the host mocks.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Conversion times are checked against this clock, which counts
+ * BMP180_SIM_TICKS_PER_SECOND. The host build provides its virtual
+ * clock here.
+ */
+#define BMP180_SIM_TICKS_PER_SECOND	32768
+
+uint64_t mock_time(void);
+
+struct bmp180_sim_stats {
+  uint32_t transfers;
+  uint32_t bytes;
+  uint32_t temperature_conversions;
+  uint32_t pressure_conversions;
+  uint32_t failed_transfers;
+  uint64_t conversion_us;	/* Time spent converting */
+  uint64_t busy_wait_us;	/* Conversion time left when results were read */
+  uint32_t overlapped;		/* Conversions started before the last was done */
+};
+
+void bmp180_sim_set(int32_t pressure, int16_t temperature);
+void bmp180_sim_present(bool present);
+void bmp180_sim_fail(uint32_t transfers);
+void bmp180_sim_spike(int32_t pressure);
+int32_t bmp180_sim_pressure(void);
+const struct bmp180_sim_stats* bmp180_sim_stats(void);
+
+#endif /* BMP180_SIM_H */
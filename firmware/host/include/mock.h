@@ -0,0 +1,134 @@
+/*
+ * Host simulation hooks
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_H
+#define MOCK_H
+
+/**
+ * Hooks between the host mocks and the simulation driver in sim.c.
+ * None of this is visible to the firmware itself.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf.h"
+#include "ble.h"
+#include "bmp180_sim.h"
+
+/**
+ * Virtual clock, in RTC1 ticks. Never wraps, unlike the 24-bit RTC
+ * the firmware sees.
+ */
+#define MOCK_TICKS_PER_SECOND	BMP180_SIM_TICKS_PER_SECOND
+#define MOCK_MS_TO_TICKS(ms)	(((uint64_t)(ms) * MOCK_TICKS_PER_SECOND) / 1000)
+
+uint64_t mock_time(void);
+void mock_time_set(uint64_t ticks);
+bool mock_timer_next(uint64_t* p_when);
+bool mock_timer_run(void);
+
+/**
+ * SoftDevice. Events are queued and handed to the application from
+ * mock_sd_dispatch, as they would be from SWI2.
+ */
+#define MOCK_TX_POWER_LEVELS	9	/* -40, -30, -20, -16 ... +4dBm */
+
+struct mock_sd_stats {
+  uint32_t notifications;
+  uint32_t indications;
+  uint32_t tx_buffers_full;
+  uint32_t connection_events;
+  uint32_t adv_starts;
+  uint32_t adv_events;
+  uint32_t conn_param_updates;
+  uint64_t tx_us[MOCK_TX_POWER_LEVELS]; /* Time on air transmitting, by level */
+  uint64_t rx_us;		/* Time on air, listening */
+  uint16_t lfclk_ppm;		/* Low frequency clock accuracy */
+  uint16_t lfclk_cal_ms;	/* RC calibration interval, zero for a crystal */
+};
+
+/**
+ * Called with what the central receives, for notifications,
+ * indications and read responses (type BLE_GATT_HVX_INVALID)
+ */
+typedef void (*mock_rx_handler_t)(uint16_t handle, uint8_t type,
+                                  const uint8_t* p_data, uint16_t len);
+
+bool mock_sd_dispatch(void);
+bool mock_sd_next(uint64_t* p_when);
+void mock_sd_run(void);
+bool mock_sd_advertising(void);
+bool mock_sd_connected(void);
+uint16_t mock_sd_conn_interval(void);
+uint16_t mock_sd_handle_find(uint8_t uuid_type, uint16_t uuid);
+uint16_t mock_sd_cccd_find(uint8_t uuid_type, uint16_t uuid);
+bool mock_sd_connect(void);
+void mock_sd_disconnect(void);
+void mock_sd_write(uint16_t handle, const uint8_t* p_data, uint16_t len);
+void mock_sd_read(uint16_t handle);
+void mock_sd_rx_handler_set(mock_rx_handler_t handler);
+void mock_sd_sys_evt(uint32_t evt_id);
+void mock_sd_rssi_set(int8_t rssi);
+const uint8_t* mock_adv_manuf_data(uint16_t* p_company, uint8_t* p_len);
+#define MOCK_FLASH_PAGE_SIZE	1024	/* As the nRF51 */
+uint8_t* mock_flash(uint32_t* p_size);
+const struct mock_sd_stats* mock_sd_stats(void);
+
+/**
+ * Peripherals the firmware drives directly
+ */
+bool mock_irq_enabled(IRQn_Type irqn);
+bool mock_adc_run(void);
+void mock_adc_set(uint8_t result);
+uint32_t mock_adc_count(void);
+void mock_button_press(uint8_t pin_no);
+
+/**
+ * Energy model. Snapshots of the activity counted by the mocks are
+ * turned into average currents.
+ */
+struct energy_activity {
+  uint64_t time;		/* Virtual ticks */
+  uint32_t wakeups;
+  uint32_t radio_events;
+  uint64_t tx_us[MOCK_TX_POWER_LEVELS];
+  uint64_t rx_us;
+  uint32_t twi_transfers;
+  uint32_t twi_bytes;
+  uint64_t conversion_us;
+  uint64_t busy_wait_us;
+  uint32_t adc_conversions;
+};
+
+void energy_wakeup(void);
+void energy_snapshot(struct energy_activity* p_activity);
+void energy_report(const char* phase, const struct energy_activity* p_from,
+                   const struct energy_activity* p_to, double battery_mah);
+
+/**
+ * Simulation driver
+ */
+void sim_wait(void);
+
+#endif /* MOCK_H */
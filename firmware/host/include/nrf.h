@@ -0,0 +1,142 @@
+/*
+ * Host mock of the nRF51 device header
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_NRF_H
+#define MOCK_NRF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Peripherals are plain structs in host memory. Only the registers
+ * the application touches are modelled.
+ */
+#define __I	volatile const
+#define __O	volatile
+#define __IO	volatile
+
+typedef struct {
+  __O  uint32_t TASKS_START, TASKS_STOP, TASKS_COUNT, TASKS_CLEAR;
+  __O  uint32_t TASKS_CAPTURE[4];
+  __IO uint32_t EVENTS_COMPARE[4];
+  __IO uint32_t SHORTS, INTENSET, INTENCLR;
+  __IO uint32_t MODE, BITMODE, PRESCALER;
+  __IO uint32_t CC[4];
+} NRF_TIMER_Type;
+
+typedef struct {
+  __O  uint32_t TASKS_START, TASKS_STOP;
+  __IO uint32_t EVENTS_END;
+  __IO uint32_t INTENSET, INTENCLR;
+  __IO uint32_t ENABLE, CONFIG, RESULT;
+} NRF_ADC_Type;
+
+typedef struct {
+  __O  uint32_t TASKS_OUT[4];
+  __IO uint32_t EVENTS_IN[4];
+  __IO uint32_t CONFIG[4];
+} NRF_GPIOTE_Type;
+
+typedef struct {
+  __IO uint32_t OUT, OUTSET, OUTCLR, IN, DIR, DIRSET, DIRCLR;
+  __IO uint32_t PIN_CNF[32];
+} NRF_GPIO_Type;
+
+typedef struct {
+  __IO uint32_t CHEN, CHENSET, CHENCLR;
+} NRF_PPI_Type;
+
+typedef struct {
+  __IO uint32_t RESETREAS, GPREGRET, DCDCEN;
+} NRF_POWER_Type;
+
+typedef struct {
+  __IO uint32_t COUNTER, PRESCALER;
+} NRF_RTC_Type;
+
+typedef struct {
+  __O  uint32_t TASKS_STARTRX, TASKS_STARTTX, TASKS_STOP, TASKS_RESUME;
+  __IO uint32_t EVENTS_STOPPED, EVENTS_RXDREADY, EVENTS_TXDSENT, EVENTS_ERROR;
+  __IO uint32_t ENABLE, PSELSCL, PSELSDA, RXD, TXD, FREQUENCY, ADDRESS;
+} NRF_TWI_Type;
+
+typedef struct {
+  __I uint32_t CODEPAGESIZE, CODESIZE;
+} NRF_FICR_Type;
+
+typedef struct {
+  __IO uint32_t BOOTLOADERADDR;
+} NRF_UICR_Type;
+
+extern NRF_TIMER_Type	mock_timer1, mock_timer2;
+extern NRF_ADC_Type	mock_adc;
+extern NRF_GPIOTE_Type	mock_gpiote;
+extern NRF_GPIO_Type	mock_gpio;
+extern NRF_PPI_Type	mock_ppi;
+extern NRF_POWER_Type	mock_power;
+extern NRF_RTC_Type	mock_rtc1;
+extern NRF_TWI_Type	mock_twi1;
+extern NRF_FICR_Type	mock_ficr;
+extern NRF_UICR_Type	mock_uicr;
+
+#define NRF_TIMER1	(&mock_timer1)
+#define NRF_TIMER2	(&mock_timer2)
+#define NRF_ADC		(&mock_adc)
+#define NRF_GPIOTE	(&mock_gpiote)
+#define NRF_GPIO	(&mock_gpio)
+#define NRF_PPI		(&mock_ppi)
+#define NRF_POWER	(&mock_power)
+#define NRF_RTC1	(&mock_rtc1)
+#define NRF_TWI1	(&mock_twi1)
+#define NRF_FICR	(&mock_ficr)
+#define NRF_UICR	(&mock_uicr)
+
+/**
+ * Interrupt numbers
+ */
+typedef enum {
+  HardFault_IRQn = -13,
+  POWER_CLOCK_IRQn = 0, RADIO_IRQn, UART0_IRQn, SPI0_TWI0_IRQn,
+  SPI1_TWI1_IRQn, GPIOTE_IRQn = 6, ADC_IRQn, TIMER0_IRQn, TIMER1_IRQn,
+  TIMER2_IRQn, RTC0_IRQn, TEMP_IRQn, RNG_IRQn, ECB_IRQn, CCM_AAR_IRQn,
+  WDT_IRQn, RTC1_IRQn, QDEC_IRQn, LPCOMP_IRQn, SWI0_IRQn, SWI1_IRQn,
+  SWI2_IRQn, SWI3_IRQn, SWI4_IRQn, SWI5_IRQn
+} IRQn_Type;
+
+/**
+ * CMSIS core intrinsics
+ */
+#define __DMB()			__sync_synchronize()
+#define __DSB()			__sync_synchronize()
+#define __WFE()			do { } while (0)
+#define __get_MSP()		((uint32_t)0)
+#define __get_IPSR()		((uint32_t)0)
+#define NVIC_ClearPendingIRQ(irq)	do { } while (0)
+#define NVIC_SetPriority(irq, priority)	do { } while (0)
+#define NVIC_EnableIRQ(irq)		do { } while (0)
+void NVIC_SystemReset(void);
+
+#include "nrf51_bitfields.h"
+
+#endif /* MOCK_NRF_H */
@@ -0,0 +1,60 @@
+/*
+ * Host mock of the nRF51 register bitfields
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_NRF51_BITFIELDS_H
+#define MOCK_NRF51_BITFIELDS_H
+
+#define ADC_INTENSET_END_Msk				(1UL)
+#define ADC_CONFIG_RES_Pos				(0UL)
+#define ADC_CONFIG_RES_8bit				(0UL)
+#define ADC_CONFIG_INPSEL_Pos				(2UL)
+#define ADC_CONFIG_INPSEL_SupplyOneThirdPrescaling	(6UL)
+#define ADC_CONFIG_REFSEL_Pos				(5UL)
+#define ADC_CONFIG_REFSEL_VBG				(0UL)
+#define ADC_CONFIG_PSEL_Pos				(8UL)
+#define ADC_CONFIG_PSEL_Disabled			(0UL)
+#define ADC_CONFIG_EXTREFSEL_Pos			(16UL)
+#define ADC_CONFIG_EXTREFSEL_None			(0UL)
+#define ADC_ENABLE_ENABLE_Enabled			(1UL)
+#define ADC_ENABLE_ENABLE_Disabled			(0UL)
+
+#define TIMER_MODE_MODE_Timer				(0UL)
+#define TIMER_BITMODE_BITMODE_16Bit			(0UL)
+#define TIMER_BITMODE_BITMODE_32Bit			(3UL)
+#define TIMER_SHORTS_COMPARE0_CLEAR_Pos			(0UL)
+#define TIMER_SHORTS_COMPARE0_CLEAR_Enabled		(1UL)
+#define TIMER_INTENSET_COMPARE2_Msk			(1UL << 18)
+
+#define GPIOTE_CONFIG_MODE_Pos				(0UL)
+#define GPIOTE_CONFIG_MODE_Disabled			(0UL)
+
+#define PPI_CHEN_CH0_Msk				(1UL)
+
+#define POWER_RESETREAS_RESETPIN_Msk			(1UL << 0)
+#define POWER_RESETREAS_DOG_Msk				(1UL << 1)
+#define POWER_RESETREAS_SREQ_Msk			(1UL << 2)
+#define POWER_RESETREAS_LOCKUP_Msk			(1UL << 3)
+#define POWER_RESETREAS_OFF_Msk				(1UL << 16)
+
+#endif /* MOCK_NRF51_BITFIELDS_H */
@@ -0,0 +1,47 @@
+/*
+ * Host mock of the nRF51 SoftDevice error codes
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_NRF_ERROR_H
+#define MOCK_NRF_ERROR_H
+
+#define NRF_SUCCESS			(0)
+#define NRF_ERROR_SVC_HANDLER_MISSING	(1)
+#define NRF_ERROR_SOFTDEVICE_NOT_ENABLED (2)
+#define NRF_ERROR_INTERNAL		(3)
+#define NRF_ERROR_NO_MEM		(4)
+#define NRF_ERROR_NOT_FOUND		(5)
+#define NRF_ERROR_NOT_SUPPORTED		(6)
+#define NRF_ERROR_INVALID_PARAM		(7)
+#define NRF_ERROR_INVALID_STATE		(8)
+#define NRF_ERROR_INVALID_LENGTH	(9)
+#define NRF_ERROR_INVALID_FLAGS		(10)
+#define NRF_ERROR_INVALID_DATA		(11)
+#define NRF_ERROR_DATA_SIZE		(12)
+#define NRF_ERROR_TIMEOUT		(13)
+#define NRF_ERROR_NULL			(14)
+#define NRF_ERROR_FORBIDDEN		(15)
+#define NRF_ERROR_INVALID_ADDR		(16)
+#define NRF_ERROR_BUSY			(17)
+
+#endif /* MOCK_NRF_ERROR_H */
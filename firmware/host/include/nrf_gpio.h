@@ -0,0 +1,70 @@
+/*
+ * Host mock of the SDK GPIO helpers
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_NRF_GPIO_H
+#define MOCK_NRF_GPIO_H
+
+#include <stdint.h>
+#include "nrf.h"
+
+typedef enum {
+  NRF_GPIO_PIN_NOPULL   = 0,
+  NRF_GPIO_PIN_PULLDOWN = 1,
+  NRF_GPIO_PIN_PULLUP   = 3
+} nrf_gpio_pin_pull_t;
+
+typedef enum {
+  NRF_GPIO_PIN_NOSENSE    = 0,
+  NRF_GPIO_PIN_SENSE_LOW  = 3,
+  NRF_GPIO_PIN_SENSE_HIGH = 2
+} nrf_gpio_pin_sense_t;
+
+static inline void nrf_gpio_cfg_output(uint32_t pin_number)
+{
+  NRF_GPIO->DIRSET = (1UL << pin_number);
+}
+static inline void nrf_gpio_cfg_input(uint32_t pin_number, nrf_gpio_pin_pull_t pull_config)
+{
+  NRF_GPIO->PIN_CNF[pin_number] = pull_config;
+}
+static inline void nrf_gpio_cfg_sense_input(uint32_t pin_number,
+                                            nrf_gpio_pin_pull_t pull_config,
+                                            nrf_gpio_pin_sense_t sense_config)
+{
+  NRF_GPIO->PIN_CNF[pin_number] = (sense_config << 16) | pull_config;
+}
+static inline void nrf_gpio_pin_set(uint32_t pin_number)
+{
+  NRF_GPIO->OUTSET = (1UL << pin_number);
+}
+static inline void nrf_gpio_pin_clear(uint32_t pin_number)
+{
+  NRF_GPIO->OUTCLR = (1UL << pin_number);
+}
+static inline uint32_t nrf_gpio_pin_read(uint32_t pin_number)
+{
+  return ((NRF_GPIO->IN >> pin_number) & 1UL);
+}
+
+#endif /* MOCK_NRF_GPIO_H */
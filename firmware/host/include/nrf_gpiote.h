@@ -0,0 +1,50 @@
+/*
+ * Host mock of the SDK GPIOTE helpers
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_NRF_GPIOTE_H
+#define MOCK_NRF_GPIOTE_H
+
+#include <stdint.h>
+#include "nrf.h"
+
+typedef enum {
+  NRF_GPIOTE_POLARITY_LOTOHI = 1,
+  NRF_GPIOTE_POLARITY_HITOLO,
+  NRF_GPIOTE_POLARITY_TOGGLE
+} nrf_gpiote_polarity_t;
+
+typedef enum {
+  NRF_GPIOTE_INITIAL_VALUE_LOW,
+  NRF_GPIOTE_INITIAL_VALUE_HIGH
+} nrf_gpiote_outinit_t;
+
+static inline void nrf_gpiote_task_config(uint32_t channel_number, uint32_t pin_number,
+                                          nrf_gpiote_polarity_t polarity,
+                                          nrf_gpiote_outinit_t initial_value)
+{
+  NRF_GPIOTE->CONFIG[channel_number] = (pin_number << 8) | (polarity << 16) | 3;
+  (void)initial_value;
+}
+
+#endif /* MOCK_NRF_GPIOTE_H */
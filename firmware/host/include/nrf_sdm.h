@@ -0,0 +1,48 @@
+/*
+ * Host mock of the nRF51 SoftDevice manager
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_NRF_SDM_H
+#define MOCK_NRF_SDM_H
+
+#include <stdint.h>
+
+typedef enum {
+  NRF_CLOCK_LFCLKSRC_SYNTH_250_PPM,
+  NRF_CLOCK_LFCLKSRC_XTAL_500_PPM,
+  NRF_CLOCK_LFCLKSRC_XTAL_250_PPM,
+  NRF_CLOCK_LFCLKSRC_XTAL_150_PPM,
+  NRF_CLOCK_LFCLKSRC_XTAL_100_PPM,
+  NRF_CLOCK_LFCLKSRC_XTAL_75_PPM,
+  NRF_CLOCK_LFCLKSRC_XTAL_50_PPM,
+  NRF_CLOCK_LFCLKSRC_XTAL_30_PPM,
+  NRF_CLOCK_LFCLKSRC_XTAL_20_PPM,
+  NRF_CLOCK_LFCLKSRC_RC_250_PPM_250MS_CALIBRATION,
+  NRF_CLOCK_LFCLKSRC_RC_250_PPM_500MS_CALIBRATION,
+  NRF_CLOCK_LFCLKSRC_RC_250_PPM_1000MS_CALIBRATION,
+  NRF_CLOCK_LFCLKSRC_RC_250_PPM_2000MS_CALIBRATION,
+  NRF_CLOCK_LFCLKSRC_RC_250_PPM_4000MS_CALIBRATION,
+  NRF_CLOCK_LFCLKSRC_RC_250_PPM_8000MS_CALIBRATION,
+} nrf_clock_lfclksrc_t;
+
+#endif /* MOCK_NRF_SDM_H */
@@ -0,0 +1,98 @@
+/*
+ * Host mock of the nRF51 SoftDevice SoC API
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_NRF_SOC_H
+#define MOCK_NRF_SOC_H
+
+#include <stdint.h>
+#include "nrf.h"
+#include "nrf_error.h"
+
+enum NRF_SOC_EVTS {
+  NRF_EVT_HFCLKSTARTED,
+  NRF_EVT_POWER_FAILURE_WARNING,
+  NRF_EVT_FLASH_OPERATION_SUCCESS,
+  NRF_EVT_FLASH_OPERATION_ERROR,
+  NRF_EVT_RADIO_BLOCKED,
+  NRF_EVT_RADIO_CANCELED,
+  NRF_EVT_RADIO_SIGNAL_CALLBACK_INVALID_RETURN,
+  NRF_EVT_RADIO_SESSION_IDLE,
+  NRF_EVT_RADIO_SESSION_CLOSED,
+  NRF_EVT_NUMBER_OF_EVTS
+};
+
+#define NRF_APP_PRIORITY_HIGH	1
+#define NRF_APP_PRIORITY_LOW	3
+
+typedef enum {
+  NRF_POWER_DCDC_MODE_OFF,
+  NRF_POWER_DCDC_MODE_ON,
+  NRF_POWER_DCDC_MODE_AUTOMATIC
+} nrf_power_dcdc_mode_t;
+
+typedef enum {
+  NRF_RADIO_NOTIFICATION_DISTANCE_NONE = 0,
+  NRF_RADIO_NOTIFICATION_DISTANCE_800US,
+  NRF_RADIO_NOTIFICATION_DISTANCE_1740US,
+  NRF_RADIO_NOTIFICATION_DISTANCE_2680US,
+  NRF_RADIO_NOTIFICATION_DISTANCE_3620US,
+  NRF_RADIO_NOTIFICATION_DISTANCE_4560US,
+  NRF_RADIO_NOTIFICATION_DISTANCE_5500US
+} nrf_radio_notification_distance_t;
+
+typedef enum {
+  NRF_RADIO_NOTIFICATION_TYPE_NONE = 0,
+  NRF_RADIO_NOTIFICATION_TYPE_INT_ON_ACTIVE,
+  NRF_RADIO_NOTIFICATION_TYPE_INT_ON_INACTIVE,
+  NRF_RADIO_NOTIFICATION_TYPE_INT_ON_BOTH
+} nrf_radio_notification_type_t;
+
+uint32_t sd_app_evt_wait(void);
+uint32_t sd_evt_get(uint32_t* p_evt_id);
+
+uint32_t sd_power_system_off(void);
+uint32_t sd_power_dcdc_mode_set(nrf_power_dcdc_mode_t dcdc_mode);
+uint32_t sd_power_reset_reason_get(uint32_t* p_reset_reason);
+uint32_t sd_power_reset_reason_clr(uint32_t reset_reason_clr_msk);
+uint32_t sd_power_gpregret_set(uint32_t gpregret_msk);
+uint32_t sd_power_gpregret_clr(uint32_t gpregret_msk);
+uint32_t sd_power_gpregret_get(uint32_t* p_gpregret);
+
+uint32_t sd_radio_notification_cfg_set(nrf_radio_notification_type_t type,
+                                       nrf_radio_notification_distance_t distance);
+
+uint32_t sd_ppi_channel_assign(uint8_t channel_num, const volatile void* evt_endpoint,
+                               const volatile void* task_endpoint);
+uint32_t sd_ppi_channel_enable_set(uint32_t channel_enable_set_msk);
+uint32_t sd_ppi_channel_enable_clr(uint32_t channel_enable_clr_msk);
+
+uint32_t sd_nvic_EnableIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_DisableIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_ClearPendingIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_SetPendingIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_SetPriority(IRQn_Type IRQn, uint32_t priority);
+uint32_t sd_nvic_critical_region_enter(uint8_t* p_is_nested_critical_region);
+uint32_t sd_nvic_critical_region_exit(uint8_t is_nested_critical_region);
+
+#endif /* MOCK_NRF_SOC_H */
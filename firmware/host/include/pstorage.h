@@ -0,0 +1,62 @@
+/*
+ * Host mock of the SDK persistent storage
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_PSTORAGE_H
+#define MOCK_PSTORAGE_H
+
+#include <stdint.h>
+#include "nrf_error.h"
+#include "pstorage_platform.h"
+
+#define PSTORAGE_ERROR_OP_CODE		0x01
+#define PSTORAGE_STORE_OP_CODE		0x02
+#define PSTORAGE_LOAD_OP_CODE		0x03
+#define PSTORAGE_CLEAR_OP_CODE		0x04
+#define PSTORAGE_UPDATE_OP_CODE		0x05
+
+typedef void (*pstorage_ntf_cb_t)(pstorage_handle_t* p_handle, uint8_t op_code,
+                                  uint32_t result, uint8_t* p_data, uint32_t data_len);
+
+typedef struct {
+  pstorage_ntf_cb_t cb;
+  pstorage_size_t block_size;
+  pstorage_size_t block_count;
+} pstorage_module_param_t;
+
+uint32_t pstorage_init(void);
+uint32_t pstorage_register(pstorage_module_param_t* p_module_param,
+                           pstorage_handle_t* p_block_id);
+uint32_t pstorage_block_identifier_get(pstorage_handle_t* p_base_id,
+                                       pstorage_size_t block_num,
+                                       pstorage_handle_t* p_block_id);
+uint32_t pstorage_store(pstorage_handle_t* p_dest, uint8_t* p_src,
+                        pstorage_size_t size, pstorage_size_t offset);
+uint32_t pstorage_update(pstorage_handle_t* p_dest, uint8_t* p_src,
+                         pstorage_size_t size, pstorage_size_t offset);
+uint32_t pstorage_load(uint8_t* p_dest, pstorage_handle_t* p_src,
+                       pstorage_size_t size, pstorage_size_t offset);
+uint32_t pstorage_clear(pstorage_handle_t* p_base_id, pstorage_size_t size);
+uint32_t pstorage_access_status_get(uint32_t* p_count);
+
+#endif /* MOCK_PSTORAGE_H */
@@ -0,0 +1,45 @@
+/*
+ * Host mock of the SDK SoftDevice handler
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MOCK_SOFTDEVICE_HANDLER_H
+#define MOCK_SOFTDEVICE_HANDLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf_sdm.h"
+#include "nrf_soc.h"
+#include "ble.h"
+
+typedef void (*ble_evt_handler_t)(ble_evt_t* p_ble_evt);
+typedef void (*sys_evt_handler_t)(uint32_t evt_id);
+
+void mock_softdevice_enable(nrf_clock_lfclksrc_t clock_source);
+
+#define SOFTDEVICE_HANDLER_INIT(CLOCK_SOURCE, USE_SCHEDULER)	\
+  mock_softdevice_enable(CLOCK_SOURCE)
+
+uint32_t softdevice_ble_evt_handler_set(ble_evt_handler_t ble_evt_handler);
+uint32_t softdevice_sys_evt_handler_set(sys_evt_handler_t sys_evt_handler);
+
+#endif /* MOCK_SOFTDEVICE_HANDLER_H */
@@ -0,0 +1,281 @@
+/*
+ * Simulated BMP180 on the host TWI bus
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Stands in for twi_hw_master.c. The BMP180 register model answers at
+ * its usual address with the example calibration from the datasheet,
+ * and conversions produce the raw values that compensate back to
+ * whatever pressure and temperature the simulation has set.
+ *
+ * Virtual time doesn't move while the firmware spins in delay_us, so
+ * in the host simulation a result read before its conversion time is
+ * up means the firmware busy-waited for the rest. That goes in the
+ * stats for the energy model. Against a real clock it means the
+ * result was read too early.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "twi_master.h"
+#include "bmp180_sim.h"
+
+#define BMP180_ADDRESS		0xEE
+#define REG_CALIBRATION		0xAA
+#define REG_ID			0xD0
+#define REG_CTRLMEAS		0xF4
+#define REG_OUT			0xF6
+
+#define CMD_TEMPERATURE		0x2E
+#define CMD_PRESSURE		0x34
+
+#define TEMPERATURE_US		4500
+
+/**
+ * Datasheet example calibration
+ */
+static const int16_t AC1 = 408, AC2 = -72, AC3 = -14383, B1 = 6190, B2 = 4;
+static const int16_t MB = -32768, MC = -8711, MD = 2868;
+static const uint16_t AC4 = 32741, AC5 = 32757, AC6 = 23153;
+
+static uint8_t regs[256];
+static uint8_t pointer;
+
+static bool present = true;
+static uint32_t fail_transfers;
+static int32_t spike;			/* Pa, on the next pressure conversion */
+static int32_t env_pressure = 101325;	/* Pa */
+static int16_t env_temperature = 200;	/* 0.1°C */
+
+static const uint32_t pressure_us[] = { 4500, 7500, 13500, 25500 };
+static uint64_t conversion_at;		/* Virtual time of the last start */
+static uint32_t conversion_us;		/* How long it takes */
+static bool converting;
+
+static struct bmp180_sim_stats stats;
+
+/* -----------------------------------------------------------------------------
+ * Datasheet compensation, run backwards
+ */
+
+static int32_t b5_from_ut(int32_t ut) {
+  int32_t x1 = ((ut - AC6) * AC5) >> 15;
+  int32_t x2 = (MC * 2048) / (x1 + MD);
+
+  return x1 + x2;
+}
+static int32_t pressure_from_up(int32_t up, int32_t b5, uint8_t oss) {
+  int64_t b6, x1, x2, x3, b3, p;
+  uint64_t b4, b7;
+
+  b6 = b5 - 4000;
+  x1 = (B2 * ((b6 * b6) >> 12)) >> 11;
+  x2 = (AC2 * b6) >> 11;
+  x3 = x1 + x2;
+  b3 = ((((int64_t)AC1 * 4 + x3) << oss) + 2) >> 2;
+  x1 = (AC3 * b6) >> 13;
+  x2 = (B1 * ((b6 * b6) >> 12)) >> 16;
+  x3 = ((x1 + x2) + 2) >> 2;
+  b4 = (AC4 * (uint64_t)(x3 + 32768)) >> 15;
+  b7 = (uint64_t)(up - b3) * (50000 >> oss);
+
+  p = (b7 < 0x80000000) ? (int64_t)((b7 << 1) / b4) : (int64_t)((b7 / b4) << 1);
+
+  x1 = (p >> 8) * (p >> 8);
+  x1 = (x1 * 3038) >> 16;
+  x2 = (-7357 * p) >> 16;
+
+  return (int32_t)(p + ((x1 + x2 + 3791) >> 4));
+}
+/**
+ * Smallest raw temperature that reads as the set temperature
+ */
+static int32_t ut_for(int16_t temperature) {
+  int32_t lo = 0, hi = 0xFFFF, mid;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (((b5_from_ut(mid) + 8) >> 4) < temperature) lo = mid + 1; else hi = mid;
+  }
+
+  return lo;
+}
+/**
+ * Raw pressure that reads closest to the set pressure. The datasheet's
+ * second order correction jumps by 2 or 3Pa every 256 steps of the
+ * first order result, so some pressures can't be read exactly.
+ */
+static int32_t up_for(int32_t pressure, uint8_t oss) {
+  int32_t b5 = b5_from_ut(ut_for(env_temperature));
+  int32_t lo = 0, hi = (1L << (16 + oss)) - 1, mid;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (pressure_from_up(mid, b5, oss) < pressure) lo = mid + 1; else hi = mid;
+  }
+
+  if (lo > 0 && pressure - pressure_from_up(lo - 1, b5, oss) <
+      pressure_from_up(lo, b5, oss) - pressure) {
+    return lo - 1;
+  }
+  return lo;
+}
+
+/* -----------------------------------------------------------------------------
+ * Register model
+ */
+
+static void put_16(uint8_t reg, uint16_t value) {
+  regs[reg] = value >> 8;
+  regs[reg + 1] = value & 0xFF;
+}
+static void reset(void) {
+  memset(regs, 0, sizeof(regs));
+
+  put_16(REG_CALIBRATION + 0, AC1);
+  put_16(REG_CALIBRATION + 2, AC2);
+  put_16(REG_CALIBRATION + 4, AC3);
+  put_16(REG_CALIBRATION + 6, AC4);
+  put_16(REG_CALIBRATION + 8, AC5);
+  put_16(REG_CALIBRATION + 10, AC6);
+  put_16(REG_CALIBRATION + 12, B1);
+  put_16(REG_CALIBRATION + 14, B2);
+  put_16(REG_CALIBRATION + 16, MB);
+  put_16(REG_CALIBRATION + 18, MC);
+  put_16(REG_CALIBRATION + 20, MD);
+  regs[REG_ID] = 0x55;
+}
+/**
+ * Conversions finish straight away, the firmware does the waiting.
+ * Starting one before the last is done would lose the last on the
+ * chip, so that goes in the stats.
+ */
+static void ctrl_meas(uint8_t command) {
+  uint8_t oss = command >> 6;
+  uint32_t up;
+
+  if (converting &&
+      ((mock_time() - conversion_at) * 1000000) / BMP180_SIM_TICKS_PER_SECOND < conversion_us) {
+    stats.overlapped++;
+  }
+
+  if (command == CMD_TEMPERATURE) {
+    put_16(REG_OUT, ut_for(env_temperature));
+    stats.temperature_conversions++;
+    conversion_us = TEMPERATURE_US;
+  } else if ((command & 0x3F) == CMD_PRESSURE) {
+    up = (uint32_t)up_for(env_pressure + spike, oss) << (8 - oss);
+    spike = 0;
+    regs[REG_OUT] = up >> 16;
+    regs[REG_OUT + 1] = (up >> 8) & 0xFF;
+    regs[REG_OUT + 2] = up & 0xFF;
+    stats.pressure_conversions++;
+    conversion_us = pressure_us[oss];
+  } else {
+    return;
+  }
+
+  stats.conversion_us += conversion_us;
+  conversion_at = mock_time();
+  converting = true;
+}
+/**
+ * Called when the result registers are addressed
+ */
+static void result_read(void) {
+  uint64_t elapsed_us;
+
+  if (!converting) return;
+  converting = false;
+
+  elapsed_us = ((mock_time() - conversion_at) * 1000000) / BMP180_SIM_TICKS_PER_SECOND;
+  if (elapsed_us < conversion_us) {
+    stats.busy_wait_us += conversion_us - elapsed_us;
+  }
+}
+
+/* -----------------------------------------------------------------------------
+ * TWI API
+ */
+
+bool twi_master_init(void) {
+  if (regs[REG_ID] == 0) reset();
+
+  return present;
+}
+bool twi_master_transfer(uint8_t address, uint8_t* data, uint8_t data_length,
+                         bool issue_stop_condition) {
+  uint8_t i;
+
+  stats.transfers++;
+  stats.bytes += 1 + data_length;
+
+  if (!present || (address & ~TWI_READ_BIT) != BMP180_ADDRESS || data_length == 0) {
+    stats.failed_transfers++;
+    return false;
+  }
+  if (fail_transfers) {
+    fail_transfers--;
+    stats.failed_transfers++;
+    return false;
+  }
+
+  if (address & TWI_READ_BIT) {
+    for (i = 0; i < data_length; i++) data[i] = regs[pointer++];
+  } else {
+    pointer = data[0];
+    if (pointer == REG_OUT) result_read();
+    for (i = 1; i < data_length; i++) {
+      if (pointer == REG_CTRLMEAS) ctrl_meas(data[i]);
+      pointer++;
+    }
+  }
+
+  return true;
+}
+
+/* -----------------------------------------------------------------------------
+ * Simulation hooks
+ */
+
+void bmp180_sim_set(int32_t pressure, int16_t temperature) {
+  env_pressure = pressure;
+  env_temperature = temperature;
+}
+void bmp180_sim_present(bool is_present) {
+  present = is_present;
+}
+void bmp180_sim_fail(uint32_t transfers) {
+  fail_transfers = transfers;
+}
+void bmp180_sim_spike(int32_t pressure) {
+  spike = pressure;
+}
+int32_t bmp180_sim_pressure(void) {
+  return env_pressure;
+}
+const struct bmp180_sim_stats* bmp180_sim_stats(void) {
+  return &stats;
+}
@@ -0,0 +1,195 @@
+/*
+ * Energy model for the host simulation
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Turns the activity counted by the mocks into current. The firmware
+ * runs its real schedule in the simulation, so all that's modelled
+ * here is what each thing costs.
+ *
+ * Currents are typical figures from the nRF51822 product
+ * specification, the BMP180 and TLV70033 datasheets, rounded. Good
+ * enough to compare configurations, not to replace a measurement.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "nrf.h"
+#include "mock.h"
+
+/**
+ * nRF51822, µA at 3V
+ */
+#define SLEEP_UA		2.6	/* System ON, RTC running, RAM retained */
+#define LFXO_UA			0.4
+#define LFRC_UA			0.8
+#define CPU_UA			4400.0	/* Running from flash */
+#define HFXO_UA			470.0
+#define RX_UA			13000.0
+#define ADC_UA			260.0
+#define DCDC_FACTOR		0.75	/* On the CPU and radio, when enabled */
+
+static const double tx_ua[MOCK_TX_POWER_LEVELS] = {
+  5200.0, 5500.0, 6500.0, 7000.0, 7500.0, 8000.0, 8800.0, 10500.0, 16000.0,
+};
+
+/**
+ * Time taken, µs
+ */
+#define WAKEUP_US		50.0	/* Into an interrupt handler and back */
+#define RADIO_STARTUP_US	1500.0	/* HFXO and radio ramp up, per event */
+#define RADIO_CPU_US		350.0	/* Stack processing, per event */
+#define RC_CAL_US		1000.0	/* HFXO running for an LFRC calibration */
+#define ADC_US			20.0	/* 8-bit conversion */
+#define TWI_BYTE_US		90.0	/* Nine bits at 100kHz, the CPU polls */
+#define TWI_TRANSFER_US		20.0	/* Start, stop and the driver */
+
+/**
+ * BMP180 and the LDO, µA
+ */
+#define BMP180_CONVERT_UA	650.0
+#define BMP180_STANDBY_UA	0.1
+#define LDO_UA			31.0	/* TLV70033 quiescent */
+
+static uint32_t wakeups;
+
+/**
+ * Called each time the firmware wakes from sd_app_evt_wait
+ */
+void energy_wakeup(void) {
+  wakeups++;
+}
+/**
+ * Everything counted so far
+ */
+void energy_snapshot(struct energy_activity* p_activity) {
+  const struct mock_sd_stats* sd = mock_sd_stats();
+  const struct bmp180_sim_stats* bmp = bmp180_sim_stats();
+  uint8_t i;
+
+  p_activity->time = mock_time();
+  p_activity->wakeups = wakeups;
+  p_activity->radio_events = sd->adv_events + sd->connection_events;
+  for (i = 0; i < MOCK_TX_POWER_LEVELS; i++) {
+    p_activity->tx_us[i] = sd->tx_us[i];
+  }
+  p_activity->rx_us = sd->rx_us;
+  p_activity->twi_transfers = bmp->transfers;
+  p_activity->twi_bytes = bmp->bytes;
+  p_activity->conversion_us = bmp->conversion_us;
+  p_activity->busy_wait_us = bmp->busy_wait_us;
+  p_activity->adc_conversions = mock_adc_count();
+}
+
+/* -----------------------------------------------------------------------------
+ * Report
+ */
+
+static void line(const char* name, double active_us, double charge, double period_us) {
+  printf("energy:   %-10s %7.3f%% %10.2fuA\n",
+         name, 100.0 * active_us / period_us, charge / period_us);
+}
+/**
+ * Prints the average current of each subsystem between two snapshots,
+ * and how long a battery would last at that rate.
+ */
+void energy_report(const char* phase, const struct energy_activity* p_from,
+                   const struct energy_activity* p_to, double battery_mah) {
+  const struct mock_sd_stats* sd = mock_sd_stats();
+  double period_us = ((double)(p_to->time - p_from->time) * 1000000) / MOCK_TICKS_PER_SECOND;
+  double dcdc = NRF_POWER->DCDCEN ? DCDC_FACTOR : 1.0;
+  double cpu_ua = CPU_UA * dcdc;
+  double active, charge, total = 0;
+  uint32_t events = p_to->radio_events - p_from->radio_events;
+  uint8_t i;
+
+  if (period_us <= 0) return;
+
+  printf("energy: %s, %.1fs, DCDC %s, LFCLK %uppm%s\n", phase, period_us / 1000000,
+         NRF_POWER->DCDCEN ? "on" : "off", sd->lfclk_ppm, sd->lfclk_cal_ms ? " RC" : "");
+  printf("energy:   %-10s %8s %12s\n", "", "duty", "average");
+
+  /* Charge in µA·µs */
+  charge = SLEEP_UA * period_us;
+  line("sleep", period_us, charge, period_us);
+  total += charge;
+
+  if (sd->lfclk_cal_ms) {
+    active = (period_us / (sd->lfclk_cal_ms * 1000.0)) * RC_CAL_US;
+    charge = LFRC_UA * period_us + HFXO_UA * active;
+  } else {
+    active = period_us;
+    charge = LFXO_UA * period_us;
+  }
+  line("lfclk", active, charge, period_us);
+  total += charge;
+
+  active = (p_to->wakeups - p_from->wakeups) * WAKEUP_US;
+  charge = cpu_ua * active;
+  line("cpu", active, charge, period_us);
+  total += charge;
+
+  active = p_to->busy_wait_us - p_from->busy_wait_us;
+  charge = cpu_ua * active;
+  line("busy wait", active, charge, period_us);
+  total += charge;
+
+  active = 0;
+  charge = 0;
+  for (i = 0; i < MOCK_TX_POWER_LEVELS; i++) {
+    active += p_to->tx_us[i] - p_from->tx_us[i];
+    charge += tx_ua[i] * dcdc * (p_to->tx_us[i] - p_from->tx_us[i]);
+  }
+  active += p_to->rx_us - p_from->rx_us;
+  charge += RX_UA * dcdc * (p_to->rx_us - p_from->rx_us);
+  charge += events * (HFXO_UA * RADIO_STARTUP_US + cpu_ua * RADIO_CPU_US);
+  active += events * (RADIO_STARTUP_US + RADIO_CPU_US);
+  line("radio", active, charge, period_us);
+  total += charge;
+
+  active = (p_to->twi_transfers - p_from->twi_transfers) * TWI_TRANSFER_US +
+    (p_to->twi_bytes - p_from->twi_bytes) * TWI_BYTE_US;
+  charge = cpu_ua * active;
+  line("twi", active, charge, period_us);
+  total += charge;
+
+  active = p_to->conversion_us - p_from->conversion_us;
+  charge = BMP180_CONVERT_UA * active + BMP180_STANDBY_UA * period_us;
+  line("bmp180", active, charge, period_us);
+  total += charge;
+
+  active = (p_to->adc_conversions - p_from->adc_conversions) * ADC_US;
+  charge = ADC_UA * active;
+  line("adc", active, charge, period_us);
+  total += charge;
+
+  charge = LDO_UA * period_us;
+  line("ldo", period_us, charge, period_us);
+  total += charge;
+
+  total /= period_us;
+  printf("energy:   %-10s %8s %10.2fuA, %.0f days from %.0fmAh\n", "total", "",
+         total, battery_mah * 1000 / total / 24, battery_mah);
+}
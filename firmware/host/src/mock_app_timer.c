@@ -0,0 +1,166 @@
+/*
+ * Host mock of app_timer against a virtual clock
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Timers run against a virtual RTC1 that only moves when the
+ * simulation driver moves it, so hours of firmware time pass in
+ * milliseconds. The behaviour the firmware relies on is kept: the
+ * counter is 24 bits wide, timeouts have the same limits, and single
+ * shot timers stop themselves.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "app_timer.h"
+#include "mock.h"
+
+#define MAX_TIMERS		16
+#define RTC_MASK		0x00FFFFFF
+
+struct timer {
+  app_timer_mode_t mode;
+  app_timer_timeout_handler_t handler;
+  void* p_context;
+  uint32_t period;
+  uint64_t expiry;
+  bool running;
+};
+
+static struct timer timers[MAX_TIMERS];
+static uint8_t timer_count;
+static uint8_t max_timers;
+static uint64_t now;
+
+uint64_t mock_time(void) {
+  return now;
+}
+void mock_time_set(uint64_t ticks) {
+  if (ticks > now) now = ticks;
+}
+/**
+ * Finds when the next timer expires
+ */
+bool mock_timer_next(uint64_t* p_when) {
+  bool found = false;
+  uint8_t i;
+
+  for (i = 0; i < timer_count; i++) {
+    if (timers[i].running && (!found || timers[i].expiry < *p_when)) {
+      *p_when = timers[i].expiry;
+      found = true;
+    }
+  }
+
+  return found;
+}
+/**
+ * Runs the handler of the first timer due, if there is one
+ */
+bool mock_timer_run(void) {
+  struct timer* t = NULL;
+  uint8_t i;
+
+  for (i = 0; i < timer_count; i++) {
+    if (timers[i].running && timers[i].expiry <= now &&
+        (t == NULL || timers[i].expiry < t->expiry)) {
+      t = &timers[i];
+    }
+  }
+  if (t == NULL) return false;
+
+  if (t->mode == APP_TIMER_MODE_REPEATED) {
+    t->expiry += t->period;
+  } else {
+    t->running = false;
+  }
+  t->handler(t->p_context);
+
+  return true;
+}
+
+uint32_t app_timer_init(uint32_t prescaler, uint8_t max, uint8_t op_queues_size,
+                        void* p_buffer, void* evt_schedule_func) {
+  if (prescaler != 0 || max > MAX_TIMERS) return NRF_ERROR_INVALID_PARAM;
+
+  memset(timers, 0, sizeof(timers));
+  timer_count = 0;
+  max_timers = max;
+
+  return NRF_SUCCESS;
+}
+uint32_t app_timer_create(app_timer_id_t* p_timer_id, app_timer_mode_t mode,
+                          app_timer_timeout_handler_t timeout_handler) {
+  if (p_timer_id == NULL || timeout_handler == NULL) return NRF_ERROR_NULL;
+  if (timer_count >= max_timers) return NRF_ERROR_NO_MEM;
+
+  timers[timer_count].mode = mode;
+  timers[timer_count].handler = timeout_handler;
+  *p_timer_id = timer_count++;
+
+  return NRF_SUCCESS;
+}
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void* p_context) {
+  struct timer* t;
+
+  if (timer_id >= timer_count) return NRF_ERROR_INVALID_PARAM;
+  if (timeout_ticks < APP_TIMER_MIN_TIMEOUT_TICKS ||
+      timeout_ticks > RTC_MASK) return NRF_ERROR_INVALID_PARAM;
+
+  t = &timers[timer_id];
+  t->period = timeout_ticks;
+  t->expiry = now + timeout_ticks;
+  t->p_context = p_context;
+  t->running = true;
+
+  return NRF_SUCCESS;
+}
+uint32_t app_timer_stop(app_timer_id_t timer_id) {
+  if (timer_id >= timer_count) return NRF_ERROR_INVALID_PARAM;
+
+  timers[timer_id].running = false;
+
+  return NRF_SUCCESS;
+}
+uint32_t app_timer_stop_all(void) {
+  uint8_t i;
+
+  for (i = 0; i < timer_count; i++) {
+    timers[i].running = false;
+  }
+
+  return NRF_SUCCESS;
+}
+uint32_t app_timer_cnt_get(uint32_t* p_ticks) {
+  *p_ticks = (uint32_t)(now & RTC_MASK);
+
+  return NRF_SUCCESS;
+}
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from,
+                                    uint32_t* p_ticks_diff) {
+  *p_ticks_diff = (ticks_to - ticks_from) & RTC_MASK;
+
+  return NRF_SUCCESS;
+}
@@ -0,0 +1,656 @@
+/*
+ * Host stand-ins for the nRF51 SDK libraries and peripherals
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * The SDK libraries the application links against, cut down to what
+ * it uses. Where the real library talks to the SoftDevice so does
+ * its stand-in, so the mock SoftDevice sees the same calls.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "app_timer.h"
+#include "app_button.h"
+#include "ble.h"
+#include "ble_srv_common.h"
+#include "ble_advdata.h"
+#include "ble_bas.h"
+#include "ble_dis.h"
+#include "ble_conn_params.h"
+#include "ble_debug_assert_handler.h"
+#include "device_manager.h"
+#include "pstorage.h"
+#include "crc16.h"
+#include "ble_sensorsim.h"
+#include "nrf_delay.h"
+#include "mock.h"
+
+void ADC_IRQHandler(void);
+
+/* -----------------------------------------------------------------------------
+ * Peripherals
+ */
+
+NRF_TIMER_Type	mock_timer1, mock_timer2;
+NRF_ADC_Type	mock_adc;
+NRF_GPIOTE_Type	mock_gpiote;
+NRF_GPIO_Type	mock_gpio = { .IN = 0xFFFFFFFF }; /* Buttons have pull-ups */
+NRF_PPI_Type	mock_ppi;
+NRF_POWER_Type	mock_power;
+NRF_RTC_Type	mock_rtc1;
+NRF_TWI_Type	mock_twi1;
+NRF_FICR_Type	mock_ficr = { .CODEPAGESIZE = 1024, .CODESIZE = 256 };
+NRF_UICR_Type	mock_uicr = { .BOOTLOADERADDR = 0xFFFFFFFF };
+
+/**
+ * About 3.0V on the supply
+ */
+static uint8_t adc_result = 193;
+static uint32_t adc_count;
+
+void mock_adc_set(uint8_t result) {
+  adc_result = result;
+}
+uint32_t mock_adc_count(void) {
+  return adc_count;
+}
+/**
+ * Finishes an ADC conversion if one has been started
+ */
+bool mock_adc_run(void) {
+  if (!mock_adc.TASKS_START || !mock_adc.ENABLE) return false;
+
+  mock_adc.TASKS_START = 0;
+  mock_adc.RESULT = adc_result;
+  mock_adc.EVENTS_END = 1;
+  adc_count++;
+
+  if ((mock_adc.INTENSET & ADC_INTENSET_END_Msk) && mock_irq_enabled(ADC_IRQn)) {
+    ADC_IRQHandler();
+  }
+
+  return true;
+}
+
+/**
+ * The chip resets on a fault, which ends the simulation
+ */
+void NVIC_SystemReset(void) {
+  printf("mock: system reset at %.3fs\n",
+         (double)mock_time() / MOCK_TICKS_PER_SECOND);
+  exit(EXIT_FAILURE);
+}
+void ble_debug_assert_handler(uint32_t error_code, uint32_t line_num,
+                              const uint8_t* p_file_name) {
+  printf("mock: assert 0x%x at %s:%u\n", error_code, p_file_name, line_num);
+  exit(EXIT_FAILURE);
+}
+void nrf_delay_us(uint32_t volatile number_of_us) {
+}
+
+/* -----------------------------------------------------------------------------
+ * Buttons
+ */
+
+static app_button_cfg_t* buttons;
+static uint8_t button_count;
+static bool buttons_enabled;
+
+void mock_app_button_init(app_button_cfg_t* p_buttons, uint8_t count) {
+  buttons = p_buttons;
+  button_count = count;
+}
+uint32_t app_button_enable(void) {
+  if (buttons == NULL) return NRF_ERROR_INVALID_STATE;
+
+  buttons_enabled = true;
+
+  return NRF_SUCCESS;
+}
+uint32_t app_button_disable(void) {
+  buttons_enabled = false;
+
+  return NRF_SUCCESS;
+}
+void mock_button_press(uint8_t pin_no) {
+  uint8_t i;
+
+  if (!buttons_enabled) return;
+
+  for (i = 0; i < button_count; i++) {
+    if (buttons[i].pin_no == pin_no && buttons[i].button_handler) {
+      buttons[i].button_handler(pin_no, APP_BUTTON_PUSH);
+      buttons[i].button_handler(pin_no, APP_BUTTON_RELEASE);
+    }
+  }
+}
+
+/* -----------------------------------------------------------------------------
+ * Services
+ */
+
+static uint16_t adv_company = 0xFFFF;
+static uint8_t adv_manuf[31];
+static uint8_t adv_manuf_len;
+
+uint32_t ble_advdata_set(const ble_advdata_t* p_advdata, const ble_advdata_t* p_srdata) {
+  const ble_advdata_manuf_data_t* p_manuf = p_advdata->p_manuf_specific_data;
+  uint8_t len = 3;	/* Flags */
+  uint32_t err_code;
+
+  if (p_advdata->name_type != BLE_ADVDATA_NO_NAME) len += 2 + 8;
+  if (p_advdata->include_appearance) len += 4;
+  if (p_advdata->p_tx_power_level) len += 3;
+  if (p_advdata->uuids_complete.uuid_cnt) len += 2 + 2 * p_advdata->uuids_complete.uuid_cnt;
+  if (p_manuf) len += 4 + p_manuf->data.size;
+
+  err_code = sd_ble_gap_adv_data_set(NULL, len, NULL, 0);
+  if (err_code != NRF_SUCCESS) return err_code;
+
+  /* Only what the stack took */
+  adv_manuf_len = 0;
+  if (p_manuf && p_manuf->data.size <= sizeof(adv_manuf)) {
+    adv_company = p_manuf->company_identifier;
+    adv_manuf_len = p_manuf->data.size;
+    memcpy(adv_manuf, p_manuf->data.p_data, adv_manuf_len);
+  }
+
+  return NRF_SUCCESS;
+}
+/**
+ * The manufacturer specific data being advertised, or NULL
+ */
+const uint8_t* mock_adv_manuf_data(uint16_t* p_company, uint8_t* p_len) {
+  if (adv_manuf_len == 0) return NULL;
+
+  *p_company = adv_company;
+  *p_len = adv_manuf_len;
+  return adv_manuf;
+}
+
+uint32_t ble_bas_init(ble_bas_t* p_bas, const ble_bas_init_t* p_bas_init) {
+  ble_gatts_char_md_t char_md;
+  ble_gatts_attr_md_t attr_md;
+  ble_gatts_attr_t attr_char_value;
+  ble_uuid_t ble_uuid;
+  uint32_t err_code;
+
+  p_bas->evt_handler = p_bas_init->evt_handler;
+  p_bas->conn_handle = BLE_CONN_HANDLE_INVALID;
+  p_bas->is_notification_supported = p_bas_init->support_notification;
+  p_bas->battery_level_last = 0xFF;
+
+  BLE_UUID_BLE_ASSIGN(ble_uuid, BLE_UUID_BATTERY_SERVICE);
+  err_code = sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &ble_uuid,
+                                      &p_bas->service_handle);
+  if (err_code != NRF_SUCCESS) return err_code;
+
+  memset(&char_md, 0, sizeof(char_md));
+  char_md.char_props.read = 1;
+  char_md.char_props.notify = p_bas_init->support_notification;
+
+  memset(&attr_md, 0, sizeof(attr_md));
+  attr_md.vloc = BLE_GATTS_VLOC_STACK;
+
+  BLE_UUID_BLE_ASSIGN(ble_uuid, 0x2A19);
+  memset(&attr_char_value, 0, sizeof(attr_char_value));
+  attr_char_value.p_uuid = &ble_uuid;
+  attr_char_value.p_attr_md = &attr_md;
+  attr_char_value.init_len = sizeof(uint8_t);
+  attr_char_value.max_len = sizeof(uint8_t);
+  attr_char_value.p_value = (uint8_t*)&p_bas_init->initial_batt_level;
+
+  return sd_ble_gatts_characteristic_add(p_bas->service_handle, &char_md,
+                                         &attr_char_value,
+                                         &p_bas->battery_level_handles);
+}
+void ble_bas_on_ble_evt(ble_bas_t* p_bas, ble_evt_t* p_ble_evt) {
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+      p_bas->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+      break;
+    case BLE_GAP_EVT_DISCONNECTED:
+      p_bas->conn_handle = BLE_CONN_HANDLE_INVALID;
+      break;
+    default:
+      break;
+  }
+}
+uint32_t ble_bas_battery_level_update(ble_bas_t* p_bas, uint8_t battery_level) {
+  ble_gatts_hvx_params_t hvx_params;
+  uint16_t len = sizeof(uint8_t);
+  uint32_t err_code;
+
+  if (battery_level == p_bas->battery_level_last) return NRF_SUCCESS;
+
+  err_code = sd_ble_gatts_value_set(p_bas->battery_level_handles.value_handle,
+                                    0, &len, &battery_level);
+  if (err_code != NRF_SUCCESS) return err_code;
+  p_bas->battery_level_last = battery_level;
+
+  if (p_bas->conn_handle == BLE_CONN_HANDLE_INVALID || !p_bas->is_notification_supported) {
+    return NRF_ERROR_INVALID_STATE;
+  }
+
+  memset(&hvx_params, 0, sizeof(hvx_params));
+  hvx_params.handle = p_bas->battery_level_handles.value_handle;
+  hvx_params.type = BLE_GATT_HVX_NOTIFICATION;
+  hvx_params.p_len = &len;
+  hvx_params.p_data = &battery_level;
+
+  return sd_ble_gatts_hvx(p_bas->conn_handle, &hvx_params);
+}
+
+uint32_t ble_dis_init(const ble_dis_init_t* p_dis_init) {
+  ble_uuid_t ble_uuid;
+  uint16_t service_handle;
+
+  BLE_UUID_BLE_ASSIGN(ble_uuid, BLE_UUID_DEVICE_INFORMATION_SERVICE);
+
+  return sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &ble_uuid, &service_handle);
+}
+
+/* -----------------------------------------------------------------------------
+ * Connection parameters
+ *
+ * Asks for the preferred parameters a while after connecting, or
+ * after the given CCCD is written, and keeps asking until the
+ * central agrees or the attempts run out.
+ */
+
+static ble_conn_params_init_t cp_init;
+static ble_gap_conn_params_t cp_preferred;
+static ble_gap_conn_params_t cp_current;
+static app_timer_id_t cp_timer_id;
+static uint16_t cp_conn_handle = BLE_CONN_HANDLE_INVALID;
+static uint8_t cp_update_count;
+
+static bool conn_params_ok(const ble_gap_conn_params_t* p_params) {
+  return (p_params->max_conn_interval >= cp_preferred.min_conn_interval &&
+          p_params->max_conn_interval <= cp_preferred.max_conn_interval);
+}
+static void conn_params_evt(ble_conn_params_evt_type_t type) {
+  ble_conn_params_evt_t evt;
+
+  if (type == BLE_CONN_PARAMS_EVT_FAILED && cp_init.disconnect_on_fail) {
+    (void)sd_ble_gap_disconnect(cp_conn_handle, BLE_HCI_CONN_INTERVAL_UNACCEPTABLE);
+  }
+  if (cp_init.evt_handler) {
+    evt.evt_type = type;
+    cp_init.evt_handler(&evt);
+  }
+}
+static void cp_timeout_handler(void* p_context) {
+  uint32_t err_code;
+
+  if (cp_conn_handle == BLE_CONN_HANDLE_INVALID) return;
+
+  cp_update_count++;
+  err_code = sd_ble_gap_conn_param_update(cp_conn_handle, &cp_preferred);
+  if (err_code != NRF_SUCCESS && err_code != NRF_ERROR_BUSY && cp_init.error_handler) {
+    cp_init.error_handler(err_code);
+  }
+}
+static void cp_negotiation_start(void) {
+  uint32_t delay = cp_update_count ? cp_init.next_conn_params_update_delay
+                                   : cp_init.first_conn_params_update_delay;
+
+  if (app_timer_start(cp_timer_id, delay, NULL) != NRF_SUCCESS && cp_init.error_handler) {
+    cp_init.error_handler(NRF_ERROR_INTERNAL);
+  }
+}
+
+uint32_t ble_conn_params_init(const ble_conn_params_init_t* p_init) {
+  uint32_t err_code;
+
+  cp_init = *p_init;
+
+  if (p_init->p_conn_params) {
+    cp_preferred = *p_init->p_conn_params;
+    err_code = sd_ble_gap_ppcp_set(&cp_preferred);
+  } else {
+    err_code = sd_ble_gap_ppcp_get(&cp_preferred);
+  }
+  if (err_code != NRF_SUCCESS) return err_code;
+
+  return app_timer_create(&cp_timer_id, APP_TIMER_MODE_SINGLE_SHOT, cp_timeout_handler);
+}
+uint32_t ble_conn_params_stop(void) {
+  return app_timer_stop(cp_timer_id);
+}
+uint32_t ble_conn_params_change_conn_params(ble_gap_conn_params_t* new_params) {
+  uint32_t err_code;
+
+  cp_preferred = *new_params;
+  err_code = sd_ble_gap_ppcp_set(&cp_preferred);
+  if (err_code != NRF_SUCCESS) return err_code;
+
+  /* As the SDK, this goes on the last parameters, connected or not */
+  if (!conn_params_ok(&cp_current)) {
+    cp_update_count = 1;
+    return sd_ble_gap_conn_param_update(cp_conn_handle, &cp_preferred);
+  }
+
+  conn_params_evt(BLE_CONN_PARAMS_EVT_SUCCEEDED);
+  return NRF_SUCCESS;
+}
+void ble_conn_params_on_ble_evt(ble_evt_t* p_ble_evt) {
+  ble_gatts_evt_write_t* p_write;
+  ble_gap_conn_params_t* p_params;
+
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+      cp_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+      cp_current = p_ble_evt->evt.gap_evt.params.connected.conn_params;
+      cp_update_count = 0;
+      if (cp_init.start_on_notify_cccd_handle == BLE_GATT_HANDLE_INVALID &&
+          !conn_params_ok(&cp_current)) {
+        cp_negotiation_start();
+      }
+      break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+      cp_conn_handle = BLE_CONN_HANDLE_INVALID;
+      (void)app_timer_stop(cp_timer_id);
+      break;
+
+    case BLE_GATTS_EVT_WRITE:
+      p_write = &p_ble_evt->evt.gatts_evt.params.write;
+      if (p_write->handle == cp_init.start_on_notify_cccd_handle && p_write->len == 2 &&
+          ble_srv_is_notification_enabled(p_write->data) && !conn_params_ok(&cp_current)) {
+        cp_negotiation_start();
+      }
+      break;
+
+    case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+      p_params = &p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params;
+      cp_current = *p_params;
+      if (conn_params_ok(p_params)) {
+        (void)app_timer_stop(cp_timer_id);
+        conn_params_evt(BLE_CONN_PARAMS_EVT_SUCCEEDED);
+      } else if (cp_update_count < cp_init.max_conn_params_update_count) {
+        cp_negotiation_start();
+      } else {
+        conn_params_evt(BLE_CONN_PARAMS_EVT_FAILED);
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+/* -----------------------------------------------------------------------------
+ * Device manager
+ *
+ * Nothing is bonded on the host, so only connections are reported.
+ */
+
+static dm_event_cb_t dm_handler;
+
+api_result_t dm_init(dm_init_param_t const* p_init_param) {
+  return NRF_SUCCESS;
+}
+api_result_t dm_register(dm_application_instance_t* p_appl_instance,
+                         dm_application_param_t const* p_appl_param) {
+  dm_handler = p_appl_param->evt_handler;
+  *p_appl_instance = 0;
+
+  return NRF_SUCCESS;
+}
+api_result_t dm_peer_addr_get(dm_handle_t const* p_handle, ble_gap_addr_t* p_addr) {
+  return NRF_ERROR_NOT_FOUND;
+}
+api_result_t dm_handle_initialize(dm_handle_t* p_handle) {
+  memset(p_handle, DM_INVALID_ID, sizeof(*p_handle));
+
+  return NRF_SUCCESS;
+}
+void dm_ble_evt_handler(ble_evt_t* p_ble_evt) {
+  dm_handle_t handle;
+  dm_event_t event;
+
+  if (dm_handler == NULL) return;
+
+  memset(&handle, 0, sizeof(handle));
+  memset(&event, 0, sizeof(event));
+
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+      event.event_id = DM_EVT_CONNECTION;
+      break;
+    case BLE_GAP_EVT_DISCONNECTED:
+      event.event_id = DM_EVT_DISCONNECTION;
+      break;
+    default:
+      return;
+  }
+
+  dm_handler(&handle, &event, NRF_SUCCESS);
+}
+
+/* -----------------------------------------------------------------------------
+ * Persistent storage
+ *
+ * Flash is a RAM array. Writes land straight away but completion is
+ * reported through a system event, as it is on the chip. Each module
+ * registered starts on a new page, as it does on the chip.
+ */
+
+#define FLASH_SIZE		(4 * MOCK_FLASH_PAGE_SIZE)
+#define OP_QUEUE_SIZE		PSTORAGE_CMD_QUEUE_SIZE
+
+struct pstorage_op {
+  uint8_t op_code;
+  pstorage_handle_t handle;
+  uint8_t* p_data;
+  uint32_t size;
+};
+
+static uint8_t flash[FLASH_SIZE];
+static uint32_t flash_used;
+static pstorage_ntf_cb_t pstorage_cb[PSTORAGE_MAX_APPLICATIONS];
+static pstorage_size_t block_size[PSTORAGE_MAX_APPLICATIONS];
+static uint8_t modules;
+static struct pstorage_op ops[OP_QUEUE_SIZE];
+static uint8_t op_head, op_count;
+
+static uint32_t op_queue(uint8_t op_code, pstorage_handle_t* p_handle,
+                         uint8_t* p_data, uint32_t size) {
+  struct pstorage_op* op;
+
+  if (op_count >= OP_QUEUE_SIZE) return NRF_ERROR_NO_MEM;
+
+  op = &ops[(op_head + op_count++) % OP_QUEUE_SIZE];
+  op->op_code = op_code;
+  op->handle = *p_handle;
+  op->p_data = p_data;
+  op->size = size;
+
+  mock_sd_sys_evt(NRF_EVT_FLASH_OPERATION_SUCCESS);
+
+  return NRF_SUCCESS;
+}
+void pstorage_sys_event_handler(uint32_t sys_evt) {
+  struct pstorage_op op;
+
+  if (op_count == 0 || (sys_evt != NRF_EVT_FLASH_OPERATION_SUCCESS &&
+                        sys_evt != NRF_EVT_FLASH_OPERATION_ERROR)) return;
+
+  op = ops[op_head];
+  op_head = (op_head + 1) % OP_QUEUE_SIZE;
+  op_count--;
+
+  if (pstorage_cb[op.handle.module_id]) {
+    pstorage_cb[op.handle.module_id](&op.handle, op.op_code,
+                (sys_evt == NRF_EVT_FLASH_OPERATION_SUCCESS) ? NRF_SUCCESS : NRF_ERROR_TIMEOUT,
+                op.p_data, op.size);
+  }
+}
+uint32_t pstorage_init(void) {
+  memset(flash, 0xFF, sizeof(flash));
+  flash_used = 0;
+  modules = 0;
+  op_count = 0;
+
+  return NRF_SUCCESS;
+}
+uint32_t pstorage_register(pstorage_module_param_t* p_module_param,
+                           pstorage_handle_t* p_block_id) {
+  uint32_t size = (uint32_t)p_module_param->block_size * p_module_param->block_count;
+
+  /* Whole pages */
+  size = ((size + MOCK_FLASH_PAGE_SIZE - 1) / MOCK_FLASH_PAGE_SIZE) * MOCK_FLASH_PAGE_SIZE;
+
+  if (p_module_param->cb == NULL) return NRF_ERROR_NULL;
+  if (p_module_param->block_size < PSTORAGE_MIN_BLOCK_SIZE) return NRF_ERROR_INVALID_PARAM;
+  if (flash_used + size > FLASH_SIZE || modules >= PSTORAGE_MAX_APPLICATIONS) {
+    return NRF_ERROR_NO_MEM;
+  }
+
+  pstorage_cb[modules] = p_module_param->cb;
+  block_size[modules] = p_module_param->block_size;
+  p_block_id->module_id = modules++;
+  p_block_id->block_id = flash_used;
+  flash_used += size;
+
+  return NRF_SUCCESS;
+}
+uint32_t pstorage_block_identifier_get(pstorage_handle_t* p_base_id,
+                                       pstorage_size_t block_num,
+                                       pstorage_handle_t* p_block_id) {
+  *p_block_id = *p_base_id;
+  p_block_id->block_id += (uint32_t)block_num * block_size[p_base_id->module_id];
+
+  return NRF_SUCCESS;
+}
+uint32_t pstorage_store(pstorage_handle_t* p_dest, uint8_t* p_src,
+                        pstorage_size_t size, pstorage_size_t offset) {
+  uint32_t i, addr = p_dest->block_id + offset;
+
+  if (addr + size > FLASH_SIZE) return NRF_ERROR_INVALID_ADDR;
+
+  /* Flash can only clear bits */
+  for (i = 0; i < size; i++) flash[addr + i] &= p_src[i];
+
+  return op_queue(PSTORAGE_STORE_OP_CODE, p_dest, p_src, size);
+}
+uint32_t pstorage_update(pstorage_handle_t* p_dest, uint8_t* p_src,
+                         pstorage_size_t size, pstorage_size_t offset) {
+  uint32_t addr = p_dest->block_id + offset;
+
+  if (addr + size > FLASH_SIZE) return NRF_ERROR_INVALID_ADDR;
+
+  memcpy(&flash[addr], p_src, size);
+
+  return op_queue(PSTORAGE_UPDATE_OP_CODE, p_dest, p_src, size);
+}
+uint32_t pstorage_load(uint8_t* p_dest, pstorage_handle_t* p_src,
+                       pstorage_size_t size, pstorage_size_t offset) {
+  uint32_t addr = p_src->block_id + offset;
+
+  if (addr + size > FLASH_SIZE) return NRF_ERROR_INVALID_ADDR;
+
+  memcpy(p_dest, &flash[addr], size);
+
+  return NRF_SUCCESS;
+}
+uint32_t pstorage_clear(pstorage_handle_t* p_base_id, pstorage_size_t size) {
+  if (p_base_id->block_id + size > FLASH_SIZE) return NRF_ERROR_INVALID_ADDR;
+
+  memset(&flash[p_base_id->block_id], 0xFF, size);
+
+  return op_queue(PSTORAGE_CLEAR_OP_CODE, p_base_id, NULL, size);
+}
+uint32_t pstorage_access_status_get(uint32_t* p_count) {
+  *p_count = op_count;
+
+  return NRF_SUCCESS;
+}
+/**
+ * The flash behind pstorage, from the first block registered
+ */
+uint8_t* mock_flash(uint32_t* p_size) {
+  *p_size = flash_used;
+  return flash;
+}
+
+/* -----------------------------------------------------------------------------
+ * CRC
+ */
+
+/**
+ * CRC-16-CCITT, the same as the SDK's crc16 module
+ */
+uint16_t crc16_compute(const uint8_t* p_data, uint32_t size, const uint16_t* p_crc) {
+  uint16_t crc = (p_crc == NULL) ? 0xFFFF : *p_crc;
+  uint32_t i;
+
+  for (i = 0; i < size; i++) {
+    crc = (uint16_t)((crc >> 8) | (crc << 8));
+    crc ^= p_data[i];
+    crc ^= (uint16_t)((crc & 0xFF) >> 4);
+    crc ^= (uint16_t)((crc << 8) << 4);
+    crc ^= (uint16_t)(((crc & 0xFF) << 4) << 1);
+  }
+
+  return crc;
+}
+
+/* -----------------------------------------------------------------------------
+ * Sensor simulator
+ */
+
+void ble_sensorsim_init(ble_sensorsim_state_t* p_state, const ble_sensorsim_cfg_t* p_cfg) {
+  p_state->current_val = p_cfg->start_at_max ? p_cfg->max : p_cfg->min;
+  p_state->is_increasing = !p_cfg->start_at_max;
+}
+/**
+ * A triangle wave between min and max, as the SDK's
+ */
+uint32_t ble_sensorsim_measure(ble_sensorsim_state_t* p_state, const ble_sensorsim_cfg_t* p_cfg) {
+  if (p_state->is_increasing) {
+    if (p_cfg->max - p_state->current_val > p_cfg->incr) {
+      p_state->current_val += p_cfg->incr;
+    } else {
+      p_state->current_val = p_cfg->max;
+      p_state->is_increasing = false;
+    }
+  } else {
+    if (p_state->current_val - p_cfg->min > p_cfg->incr) {
+      p_state->current_val -= p_cfg->incr;
+    } else {
+      p_state->current_val = p_cfg->min;
+      p_state->is_increasing = true;
+    }
+  }
+
+  return p_state->current_val;
+}
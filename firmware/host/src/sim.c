@@ -0,0 +1,1515 @@
+/*
+ * Host simulation driver
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Runs the firmware against the mocks with a scripted central. The
+ * firmware's own main() runs unchanged; every time it sleeps in
+ * sd_app_evt_wait we deliver the next thing that would have woken
+ * it, moving the virtual clock forward when nothing is due.
+ *
+ * The script connects, reads pressure on demand, subscribes, and
+ * checks each notification against the simulated environment, which
+ * climbs at about 1m/s so that every sample is new. The variometer
+ * should find that climb once it has had a few samples. A stream is
+ * started while the first read is still converting, and has to wait
+ * for it so the read is answered right. Last it streams again, and
+ * disconnects in the middle of the stream, after which the usual
+ * connection parameters have to be back. The exit status
+ * is non-zero if anything went wrong.
+ *
+ * With SIM_SCRIPT=energy it instead advertises for a while, then
+ * stays connected and subscribed, and reports the energy model for
+ * each phase. ENERGY_ADVERTISING_S, ENERGY_CONNECTED_S and
+ * BATTERY_MAH set the lengths and the battery.
+ *
+ * With SIM_SCRIPT=flight the barometer goes up 300m and comes back
+ * down, and each flight event has to be indicated in order and in
+ * good time. The client only subscribes to the flight events, and
+ * drops the link before confirming apogee, which has to be indicated
+ * again once it is back.
+ *
+ * With SIM_SCRIPT=synth, in a SYNTH_ENABLED build, the synthetic
+ * source takes over from the barometer once subscribed, and the run
+ * fails if any of its samples arrived with the wrong value. Once it
+ * is stopped the altitude and climb have to follow the barometer
+ * again, with nothing carried over from the synthetic samples.
+ *
+ * With SIM_SCRIPT=capture a burst capture is armed, and the pressure
+ * steps down. The window uploaded has to have the step right after
+ * the pre-trigger samples. It is then armed again and triggered with
+ * a button.
+ *
+ * With SIM_SCRIPT=adapt the bench profile is selected, which samples
+ * adaptively, and the barometer sits still for a while, then moves
+ * quickly. Sampling has to slow right down while it is still, and
+ * speed up once it moves.
+ *
+ * With SIM_SCRIPT=faults the default script runs with pressure spikes
+ * and failed TWI transfers thrown in. None of them may get as far as
+ * a notification.
+ *
+ * With SIM_SCRIPT=stats only the windowed statistics are subscribed
+ * to, first over tumbling windows and then sliding ones. Each summary
+ * has to match the steady fall in pressure, and nothing else may be
+ * notified.
+ *
+ * With SIM_SCRIPT=weather the pressure falls slowly for a few hours,
+ * then rises again. A central connects now and then to read the
+ * tendency, forecast and history, which have to follow it, and the
+ * advertising data has to carry the same tendency and forecast. For
+ * the last hour it stays connected, subscribed only to the status,
+ * which has to keep the history going.
+ *
+ * With SIM_SCRIPT=config a few configurations are written, one of
+ * them invalid. Each has to be read back as expected and applied, and
+ * both copies in flash have to check out. The newest is then
+ * corrupted, and loading has to fall back to the one before.
+ *
+ * With SIM_SCRIPT=control the control point switches to fast sampling
+ * with the temperature decimated, then to unfiltered samples that are
+ * only stored, and back to the config. Every answer has to match the
+ * write, a bad command has to change nothing, and the sampling and
+ * notifications have to follow each switch. Last, the flight
+ * thresholds are changed, once properly and once not.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "ble.h"
+#include "ble_ess.h"
+#include "boards.h"
+#include "telemetry.h"
+#include "synth.h"
+#include "flight.h"
+#include "capture.h"
+#include "stats.h"
+#include "adapt.h"
+#include "weather.h"
+#include "config.h"
+#include "control.h"
+#include "stream.h"
+#include "vario.h"
+#include "power.h"
+#include "crc16.h"
+#include "mock.h"
+
+#define UUID_PRESSURE_CHAR	0x2A6D
+#define UUID_TEMPERATURE_CHAR	0x2A6E
+
+#define GROUND_PRESSURE		101325	/* Pa */
+#define GROUND_TEMPERATURE	200	/* 0.1°C */
+#define PRESSURE_LAPSE		12	/* Pa/s */
+#define TEMPERATURE_LAPSE	2	/* Seconds per 0.1°C */
+#define TEMPERATURE_MIN		-400	/* Where the climb levels off */
+
+#define PRESSURE_TOLERANCE	50	/* 0.1Pa */
+#define ALTITUDE_TOLERANCE	100	/* cm */
+#define CLIMB_TOLERANCE		30	/* cm/s */
+#define CLIMB_SETTLE		4	/* Notifications before the climb is checked */
+#define TEMPERATURE_TOLERANCE	10	/* 0.01°C */
+#define MIN_NOTIFICATIONS	8
+
+#define ENERGY_ADVERTISING_S	600
+#define ENERGY_CONNECTED_S	3600
+#define ENERGY_SETTLE_MS	10000	/* For the connection parameters */
+#define BATTERY_MAH		500
+
+/**
+ * Flight, s and m/s. Launch, climb, fall, then a parachute.
+ */
+#define FLIGHT_LAUNCH		20
+#define FLIGHT_CLIMB		5
+#define FLIGHT_APOGEE		80
+#define FLIGHT_FALL		-20
+#define FLIGHT_DEPLOY		85
+#define FLIGHT_DESCENT		-6
+
+/**
+ * Burst capture. The pressure drifts slowly, so the pipeline has
+ * something new to send, and steps down at CAPTURE_STEP, ms, which
+ * should trip the rate trigger. The step is less than the launch
+ * height, so the flight detector can't take it for a launch. The
+ * button goes at CAPTURE_BUTTON.
+ */
+#define CAPTURE_PERIOD		50	/* ms */
+#define CAPTURE_PRE		40
+#define CAPTURE_POST		40
+#define CAPTURE_THRESHOLD	60	/* Pa */
+#define CAPTURE_LAPSE		1	/* Pa/s */
+#define CAPTURE_STEP		6510
+#define CAPTURE_DROP		100	/* Pa */
+#define CAPTURE_BUTTON		14000
+
+/**
+ * Adaptive sampling. Still until ADAPT_MOVE, s, then the pressure
+ * rises at ADAPT_RATE, about 10m/s down. Rates are in samples/s.
+ */
+/**
+ * Faults. Spikes are added to a single pressure conversion.
+ */
+#define FAULT_SPIKE		5000	/* Pa */
+#define FAULT_COUNT		2	/* Of each kind */
+
+/**
+ * Windowed statistics. The first config tumbles, the second slides.
+ */
+#define STATS_PERIOD		10	/* s */
+#define STATS_SLIDING		3	/* Periods in the sliding windows */
+#define STATS_MIN_SUMMARIES	7
+
+/**
+ * Weather. Falls at WEATHER_LAPSE until WEATHER_TURN, s, then rises at
+ * the same rate. Each check reads the weather just after a point.
+ */
+#define WEATHER_LAPSE		100	/* Pa/h */
+#define WEATHER_TURN		(4 * 3600)
+#define WEATHER_CHANGE_TOLERANCE	10	/* Pa */
+#define WEATHER_POINT_TOLERANCE	2	/* 2Pa */
+#define WEATHER_MIN_NOTIFICATIONS	5	/* Over the hour subscribed */
+
+/**
+ * Configuration. The records are decoded here independently of the
+ * firmware.
+ */
+#define CONFIG_BLOCK		MOCK_FLASH_PAGE_SIZE	/* A page for each copy */
+#define CONFIG_HEADER		12
+
+/**
+ * Control point. Fast sampling is checked over the first two marks,
+ * and the lack of notifications while only storing over the last two.
+ */
+#define CONTROL_PERIOD		100	/* ms */
+#define CONTROL_DECIMATION	10
+#define CONTROL_RATE_TOLERANCE	0.1	/* Of the rate expected */
+#define CONTROL_SETTLE		2	/* s for the connection interval to catch up */
+
+#define ADAPT_PROFILE		1	/* Bench */
+#define ADAPT_MOVE		90
+#define ADAPT_RATE		120	/* Pa/s */
+#define ADAPT_STILL_MAX		0.15
+#define ADAPT_MOVING_MIN	4
+
+#define SYNTH_PROFILE		SYNTH_SINE
+#define SYNTH_RATE		50	/* Samples/s */
+
+enum action {
+  ACTION_CONNECT,
+  ACTION_READ_PRESSURE,
+  ACTION_SUBSCRIBE,
+  ACTION_STREAM,
+  ACTION_STREAM_STOP,
+  ACTION_READ_TELEMETRY,
+  ACTION_DISCONNECT,
+  ACTION_SYNTH_START,
+  ACTION_SYNTH_STOP,
+  ACTION_READ_SYNTH,
+  ACTION_CAPTURE_ARM,
+  ACTION_CAPTURE_UPLOAD,
+  ACTION_BUTTON,
+  ACTION_PROFILE,
+  ACTION_MARK,
+  ACTION_SPIKE,
+  ACTION_TWI_FAIL,
+  ACTION_STATS_CONFIG,
+  ACTION_READ_WEATHER,
+  ACTION_CONFIG_WRITE,
+  ACTION_CONFIG_READ,
+  ACTION_CONFIG_CHECK,
+  ACTION_CONTROL_WRITE,
+  ACTION_PHASE,
+  ACTION_END,
+};
+
+struct step {
+  uint32_t at;			/* ms after boot */
+  enum action action;
+  const char* phase;		/* For ACTION_PHASE, NULL to not report */
+};
+
+static const struct step default_script[] = {
+  {  2000, ACTION_CONNECT, NULL },
+  {  2100, ACTION_READ_PRESSURE, NULL },
+  {  2110, ACTION_STREAM, NULL },
+  {  2400, ACTION_STREAM_STOP, NULL },
+  {  2500, ACTION_SUBSCRIBE, NULL },
+  { 12000, ACTION_READ_TELEMETRY, NULL },
+  { 12500, ACTION_STREAM, NULL },
+  { 15000, ACTION_DISCONNECT, NULL },
+  { 15500, ACTION_END, NULL },
+};
+static const struct step faults_script[] = {
+  {  2000, ACTION_CONNECT, NULL },
+  {  2100, ACTION_READ_PRESSURE, NULL },
+  {  2500, ACTION_SUBSCRIBE, NULL },
+  {  5000, ACTION_SPIKE, NULL },
+  {  7000, ACTION_TWI_FAIL, NULL },
+  {  9000, ACTION_SPIKE, NULL },
+  { 11000, ACTION_TWI_FAIL, NULL },
+  { 12000, ACTION_READ_TELEMETRY, NULL },
+  { 12500, ACTION_DISCONNECT, NULL },
+  { 13000, ACTION_END, NULL },
+};
+static const struct step stats_script[] = {
+  {  1000, ACTION_CONNECT, NULL },
+  {  1500, ACTION_STATS_CONFIG, NULL },
+  {  1600, ACTION_SUBSCRIBE, NULL },
+  { 42000, ACTION_STATS_CONFIG, NULL },
+  { 90000, ACTION_END, NULL },
+};
+static struct step energy_script[6];
+static const struct step config_script[] = {
+  { 1000, ACTION_CONNECT, NULL },
+  { 1500, ACTION_CONFIG_WRITE, NULL },
+  { 1700, ACTION_CONFIG_READ, NULL },
+  { 2000, ACTION_CONFIG_WRITE, NULL },
+  { 2200, ACTION_CONFIG_READ, NULL },
+  { 2500, ACTION_CONFIG_WRITE, NULL },
+  { 2700, ACTION_CONFIG_READ, NULL },
+  { 3000, ACTION_DISCONNECT, NULL },
+  { 3500, ACTION_CONFIG_CHECK, NULL },
+  { 4000, ACTION_END, NULL },
+};
+
+/**
+ * Written in turn, and what should be read back after each
+ */
+static const struct config config_writes[] = {
+  /* Slower fixed sampling, shorter connection intervals and an altitude */
+  { POWER_PROFILE_FLIGHT, 1, 2000, 0, 1600, 40, 320, 640, 400, 120, 30, 0 },
+  /* The supervision timeout is too short for the interval */
+  { POWER_PROFILE_FLIGHT, 1, 2000, 0, 1600, 40, 320, 640, 100, 120, 30, 0 },
+  /* Shorter fast advertising and a new altitude */
+  { POWER_PROFILE_FLIGHT, 1, 2000, 0, 1600, 40, 320, 640, 400, 150, 10, 0 },
+};
+static const uint8_t config_expected[] = { 0, 0, 2 };
+#define CONFIG_WRITES	(sizeof(config_writes) / sizeof(config_writes[0]))
+static const struct step control_script[] = {
+  {  1000, ACTION_CONNECT, NULL },
+  {  1500, ACTION_SUBSCRIBE, NULL },
+  {  3000, ACTION_CONTROL_WRITE, NULL },
+  {  4000, ACTION_MARK, NULL },
+  {  9000, ACTION_MARK, NULL },
+  {  9500, ACTION_CONTROL_WRITE, NULL },
+  { 10000, ACTION_CONTROL_WRITE, NULL },
+  { 10500, ACTION_MARK, NULL },
+  { 14000, ACTION_READ_PRESSURE, NULL },
+  { 15500, ACTION_MARK, NULL },
+  { 16000, ACTION_CONTROL_WRITE, NULL },
+  { 16500, ACTION_CONTROL_WRITE, NULL },
+  { 17000, ACTION_CONTROL_WRITE, NULL },
+  { 17500, ACTION_CONTROL_WRITE, NULL },
+  { 20000, ACTION_END, NULL },
+};
+
+/**
+ * Flight thresholds after the launch and landing are changed
+ */
+static const struct flight_config control_flight = {
+  .launch_climb		= 300,
+  .launch_height	= 2000,
+  .launch_hold		= 500,
+  .apogee_drop		= 1000,
+  .apogee_hold		= 1000,
+  .descent_min		= 200,
+  .descent_max		= 1500,
+  .descent_hold		= 3000,
+  .landing_climb	= 50,
+  .landing_hold		= 5000,
+};
+
+/**
+ * Written in turn, and the answer each should get. Where the settings
+ * are the defaults they are worked out from the config, and where the
+ * flight thresholds aren't given they are the detector's defaults.
+ */
+static const struct {
+  uint8_t command[CONTROL_WRITE_MAX];
+  uint8_t len;
+  uint8_t result;
+  uint8_t opcode;
+  bool defaults;
+  struct control_settings settings;
+  const struct flight_config* flight;
+} control_writes[] = {
+  /* Fast fixed sampling at the lowest oversampling, temperature once a second */
+  { { CONTROL_OP_SAMPLE_PERIOD, 4, CONTROL_PERIOD, 0, 0, 0, CONTROL_OP_OSS, 1, 0,
+      CONTROL_OP_TEMPERATURE_DECIMATION, 1, CONTROL_DECIMATION }, 12,
+    CONTROL_RESULT_SUCCESS, 0, false,
+    { CONTROL_PERIOD, 0, 0, CONTROL_DECIMATION, VARIO_MODEL_BALLOON, CONTROL_REPORT_NOTIFY },
+    NULL },
+  /* A bad oversampling setting, so the period doesn't change either */
+  { { CONTROL_OP_SAMPLE_PERIOD, 4, 2 * CONTROL_PERIOD, 0, 0, 0, CONTROL_OP_OSS, 1, 9 }, 9,
+    CONTROL_RESULT_INVALID_PARAMETER, CONTROL_OP_OSS, false,
+    { CONTROL_PERIOD, 0, 0, CONTROL_DECIMATION, VARIO_MODEL_BALLOON, CONTROL_REPORT_NOTIFY },
+    NULL },
+  /* Unfiltered, and only stored */
+  { { CONTROL_OP_FILTER, 1, VARIO_MODEL_OFF, CONTROL_OP_REPORT, 1, CONTROL_REPORT_STORE }, 6,
+    CONTROL_RESULT_SUCCESS, 0, false,
+    { CONTROL_PERIOD, 0, 0, CONTROL_DECIMATION, VARIO_MODEL_OFF, CONTROL_REPORT_STORE },
+    NULL },
+  /* Back to the config */
+  { { CONTROL_OP_DEFAULTS, 0 }, 2,
+    CONTROL_RESULT_SUCCESS, 0, true, { 0, 0, 0, 0, 0, 0 }, NULL },
+  /* Not a command */
+  { { 0x7F, 0 }, 2,
+    CONTROL_RESULT_OPCODE_UNSUPPORTED, 0x7F, true, { 0, 0, 0, 0, 0, 0 }, NULL },
+  /* New launch and landing thresholds, and wait for a launch again */
+  { { CONTROL_OP_FLIGHT_LAUNCH, 6, 300 & 0xFF, 300 >> 8, 2000 & 0xFF, 2000 >> 8, 500 & 0xFF, 500 >> 8,
+      CONTROL_OP_FLIGHT_LANDING, 4, 50, 0, 5000 & 0xFF, 5000 >> 8,
+      CONTROL_OP_FLIGHT_RESET, 0 }, 16,
+    CONTROL_RESULT_SUCCESS, 0, true, { 0, 0, 0, 0, 0, 0 }, &control_flight },
+  /* A descent that is slowest faster than fastest */
+  { { CONTROL_OP_FLIGHT_DESCENT, 6, 500 & 0xFF, 500 >> 8, 400 & 0xFF, 400 >> 8, 3000 & 0xFF, 3000 >> 8 }, 8,
+    CONTROL_RESULT_INVALID_PARAMETER, CONTROL_OP_FLIGHT_DESCENT, true, { 0, 0, 0, 0, 0, 0 },
+    &control_flight },
+};
+#define CONTROL_WRITES	(sizeof(control_writes) / sizeof(control_writes[0]))
+static const struct step weather_script[] = {
+  { 12660000, ACTION_CONNECT, NULL },
+  { 12660500, ACTION_READ_WEATHER, NULL },
+  { 12661000, ACTION_DISCONNECT, NULL },
+  { 23460000, ACTION_CONNECT, NULL },
+  { 23460500, ACTION_SUBSCRIBE, NULL },
+  { 27060500, ACTION_READ_WEATHER, NULL },
+  { 27061000, ACTION_DISCONNECT, NULL },
+  { 27062000, ACTION_END, NULL },
+};
+
+/**
+ * What each weather read should find: falling steadily at 3.5 hours,
+ * and rising steadily at 7.5
+ */
+static const struct {
+  uint8_t tendency;
+  int16_t change;		/* Pa */
+  char forecast;
+} weather_expected[] = {
+  { WEATHER_FALLING, -3 * WEATHER_LAPSE, 'R' },
+  { WEATHER_RISING, 3 * WEATHER_LAPSE, 'F' },
+};
+#define WEATHER_CHECKS	(sizeof(weather_expected) / sizeof(weather_expected[0]))
+static const struct step flight_script[] = {
+  {   1000, ACTION_CONNECT, NULL },
+  {   1500, ACTION_SUBSCRIBE, NULL },
+  {  83000, ACTION_CONNECT, NULL },	/* After dropping apogee */
+  {  83500, ACTION_SUBSCRIBE, NULL },
+  { 150000, ACTION_END, NULL },
+};
+
+/**
+ * When each flight event may be indicated, in seconds
+ */
+static const struct {
+  double from, to;
+} flight_deadlines[FLIGHT_EVENT_COUNT] = {
+  [FLIGHT_EVENT_LAUNCH]		= { FLIGHT_LAUNCH, FLIGHT_LAUNCH + 5 },
+  [FLIGHT_EVENT_APOGEE]		= { FLIGHT_APOGEE, FLIGHT_APOGEE + 5 },
+  [FLIGHT_EVENT_DESCENT]	= { FLIGHT_DEPLOY, FLIGHT_DEPLOY + 8 },
+  [FLIGHT_EVENT_LANDING]	= { 118.3, 118.3 + 15 },
+};
+static const struct step capture_script[] = {
+  {           1000, ACTION_CONNECT, NULL },
+  {           1500, ACTION_SUBSCRIBE, NULL },
+  {           2000, ACTION_CAPTURE_ARM, NULL },
+  {           9000, ACTION_CAPTURE_UPLOAD, NULL },
+  {          11000, ACTION_CAPTURE_ARM, NULL },
+  { CAPTURE_BUTTON, ACTION_BUTTON, NULL },
+  {          17000, ACTION_CAPTURE_UPLOAD, NULL },
+  {          19000, ACTION_END, NULL },
+};
+
+static const struct step adapt_script[] = {
+  {   1000, ACTION_CONNECT, NULL },
+  {   1500, ACTION_SUBSCRIBE, NULL },
+  {   2000, ACTION_PROFILE, NULL },
+  {  60000, ACTION_MARK, NULL },
+  {  90000, ACTION_MARK, NULL },
+  { 100000, ACTION_MARK, NULL },
+  { 110000, ACTION_MARK, NULL },
+  { 110000, ACTION_END, NULL },
+};
+
+/**
+ * What each capture should have been triggered by, and when, in ms
+ */
+static const struct {
+  enum capture_source source;
+  uint32_t at;
+} capture_expected[] = {
+  { CAPTURE_SOURCE_RATE, CAPTURE_STEP },
+  { CAPTURE_SOURCE_BUTTON, CAPTURE_BUTTON },
+};
+#define CAPTURE_COUNT	(sizeof(capture_expected) / sizeof(capture_expected[0]))
+
+#ifdef SYNTH_ENABLED
+static const struct step synth_script[] = {
+  {  2000, ACTION_CONNECT, NULL },
+  {  2100, ACTION_READ_PRESSURE, NULL },
+  {  2500, ACTION_SUBSCRIBE, NULL },
+  {  3000, ACTION_SYNTH_START, NULL },
+  {  8000, ACTION_READ_SYNTH, NULL },
+  {  8100, ACTION_SYNTH_STOP, NULL },
+  { 30000, ACTION_DISCONNECT, NULL },
+  { 30500, ACTION_END, NULL },
+};
+#endif
+
+static const struct step* script = default_script;
+static uint8_t script_length = sizeof(default_script) / sizeof(default_script[0]);
+static uint8_t next_step;
+static bool energy;
+static bool synthetic;		/* Values come from synth.c after the start */
+static double synth_stopped;	/* s, 0 until stopped */
+static bool synth_drained;	/* Samples from the barometer came through again */
+static uint32_t last_pressure;	/* 0.1Pa, notified just before the altitude */
+static uint32_t climb_from;	/* Vario notifications before the climb is checked */
+static bool flying;		/* The barometer follows the flight */
+static uint8_t flight_events;	/* Indicated so far, in order */
+static bool flight_dropped;	/* The link went before apogee was confirmed */
+static bool capturing;		/* The pressure steps for the capture */
+static uint8_t captures;	/* Windows checked so far */
+static struct capture_status capture_last;
+static int32_t capture_window[CAPTURE_RING_SIZE];
+static uint16_t capture_received;
+static bool adapting;		/* Still, then moving quickly */
+static uint32_t marks[4];	/* Pressure conversions at each mark */
+static uint8_t mark_count;
+static bool faulty;		/* Spikes and TWI failures */
+static bool summarising;	/* Only the statistics are subscribed to */
+static uint8_t stats_buckets;	/* In the config last written */
+static uint32_t summaries;
+static bool weathering;		/* Hours of slow change, read now and then */
+static uint8_t weather_checks;
+static struct weather_status weather_last;
+static uint8_t weather_notifications;
+static bool configuring;	/* Writing configs */
+static uint8_t config_writes_done;
+static uint8_t config_reads;
+static bool controlling;	/* Writing to the control point */
+static uint8_t control_writes_done;
+static uint8_t control_answers;
+static double control_written;	/* s */
+static struct {
+  uint32_t temperature_conversions;
+  uint32_t notifications;
+} control_marks[4];
+
+static const char* phase;
+static struct energy_activity phase_start;
+static double battery_mah = BATTERY_MAH;
+static uint16_t pressure_handle, temperature_handle, telemetry_handle, synth_handle;
+static uint16_t vario_handle, flight_handle, capture_status_handle, capture_data_handle;
+static uint16_t power_profile_handle, stats_config_handle, stats_summary_handle;
+static uint16_t weather_handle, weather_history_handle, config_handle, control_handle;
+static uint16_t stream_handle;
+static uint32_t stream_packets;
+
+static uint32_t pressure_notifications, temperature_notifications, vario_notifications;
+static uint32_t reads, failures;
+
+#define FAIL(...) do {				\
+    printf("sim: FAIL " __VA_ARGS__);		\
+    failures++;					\
+  } while (0)
+
+static double now_s(void) {
+  return (double)mock_time() / MOCK_TICKS_PER_SECOND;
+}
+static int16_t sim_temperature(void) {
+  int32_t t;
+
+  if (capturing) return GROUND_TEMPERATURE;
+
+  t = GROUND_TEMPERATURE - (int32_t)(mock_time() / MOCK_TICKS_PER_SECOND / TEMPERATURE_LAPSE);
+
+  return (t < TEMPERATURE_MIN) ? TEMPERATURE_MIN : t;
+}
+static double flight_altitude(double t) {
+  double h;
+
+  if (t < FLIGHT_LAUNCH) return 0;
+  if (t < FLIGHT_APOGEE) return FLIGHT_CLIMB * (t - FLIGHT_LAUNCH);
+  h = FLIGHT_CLIMB * (FLIGHT_APOGEE - FLIGHT_LAUNCH);
+  if (t < FLIGHT_DEPLOY) return h + FLIGHT_FALL * (t - FLIGHT_APOGEE);
+  h += FLIGHT_FALL * (FLIGHT_DEPLOY - FLIGHT_APOGEE) + FLIGHT_DESCENT * (t - FLIGHT_DEPLOY);
+
+  return (h > 0) ? h : 0;
+}
+static int32_t capture_pressure(double t) {
+  return GROUND_PRESSURE - (int32_t)(t * CAPTURE_LAPSE) -
+    ((t >= CAPTURE_STEP / 1000.0) ? CAPTURE_DROP : 0);
+}
+/**
+ * The pressure at t seconds, Pa
+ */
+static int32_t sim_pressure(double t) {
+  if (capturing) {
+    return capture_pressure(t);
+  } else if (adapting) {
+    return GROUND_PRESSURE + ((t > ADAPT_MOVE) ? (int32_t)((t - ADAPT_MOVE) * ADAPT_RATE) : 0);
+  } else if (weathering) {
+    return GROUND_PRESSURE - lround(WEATHER_LAPSE * (t - 2 * fmax(t - WEATHER_TURN, 0)) / 3600);
+  } else if (flying) {
+    return lround(GROUND_PRESSURE * pow(1 - 2.25577e-5 * flight_altitude(t), 5.25588));
+  } else {
+    return GROUND_PRESSURE - (int32_t)(t * PRESSURE_LAPSE);
+  }
+}
+static void environment_update(void) {
+  bmp180_sim_set(sim_pressure(now_s()), sim_temperature());
+}
+
+/* -----------------------------------------------------------------------------
+ * Central
+ */
+
+/**
+ * A sample can wait up to a connection interval to go out, so the
+ * pressure can be anything it has been over the last one. Just after
+ * the control point speeds up sampling they can queue for longer,
+ * until the connection interval catches up. Once synth.c is stopped
+ * the barometer's samples queue behind its backlog, so they can be
+ * anything since the stop. The first of them marks the end of the
+ * synthetic ones, which never come that close.
+ */
+static void check_pressure(uint32_t pressure) {
+  int32_t expected = bmp180_sim_pressure() * 10;
+  double since = (synth_stopped != 0) ? synth_stopped :
+    now_s() - mock_sd_conn_interval() * 0.00125;
+  int32_t before = sim_pressure(since) * 10;
+  int32_t low = (before < expected) ? before : expected;
+  int32_t high = (before < expected) ? expected : before;
+  bool inside = ((int32_t)pressure >= low - PRESSURE_TOLERANCE &&
+                 (int32_t)pressure <= high + PRESSURE_TOLERANCE);
+
+  last_pressure = pressure;
+  if (synth_stopped != 0 && inside) synth_drained = true;
+  if (synthetic && !synth_drained) return;	/* Checked by the firmware itself */
+  if (controlling && now_s() < control_written + CONTROL_SETTLE) return;
+  if (!inside) {
+    FAIL("pressure %u, expected %d at %.3fs\n", pressure, expected, now_s());
+  }
+}
+static void check_temperature(int16_t temperature) {
+  int32_t expected = sim_temperature() * 10;
+
+  if (synthetic) return;
+  if (abs(temperature - expected) > TEMPERATURE_TOLERANCE) {
+    FAIL("temperature %d, expected %d at %.3fs\n", temperature, expected, now_s());
+  }
+}
+/**
+ * The climb is what the environment is doing, converted through the
+ * standard atmosphere independently of the firmware. After synth.c the
+ * samples are late, so the altitude is checked against the pressure
+ * notified with it, and the filter has to start again from there.
+ */
+static void check_vario(int32_t altitude, int16_t climb) {
+  double p = synth_drained ? last_pressure / 10.0 : bmp180_sim_pressure();
+  double expected = 100 * 44330.77 * (1 - pow(p / 101325, 0.190263));
+  double expected_climb = 100 * PRESSURE_LAPSE * 44330.77 * 0.190263 *
+    pow(p / 101325, 0.190263) / p;
+
+  if ((synthetic && !synth_drained) || flying || capturing || adapting || controlling) return;
+  if (climb_from == 0) climb_from = vario_notifications + CLIMB_SETTLE;
+  if (fabs(altitude - expected) > ALTITUDE_TOLERANCE) {
+    FAIL("altitude %d, expected %.0f at %.3fs\n", altitude, expected, now_s());
+  }
+  if (vario_notifications >= climb_from &&
+      fabs(climb - expected_climb) > CLIMB_TOLERANCE) {
+    FAIL("climb %d, expected %.0f at %.3fs\n", climb, expected_climb, now_s());
+  }
+}
+/**
+ * The pressure falls steadily, so over any window the mean is half way
+ * between the extremes, and the values are spread evenly between them
+ */
+static void check_stats(const uint8_t* p) {
+  uint16_t count = p[0] | (p[1] << 8);
+  int32_t p_min = p[2] | (p[3] << 8) | (p[4] << 16);
+  int32_t p_max = p[5] | (p[6] << 8) | (p[7] << 16);
+  int32_t p_mean = p[8] | (p[9] << 8) | (p[10] << 16);
+  uint16_t p_sd = p[11] | (p[12] << 8);
+  int16_t t_min = p[13] | (p[14] << 8);
+  int16_t t_max = p[15] | (p[16] << 8);
+  int16_t t_mean = p[17] | (p[18] << 8);
+  double window = STATS_PERIOD * stats_buckets + 2;
+  double sd = (count > 1) ?
+    (p_max - p_min) * sqrt((count + 1) / (12.0 * (count - 1))) : 0;
+
+  printf("sim: stats at %.3fs, %u samples, %.1f-%.1fPa mean %.1fPa sd %.1fPa, "
+         "%.2f-%.2fC mean %.2fC\n", now_s(), count, p_min / 10.0, p_max / 10.0,
+         p_mean / 10.0, p_sd / 10.0, t_min / 100.0, t_max / 100.0, t_mean / 100.0);
+
+  if (count == 0 || count > window * 1000 / ADAPT_PERIOD_MIN) {
+    FAIL("%u samples in the window\n", count);
+  }
+  if (p_min < sim_pressure(now_s()) * 10 - PRESSURE_TOLERANCE ||
+      p_max > sim_pressure(now_s() - window) * 10 + PRESSURE_TOLERANCE ||
+      p_min > p_max) {
+    FAIL("pressure %d to %d outside the window\n", p_min, p_max);
+  }
+  if (abs(2 * p_mean - (p_min + p_max)) > 2 * PRESSURE_TOLERANCE) {
+    FAIL("pressure mean %d, expected %d\n", p_mean, (p_min + p_max) / 2);
+  }
+  if (fabs(p_sd - sd) > 0.02 * sd + PRESSURE_TOLERANCE) {
+    FAIL("pressure standard deviation %u, expected %.0f\n", p_sd, sd);
+  }
+  if (t_min > t_mean || t_mean > t_max ||
+      t_max - t_min > (window / TEMPERATURE_LAPSE + 1) * 10) {
+    FAIL("temperature %d to %d, mean %d\n", t_min, t_max, t_mean);
+  }
+  summaries++;
+}
+/**
+ * The status read has to match the change in the environment, and the
+ * advertising data has to carry the same tendency and forecast
+ */
+static void check_weather(const struct weather_status* s) {
+  const uint8_t* p_manuf;
+  uint16_t company;
+  uint8_t len;
+
+  printf("sim: weather at %.3fs, tendency %u, change %dPa, forecast %c, "
+         "%.1fhPa at sea level, %u points\n", now_s(), s->tendency, s->change,
+         (s->forecast == WEATHER_UNKNOWN) ? '?' : 'A' + s->forecast,
+         s->sea_level / 10.0, s->points);
+
+  weather_last = *s;
+  if (weather_checks >= WEATHER_CHECKS) return;
+
+  if (s->tendency != weather_expected[weather_checks].tendency ||
+      abs(s->change - weather_expected[weather_checks].change) > WEATHER_CHANGE_TOLERANCE ||
+      s->forecast != weather_expected[weather_checks].forecast - 'A') {
+    FAIL("weather %u, expected tendency %u, change %d, forecast %c\n", weather_checks,
+         weather_expected[weather_checks].tendency, weather_expected[weather_checks].change,
+         weather_expected[weather_checks].forecast);
+  }
+
+  p_manuf = mock_adv_manuf_data(&company, &len);
+  if (p_manuf == NULL || len != 2 ||
+      p_manuf[0] != s->tendency || p_manuf[1] != s->forecast) {
+    FAIL("advertising doesn't carry the weather\n");
+  }
+  weather_checks++;
+}
+/**
+ * The newest point is the mean over the last WEATHER_POINT_MINUTES
+ */
+static void check_weather_history(const uint8_t* p, uint16_t len) {
+  double point = WEATHER_POINT_MINUTES * 60;
+  double t = floor(now_s() / point) * point - point / 2;
+  int32_t expected = (sim_pressure(t) + 1) / 2;
+  int32_t newest;
+
+  if (len != WEATHER_POINTS * sizeof(uint16_t) || weather_last.points == 0) {
+    FAIL("weather history of %u bytes with %u points\n", len, weather_last.points);
+    return;
+  }
+  newest = p[2 * weather_last.newest] | (p[2 * weather_last.newest + 1] << 8);
+  if (abs(newest - expected) > WEATHER_POINT_TOLERANCE) {
+    FAIL("weather point %d, expected %d\n", newest, expected);
+  }
+}
+/**
+ * Each config read back has to be the last valid one written
+ */
+static void check_config(const struct config* c) {
+  const struct config* expected;
+
+  if (config_writes_done == 0) return;
+  expected = &config_writes[config_expected[config_writes_done - 1]];
+
+  printf("sim: config %u read back, oss %u, sample period %u-%ums, altitude %dm\n",
+         config_writes_done - 1, c->oss, c->sample_period_min, c->sample_period, c->altitude);
+
+  if (memcmp(c, expected, sizeof(*c)) != 0) {
+    FAIL("config %u read back wrong\n", config_writes_done - 1);
+  }
+  config_reads++;
+}
+/**
+ * Decodes a copy in flash, returning false if it doesn't check out
+ */
+static bool config_copy(const uint8_t* p, uint32_t* p_sequence, struct config* c) {
+  uint16_t version = p[0] | (p[1] << 8);
+  uint16_t size = p[2] | (p[3] << 8);
+  uint16_t crc = p[10] | (p[11] << 8);
+  uint16_t computed;
+
+  if (version != CONFIG_VERSION || size != sizeof(*c)) return false;
+
+  computed = crc16_compute(p, 10, NULL);
+  computed = crc16_compute(p + CONFIG_HEADER, size, &computed);
+  if (crc != computed) return false;
+
+  *p_sequence = p[4] | (p[5] << 8) | (p[6] << 16) | ((uint32_t)p[7] << 24);
+  memcpy(c, p + CONFIG_HEADER, sizeof(*c));
+  return true;
+}
+/**
+ * Both copies have to check out, each in a page of its own, the
+ * newer holding the last config written and the older the one before. Loading has to take the
+ * newer, or the older once the newer is corrupted.
+ */
+static void check_config_flash(void) {
+  const struct config* last = &config_writes[config_expected[CONFIG_WRITES - 1]];
+  const struct config* before = &config_writes[config_expected[0]];
+  ble_gap_conn_params_t ppcp;
+  struct config copies[2];
+  uint32_t sequences[2], size;
+  uint8_t* flash = mock_flash(&size);
+  uint8_t newer;
+
+  if (size < 2 * CONFIG_BLOCK ||
+      !config_copy(flash, &sequences[0], &copies[0]) ||
+      !config_copy(flash + CONFIG_BLOCK, &sequences[1], &copies[1])) {
+    FAIL("config copies in flash don't check out\n");
+    return;
+  }
+  newer = (int32_t)(sequences[1] - sequences[0]) > 0;
+  printf("sim: config copies %u and %u in flash, %u stores\n",
+         sequences[0], sequences[1], telemetry_table()[TELEMETRY_CONFIG_STORES]);
+
+  if (memcmp(&copies[newer], last, sizeof(*last)) != 0 ||
+      memcmp(&copies[!newer], before, sizeof(*before)) != 0) {
+    FAIL("config copies in flash aren't the last two written\n");
+  }
+
+  /* Applied */
+  sd_ble_gap_ppcp_get(&ppcp);
+  if (adapt_config()->max_period != last->sample_period ||
+      weather_status()->altitude != last->altitude ||
+      ppcp.max_conn_interval != last->max_conn_interval ||
+      ppcp.conn_sup_timeout != last->conn_sup_timeout) {
+    FAIL("config not applied\n");
+  }
+
+  config_load();
+  if (memcmp(config(), last, sizeof(*last)) != 0) {
+    FAIL("newest config not loaded\n");
+  }
+  flash[newer * CONFIG_BLOCK + CONFIG_HEADER] ^= 0x01;
+  config_load();
+  if (memcmp(config(), before, sizeof(*before)) != 0) {
+    FAIL("didn't fall back to the older config\n");
+  }
+  flash[newer * CONFIG_BLOCK + CONFIG_HEADER] ^= 0x01;
+  config_load();
+}
+/**
+ * Each answer has to be for the last write, and the settings in it
+ * have to be the ones in effect
+ */
+static void check_control(const struct control_response* r) {
+  struct control_settings expected;
+  uint8_t i = control_writes_done - 1;
+
+  printf("sim: control answer %u at %.3fs, result %u, opcode 0x%02X, period %u-%ums, oss %u, "
+         "temperature every %u, filter %u, report %u\n", i, now_s(), r->result, r->opcode,
+         r->settings.sample_period_min, r->settings.sample_period, r->settings.oss,
+         r->settings.temperature_decimation, r->settings.filter, r->settings.report);
+
+  if (control_writes_done == 0 || control_answers != i) {
+    FAIL("control answer %u without a write\n", control_answers);
+    return;
+  }
+  control_answers++;
+
+  expected = control_writes[i].settings;
+  if (control_writes[i].defaults) {
+    expected.sample_period = config()->sample_period;
+    expected.sample_period_min = config()->sample_period_min;
+    expected.oss = config()->oss;
+    expected.temperature_decimation = 1;
+    expected.filter = VARIO_MODEL_BALLOON;
+    expected.report = CONTROL_REPORT_NOTIFY;
+  }
+
+  if (r->result != control_writes[i].result || r->opcode != control_writes[i].opcode ||
+      memcmp(&r->settings, &expected, sizeof(expected)) != 0) {
+    FAIL("control answer %u wrong\n", i);
+  }
+  if (adapt_config()->max_period != expected.sample_period ||
+      adapt_config()->min_period != expected.sample_period_min ||
+      vario_model() != expected.filter) {
+    FAIL("control write %u not applied\n", i);
+  }
+  if (memcmp(flight_config(), control_writes[i].flight ? control_writes[i].flight : flight_defaults(),
+             sizeof(struct flight_config)) != 0 || flight_state() != FLIGHT_PAD) {
+    FAIL("control write %u left the wrong flight thresholds\n", i);
+  }
+}
+static void check_flight_event(const struct flight_record* r) {
+  printf("sim: flight event %u at %.3fs, altitude %.2fm, climb %.2fm/s\n",
+         r->event, now_s(), r->altitude / 100.0, r->climb / 100.0);
+
+  /* The first apogee is lost with the link, so it has to come again */
+  if (r->event == FLIGHT_EVENT_APOGEE && !flight_dropped) {
+    flight_dropped = true;
+    mock_sd_disconnect();
+    return;
+  }
+
+  if (r->event != flight_events) {
+    FAIL("flight event %u, expected %u\n", r->event, flight_events);
+  } else if (now_s() < flight_deadlines[r->event].from ||
+             now_s() > flight_deadlines[r->event].to) {
+    FAIL("flight event %u at %.3fs, expected %.1f to %.1fs\n", r->event, now_s(),
+         flight_deadlines[r->event].from, flight_deadlines[r->event].to);
+  }
+  flight_events++;
+}
+/**
+ * Checks the last window uploaded against the step, or the lack of
+ * one. The samples are taken to be evenly spaced about the trigger.
+ */
+static void check_capture(void) {
+  uint32_t trigger_ms;
+  int32_t expected;
+  uint16_t i;
+
+  if (captures >= CAPTURE_COUNT) return;
+
+  trigger_ms = (uint32_t)(((uint64_t)capture_last.timestamp * 1000) / MOCK_TICKS_PER_SECOND);
+  printf("sim: capture %u triggered by %u at %ums, %u samples, %u uploaded\n",
+         captures, capture_last.source, trigger_ms, capture_last.count, capture_received);
+
+  if (capture_last.state != CAPTURE_FROZEN ||
+      capture_last.source != capture_expected[captures].source) {
+    FAIL("capture %u in state %u from source %u\n",
+         captures, capture_last.state, capture_last.source);
+  }
+  if (trigger_ms < capture_expected[captures].at ||
+      trigger_ms > capture_expected[captures].at + 2 * CAPTURE_PERIOD) {
+    FAIL("capture %u triggered at %ums, expected %ums\n",
+         captures, trigger_ms, capture_expected[captures].at);
+  }
+  if (capture_last.count != CAPTURE_PRE + CAPTURE_POST ||
+      capture_received != capture_last.count) {
+    FAIL("capture %u uploaded %u of %u samples\n",
+         captures, capture_received, capture_last.count);
+  }
+
+  for (i = 0; i < capture_received; i++) {
+    expected = capture_pressure((trigger_ms + ((int32_t)i - CAPTURE_PRE) * CAPTURE_PERIOD) /
+                                1000.0);
+
+    if (abs(capture_window[i] - expected) > PRESSURE_TOLERANCE / 10) {
+      FAIL("capture %u sample %u is %d, expected %d\n",
+           captures, i, capture_window[i], expected);
+      break;
+    }
+  }
+
+  captures++;
+  capture_received = 0;
+}
+/**
+ * The stream has to have sent something, and stopped with the link,
+ * leaving the usual connection parameters for the next connection
+ */
+static void check_stream_end(void) {
+  ble_gap_conn_params_t ppcp;
+
+  printf("sim: %u stream packets\n", stream_packets);
+  if (stream_packets < MIN_NOTIFICATIONS) {
+    FAIL("only %u stream packets\n", stream_packets);
+  }
+
+  sd_ble_gap_ppcp_get(&ppcp);
+  if (stream_active() || ppcp.max_conn_interval != config()->max_conn_interval) {
+    FAIL("stream still running after the disconnect\n");
+  }
+}
+static void rx_handler(uint16_t handle, uint8_t type, const uint8_t* p_data, uint16_t len) {
+  uint32_t value;
+  int16_t temperature;
+  uint8_t i;
+
+  if (handle == pressure_handle && len == sizeof(value)) {
+    memcpy(&value, p_data, sizeof(value));
+    check_pressure(value);
+    if (type == BLE_GATT_HVX_NOTIFICATION) pressure_notifications++; else reads++;
+
+  } else if (handle == temperature_handle && len == sizeof(temperature)) {
+    memcpy(&temperature, p_data, sizeof(temperature));
+    check_temperature(temperature);
+    if (type == BLE_GATT_HVX_NOTIFICATION) temperature_notifications++; else reads++;
+
+  } else if (handle == vario_handle && len == BLE_ESS_VARIO_LEN) {
+    int32_t altitude;
+    int16_t climb;
+
+    memcpy(&altitude, p_data, sizeof(altitude));
+    memcpy(&climb, p_data + sizeof(altitude), sizeof(climb));
+    check_vario(altitude, climb);
+    if (type == BLE_GATT_HVX_NOTIFICATION) vario_notifications++; else reads++;
+
+  } else if (handle == stream_handle && len == STREAM_PACKET_SIZE) {
+    stream_packets++;
+
+  } else if (handle == flight_handle && len == sizeof(struct flight_record)) {
+    struct flight_record record;
+
+    memcpy(&record, p_data, sizeof(record));
+    if (type == BLE_GATT_HVX_INDICATION) check_flight_event(&record); else reads++;
+
+  } else if (handle == capture_status_handle && len == sizeof(struct capture_status)) {
+    memcpy(&capture_last, p_data, sizeof(capture_last));
+    if (type != BLE_GATT_HVX_NOTIFICATION) reads++;
+
+  } else if (handle == capture_data_handle && len > 2 && (len - 2) % 3 == 0) {
+    uint16_t offset = p_data[0] | (p_data[1] << 8);
+
+    for (i = 0; 2 + (3 * i) < len && offset + i < CAPTURE_RING_SIZE; i++) {
+      capture_window[offset + i] = p_data[2 + (3 * i)] | (p_data[3 + (3 * i)] << 8) |
+        (p_data[4 + (3 * i)] << 16);
+    }
+    if (offset == capture_received) capture_received += i;
+
+  } else if (handle == stats_summary_handle && len == STATS_SUMMARY_SIZE) {
+    if (type == BLE_GATT_HVX_NOTIFICATION) check_stats(p_data); else reads++;
+
+  } else if (handle == weather_handle && len == sizeof(struct weather_status)) {
+    struct weather_status status;
+
+    memcpy(&status, p_data, sizeof(status));
+    if (type == BLE_GATT_HVX_INVALID) {
+      check_weather(&status);
+      reads++;
+    } else {
+      weather_notifications++;
+    }
+
+  } else if (handle == config_handle && len == sizeof(struct config)) {
+    struct config c;
+
+    memcpy(&c, p_data, sizeof(c));
+    if (type == BLE_GATT_HVX_INVALID) {
+      check_config(&c);
+      reads++;
+    }
+
+  } else if (handle == control_handle && len == sizeof(struct control_response)) {
+    struct control_response response;
+
+    memcpy(&response, p_data, sizeof(response));
+    if (type == BLE_GATT_HVX_INDICATION) check_control(&response); else reads++;
+
+  } else if (handle == weather_history_handle) {
+    check_weather_history(p_data, len);
+    reads++;
+
+  } else if (handle == telemetry_handle) {
+    printf("sim: telemetry");
+    for (i = 0; i + sizeof(value) <= len; i += sizeof(value)) {
+      memcpy(&value, p_data + i, sizeof(value));
+      printf(" %u", value);
+    }
+    printf("\n");
+    reads++;
+
+#ifdef SYNTH_ENABLED
+  } else if (handle == synth_handle && len == sizeof(struct synth_status)) {
+    struct synth_status status;
+
+    memcpy(&status, p_data, sizeof(status));
+    printf("sim: synth profile %u at %u/s, %u generated, %u checked, %u gaps, %u mismatches\n",
+           status.profile, status.rate, status.generated, status.checked,
+           status.gaps, status.mismatches);
+    if (status.profile != SYNTH_PROFILE || status.rate != SYNTH_RATE) {
+      FAIL("synth running profile %u at %u/s\n", status.profile, status.rate);
+    }
+    if (status.checked < MIN_NOTIFICATIONS || status.mismatches) {
+      FAIL("%u synthetic samples checked, %u mismatched\n", status.checked, status.mismatches);
+    }
+    reads++;
+#endif
+  }
+}
+static void subscribe(uint8_t uuid_type, uint16_t uuid, uint8_t type) {
+  uint8_t cccd[2] = { type, 0 };
+  uint16_t handle = mock_sd_cccd_find(uuid_type, uuid);
+
+  if (handle == BLE_GATT_HANDLE_INVALID) {
+    FAIL("no CCCD for 0x%04X\n", uuid);
+    return;
+  }
+  mock_sd_write(handle, cccd, sizeof(cccd));
+}
+
+/* -----------------------------------------------------------------------------
+ * Script
+ */
+
+static void summary(void) {
+  const struct mock_sd_stats* sd = mock_sd_stats();
+  const struct bmp180_sim_stats* bmp = bmp180_sim_stats();
+
+  printf("sim: %.3fs simulated in %.1fms of host time\n",
+         now_s(), 1000.0 * clock() / CLOCKS_PER_SEC);
+  printf("sim: %u pressure, %u temperature and %u altitude notifications, %u reads\n",
+         pressure_notifications, temperature_notifications, vario_notifications, reads);
+  printf("sim: radio %u connection events, %u notifications, %u TX buffer full, "
+         "%u advertising starts, %u parameter updates\n",
+         sd->connection_events, sd->notifications, sd->tx_buffers_full,
+         sd->adv_starts, sd->conn_param_updates);
+  printf("sim: bmp180 %u transfers, %u bytes, %u temperature and %u pressure conversions\n",
+         bmp->transfers, bmp->bytes, bmp->temperature_conversions, bmp->pressure_conversions);
+}
+static void phase_end(void) {
+  struct energy_activity now;
+
+  energy_snapshot(&now);
+  if (phase) energy_report(phase, &phase_start, &now, battery_mah);
+  phase_start = now;
+}
+static void end(void) {
+  if (energy) {
+    phase_end();
+  } else if (flying) {
+    if (flight_events != FLIGHT_EVENT_COUNT) {
+      FAIL("only %u flight events\n", flight_events);
+    }
+    if (!flight_dropped) FAIL("apogee never dropped\n");
+  } else if (adapting) {
+    double still = (marks[1] - marks[0]) / 30.0;
+    double moving = (marks[3] - marks[2]) / 10.0;
+
+    printf("sim: %.2f samples/s still, %.2f samples/s moving\n", still, moving);
+    if (mark_count != 4 || still > ADAPT_STILL_MAX || moving < ADAPT_MOVING_MIN) {
+      FAIL("sampling didn't follow the pressure\n");
+    }
+  } else if (configuring) {
+    if (config_reads != CONFIG_WRITES) {
+      FAIL("only %u configs read back\n", config_reads);
+    }
+  } else if (controlling) {
+    double rate = (marks[1] - marks[0]) / 5.0;
+    double temperature_rate =
+      (control_marks[1].temperature_conversions - control_marks[0].temperature_conversions) / 5.0;
+
+    printf("sim: %.2f samples/s and %.2f temperatures/s fast, %u notifications stored only\n",
+           rate, temperature_rate, control_marks[3].notifications - control_marks[2].notifications);
+    if (control_answers != CONTROL_WRITES) {
+      FAIL("only %u control answers\n", control_answers);
+    }
+    if (mark_count != 4 ||
+        fabs(rate - 1000.0 / CONTROL_PERIOD) > CONTROL_RATE_TOLERANCE * 1000.0 / CONTROL_PERIOD ||
+        fabs(temperature_rate - rate / CONTROL_DECIMATION) >
+        CONTROL_RATE_TOLERANCE * rate / CONTROL_DECIMATION + 0.2) {
+      FAIL("sampling didn't follow the control point\n");
+    }
+    if (control_marks[3].notifications != control_marks[2].notifications ||
+        marks[3] == marks[2]) {
+      FAIL("samples notified while only stored\n");
+    }
+    if (pressure_notifications + temperature_notifications + vario_notifications ==
+        control_marks[3].notifications || reads < 1) {
+      FAIL("nothing notified after going back to the config\n");
+    }
+  } else if (weathering) {
+    if (weather_checks != WEATHER_CHECKS) {
+      FAIL("only %u weather reads\n", weather_checks);
+    }
+    if (weather_notifications < WEATHER_MIN_NOTIFICATIONS) {
+      FAIL("only %u weather notifications\n", weather_notifications);
+    }
+  } else if (summarising) {
+    if (summaries < STATS_MIN_SUMMARIES) {
+      FAIL("only %u summaries\n", summaries);
+    }
+    if (pressure_notifications || temperature_notifications || vario_notifications) {
+      FAIL("notified every sample as well\n");
+    }
+  } else if (capturing) {
+    check_capture();
+    if (captures != CAPTURE_COUNT) {
+      FAIL("only %u captures\n", captures);
+    }
+    /* The pipeline carries on from the capture samples */
+    if (pressure_notifications < MIN_NOTIFICATIONS) {
+      FAIL("only %u pressure notifications\n", pressure_notifications);
+    }
+  } else {
+    if (pressure_notifications < MIN_NOTIFICATIONS) {
+      FAIL("only %u pressure notifications\n", pressure_notifications);
+    }
+    if (vario_notifications < MIN_NOTIFICATIONS) {
+      FAIL("only %u altitude notifications\n", vario_notifications);
+    }
+    if (reads < 2) {
+      FAIL("only %u reads answered\n", reads);
+    }
+    if (faulty && telemetry_table()[TELEMETRY_SAMPLES_REJECTED] < 2 * FAULT_COUNT) {
+      FAIL("only %u samples rejected\n", telemetry_table()[TELEMETRY_SAMPLES_REJECTED]);
+    }
+    if (script == default_script) check_stream_end();
+  }
+  if (bmp180_sim_stats()->overlapped) {
+    FAIL("%u conversions started before the last was done\n", bmp180_sim_stats()->overlapped);
+  }
+
+  summary();
+  printf("sim: %s\n", failures ? "FAILED" : "passed");
+
+  exit(failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+static void step_run(const struct step* p_step) {
+  switch (p_step->action) {
+    case ACTION_CONNECT:
+      if (!mock_sd_connect()) FAIL("not advertising at %.3fs\n", now_s());
+      break;
+    case ACTION_READ_PRESSURE:
+      mock_sd_read(pressure_handle);
+      break;
+    case ACTION_SUBSCRIBE:
+      if (summarising) {
+        subscribe(BLE_UUID_TYPE_VENDOR_BEGIN, BLE_ESS_UUID_STATS_SUMMARY_CHAR,
+                  BLE_GATT_HVX_NOTIFICATION);
+        break;
+      }
+      if (weathering) {
+        /* As a gateway would, the status alone has to keep the sampling going */
+        subscribe(BLE_UUID_TYPE_VENDOR_BEGIN, BLE_ESS_UUID_WEATHER_CHAR,
+                  BLE_GATT_HVX_NOTIFICATION);
+        break;
+      }
+      if (flying) {
+        /* The events alone have to keep the sampling going */
+        subscribe(BLE_UUID_TYPE_VENDOR_BEGIN, BLE_ESS_UUID_FLIGHT_EVENT_CHAR,
+                  BLE_GATT_HVX_INDICATION);
+        break;
+      }
+      subscribe(BLE_UUID_TYPE_BLE, UUID_PRESSURE_CHAR, BLE_GATT_HVX_NOTIFICATION);
+      subscribe(BLE_UUID_TYPE_BLE, UUID_TEMPERATURE_CHAR, BLE_GATT_HVX_NOTIFICATION);
+      subscribe(BLE_UUID_TYPE_VENDOR_BEGIN, BLE_ESS_UUID_VARIO_CHAR,
+                BLE_GATT_HVX_NOTIFICATION);
+      subscribe(BLE_UUID_TYPE_VENDOR_BEGIN, BLE_ESS_UUID_FLIGHT_EVENT_CHAR,
+                BLE_GATT_HVX_INDICATION);
+      if (controlling) {
+        subscribe(BLE_UUID_TYPE_VENDOR_BEGIN, BLE_ESS_UUID_CONTROL_POINT_CHAR,
+                  BLE_GATT_HVX_INDICATION);
+      }
+      if (capturing) {
+        subscribe(BLE_UUID_TYPE_VENDOR_BEGIN, BLE_ESS_UUID_CAPTURE_STATUS_CHAR,
+                  BLE_GATT_HVX_NOTIFICATION);
+        subscribe(BLE_UUID_TYPE_VENDOR_BEGIN, BLE_ESS_UUID_CAPTURE_DATA_CHAR,
+                  BLE_GATT_HVX_NOTIFICATION);
+      }
+      break;
+    case ACTION_STREAM:
+      subscribe(BLE_UUID_TYPE_VENDOR_BEGIN, BLE_ESS_UUID_STREAM_CHAR, BLE_GATT_HVX_NOTIFICATION);
+      break;
+    case ACTION_STREAM_STOP:
+      subscribe(BLE_UUID_TYPE_VENDOR_BEGIN, BLE_ESS_UUID_STREAM_CHAR, 0);
+      break;
+    case ACTION_READ_TELEMETRY:
+      mock_sd_read(telemetry_handle);
+      break;
+    case ACTION_DISCONNECT:
+      mock_sd_disconnect();
+      break;
+    case ACTION_SYNTH_START:
+      {
+        uint8_t config[4] = { SYNTH_PROFILE, 0, SYNTH_RATE & 0xFF, SYNTH_RATE >> 8 };
+        mock_sd_write(synth_handle, config, sizeof(config));
+        synthetic = true;
+      }
+      break;
+    case ACTION_SYNTH_STOP:
+      {
+        uint8_t config[4] = { SYNTH_OFF, 0, 0, 0 };
+        mock_sd_write(synth_handle, config, sizeof(config));
+        synth_stopped = now_s();
+        climb_from = 0;		/* The filter starts again */
+      }
+      break;
+    case ACTION_READ_SYNTH:
+      mock_sd_read(synth_handle);
+      break;
+    case ACTION_CAPTURE_ARM:
+      {
+        uint8_t command[2 + sizeof(struct capture_config)] = {
+          CAPTURE_OP_ARM, 0,
+          CAPTURE_PERIOD & 0xFF, CAPTURE_PERIOD >> 8,
+          CAPTURE_PRE & 0xFF, CAPTURE_PRE >> 8,
+          CAPTURE_POST & 0xFF, CAPTURE_POST >> 8,
+          CAPTURE_THRESHOLD & 0xFF, CAPTURE_THRESHOLD >> 8,
+        };
+        if (capture_received) check_capture();
+        mock_sd_write(capture_status_handle, command, sizeof(command));
+      }
+      break;
+    case ACTION_CAPTURE_UPLOAD:
+      {
+        uint8_t command = CAPTURE_OP_UPLOAD;
+        capture_received = 0;
+        mock_sd_write(capture_status_handle, &command, sizeof(command));
+      }
+      break;
+    case ACTION_BUTTON:
+      mock_button_press(BUTTON_0);
+      break;
+    case ACTION_PROFILE:
+      {
+        uint8_t profile = ADAPT_PROFILE;
+        mock_sd_write(power_profile_handle, &profile, sizeof(profile));
+      }
+      break;
+    case ACTION_STATS_CONFIG:
+      {
+        uint8_t config[4] = { STATS_PERIOD, 0, stats_buckets ? STATS_SLIDING : 1, 0 };
+        mock_sd_write(stats_config_handle, config, sizeof(config));
+        stats_buckets = config[2];
+      }
+      break;
+    case ACTION_READ_WEATHER:
+      mock_sd_read(weather_handle);
+      mock_sd_read(weather_history_handle);
+      break;
+    case ACTION_CONFIG_WRITE:
+      if (config_writes_done < CONFIG_WRITES) {
+        mock_sd_write(config_handle, (const uint8_t*)&config_writes[config_writes_done],
+                      sizeof(struct config));
+        config_writes_done++;
+      }
+      break;
+    case ACTION_CONFIG_READ:
+      mock_sd_read(config_handle);
+      break;
+    case ACTION_CONFIG_CHECK:
+      check_config_flash();
+      break;
+    case ACTION_CONTROL_WRITE:
+      if (control_writes_done < CONTROL_WRITES) {
+        mock_sd_write(control_handle, control_writes[control_writes_done].command,
+                      control_writes[control_writes_done].len);
+        control_writes_done++;
+        control_written = now_s();
+      }
+      break;
+    case ACTION_SPIKE:
+      bmp180_sim_spike(FAULT_SPIKE);
+      break;
+    case ACTION_TWI_FAIL:
+      bmp180_sim_fail(1);
+      break;
+    case ACTION_MARK:
+      if (mark_count < sizeof(marks) / sizeof(marks[0])) {
+        control_marks[mark_count].temperature_conversions =
+          bmp180_sim_stats()->temperature_conversions;
+        control_marks[mark_count].notifications =
+          pressure_notifications + temperature_notifications + vario_notifications;
+        marks[mark_count++] = bmp180_sim_stats()->pressure_conversions;
+      }
+      break;
+    case ACTION_PHASE:
+      phase_end();
+      phase = p_step->phase;
+      break;
+    case ACTION_END:
+      end();
+      break;
+  }
+}
+/**
+ * Environment variables, where unset or empty means the default
+ */
+static double env_get(const char* name, double fallback) {
+  const char* value = getenv(name);
+
+  return (value && *value) ? atof(value) : fallback;
+}
+static void energy_script_build(void) {
+  uint32_t advertising = 1000 * env_get("ENERGY_ADVERTISING_S", ENERGY_ADVERTISING_S);
+  uint32_t connected = 1000 * env_get("ENERGY_CONNECTED_S", ENERGY_CONNECTED_S);
+  uint8_t n = 0;
+
+  battery_mah = env_get("BATTERY_MAH", BATTERY_MAH);
+
+  energy_script[n++] = (struct step){ 0, ACTION_PHASE, "advertising" };
+  energy_script[n++] = (struct step){ advertising, ACTION_PHASE, NULL };
+  energy_script[n++] = (struct step){ advertising, ACTION_CONNECT, NULL };
+  energy_script[n++] = (struct step){ advertising + 500, ACTION_SUBSCRIBE, NULL };
+  energy_script[n++] = (struct step){ advertising + ENERGY_SETTLE_MS, ACTION_PHASE, "connected" };
+  energy_script[n++] = (struct step){ advertising + ENERGY_SETTLE_MS + connected, ACTION_END, NULL };
+
+  script = energy_script;
+  script_length = n;
+  energy = true;
+}
+static void start(void) {
+  uint8_t vendor_type = BLE_UUID_TYPE_VENDOR_BEGIN;
+  const char* name = getenv("SIM_SCRIPT");
+
+  if (name && !strcmp(name, "energy")) energy_script_build();
+  if (name && !strcmp(name, "flight")) {
+    script = flight_script;
+    script_length = sizeof(flight_script) / sizeof(flight_script[0]);
+    flying = true;
+  }
+  if (name && !strcmp(name, "capture")) {
+    script = capture_script;
+    script_length = sizeof(capture_script) / sizeof(capture_script[0]);
+    capturing = true;
+  }
+  if (name && !strcmp(name, "faults")) {
+    script = faults_script;
+    script_length = sizeof(faults_script) / sizeof(faults_script[0]);
+    faulty = true;
+  }
+  if (name && !strcmp(name, "stats")) {
+    script = stats_script;
+    script_length = sizeof(stats_script) / sizeof(stats_script[0]);
+    summarising = true;
+  }
+  if (name && !strcmp(name, "weather")) {
+    script = weather_script;
+    script_length = sizeof(weather_script) / sizeof(weather_script[0]);
+    weathering = true;
+  }
+  if (name && !strcmp(name, "config")) {
+    script = config_script;
+    script_length = sizeof(config_script) / sizeof(config_script[0]);
+    configuring = true;
+  }
+  if (name && !strcmp(name, "control")) {
+    script = control_script;
+    script_length = sizeof(control_script) / sizeof(control_script[0]);
+    controlling = true;
+  }
+  if (name && !strcmp(name, "adapt")) {
+    script = adapt_script;
+    script_length = sizeof(adapt_script) / sizeof(adapt_script[0]);
+    adapting = true;
+  }
+#ifdef SYNTH_ENABLED
+  if (name && !strcmp(name, "synth")) {
+    script = synth_script;
+    script_length = sizeof(synth_script) / sizeof(synth_script[0]);
+    synth_handle = mock_sd_handle_find(vendor_type, BLE_ESS_UUID_SYNTH_CHAR);
+    if (synth_handle == BLE_GATT_HANDLE_INVALID) {
+      FAIL("synthetic data source characteristic missing\n");
+      end();
+    }
+  }
+#endif
+
+  pressure_handle = mock_sd_handle_find(BLE_UUID_TYPE_BLE, UUID_PRESSURE_CHAR);
+  temperature_handle = mock_sd_handle_find(BLE_UUID_TYPE_BLE, UUID_TEMPERATURE_CHAR);
+  telemetry_handle = mock_sd_handle_find(vendor_type, BLE_ESS_UUID_TELEMETRY_CHAR);
+  vario_handle = mock_sd_handle_find(vendor_type, BLE_ESS_UUID_VARIO_CHAR);
+  flight_handle = mock_sd_handle_find(vendor_type, BLE_ESS_UUID_FLIGHT_EVENT_CHAR);
+  capture_status_handle = mock_sd_handle_find(vendor_type, BLE_ESS_UUID_CAPTURE_STATUS_CHAR);
+  capture_data_handle = mock_sd_handle_find(vendor_type, BLE_ESS_UUID_CAPTURE_DATA_CHAR);
+  power_profile_handle = mock_sd_handle_find(vendor_type, BLE_ESS_UUID_POWER_PROFILE_CHAR);
+  stats_config_handle = mock_sd_handle_find(vendor_type, BLE_ESS_UUID_STATS_CONFIG_CHAR);
+  stats_summary_handle = mock_sd_handle_find(vendor_type, BLE_ESS_UUID_STATS_SUMMARY_CHAR);
+  weather_handle = mock_sd_handle_find(vendor_type, BLE_ESS_UUID_WEATHER_CHAR);
+  weather_history_handle = mock_sd_handle_find(vendor_type, BLE_ESS_UUID_WEATHER_HISTORY_CHAR);
+  config_handle = mock_sd_handle_find(vendor_type, BLE_ESS_UUID_CONFIG_CHAR);
+  control_handle = mock_sd_handle_find(vendor_type, BLE_ESS_UUID_CONTROL_POINT_CHAR);
+  stream_handle = mock_sd_handle_find(vendor_type, BLE_ESS_UUID_STREAM_CHAR);
+  if (pressure_handle == BLE_GATT_HANDLE_INVALID ||
+      temperature_handle == BLE_GATT_HANDLE_INVALID ||
+      telemetry_handle == BLE_GATT_HANDLE_INVALID ||
+      vario_handle == BLE_GATT_HANDLE_INVALID ||
+      flight_handle == BLE_GATT_HANDLE_INVALID ||
+      capture_status_handle == BLE_GATT_HANDLE_INVALID ||
+      capture_data_handle == BLE_GATT_HANDLE_INVALID ||
+      power_profile_handle == BLE_GATT_HANDLE_INVALID ||
+      stats_config_handle == BLE_GATT_HANDLE_INVALID ||
+      stats_summary_handle == BLE_GATT_HANDLE_INVALID ||
+      weather_handle == BLE_GATT_HANDLE_INVALID ||
+      weather_history_handle == BLE_GATT_HANDLE_INVALID ||
+      config_handle == BLE_GATT_HANDLE_INVALID ||
+      control_handle == BLE_GATT_HANDLE_INVALID ||
+      stream_handle == BLE_GATT_HANDLE_INVALID) {
+    FAIL("characteristics missing from the GATT table\n");
+    end();
+  }
+
+  mock_sd_rx_handler_set(rx_handler);
+  printf("sim: booted at %.3fs\n", now_s());
+}
+
+/**
+ * Called whenever the firmware sleeps. Returns once something has
+ * happened that the firmware would have woken for.
+ */
+void sim_wait(void) {
+  static bool started;
+  uint64_t next, when;
+  bool found;
+
+  if (!started) {
+    started = true;
+    start();
+  }
+
+  energy_wakeup();
+
+  while (1) {
+    if (mock_sd_dispatch()) return;
+    if (mock_adc_run()) return;
+    if (mock_timer_run()) return;
+
+    if (next_step < script_length &&
+        MOCK_MS_TO_TICKS(script[next_step].at) <= mock_time()) {
+      step_run(&script[next_step++]);
+      return;
+    }
+
+    /* Nothing due, move on to whatever is next */
+    found = false;
+    if (next_step < script_length) {
+      next = MOCK_MS_TO_TICKS(script[next_step].at);
+      found = true;
+    }
+    if (mock_timer_next(&when) && (!found || when < next)) {
+      next = when;
+      found = true;
+    }
+    if (mock_sd_next(&when) && (!found || when < next)) {
+      next = when;
+      found = true;
+    }
+    if (!found) {
+      FAIL("nothing left to wake for at %.3fs\n", now_s());
+      end();
+    }
+
+    mock_time_set(next);
+    environment_update();
+    mock_sd_run();
+  }
+}
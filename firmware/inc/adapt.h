@@ -0,0 +1,64 @@
+/*
+ * Adaptive sampling
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ADAPT_H
+#define ADAPT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+#include "pipeline.h"
+
+/**
+ * The period is chosen so that each sample moves by about this many
+ * times the noise
+ */
+#define ADAPT_STEP_SIGMAS	4
+
+/**
+ * Samples the pressure has to stay quiet for before the period is
+ * doubled. Shortening it happens straight away.
+ */
+#define ADAPT_HOLD		4
+
+/**
+ * Limits on the bounds, ms. The shortest leaves room for a conversion
+ * at any oversampling setting.
+ */
+#define ADAPT_PERIOD_MIN	50
+#define ADAPT_PERIOD_MAX	60000
+
+struct adapt_config {
+  uint16_t min_period;		/* ms, in fast motion, or 0 for a fixed period */
+  uint16_t max_period;		/* ms, when static */
+};
+
+bool adapt_check(const struct adapt_config* config);
+bool adapt_configure(const struct adapt_config* config);
+const struct adapt_config* adapt_config(void);
+uint16_t adapt_period(void);
+enum stage_result adapt_stage(struct sample* s);
+void adapt_on_ble_evt(ble_evt_t* p_ble_evt);
+
+#endif /* ADAPT_H */
@@ -0,0 +1,53 @@
+/*
+ * Advertising manager
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ADVERTISING_H
+#define ADVERTISING_H
+
+#include "ble.h"
+#include "device_manager.h"
+
+/**
+ * Advertising phases, in the order they run after a disconnect
+ */
+enum adv_phase {
+  ADV_PHASE_IDLE,		/* Connected, or not started */
+  ADV_PHASE_DIRECTED,		/* High duty directed to the last bonded central */
+  ADV_PHASE_FAST,		/* Quick discovery */
+  ADV_PHASE_SLOW		/* Until a connection, at the power profile's interval */
+};
+
+/**
+ * Fast phase interval (0.625ms units) and timeout (s)
+ */
+#define ADV_FAST_INTERVAL	40	/* 25ms */
+#define ADV_FAST_TIMEOUT	30
+
+void advertising_start(void);
+void advertising_boost(void);
+void advertising_peer_set(dm_handle_t const* p_handle);
+enum adv_phase advertising_phase(void);
+void advertising_on_ble_evt(ble_evt_t* p_ble_evt);
+
+#endif /* ADVERTISING_H */
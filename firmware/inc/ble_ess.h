@@ -48,6 +48,7 @@
 #include <stdbool.h>
 #include "ble.h"
 #include "ble_srv_common.h"
+#include "pipeline.h"
 
 // Body Sensor Location values
 #define BLE_ESS_BODY_SENSOR_LOCATION_OTHER      0
@@ -60,17 +61,51 @@
 
 #define BLE_ESS_MAX_BUFFERED_RR_INTERVALS       20      /**< Size of RR Interval buffer inside service. */
 
+// Vendor specific characteristic UUIDs, relative to the service's vendor base UUID
+#define BLE_ESS_UUID_POWER_PROFILE_CHAR         0x0101  /**< Power profile characteristic UUID. */
+#define BLE_ESS_UUID_LINK_QUALITY_CHAR          0x0102  /**< Link quality characteristic UUID. */
+#define BLE_ESS_UUID_STREAM_CHAR                0x0103  /**< Pressure stream characteristic UUID. */
+#define BLE_ESS_UUID_STREAM_STATS_CHAR          0x0104  /**< Pressure stream statistics characteristic UUID. */
+#define BLE_ESS_UUID_PROFILING_CHAR             0x0105  /**< Execution time profiling characteristic UUID, only with PROF_ENABLED. */
+#define BLE_ESS_UUID_TELEMETRY_CHAR             0x0106  /**< Runtime telemetry counters characteristic UUID. */
+#define BLE_ESS_UUID_CRASH_HISTORY_CHAR         0x0107  /**< Crash history characteristic UUID. */
+#define BLE_ESS_UUID_SYNTH_CHAR                 0x0108  /**< Synthetic data source characteristic UUID, only with SYNTH_ENABLED. */
+#define BLE_ESS_UUID_VARIO_CHAR                 0x0109  /**< Filtered altitude and climb rate characteristic UUID. */
+#define BLE_ESS_UUID_FLIGHT_EVENT_CHAR          0x010A  /**< Flight events characteristic UUID. */
+#define BLE_ESS_UUID_CAPTURE_STATUS_CHAR        0x010B  /**< Burst capture status and control characteristic UUID. */
+#define BLE_ESS_UUID_CAPTURE_DATA_CHAR          0x010C  /**< Burst capture upload characteristic UUID. */
+#define BLE_ESS_UUID_STATS_CONFIG_CHAR          0x010D  /**< Windowed statistics period and window length characteristic UUID. */
+#define BLE_ESS_UUID_STATS_SUMMARY_CHAR         0x010E  /**< Windowed statistics summary characteristic UUID. */
+#define BLE_ESS_UUID_WEATHER_CHAR               0x010F  /**< Pressure tendency and forecast characteristic UUID. */
+#define BLE_ESS_UUID_WEATHER_HISTORY_CHAR       0x0110  /**< 24 hour pressure history characteristic UUID. */
+#define BLE_ESS_UUID_CONFIG_CHAR                0x0111  /**< Persistent configuration characteristic UUID. */
+#define BLE_ESS_UUID_CONTROL_POINT_CHAR         0x0112  /**< Sampling control point characteristic UUID. */
+
+#define BLE_ESS_VARIO_LEN                       6       /**< Altitude in cm (int32) then climb rate in cm/s (int16), little endian. */
+
+// Properties for vendor specific characteristics
+#define BLE_ESS_CHAR_READ                       (1 << 0)        /**< Characteristic can be read. */
+#define BLE_ESS_CHAR_WRITE                      (1 << 1)        /**< Characteristic can be written with a Write Request. */
+#define BLE_ESS_CHAR_NOTIFY                     (1 << 2)        /**< Characteristic supports notification. */
+#define BLE_ESS_CHAR_INDICATE                   (1 << 3)        /**< Characteristic supports indication. */
+#define BLE_ESS_CHAR_USER_MEM                   (1 << 4)        /**< Value lives in application memory, so it can be changed without a call to the stack. */
+
 /**@brief Heart Rate Service event type. */
 typedef enum
 {
     BLE_ESS_EVT_NOTIFICATION_ENABLED,                   /**< Heart Rate value notification enabled event. */
-    BLE_ESS_EVT_NOTIFICATION_DISABLED                   /**< Heart Rate value notification disabled event. */
+    BLE_ESS_EVT_NOTIFICATION_DISABLED,                  /**< Heart Rate value notification disabled event. */
+    BLE_ESS_EVT_WRITE,                                  /**< A vendor specific characteristic or its CCCD has been written. */
+    BLE_ESS_EVT_READ_REQUEST                            /**< Pressure or temperature read in lazy read mode, answer with ble_ess_read_reply(). */
 } ble_ess_evt_type_t;
 
 /**@brief Heart Rate Service event. */
 typedef struct
 {
     ble_ess_evt_type_t evt_type;                        /**< Type of event. */
+    uint16_t           handle;                          /**< Handle of the attribute that was written. */
+    uint8_t *          p_data;                          /**< Data written, only valid for the duration of the event. */
+    uint16_t           len;                             /**< Length of the data written. */
 } ble_ess_evt_t;
 
 // Forward declaration of the ble_ess_t type.
@@ -85,6 +120,7 @@ typedef struct
 {
     ble_ess_evt_handler_t        evt_handler;                                          /**< Event handler to be called for handling events in the Heart Rate Service. */
     bool                         is_sensor_contact_supported;                          /**< Determines if sensor contact detection is to be supported. */
+    bool                         lazy_read;                                            /**< Reads of the pressure and temperature characteristics are authorized by the application, so each can trigger a fresh conversion. */
     uint8_t *                    p_body_sensor_location;                               /**< If not NULL, initial value of the Body Sensor Location characteristic. */
     ble_srv_cccd_security_mode_t ess_pc_attr_md;                                      /**< Initial security level for heart rate service measurement attribute */
     ble_srv_cccd_security_mode_t ess_tc_attr_md;                                      /**< Initial security level for body sensor location attribute */
@@ -97,13 +133,19 @@ typedef struct ble_ess_s
     bool                         is_expended_energy_supported;                         /**< TRUE if Expended Energy measurement is supported. */
     bool                         is_sensor_contact_supported;                          /**< TRUE if sensor contact detection is supported. */
     uint16_t                     service_handle;                                       /**< Handle of Heart Rate Service (as provided by the BLE stack). */
+    uint8_t                      uuid_type;                                            /**< UUID type of the vendor specific base UUID. */
+    uint16_t                     read_pending_handle;                                  /**< Handle of a read waiting for ble_ess_read_reply(), or BLE_GATT_HANDLE_INVALID. */
     ble_gatts_char_handles_t     pc_handles;                                          /**< Handles related to the pressure characteristic. */
     ble_gatts_char_handles_t     tc_handles;                                          /**< Handles related to the temperature characteristic. */
+    ble_gatts_char_handles_t     vc_handles;                                          /**< Handles related to the altitude and climb rate characteristic. */
     uint16_t                     conn_handle;                                          /**< Handle of the current connection (as provided by the BLE stack, is BLE_CONN_HANDLE_INVALID if not in a connection). */
     bool                         is_sensor_contact_detected;                           /**< TRUE if sensor contact has been detected. */
+    bool                         is_notifying;                                         /**< FALSE to keep the measurements in the database without notifying them. */
 
   uint32_t		pressure_last;
   int16_t 		temperature_last;
+  int32_t		altitude_last;
+  int16_t		climb_last;
 } ble_ess_t;
 
 /**@brief Function for initializing the Heart Rate Service.
@@ -126,20 +168,139 @@ uint32_t ble_ess_init(ble_ess_t * p_ess, const ble_ess_init_t * p_ess_init);
  */
 void ble_ess_on_ble_evt(ble_ess_t * p_ess, ble_evt_t * p_ble_evt);
 
-/**@brief Function for sending heart rate measurement if notification has been enabled.
+/**@brief Function for sending a pressure measurement if notification has been enabled.
+ *
+ * @details The application calls this function after having performed a pressure measurement.
+ *          The value is written to the database, and if a client is connected it is notified.
+ *          If there are no free TX buffers the value is not recorded as sent, so the same
+ *          value can be sent again later.
+ *
+ * @param[in]   p_ess                    Environmental Sensing Service structure.
+ * @param[in]   pressure                 New pressure measurement in units of 0.1Pa.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t ble_ess_pressure_send(ble_ess_t * p_ess, uint32_t pressure);
+
+/**@brief Function for sending a temperature measurement if notification has been enabled.
+ *
+ * @param[in]   p_ess                    Environmental Sensing Service structure.
+ * @param[in]   temperature              New temperature measurement in units of 0.01°C.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t ble_ess_temperature_send(ble_ess_t * p_ess, int16_t temperature);
+
+/**@brief Function for sending a filtered altitude and climb rate if notification has been enabled.
+ *
+ * @details As for pressure, if there are no free TX buffers the values are not recorded as sent.
+ *
+ * @param[in]   p_ess                    Environmental Sensing Service structure.
+ * @param[in]   altitude                 ISA altitude in cm.
+ * @param[in]   climb                    Climb rate in cm/s, negative when descending.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t ble_ess_vario_send(ble_ess_t * p_ess, int32_t altitude, int16_t climb);
+
+/**@brief Function for choosing whether measurements are notified.
+ *
+ * @details When not notifying, pressure, temperature and altitude are still written to the
+ *          database, so a client can read them, and the send functions return
+ *          NRF_ERROR_INVALID_STATE as if nobody were connected.
+ *
+ * @param[in]   p_ess                    Environmental Sensing Service structure.
+ * @param[in]   notify                   TRUE to notify measurements, FALSE to only store them.
+ */
+void ble_ess_notify_set(ble_ess_t * p_ess, bool notify);
+
+/**@brief Pipeline stage for converting a sample into Environmental Sensing Service units.
+ *
+ * @details Doesn't touch the stack, so it can be run without the SoftDevice.
+ *
+ * @param[in]   s   Compensated sample, encoded in place.
+ *
+ * @return      STAGE_PASS.
+ */
+enum stage_result ble_ess_encode_stage(struct sample * s);
+
+/**@brief Function for answering a read of the pressure or temperature characteristic in lazy
+ *        read mode with fresh values.
+ *
+ * @details Both characteristics are updated in the database, and the pending read is answered.
+ *
+ * @param[in]   p_ess                    Environmental Sensing Service structure.
+ * @param[in]   pressure                 Pressure in units of 0.1Pa.
+ * @param[in]   temperature              Temperature in units of 0.01°C.
+ *
+ * @return      NRF_SUCCESS on success, NRF_ERROR_INVALID_STATE if no read is pending, otherwise
+ *              an error code.
+ */
+uint32_t ble_ess_read_reply(ble_ess_t * p_ess, uint32_t pressure, int16_t temperature);
+
+/**@brief Function for answering a read of the pressure or temperature characteristic in lazy
+ *        read mode with the value already in the database.
+ *
+ * @param[in]   p_ess                    Environmental Sensing Service structure.
+ *
+ * @return      NRF_SUCCESS on success, NRF_ERROR_INVALID_STATE if no read is pending, otherwise
+ *              an error code.
+ */
+uint32_t ble_ess_read_reply_stored(ble_ess_t * p_ess);
+
+/**@brief Function for checking if a client is subscribed to pressure, temperature or altitude.
+ *
+ * @details The CCCDs are read from the stack, so this is also correct after a bonded client's
+ *          system attributes are restored.
+ *
+ * @param[in]   p_ess                    Environmental Sensing Service structure.
+ *
+ * @return      true if connected and notification is enabled on any of the characteristics.
+ */
+bool ble_ess_is_subscribed(ble_ess_t * p_ess);
+
+/**@brief Function for adding a vendor specific characteristic to the service.
+ *
+ * @details Writes to the characteristic, and to its CCCD if it has one, are passed to the
+ *          application as BLE_ESS_EVT_WRITE events.
+ *
+ * @param[in]   p_ess        Environmental Sensing Service structure.
+ * @param[in]   uuid         16-bit UUID, relative to the vendor specific base UUID.
+ * @param[in]   props        Bitmask of BLE_ESS_CHAR_* properties.
+ * @param[in]   p_value      Initial value. With BLE_ESS_CHAR_USER_MEM this memory holds the value
+ *                           for the lifetime of the characteristic.
+ * @param[in]   len          Initial length of the value.
+ * @param[in]   max_len      Maximum length of the value.
+ * @param[out]  p_handles    Handles of the new characteristic.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+uint32_t ble_ess_char_add(ble_ess_t *                p_ess,
+                          uint16_t                   uuid,
+                          uint8_t                    props,
+                          uint8_t *                  p_value,
+                          uint16_t                   len,
+                          uint16_t                   max_len,
+                          ble_gatts_char_handles_t * p_handles);
+
+/**@brief Function for updating a vendor specific characteristic.
  *
- * @details The application calls this function after having performed a heart rate measurement.
- *          If notification has been enabled, the heart rate measurement data is encoded and sent to
- *          the client.
+ * @details The value is written to the database. If a client is connected and @p hvx_type is
+ *          not BLE_GATT_HVX_INVALID it is also notified or indicated.
  *
- * @param[in]   p_ess                    Heart Rate Service structure.
- * @param[in]   heart_rate               New heart rate measurement.
- * @param[in]   include_expended_energy  Determines if expended energy will be included in the
- *                                       heart rate measurement data.
+ * @param[in]   p_ess        Environmental Sensing Service structure.
+ * @param[in]   p_handles    Handles of the characteristic.
+ * @param[in]   p_data       New value.
+ * @param[in]   len          Length of the new value.
+ * @param[in]   hvx_type     BLE_GATT_HVX_NOTIFICATION, BLE_GATT_HVX_INDICATION or BLE_GATT_HVX_INVALID.
  *
  * @return      NRF_SUCCESS on success, otherwise an error code.
  */
-uint32_t ble_ess_heart_rate_measurement_send(ble_ess_t * p_ess, uint16_t heart_rate);
+uint32_t ble_ess_char_update(ble_ess_t *                p_ess,
+                             ble_gatts_char_handles_t * p_handles,
+                             uint8_t *                  p_data,
+                             uint16_t                   len,
+                             uint8_t                    hvx_type);
 
 /**@brief Function for adding a RR Interval measurement to the RR Interval buffer.
  *
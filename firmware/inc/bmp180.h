@@ -25,6 +25,25 @@
 #ifndef BMP180_H
 #define BMP180_H
 
+#include <stdbool.h>
+#include "pipeline.h"
+
+/**
+ * Oversampling settings, 0 (ultra low power) to 3 (ultra high resolution)
+ */
+#define BMP180_OSS_MAX		3
+#define BMP180_OSS_DEFAULT	2
+
+/**
+ * Temperature conversion time, µs
+ */
+#define BMP180_TEMPERATURE_DELAY	4500
+
+/**
+ * Most samples bmp180_acquire() will take for each temperature
+ */
+#define BMP180_TEMPERATURE_DECIMATION_MAX	100
+
 /**
  * Barometer data structure
  */
@@ -35,6 +54,16 @@ struct barometer {
 };
 
 struct barometer* get_barometer(void);
-void bmp180_init(void);
+void bmp180_set_oss(uint8_t setting);
+void bmp180_set_temperature_decimation(uint8_t decimation);
+void bmp180_start_temperature(void);
+int32_t bmp180_read_ut(void);
+void bmp180_start_pressure(uint8_t oss);
+uint16_t bmp180_pressure_delay(uint8_t oss);
+int32_t bmp180_read_up(uint8_t oss);
+bool bmp180_twi_error(void);
+void bmp180_acquire(struct sample* s);
+enum stage_result bmp180_compensate(struct sample* s);
+bool bmp180_init(void);
 
 #endif /* BMP180_H */
@@ -0,0 +1,132 @@
+/*
+ * Burst capture
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+#include "ble_ess.h"
+#include "pipeline.h"
+
+/**
+ * Samples held in RAM, as 24-bit pressures. Must be a power of two
+ */
+#define CAPTURE_RING_SIZE		256
+
+/**
+ * Limits on the sample period, ms. The shortest leaves room for both
+ * conversions at CAPTURE_OSS_MAX.
+ */
+#define CAPTURE_PERIOD_MIN		20
+#define CAPTURE_PERIOD_MAX		1000
+
+/**
+ * Highest oversampling setting used while capturing
+ */
+#define CAPTURE_OSS_MAX			1
+
+/**
+ * A temperature conversion is done once every this many pressure
+ * conversions
+ */
+#define CAPTURE_TEMPERATURE_DECIMATION	16
+
+/**
+ * The rate trigger compares each pressure with the one this many
+ * samples before it
+ */
+#define CAPTURE_RATE_SPAN		4
+
+/**
+ * Each upload packet fills a 20 byte notification:
+ *
+ * [0-1]  Position in the window of the first sample, little endian
+ * [2-19] Up to six pressures, Pa, 24-bit little endian
+ */
+#define CAPTURE_PACKET_SIZE		20
+#define CAPTURE_SAMPLES_PER_PACKET	6
+
+enum capture_state {
+  CAPTURE_IDLE,
+  CAPTURE_ARMED,		/* Sampling into the ring, waiting for a trigger */
+  CAPTURE_TRIGGERED,		/* Taking the post-trigger samples */
+  CAPTURE_FROZEN,		/* Window held until the next arm */
+};
+
+enum capture_source {
+  CAPTURE_SOURCE_NONE,
+  CAPTURE_SOURCE_RATE,		/* Pressure changed faster than the threshold */
+  CAPTURE_SOURCE_GATT,
+  CAPTURE_SOURCE_BUTTON,
+};
+
+/**
+ * Written as the first byte of the status characteristic
+ */
+enum capture_opcode {
+  CAPTURE_OP_DISARM,
+  CAPTURE_OP_ARM,		/* Followed by a reserved byte and a config, optionally */
+  CAPTURE_OP_TRIGGER,
+  CAPTURE_OP_UPLOAD,
+};
+
+struct capture_config {
+  uint16_t period;		/* ms between samples */
+  uint16_t pre;			/* Samples kept from before the trigger */
+  uint16_t post;		/* Samples from the trigger on, at least one */
+  uint16_t threshold;		/* Pa over CAPTURE_RATE_SPAN samples, 0 for none */
+};
+
+/**
+ * Laid out as it appears in the characteristic. Writing an opcode and
+ * a config over the first ten bytes arms with that config.
+ */
+struct capture_status {
+  uint8_t state;		/* enum capture_state */
+  uint8_t source;		/* enum capture_source, of the last trigger */
+  struct capture_config config;
+  uint16_t count;		/* Samples in the frozen window */
+  int16_t temperature;		/* 0.1°C, at the trigger */
+  uint16_t triggers;		/* Since boot */
+  uint32_t timestamp;		/* RTC ticks, at the trigger */
+};
+
+void capture_init(void);
+bool capture_arm(const struct capture_config* config);
+void capture_disarm(void);
+void capture_trigger(enum capture_source source);
+bool capture_upload(void);
+bool capture_sampling(void);
+bool capture_converting(void);
+bool capture_latest(struct sample* s);
+const struct capture_status* capture_status(void);
+
+void capture_gatt_init(ble_ess_t* p_ess, ble_gatts_char_handles_t* p_status_handles,
+                       ble_gatts_char_handles_t* p_data_handles);
+void capture_report(void);
+void capture_on_ble_evt(ble_evt_t* p_ble_evt);
+
+#endif /* CAPTURE_H */
@@ -0,0 +1,65 @@
+/*
+ * Persistent configuration
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+
+/**
+ * Bumped when a field changes meaning. Adding fields to the end
+ * doesn't need a new version, see config.c.
+ */
+#define CONFIG_VERSION		1
+
+/**
+ * The settings that used to be build time, read from RAM by whichever
+ * module needs them. Laid out as it appears in the characteristic,
+ * which it fills in a single 20 byte write.
+ */
+struct config {
+  uint8_t power_profile;	/* enum power_profile_id */
+  uint8_t oss;			/* BMP180 oversampling setting */
+  uint16_t sample_period;	/* ms, the longest if adaptive */
+  uint16_t sample_period_min;	/* ms, the shortest, or 0 for a fixed period */
+  uint16_t adv_interval;	/* Slow advertising, 0.625ms units */
+  uint16_t adv_fast_interval;	/* Fast advertising, 0.625ms units */
+  uint16_t min_conn_interval;	/* 1.25ms units */
+  uint16_t max_conn_interval;	/* 1.25ms units */
+  uint16_t conn_sup_timeout;	/* 10ms units */
+  int16_t altitude;		/* m, of the station for the weather forecast */
+  uint8_t adv_fast_timeout;	/* s */
+  uint8_t slave_latency;
+};
+
+void config_init(void);
+void config_load(void);
+const struct config* config(void);
+bool config_check(const struct config* c);
+uint32_t config_set(const struct config* c);
+void config_conn_params(ble_gap_conn_params_t* p_conn_params);
+
+#endif /* CONFIG_H */
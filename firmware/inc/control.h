@@ -0,0 +1,107 @@
+/*
+ * Sampling control point
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+#include "ble_ess.h"
+
+/**
+ * Longest write, a whole ATT payload at the default MTU
+ */
+#define CONTROL_WRITE_MAX	20
+
+/**
+ * A write to the control point is a list of commands, each an opcode,
+ * the length of its value and then the value, little endian. As many
+ * as fit in the write are applied together, or none of them are.
+ */
+enum control_opcode {
+  CONTROL_OP_DEFAULTS = 0x01,	/* No value. Back to the config */
+  CONTROL_OP_SAMPLE_PERIOD,	/* uint16 ms, then uint16 shortest ms or 0 for fixed */
+  CONTROL_OP_OSS,		/* uint8 BMP180 oversampling setting */
+  CONTROL_OP_TEMPERATURE_DECIMATION, /* uint8 samples for each temperature */
+  CONTROL_OP_FILTER,		/* uint8 enum vario_model */
+  CONTROL_OP_REPORT,		/* uint8 enum control_report */
+  CONTROL_OP_FLIGHT_LAUNCH,	/* int16 cm/s, uint16 cm above the pad, uint16 hold ms */
+  CONTROL_OP_FLIGHT_APOGEE,	/* uint16 cm below the highest point, uint16 hold ms */
+  CONTROL_OP_FLIGHT_DESCENT,	/* int16 slowest cm/s, int16 fastest cm/s, uint16 hold ms */
+  CONTROL_OP_FLIGHT_LANDING,	/* int16 cm/s, uint16 hold ms */
+  CONTROL_OP_FLIGHT_RESET,	/* No value. Wait for a launch again */
+};
+
+/**
+ * Result of a write, numbered as for the SIG's control points
+ */
+enum control_result {
+  CONTROL_RESULT_SUCCESS = 0x01,
+  CONTROL_RESULT_OPCODE_UNSUPPORTED,
+  CONTROL_RESULT_INVALID_PARAMETER,
+};
+
+/**
+ * What happens to each sample once it has been through the pipeline
+ */
+enum control_report {
+  CONTROL_REPORT_NOTIFY,	/* Notified to a subscribed client */
+  CONTROL_REPORT_STORE,		/* Only kept for reads */
+  CONTROL_REPORT_COUNT
+};
+
+/**
+ * The sampling in effect. The flight detector thresholds are set by
+ * the same writes, but don't fit in the answer.
+ */
+struct control_settings {
+  uint16_t sample_period;	/* ms, the longest if adaptive */
+  uint16_t sample_period_min;	/* ms, the shortest, or 0 for a fixed period */
+  uint8_t oss;			/* BMP180 oversampling setting */
+  uint8_t temperature_decimation; /* Samples for each temperature */
+  uint8_t filter;		/* enum vario_model */
+  uint8_t report;		/* enum control_report */
+};
+
+/**
+ * Indicated in answer to each write, laid out as it appears in the
+ * characteristic
+ */
+struct control_response {
+  uint8_t result;		/* enum control_result */
+  uint8_t opcode;		/* The command that failed, or 0 */
+  struct control_settings settings; /* In effect after the write */
+};
+
+void control_reset(void);
+const struct control_settings* control_settings(void);
+void control_write(const uint8_t* p_data, uint16_t len);
+
+const struct control_response* control_response(void);
+void control_report(void);
+void control_on_ble_evt(ble_evt_t* p_ble_evt);
+void control_gatt_init(ble_ess_t* p_ess, ble_gatts_char_handles_t* p_handles);
+
+#endif /* CONTROL_H */
@@ -0,0 +1,63 @@
+/*
+ * Fault records and fast recovery
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FAULT_H
+#define FAULT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+#include "ble_ess.h"
+
+#define FAULT_RING_SIZE		4
+
+/**
+ * Error code recorded for a hard fault
+ */
+#define FAULT_CODE_HARDFAULT	0xFFFF
+
+/**
+ * A crash record, laid out as it appears in the characteristic.
+ */
+struct fault_record {
+  uint16_t code;		/* Low half of the error code */
+  uint16_t line;		/* 0 for hard faults */
+  uint32_t file_hash;		/* FNV-1a of the file name, 0 for hard faults */
+  uint32_t pc;
+  uint32_t lr;			/* Hard faults only */
+  uint32_t uptime;		/* Seconds since boot */
+};
+
+void fault_error(uint32_t error_code, uint32_t line_num,
+                 const uint8_t* p_file_name, uint32_t pc);
+bool fault_safe_mode(void);
+const struct fault_record* fault_latest(void);
+void fault_report(void);
+
+void fault_init(void);
+void fault_gatt_init(ble_ess_t* p_ess, ble_gatts_char_handles_t* p_handles);
+void fault_start(void);
+void fault_on_ble_evt(ble_evt_t* p_ble_evt);
+
+#endif /* FAULT_H */
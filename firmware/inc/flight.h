@@ -0,0 +1,98 @@
+/*
+ * Flight events
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FLIGHT_H
+#define FLIGHT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+#include "ble_ess.h"
+#include "pipeline.h"
+
+enum flight_state {
+  FLIGHT_PAD,			/* On the ground, waiting for launch */
+  FLIGHT_ASCENT,
+  FLIGHT_FALLING,		/* Past apogee, before a steady descent */
+  FLIGHT_DESCENT,		/* Steady descent under a parachute */
+  FLIGHT_LANDED,
+};
+
+enum flight_event {
+  FLIGHT_EVENT_LAUNCH,
+  FLIGHT_EVENT_APOGEE,		/* Or burst, for a balloon */
+  FLIGHT_EVENT_DESCENT,
+  FLIGHT_EVENT_LANDING,
+  FLIGHT_EVENT_COUNT,
+  FLIGHT_EVENT_NONE = 0xFF
+};
+
+/**
+ * Detector thresholds. Each condition has to hold for its hold time
+ * before the event fires, and a sample that breaks it starts the hold
+ * again.
+ */
+struct flight_config {
+  int16_t launch_climb;		/* cm/s, climbing faster than this */
+  uint16_t launch_height;	/* cm, above the pad */
+  uint16_t launch_hold;		/* ms */
+  uint16_t apogee_drop;		/* cm, below the highest point */
+  uint16_t apogee_hold;		/* ms */
+  int16_t descent_min;		/* cm/s, falling at least this fast */
+  int16_t descent_max;		/* cm/s, and no faster than this */
+  uint16_t descent_hold;	/* ms */
+  int16_t landing_climb;	/* cm/s, moving slower than this */
+  uint16_t landing_hold;	/* ms */
+};
+
+/**
+ * An event, laid out as it appears in the characteristic
+ */
+struct flight_record {
+  uint8_t event;		/* enum flight_event */
+  uint8_t state;		/* enum flight_state it led to */
+  uint16_t sequence;		/* Of the sample it fired on */
+  int32_t altitude;		/* cm */
+  int32_t max_altitude;		/* cm, so far */
+  int16_t climb;		/* cm/s */
+  uint16_t reserved;
+};
+
+typedef void (*flight_event_handler_t)(const struct flight_record* record);
+
+void flight_init(flight_event_handler_t handler);
+void flight_reset(void);
+const struct flight_config* flight_config(void);
+const struct flight_config* flight_defaults(void);
+bool flight_check(const struct flight_config* config);
+bool flight_configure(const struct flight_config* config);
+enum flight_state flight_state(void);
+enum stage_result flight_detect_stage(struct sample* s);
+
+void flight_gatt_init(ble_ess_t* p_ess, ble_gatts_char_handles_t* p_handles);
+void flight_report(void);
+bool flight_subscribed(void);
+void flight_on_ble_evt(ble_evt_t* p_ble_evt);
+
+#endif /* FLIGHT_H */
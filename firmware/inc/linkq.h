@@ -0,0 +1,47 @@
+/*
+ * Link quality manager
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef LINKQ_H
+#define LINKQ_H
+
+#include <stdint.h>
+#include "ble.h"
+
+/**
+ * Link statistics, laid out as they appear in the characteristic
+ */
+struct linkq_stats {
+  int8_t tx_power;		/* dBm */
+  int8_t rssi_avg;		/* dBm */
+  int8_t rssi_min;
+  int8_t rssi_max;
+  uint16_t rssi_samples;
+  uint16_t tx_changes;
+};
+
+void linkq_tx_ceiling_set(int8_t ceiling);
+struct linkq_stats* linkq_stats(void);
+void linkq_on_ble_evt(ble_evt_t* p_ble_evt);
+
+#endif /* LINKQ_H */
@@ -24,6 +24,15 @@
 #ifndef MAIN_H__
 #define MAIN_H__
 
+#include "ble_bas.h"
+
+#define APP_TIMER_PRESCALER                  0                                          /**< Value of the RTC1 PRESCALER register. */
+
+/**@brief Convert a time in microseconds to app_timer ticks, rounding up. */
+#define APP_TIMER_US_TO_TICKS(US)                                                              \
+  ((((uint32_t)(US) * 32768) + (1000000 * (APP_TIMER_PRESCALER + 1)) - 1) /                    \
+   (1000000 * (APP_TIMER_PRESCALER + 1)))
+
 /**@brief External reference to the Battery Service. */
 extern ble_bas_t                             bas;
 
@@ -0,0 +1,131 @@
+/*
+ * Staged sample pipeline
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Number of samples that can wait at the input of each stage. Must be
+ * a power of two.
+ */
+#define PIPELINE_RING_SIZE	4
+
+/**
+ * Sample flags
+ */
+#define SAMPLE_FLAG_COMPENSATED	(1 << 0)
+#define SAMPLE_FLAG_ENCODED	(1 << 1)
+#define SAMPLE_FLAG_TWI_ERROR	(1 << 2)	/* Raw values can't be trusted */
+#define SAMPLE_FLAG_SYNTHETIC	(1 << 3)	/* Made by synth.c, not measured */
+#define SAMPLE_FLAG_FILTERED	(1 << 4)	/* altitude and climb are set */
+#define SAMPLE_FLAG_VALIDATED	(1 << 5)	/* quality is set */
+#define SAMPLE_FLAG_RETRY	(1 << 6)	/* Taken again for a rejected one */
+
+/**
+ * Sample quality, set by the validate stage. Samples with any of the
+ * SAMPLE_QUALITY_REJECT bits set go no further.
+ */
+#define SAMPLE_QUALITY_TWI		(1 << 0)	/* A transfer failed */
+#define SAMPLE_QUALITY_PRESSURE_RANGE	(1 << 1)	/* Outside the BMP180's range */
+#define SAMPLE_QUALITY_TEMPERATURE_RANGE (1 << 2)
+#define SAMPLE_QUALITY_PRESSURE_SPIKE	(1 << 3)	/* Too far from the median */
+#define SAMPLE_QUALITY_TEMPERATURE_SPIKE (1 << 4)	/* Replaced by the median */
+#define SAMPLE_QUALITY_INVALID		(SAMPLE_QUALITY_TWI |		\
+					 SAMPLE_QUALITY_PRESSURE_RANGE |	\
+					 SAMPLE_QUALITY_TEMPERATURE_RANGE)
+#define SAMPLE_QUALITY_REJECT		(SAMPLE_QUALITY_INVALID |	\
+					 SAMPLE_QUALITY_PRESSURE_SPIKE)
+
+/**
+ * A single sample as it travels through the pipeline.
+ *
+ * pressure and temperature are in Pa and 0.1°C after compensation,
+ * and in the ESS units of 0.1Pa and 0.01°C once encoded. altitude
+ * and climb are in cm and cm/s, set by the filter stage.
+ */
+struct sample {
+  uint32_t timestamp;		/* RTC1 ticks at acquisition */
+  int32_t ut;			/* Uncompensated temperature */
+  int32_t up;			/* Uncompensated pressure */
+  int32_t pressure;
+  int16_t temperature;
+  uint8_t oss;			/* Oversampling setting used for up */
+  uint8_t flags;
+  uint16_t sequence;		/* Numbered by pipeline_acquire() */
+  int16_t climb;
+  int32_t altitude;
+  uint8_t quality;		/* SAMPLE_QUALITY_* */
+};
+
+/**
+ * Pipeline stages. Each stage has a ring buffer on its input, filled
+ * by the stage before it. The compensate stage is fed by
+ * pipeline_acquire().
+ */
+enum pipeline_stage {
+  STAGE_COMPENSATE,
+  STAGE_VALIDATE,
+  STAGE_FILTER,
+  STAGE_DETECT,
+  STAGE_ADAPT,
+  STAGE_STATS,
+  STAGE_WEATHER,
+  STAGE_ENCODE,
+  STAGE_TRANSMIT,
+  STAGE_COUNT
+};
+
+/**
+ * What a stage did with a sample
+ */
+enum stage_result {
+  STAGE_PASS,			/* Forward to the next stage */
+  STAGE_DROP,			/* Discard the sample */
+  STAGE_RETRY,			/* Leave it on the input and try later */
+};
+
+/**
+ * A stage works on a copy of the sample at the head of its input, so
+ * changes are only kept if it returns STAGE_PASS.
+ */
+typedef enum stage_result (*stage_fn)(struct sample* s);
+
+struct stage_stats {
+  uint32_t processed;
+  uint32_t dropped;
+  uint8_t high_water;		/* Most samples ever waiting on the input */
+};
+
+bool pipeline_acquire(struct sample* s);
+void pipeline_register(enum pipeline_stage stage, stage_fn fn);
+bool pipeline_run_stage(enum pipeline_stage stage);
+void pipeline_poll(void);
+const struct stage_stats* pipeline_stats(enum pipeline_stage stage);
+uint32_t pipeline_overflows(void);
+uint16_t pipeline_sequence(void);
+
+#endif /* PIPELINE_H */
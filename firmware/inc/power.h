@@ -0,0 +1,73 @@
+/*
+ * Power profiles
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+#include "nrf_soc.h"
+#include "nrf_sdm.h"
+#include "config.h"
+
+/**
+ * Named power profiles
+ */
+enum power_profile_id {
+  POWER_PROFILE_FLIGHT,		/* Full rate, fast discovery */
+  POWER_PROFILE_BENCH,		/* Bench supply, short range */
+  POWER_PROFILE_STORAGE,	/* Lowest current, slow sampling */
+  POWER_PROFILE_COUNT
+};
+
+/**
+ * The profile used on a power-on reset. Set from config.mk
+ */
+#ifndef POWER_PROFILE
+#define POWER_PROFILE		POWER_PROFILE_FLIGHT
+#endif
+
+/**
+ * The advertising interval, sample periods and OSS are presets,
+ * copied into the config when the profile is selected. They can be
+ * tuned from there.
+ */
+struct power_profile {
+  const char* name;
+  nrf_power_dcdc_mode_t dcdc;
+  nrf_clock_lfclksrc_t lfclk;	/* Only takes effect from the next reset */
+  int8_t tx_power;		/* dBm, ceiling for the link quality manager */
+  uint16_t adv_interval;	/* Slow advertising, 0.625ms units */
+  uint16_t sample_period;	/* ms, the longest if adaptive */
+  uint16_t sample_period_min;	/* ms, the shortest, or 0 for a fixed period */
+  uint8_t oss;			/* BMP180 oversampling setting */
+};
+
+void power_init(void);
+void power_apply(void);
+uint32_t power_select(enum power_profile_id id);
+void power_preset(enum power_profile_id id, struct config* c);
+enum power_profile_id power_profile_id(void);
+const struct power_profile* power_profile(void);
+
+#endif /* POWER_H */
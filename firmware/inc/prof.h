@@ -0,0 +1,131 @@
+/*
+ * Execution time profiling
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+#include "pipeline.h"
+
+/**
+ * Profiled regions
+ */
+enum prof_region {
+  PROF_ACQUIRE,			/* Raw barometer measurement */
+  PROF_STAGE,			/* Pipeline stages, in pipeline_stage order */
+  PROF_ADC_IRQ = PROF_STAGE + STAGE_COUNT, /* Battery ADC interrupt */
+  PROF_BLE_DISPATCH,		/* ble_evt_dispatch fan-out */
+  PROF_RADIO_NOTIFY,		/* Radio notification interrupt */
+  PROF_REGION_COUNT
+};
+
+/**
+ * Histogram bin n counts durations of 4^n to 4^(n+1)-1 µs. The last
+ * bin also counts everything longer
+ */
+#define PROF_HIST_BINS		8
+
+struct prof_entry {
+  uint16_t min;			/* µs */
+  uint16_t max;			/* µs */
+  uint32_t count;
+  uint32_t total;		/* µs, mean is total / count. Stops at 71 minutes */
+  uint16_t hist[PROF_HIST_BINS];
+};
+
+/**
+ * Boot timings. Phases are each timed from the end of the last,
+ * milestones from the start of main.
+ */
+enum prof_boot {
+  PROF_BOOT_INIT,		/* Everything before the stack */
+  PROF_BOOT_STACK,		/* SoftDevice and power profile */
+  PROF_BOOT_GATT,		/* Device manager, GAP, services */
+  PROF_BOOT_SENSOR,		/* BMP180 bring up */
+  PROF_BOOT_DEFERRED,		/* Buttons and timers */
+  PROF_BOOT_FIRST_ADV,		/* Milestones */
+  PROF_BOOT_FIRST_SAMPLE,
+  PROF_BOOT_COUNT
+};
+
+/**
+ * Everything recorded, laid out as it appears in the characteristic
+ */
+struct prof_table {
+  struct prof_entry regions[PROF_REGION_COUNT];
+  uint32_t boot[PROF_BOOT_COUNT];	/* µs */
+};
+
+/**
+ * The table is read as a single attribute, which the SoftDevice won't
+ * make any longer than this. A new region has to fit.
+ */
+#define PROF_TABLE_MAX		512
+
+typedef char prof_table_fits[(sizeof(struct prof_table) <= PROF_TABLE_MAX) ? 1 : -1];
+
+#ifdef PROF_ENABLED
+
+/**
+ * Wrap a region in PROF_ENTER(name) and PROF_EXIT(name), where name is
+ * a prof_region without the PROF_ prefix. Both must be in the same
+ * scope.
+ */
+#define PROF_ENTER(name)	uint16_t prof_start_##name = prof_now()
+#define PROF_EXIT(name)		prof_record(PROF_##name, prof_start_##name)
+/**
+ * As PROF_EXIT, but records against PROF_name + index
+ */
+#define PROF_EXIT_AT(name, index) prof_record(PROF_##name + (index), prof_start_##name)
+/**
+ * Boot timing. PROF_BOOT_PHASE(name) ends the current phase and
+ * PROF_MILESTONE(name) marks a point in the boot, where name is a
+ * prof_boot without the PROF_BOOT_ prefix.
+ */
+#define PROF_BOOT_PHASE(name)	prof_boot_phase(PROF_BOOT_##name)
+#define PROF_MILESTONE(name)	prof_milestone(PROF_BOOT_##name)
+
+void prof_init(void);
+uint16_t prof_now(void);
+void prof_record(enum prof_region region, uint16_t start);
+void prof_boot_phase(enum prof_boot phase);
+void prof_milestone(enum prof_boot milestone);
+struct prof_table* prof_table(void);
+void prof_reset(void);
+void prof_dump(void);
+
+#else
+
+#define PROF_ENTER(name)	do { } while (0)
+#define PROF_EXIT(name)		do { } while (0)
+#define PROF_EXIT_AT(name, index) do { } while (0)
+#define PROF_BOOT_PHASE(name)	do { } while (0)
+#define PROF_MILESTONE(name)	do { } while (0)
+
+#define prof_init()		do { } while (0)
+#define prof_dump()		do { } while (0)
+
+#endif
+
+#endif /* PROF_H */
@@ -0,0 +1,51 @@
+/*
+ * Radio-aligned measurement scheduler
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+#include "ble.h"
+
+/**
+ * Work that can be due on a tick
+ */
+#define SCHED_WORK_SAMPLE	(1 << 0)
+#define SCHED_WORK_BATTERY	(1 << 1)
+
+/**
+ * Battery is measured about this often, ms, or on every tick if they
+ * are further apart
+ */
+#define SCHED_BATTERY_INTERVAL	2000
+
+typedef void (*sched_handler_t)(uint8_t work);
+
+void sched_init(sched_handler_t handler);
+void sched_set_period(uint32_t ticks);
+void sched_start(void);
+void sched_stop(void);
+void sched_on_ble_evt(ble_evt_t* p_ble_evt);
+
+#endif /* SCHED_H */
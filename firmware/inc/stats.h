@@ -0,0 +1,79 @@
+/*
+ * Windowed statistics
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+#include "ble_ess.h"
+#include "pipeline.h"
+
+/**
+ * Most periods a window can span. Each one costs a bucket of RAM.
+ */
+#define STATS_BUCKETS_MAX	8
+
+/**
+ * Limits on the period, s
+ */
+#define STATS_PERIOD_MIN	1
+#define STATS_PERIOD_MAX	3600
+
+/**
+ * Each summary fills a 20 byte notification, little endian:
+ *
+ * [0-1]   Samples in the window, saturating at 65535
+ * [2-4]   Pressure minimum, 0.1Pa, 24-bit
+ * [5-7]   Pressure maximum, 0.1Pa, 24-bit
+ * [8-10]  Pressure mean, 0.1Pa, 24-bit
+ * [11-12] Pressure standard deviation, 0.1Pa, saturating
+ * [13-14] Temperature minimum, 0.01°C, signed
+ * [15-16] Temperature maximum, 0.01°C, signed
+ * [17-18] Temperature mean, 0.01°C, signed
+ * [19]    Temperature standard deviation, 0.1°C, saturating
+ */
+#define STATS_SUMMARY_SIZE	20
+
+/**
+ * Laid out as it appears in the characteristic. A window closes every
+ * period, and covers the last buckets periods: one for tumbling
+ * windows, more for sliding ones.
+ */
+struct stats_config {
+  uint16_t period;		/* s, or 0 for off */
+  uint8_t buckets;		/* 1 to STATS_BUCKETS_MAX */
+  uint8_t reserved;
+};
+
+void stats_init(void);
+bool stats_configure(const struct stats_config* config);
+const struct stats_config* stats_config(void);
+bool stats_subscribed(void);
+enum stage_result stats_stage(struct sample* s);
+
+void stats_gatt_init(ble_ess_t* p_ess, ble_gatts_char_handles_t* p_summary_handles);
+
+#endif /* STATS_H */
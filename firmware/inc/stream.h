@@ -0,0 +1,75 @@
+/*
+ * High-rate pressure streaming
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+#include "ble_ess.h"
+
+/**
+ * Each packet fills a 20 byte notification:
+ *
+ * [0-1]  Sequence number of the first sample, little endian
+ * [2-3]  Latest temperature, 0.1°C, little endian
+ * [4]    Number of samples in the packet
+ * [5-19] Up to five pressures, Pa, 24-bit little endian
+ */
+#define STREAM_PACKET_SIZE		20
+#define STREAM_SAMPLES_PER_PACKET	5
+
+/**
+ * A temperature conversion is done once every this many pressure
+ * conversions
+ */
+#define STREAM_TEMPERATURE_DECIMATION	16
+
+/**
+ * Packets that can wait for a TX buffer. Must be a power of two
+ */
+#define STREAM_QUEUE_SIZE		8
+
+/**
+ * Highest oversampling setting used while streaming
+ */
+#define STREAM_OSS_MAX			1
+
+struct stream_stats {
+  uint16_t sample_rate;		/* Samples/s over the last second */
+  uint16_t packet_rate;		/* Packets/s over the last second */
+  uint32_t samples;
+  uint32_t dropped;		/* Samples lost with the queue full */
+};
+
+void stream_init(ble_ess_t* p_ess, ble_gatts_char_handles_t* p_handles);
+void stream_start(void);
+void stream_stop(void);
+void stream_sensor_free(void);
+bool stream_active(void);
+struct stream_stats* stream_stats(void);
+void stream_on_ble_evt(ble_evt_t* p_ble_evt);
+
+#endif /* STREAM_H */
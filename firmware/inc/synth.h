@@ -0,0 +1,77 @@
+/*
+ * Synthetic data source
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pipeline.h"
+
+/**
+ * Profiles. The values follow from the sample number alone, so a run
+ * at any rate produces the same sequence.
+ */
+enum synth_profile {
+  SYNTH_OFF,			/* Samples come from the BMP180 */
+  SYNTH_RAMP,			/* Triangle wave over the sensor's range */
+  SYNTH_SINE,			/* ±10hPa about 1000hPa, every 64 samples */
+  SYNTH_STEP,			/* 10hPa steps, every 32 samples */
+  SYNTH_REPLAY,			/* Balloon flight from a table in flash */
+  SYNTH_PROFILE_COUNT
+};
+
+#define SYNTH_RATE_MAX		1000	/* Samples/s */
+
+/**
+ * Laid out as it appears in the characteristic. Writing the first
+ * four bytes selects a profile and rate.
+ */
+struct synth_status {
+  uint8_t profile;		/* enum synth_profile */
+  uint8_t reserved;
+  uint16_t rate;		/* Samples/s */
+  uint32_t generated;		/* Samples made since the start */
+  uint32_t checked;		/* Arrived at the transmit stage intact */
+  uint32_t gaps;		/* Missing from the sequence, dropped on the way */
+  uint32_t mismatches;		/* Arrived with the wrong value */
+};
+
+#ifdef SYNTH_ENABLED
+
+void synth_init(void);
+uint32_t synth_start(enum synth_profile profile, uint16_t rate);
+bool synth_active(void);
+void synth_check(const struct sample* s);
+struct synth_status* synth_status(void);
+
+#else
+
+#define synth_init()		do { } while (0)
+#define synth_active()		(false)
+#define synth_check(s)		do { } while (0)
+
+#endif
+
+#endif /* SYNTH_H */
@@ -0,0 +1,63 @@
+/*
+ * Runtime telemetry counters
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "ble.h"
+
+/**
+ * Telemetry counters, in the order they appear in the
+ * characteristic. Each is a little-endian uint32_t.
+ */
+enum telemetry_counter {
+  TELEMETRY_SAMPLES,		/* Barometer samples taken */
+  TELEMETRY_NOTIFY_SENT,	/* Notifications queued with the stack */
+  TELEMETRY_NOTIFY_DEFERRED,	/* Notifications held back for TX buffers */
+  TELEMETRY_NOTIFY_DROPPED,	/* Notifications lost to missing system attributes */
+  TELEMETRY_TWI_ERRORS,		/* Failed TWI transfers */
+  TELEMETRY_TWI_RECOVERIES,	/* Bus clears that succeeded after an error */
+  TELEMETRY_ADC_RUNS,		/* Battery measurements */
+  TELEMETRY_RESETS,		/* Resets since power on */
+  TELEMETRY_RESET_REASON,	/* RESETREAS for the last reset */
+  TELEMETRY_CONNECTED_S,	/* Seconds spent connected */
+  TELEMETRY_ADVERTISING_S,	/* Seconds spent advertising */
+  TELEMETRY_SAMPLES_REJECTED,	/* Thrown away as bad reads */
+  TELEMETRY_SAMPLES_CORRECTED,	/* Temperature spikes replaced by the median */
+  TELEMETRY_CONFIG_STORES,	/* Configuration records written to flash */
+
+  TELEMETRY_COUNT
+};
+
+void telemetry_inc(enum telemetry_counter counter);
+void telemetry_hvx_result(uint32_t err_code);
+uint32_t telemetry_uptime(void);
+uint32_t* telemetry_table(void);
+
+void telemetry_init(void);
+void telemetry_start(void);
+void telemetry_on_ble_evt(ble_evt_t* p_ble_evt);
+
+#endif /* TELEMETRY_H */
@@ -0,0 +1,59 @@
+/*
+ * Sample validation
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef VALIDATE_H
+#define VALIDATE_H
+
+#include <stdint.h>
+#include "pipeline.h"
+
+/**
+ * The BMP180's operating range. Anything outside it is a bad read.
+ */
+#define VALIDATE_PRESSURE_MIN		30000	/* Pa */
+#define VALIDATE_PRESSURE_MAX		110000
+#define VALIDATE_TEMPERATURE_MIN	-400	/* 0.1°C */
+#define VALIDATE_TEMPERATURE_MAX	850
+
+/**
+ * Step limits. A value further than this from the median of itself
+ * and the two before is a spike. The limit grows with the time since
+ * the last sample.
+ */
+#define VALIDATE_PRESSURE_STEP		200	/* Pa */
+#define VALIDATE_PRESSURE_SLEW		1500	/* Pa/s, about 125m/s */
+#define VALIDATE_TEMPERATURE_STEP	20	/* 0.1°C */
+#define VALIDATE_TEMPERATURE_SLEW	10	/* 0.1°C/s */
+
+/**
+ * Called from the pipeline when a sample has been thrown away, to
+ * take another in its place
+ */
+typedef void (*validate_retry_t)(void);
+
+uint8_t validate_check(const struct sample* s);
+enum stage_result validate_stage(struct sample* s);
+void validate_init(validate_retry_t retry);
+
+#endif /* VALIDATE_H */
@@ -0,0 +1,71 @@
+/*
+ * Variometer
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef VARIO_H
+#define VARIO_H
+
+#include <stdint.h>
+#include "pipeline.h"
+
+/**
+ * How hard the vertical speed is expected to change, mm/s² RMS. Fine
+ * for a balloon, including the drop at burst. Much more and the climb
+ * follows every pascal of sensor noise; much less and it lags the
+ * changes in descent rate at altitude. `make vario-bench` shows both.
+ */
+#define VARIO_ACCEL_SIGMA	1000
+
+/**
+ * A rocket wants much more, or the filter lags the boost
+ */
+#define VARIO_ROCKET_ACCEL_SIGMA	50000
+
+/**
+ * Vertical speed uncertainty when the filter starts, mm/s RMS
+ */
+#define VARIO_CLIMB_SIGMA	10000
+
+/**
+ * Longest gap between samples the filter will predict over, seconds.
+ * After a longer gap it starts again from the next sample.
+ */
+#define VARIO_DT_MAX		64
+
+/**
+ * Filter models, selected at run time
+ */
+enum vario_model {
+  VARIO_MODEL_OFF,		/* Samples are passed on unfiltered */
+  VARIO_MODEL_BALLOON,		/* VARIO_ACCEL_SIGMA */
+  VARIO_MODEL_ROCKET,		/* VARIO_ROCKET_ACCEL_SIGMA */
+  VARIO_MODEL_COUNT
+};
+
+void vario_reset(void);
+void vario_set_model(enum vario_model model);
+enum vario_model vario_model(void);
+int32_t vario_pressure_altitude(int32_t pressure);
+enum stage_result vario_filter_stage(struct sample* s);
+
+#endif /* VARIO_H */
@@ -0,0 +1,105 @@
+/*
+ * Pressure tendency and forecast
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef WEATHER_H
+#define WEATHER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+#include "ble_ess.h"
+#include "pipeline.h"
+
+/**
+ * The history is a point every WEATHER_POINT_MINUTES, each the mean
+ * of the samples over that time, going back 24 hours
+ */
+#define WEATHER_POINT_MINUTES	10
+#define WEATHER_POINTS		144
+
+/**
+ * The tendency is taken over this many points, 3 hours
+ */
+#define WEATHER_TENDENCY_POINTS	18
+
+/**
+ * Less change than this over each half of the tendency, Pa, is
+ * steady. The forecast counts more than WEATHER_TREND over the whole
+ * of it as rising or falling.
+ */
+#define WEATHER_STEADY		20
+#define WEATHER_TREND		160
+
+/**
+ * For the tendency or forecast, until there are 3 hours of history
+ */
+#define WEATHER_UNKNOWN		0xFF
+
+/**
+ * WMO code 0200, the characteristic of the pressure tendency over
+ * the last 3 hours
+ */
+enum weather_tendency {
+  WEATHER_RISING_FALLING,	/* Rising then falling, same or higher */
+  WEATHER_RISING_STEADY,	/* Rising then steady, or rising more slowly */
+  WEATHER_RISING,
+  WEATHER_FALLING_RISING_FASTER, /* Falling or steady then rising, or rising faster */
+  WEATHER_STEADY_SAME,
+  WEATHER_FALLING_RISING,	/* Falling then rising, same or lower */
+  WEATHER_FALLING_STEADY,	/* Falling then steady, or falling more slowly */
+  WEATHER_FALLING,
+  WEATHER_RISING_FALLING_FASTER, /* Steady or rising then falling, or falling faster */
+};
+
+/**
+ * Laid out as it appears in the characteristic. Writing an altitude
+ * alone sets the station altitude used for the forecast.
+ */
+struct weather_status {
+  int16_t altitude;		/* m, of the station */
+  int16_t change;		/* Pa, over the last 3 hours */
+  uint16_t sea_level;		/* 0.1hPa, the latest point reduced to sea level */
+  uint8_t tendency;		/* enum weather_tendency, or WEATHER_UNKNOWN */
+  uint8_t forecast;		/* Zambretti letter, 0 for A, or WEATHER_UNKNOWN */
+  uint8_t points;		/* In the history */
+  uint8_t newest;		/* Index of the newest point in the history */
+};
+
+/**
+ * Called when the tendency or forecast changes
+ */
+typedef void (*weather_handler_t)(const struct weather_status* status);
+
+void weather_init(weather_handler_t handler);
+void weather_start(void);
+void weather_set_altitude(int16_t altitude);
+const struct weather_status* weather_status(void);
+const uint16_t* weather_history(void);
+enum stage_result weather_stage(struct sample* s);
+
+void weather_gatt_init(ble_ess_t* p_ess, ble_gatts_char_handles_t* p_status_handles);
+void weather_report(void);
+bool weather_subscribed(void);
+
+#endif /* WEATHER_H */
@@ -0,0 +1,299 @@
+/*
+ * Adaptive sampling
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Moves the sample period between bounds to follow the pressure. When
+ * it is still the period stretches out, and as soon as it starts to
+ * move quickly the period drops, so the filter and detectors see the
+ * dynamics when they matter.
+ *
+ * Runs as a pipeline stage, estimating the rate of change and the
+ * noise as each sample passes. The noise comes from how far each
+ * change was from the one before, scaled to the same time, and is
+ * never taken to be less than the BMP180's own.
+ * The part of each change inside the noise is ignored when working
+ * out the rate, so a still sensor reads as still.
+ *
+ * The period aims for each sample to move by ADAPT_STEP_SIGMAS times
+ * the noise. It is cut straight away when that calls for a shorter
+ * one, but only doubled once the longer one has been called for over
+ * ADAPT_HOLD samples, so it doesn't flap about a boundary. The periods
+ * used are the shortest times a power of two, and the longest.
+ *
+ * Samples can only be reported as often as there are connection
+ * events, so while the period is shorter than the usual connection
+ * interval a shorter one is asked for, and the usual one again once
+ * sampling slows down. The stream looks after its own.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "ble.h"
+#include "ble_conn_params.h"
+#include "bmp180.h"
+#include "sched.h"
+#include "stream.h"
+#include "main.h"
+#include "adapt.h"
+
+#define TICKS_PER_SECOND	APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER)
+
+/**
+ * Rate and noise are kept with this many fractional bits
+ */
+#define Q			4
+
+/**
+ * Largest change in one sample that is looked at, Pa. Keeps the sums
+ * inside 32 bits.
+ */
+#define DP_MAX			30000
+
+/**
+ * Differences further out than this many times the noise are taken
+ * as this far out, Huber style
+ */
+#define NOISE_CLIP		3
+
+/**
+ * BMP180 pressure noise, Pa RMS, by oversampling setting
+ */
+static const uint8_t noise_floor[BMP180_OSS_MAX + 1] = { 6, 5, 4, 3 };
+
+static struct adapt_config config;
+static uint16_t period;		/* ms */
+
+static bool primed;
+static int32_t last_pressure;
+static uint32_t last_timestamp;
+static int32_t last_dp;		/* Pa */
+static uint32_t last_ms;
+static int32_t rate;		/* Pa/s */
+static int32_t noise;		/* Pa */
+static uint8_t hold;
+
+static uint16_t conn_handle = BLE_CONN_HANDLE_INVALID;
+static uint16_t fast_interval;	/* Asked for, 1.25ms units, or 0 */
+static ble_gap_conn_params_t usual_conn_params;
+
+/**
+ * Returns the longest period in use that is no longer than ms
+ */
+static uint16_t period_below(uint32_t ms) {
+  uint32_t p = config.min_period;
+
+  while (2 * p <= ms && 2 * p < config.max_period) {
+    p *= 2;
+  }
+  if (ms >= config.max_period) {
+    p = config.max_period;
+  }
+
+  return p;
+}
+/**
+ * Asks for connection events at least as often as samples, or for
+ * the usual connection parameters back
+ */
+static void conn_interval_update(void) {
+  ble_gap_conn_params_t conn_params;
+  uint16_t interval;
+  uint32_t err_code;
+
+  if (conn_handle == BLE_CONN_HANDLE_INVALID || stream_active()) return;
+
+  interval = MSEC_TO_UNITS((uint32_t)period, UNIT_1_25_MS);
+  if (interval < BLE_GAP_CP_MIN_CONN_INTVL_MIN) interval = BLE_GAP_CP_MIN_CONN_INTVL_MIN;
+
+  if (fast_interval == 0) {
+    APP_ERROR_CHECK(sd_ble_gap_ppcp_get(&usual_conn_params));
+    if (interval >= usual_conn_params.max_conn_interval) return;
+  } else if (interval >= usual_conn_params.max_conn_interval) {
+    err_code = ble_conn_params_change_conn_params(&usual_conn_params);
+    if (err_code == NRF_SUCCESS) fast_interval = 0;
+    else if (err_code != NRF_ERROR_BUSY) APP_ERROR_HANDLER(err_code);
+    return;
+  } else if (interval >= fast_interval) {
+    return;			/* Already fast enough */
+  }
+
+  conn_params = usual_conn_params;
+  conn_params.min_conn_interval = interval / 2;
+  if (conn_params.min_conn_interval < BLE_GAP_CP_MIN_CONN_INTVL_MIN) {
+    conn_params.min_conn_interval = BLE_GAP_CP_MIN_CONN_INTVL_MIN;
+  }
+  conn_params.max_conn_interval = interval;
+
+  /* Busy with an update already, try again with the next change */
+  err_code = ble_conn_params_change_conn_params(&conn_params);
+  if (err_code == NRF_SUCCESS) fast_interval = interval;
+  else if (err_code != NRF_ERROR_BUSY) APP_ERROR_HANDLER(err_code);
+}
+static void period_set(uint16_t ms) {
+  period = ms;
+  sched_set_period(APP_TIMER_TICKS(period, APP_TIMER_PRESCALER));
+  conn_interval_update();
+}
+
+/**
+ * Returns true if the bounds can be used
+ */
+bool adapt_check(const struct adapt_config* c) {
+  return !(c->max_period < ADAPT_PERIOD_MIN || c->max_period > ADAPT_PERIOD_MAX ||
+           (c->min_period != 0 &&
+            (c->min_period < ADAPT_PERIOD_MIN || c->min_period > c->max_period)));
+}
+/**
+ * Replaces the bounds and starts again from the longest period. A
+ * min_period of zero fixes the period at max_period.
+ */
+bool adapt_configure(const struct adapt_config* c) {
+  if (!adapt_check(c)) {
+    return false;
+  }
+
+  config = *c;
+  primed = false;
+  rate = 0;
+  noise = 0;
+  hold = 0;
+  period_set(config.max_period);
+
+  return true;
+}
+const struct adapt_config* adapt_config(void) {
+  return &config;
+}
+/**
+ * Returns the sample period in use, ms
+ */
+uint16_t adapt_period(void) {
+  return period;
+}
+
+/**
+ * Pipeline stage that updates the estimates, and the period from
+ * them. The sample itself is passed on untouched.
+ */
+enum stage_result adapt_stage(struct sample* s) {
+  uint32_t dt, ms, wanted;
+  int32_t dp, sigma, moved;
+  int64_t residual;
+
+  /* Synthetic samples come at their own rate */
+  if (config.min_period == 0 ||
+      (s->flags & (SAMPLE_FLAG_TWI_ERROR | SAMPLE_FLAG_SYNTHETIC))) {
+    return STAGE_PASS;
+  }
+
+  if (!primed) {
+    primed = true;
+    last_pressure = s->pressure;
+    last_timestamp = s->timestamp;
+    last_ms = 0;
+    return STAGE_PASS;
+  }
+
+  app_timer_cnt_diff_compute(s->timestamp, last_timestamp, &dt);
+  ms = ((uint64_t)dt * 1000) / TICKS_PER_SECOND;
+  if (ms == 0) return STAGE_PASS;
+
+  dp = s->pressure - last_pressure;
+  if (dp > DP_MAX) dp = DP_MAX;
+  if (dp < -DP_MAX) dp = -DP_MAX;
+  last_pressure = s->pressure;
+  last_timestamp = s->timestamp;
+
+  sigma = noise_floor[(s->oss > BMP180_OSS_MAX) ? BMP180_OSS_MAX : s->oss] << Q;
+  if (sigma < noise) sigma = noise;
+
+  /* Noise, from the difference between this change and the last. For
+   * white noise that is about twice the RMS on average. Each one is
+   * clipped, so the rate starting to change doesn't read as noise */
+  if (last_ms) {
+    residual = (dp << Q) - ((int64_t)last_dp * ms << Q) / last_ms;
+    if (residual < 0) residual = -residual;
+    if (residual > (int64_t)NOISE_CLIP * 2 * sigma) residual = (int64_t)NOISE_CLIP * 2 * sigma;
+    noise += ((int32_t)residual / 2 - noise) / 8;
+    if (sigma < noise) sigma = noise;
+  }
+  last_dp = dp;
+  last_ms = ms;
+
+  /* Rate, from the part of the change outside the noise */
+  moved = abs(dp << Q) - sigma;
+  if (moved < 0) moved = 0;
+  if (dp < 0) moved = -moved;
+  rate += (int32_t)((((int64_t)moved * 1000) / ms - rate) / 2);
+
+  /* The period that moves each sample by ADAPT_STEP_SIGMAS */
+  if (rate == 0) {
+    wanted = config.max_period;
+  } else {
+    wanted = ((uint32_t)ADAPT_STEP_SIGMAS * sigma * 1000) / abs(rate);
+  }
+
+  if (wanted < period) {
+    hold = 0;
+    if (period_below(wanted) < period) {
+      period_set(period_below(wanted));
+    }
+  } else if (wanted >= 2 * (uint32_t)period && period < config.max_period) {
+    if (++hold >= ADAPT_HOLD) {
+      hold = 0;
+      period_set(period_below(2 * (uint32_t)period));
+    }
+  } else {
+    hold = 0;
+  }
+
+  return STAGE_PASS;
+}
+
+void adapt_on_ble_evt(ble_evt_t* p_ble_evt) {
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+      conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+      fast_interval = 0;
+      conn_interval_update();
+      break;
+    case BLE_GAP_EVT_DISCONNECTED:
+      conn_handle = BLE_CONN_HANDLE_INVALID;
+      /* Back to the usual parameters for the next connection. The link
+       * has gone, so there's nothing to update. */
+      if (fast_interval) {
+        APP_ERROR_CHECK(sd_ble_gap_ppcp_set(&usual_conn_params));
+        fast_interval = 0;
+      }
+      break;
+    default:
+      break;
+  }
+}
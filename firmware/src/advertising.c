@@ -0,0 +1,161 @@
+/*
+ * Advertising manager
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Advertising runs in phases instead of timing out into System OFF:
+ *
+ * - Directed: to the last bonded central, if it has an address that
+ *   can be advertised to. The SoftDevice ends this after 1.28s.
+ * - Fast: 25ms for ADV_FAST_TIMEOUT seconds, for quick discovery.
+ * - Slow: at the power profile's interval, until a connection.
+ *
+ * So the device is always reachable, and only pays for fast
+ * advertising around the times a connection is likely. Button presses
+ * and sensor events call advertising_boost to go back to the fast
+ * phase.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nrf.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+#include "ble.h"
+#include "device_manager.h"
+#include "led.h"
+#include "config.h"
+#include "advertising.h"
+
+static enum adv_phase phase = ADV_PHASE_IDLE;
+static dm_handle_t peer_handle;
+static bool peer_valid;
+
+/**
+ * Starts advertising in a given phase. Falls through to the next
+ * phase when there's nothing to do in this one
+ */
+static void phase_start(enum adv_phase next) {
+  ble_gap_adv_params_t params;
+  ble_gap_addr_t peer_addr;
+
+  memset(&params, 0, sizeof(params));
+  params.type = BLE_GAP_ADV_TYPE_ADV_IND;
+  params.fp = BLE_GAP_ADV_FP_ANY;
+
+  if (next == ADV_PHASE_DIRECTED) {
+    /* Resolvable addresses change, so can't be advertised to */
+    if (peer_valid &&
+        dm_peer_addr_get(&peer_handle, &peer_addr) == NRF_SUCCESS &&
+        peer_addr.addr_type != BLE_GAP_ADDR_TYPE_RANDOM_PRIVATE_RESOLVABLE) {
+      params.type = BLE_GAP_ADV_TYPE_ADV_DIRECT_IND;
+      params.p_peer_addr = &peer_addr;
+    } else {
+      next = ADV_PHASE_FAST;
+    }
+  }
+
+  switch (next) {
+    case ADV_PHASE_FAST:
+      params.interval = config()->adv_fast_interval;
+      params.timeout = config()->adv_fast_timeout;
+      break;
+    case ADV_PHASE_SLOW:
+      params.interval = config()->adv_interval;
+      params.timeout = BLE_GAP_ADV_TIMEOUT_GENERAL_UNLIMITED;
+      break;
+    default:			/* Directed, interval and timeout are fixed */
+      break;
+  }
+
+  APP_ERROR_CHECK(sd_ble_gap_adv_start(&params));
+  phase = next;
+
+  /* The LED is only worth its current while we're quick to find */
+  if (phase == ADV_PHASE_SLOW) {
+    led_stop();
+  } else {
+    led_start();
+  }
+}
+
+/**
+ * Starts advertising from the first phase
+ */
+void advertising_start(void) {
+  phase_start(ADV_PHASE_DIRECTED);
+}
+/**
+ * Returns to fast advertising, if we're advertising slowly. Can be
+ * called from any context
+ */
+void advertising_boost(void) {
+  uint32_t err_code;
+
+  CRITICAL_REGION_ENTER();
+  if (phase == ADV_PHASE_SLOW || phase == ADV_PHASE_FAST) {
+    err_code = sd_ble_gap_adv_stop();
+
+    /* A connection may have just ended advertising, in which case
+     * the event is already on its way */
+    if (err_code == NRF_SUCCESS) {
+      phase_start(ADV_PHASE_FAST);
+    } else if (err_code != NRF_ERROR_INVALID_STATE) {
+      APP_ERROR_HANDLER(err_code);
+    }
+  }
+  CRITICAL_REGION_EXIT();
+}
+/**
+ * Remembers the central to advertise to after a disconnect
+ */
+void advertising_peer_set(dm_handle_t const* p_handle) {
+  peer_handle = *p_handle;
+  peer_valid = true;
+}
+enum adv_phase advertising_phase(void) {
+  return phase;
+}
+
+void advertising_on_ble_evt(ble_evt_t* p_ble_evt) {
+  ble_gap_evt_t* p_gap_evt = &p_ble_evt->evt.gap_evt;
+
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+      phase = ADV_PHASE_IDLE;
+      led_stop();
+      break;
+    case BLE_GAP_EVT_DISCONNECTED:
+      phase_start(ADV_PHASE_DIRECTED);
+      break;
+    case BLE_GAP_EVT_TIMEOUT:
+      if (p_gap_evt->params.timeout.src == BLE_GAP_TIMEOUT_SRC_ADVERTISEMENT) {
+        phase_start(phase == ADV_PHASE_DIRECTED ? ADV_PHASE_FAST : ADV_PHASE_SLOW);
+      }
+      break;
+    default:
+      break;
+  }
+}
@@ -33,6 +33,8 @@
 #include "ble_bas.h"
 #include "main.h"
 #include "battery.h"
+#include "prof.h"
+#include "telemetry.h"
 #include "app_util.h"
 
 #define ADC_REF_VOLTAGE_IN_MILLIVOLTS        1200                                      /**< Reference voltage (in milli volts) used by ADC while doing conversion. */
@@ -54,6 +56,8 @@
  */
 void ADC_IRQHandler(void)
 {
+    PROF_ENTER(ADC_IRQ);
+
     if (NRF_ADC->EVENTS_END != 0)
     {
         uint8_t     adc_result;
@@ -69,7 +73,10 @@ void ADC_IRQHandler(void)
                                   DIODE_FWD_VOLT_DROP_MILLIVOLTS;
         percentage_batt_lvl     = battery_level_in_percent(batt_lvl_in_milli_volts);
 
+        telemetry_inc(TELEMETRY_ADC_RUNS);
+
         err_code = ble_bas_battery_level_update(&bas, percentage_batt_lvl);
+        telemetry_hvx_result(err_code);
         if (
             (err_code != NRF_SUCCESS)
             &&
@@ -83,6 +90,8 @@ void ADC_IRQHandler(void)
             APP_ERROR_HANDLER(err_code);
         }
     }
+
+    PROF_EXIT(ADC_IRQ);
 }
 
 
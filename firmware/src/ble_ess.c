@@ -31,6 +31,10 @@
 #define BLE_UUID_PRESSURE_CHAR				0x2A6D     /**< Location and Speed characteristic UUID. */
 #define BLE_UUID_TEMPERATURE_CHAR			0x2A6E     /**< LN feature characteristic UUID. */
 
+/**@brief Vendor specific base UUID, the 16-bit vendor characteristic UUIDs go in bytes 12 and 13. */
+#define BLE_ESS_VENDOR_BASE_UUID  {{0x9D, 0x5F, 0xDD, 0x7D, 0xDB, 0x2A, 0xD6, 0x92, \
+                                    0xB2, 0xA0, 0x2E, 0x0B, 0x00, 0x00, 0xC3, 0x77}}
+
 
 
 
@@ -53,7 +57,8 @@ static void on_connect(ble_ess_t * p_ess, ble_evt_t * p_ble_evt)
 static void on_disconnect(ble_ess_t * p_ess, ble_evt_t * p_ble_evt)
 {
   UNUSED_PARAMETER(p_ble_evt);
-  p_ess->conn_handle = BLE_CONN_HANDLE_INVALID;
+  p_ess->conn_handle         = BLE_CONN_HANDLE_INVALID;
+  p_ess->read_pending_handle = BLE_GATT_HANDLE_INVALID;
 }
 
 
@@ -71,6 +76,10 @@ static void on_lsc_cccd_write(ble_ess_t * p_ess, ble_gatts_evt_write_t * p_evt_w
     {
       ble_ess_evt_t evt;
 
+      evt.handle = p_evt_write->handle;
+      evt.p_data = p_evt_write->data;
+      evt.len    = p_evt_write->len;
+
       if (ble_srv_is_notification_enabled(p_evt_write->data))
       {
         evt.evt_type = BLE_ESS_EVT_NOTIFICATION_ENABLED;
@@ -99,10 +108,59 @@ static void on_write(ble_ess_t * p_ess, ble_evt_t * p_ble_evt)
   {
     on_lsc_cccd_write(p_ess, p_evt_write);
   }
-  if (p_evt_write->handle == p_ess->tc_handles.cccd_handle)
+  else if (p_evt_write->handle == p_ess->tc_handles.cccd_handle)
   {
     on_lsc_cccd_write(p_ess, p_evt_write);
   }
+  else if (p_ess->evt_handler != NULL)
+  {
+    // Vendor specific characteristic, let the application decide
+    ble_ess_evt_t evt;
+
+    evt.evt_type = BLE_ESS_EVT_WRITE;
+    evt.handle   = p_evt_write->handle;
+    evt.p_data   = p_evt_write->data;
+    evt.len      = p_evt_write->len;
+
+    p_ess->evt_handler(p_ess, &evt);
+  }
+}
+
+
+/**@brief Function for handling the Read/Write Authorization Request event.
+ *
+ * @details In lazy read mode reads of the pressure and temperature characteristics are passed to
+ *          the application, which answers with ble_ess_read_reply().
+ *
+ * @param[in]   p_ess       Environmental Sensing Service structure.
+ * @param[in]   p_ble_evt   Event received from the BLE stack.
+ */
+static void on_rw_authorize_request(ble_ess_t * p_ess, ble_evt_t * p_ble_evt)
+{
+  ble_gatts_evt_rw_authorize_request_t * p_auth_req =
+    &p_ble_evt->evt.gatts_evt.params.authorize_request;
+  ble_ess_evt_t evt;
+
+  if ((p_auth_req->type == BLE_GATTS_AUTHORIZE_TYPE_READ) &&
+      ((p_auth_req->request.read.handle == p_ess->pc_handles.value_handle) ||
+       (p_auth_req->request.read.handle == p_ess->tc_handles.value_handle)))
+  {
+    p_ess->read_pending_handle = p_auth_req->request.read.handle;
+
+    if (p_ess->evt_handler != NULL)
+    {
+      evt.evt_type = BLE_ESS_EVT_READ_REQUEST;
+      evt.handle   = p_auth_req->request.read.handle;
+      evt.p_data   = NULL;
+      evt.len      = 0;
+
+      p_ess->evt_handler(p_ess, &evt);
+    }
+    else
+    {
+      (void)ble_ess_read_reply_stored(p_ess);
+    }
+  }
 }
 
 
@@ -122,6 +180,10 @@ void ble_ess_on_ble_evt(ble_ess_t * p_ess, ble_evt_t * p_ble_evt)
     on_write(p_ess, p_ble_evt);
     break;
 
+  case BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST:
+    on_rw_authorize_request(p_ess, p_ble_evt);
+    break;
+
   default:
     // No implementation needed.
     break;
@@ -168,7 +230,7 @@ static uint32_t pressure_char_add(ble_ess_t            * p_ess,
   attr_md.read_perm  = p_ess_init->ess_pc_attr_md.read_perm;
   attr_md.write_perm = p_ess_init->ess_pc_attr_md.write_perm;
   attr_md.vloc       = BLE_GATTS_VLOC_STACK;
-  attr_md.rd_auth    = 0;
+  attr_md.rd_auth    = p_ess_init->lazy_read ? 1 : 0;
   attr_md.wr_auth    = 0;
   attr_md.vlen       = 1;
 
@@ -227,7 +289,7 @@ static uint32_t temperature_char_add(ble_ess_t * p_ess, const ble_ess_init_t * p
   attr_md.read_perm  = p_ess_init->ess_tc_attr_md.read_perm;
   attr_md.write_perm = p_ess_init->ess_tc_attr_md.write_perm;
   attr_md.vloc       = BLE_GATTS_VLOC_STACK;
-  attr_md.rd_auth    = 0;
+  attr_md.rd_auth    = p_ess_init->lazy_read ? 1 : 0;
   attr_md.wr_auth    = 0;
   attr_md.vlen       = 1;
 
@@ -247,18 +309,52 @@ static uint32_t temperature_char_add(ble_ess_t * p_ess, const ble_ess_init_t * p
 }
 
 
+/**@brief Function for adding the altitude and climb rate characteristic.
+ *
+ * @param[in]   p_ess        Environmental Sensing Service structure.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+static uint32_t vario_char_add(ble_ess_t * p_ess)
+{
+  uint8_t initial_vario[BLE_ESS_VARIO_LEN];
+
+  memset(initial_vario, 0, sizeof(initial_vario));
+
+  return ble_ess_char_add(p_ess,
+                          BLE_ESS_UUID_VARIO_CHAR,
+                          BLE_ESS_CHAR_READ | BLE_ESS_CHAR_NOTIFY,
+                          initial_vario,
+                          sizeof(initial_vario),
+                          sizeof(initial_vario),
+                          &p_ess->vc_handles);
+}
+
+
 uint32_t ble_ess_init(ble_ess_t * p_ess, const ble_ess_init_t * p_ess_init)
 {
-  uint32_t   err_code;
-  ble_uuid_t ble_uuid;
+  uint32_t      err_code;
+  ble_uuid_t    ble_uuid;
+  ble_uuid128_t base_uuid = BLE_ESS_VENDOR_BASE_UUID;
 
   // Initialize service structure
   p_ess->evt_handler                 = p_ess_init->evt_handler;
   p_ess->is_sensor_contact_supported = p_ess_init->is_sensor_contact_supported;
   p_ess->conn_handle                 = BLE_CONN_HANDLE_INVALID;
+  p_ess->read_pending_handle         = BLE_GATT_HANDLE_INVALID;
   p_ess->is_sensor_contact_detected  = false;
+  p_ess->is_notifying                = true;
   p_ess->pressure_last          	= 0;
   p_ess->temperature_last		= -32767;
+  p_ess->altitude_last		= 0;
+  p_ess->climb_last		= -32767;
+
+  // Add vendor specific base UUID
+  err_code = sd_ble_uuid_vs_add(&base_uuid, &p_ess->uuid_type);
+  if (err_code != NRF_SUCCESS)
+  {
+    return err_code;
+  }
 
   // Add service
   BLE_UUID_BLE_ASSIGN(ble_uuid, BLE_UUID_ENVIROMENTAL_SENSING_SERVICE);
@@ -286,6 +382,13 @@ uint32_t ble_ess_init(ble_ess_t * p_ess, const ble_ess_init_t * p_ess_init)
     return err_code;
   }
 
+  // Add altitude and climb rate characteristic
+  err_code = vario_char_add(p_ess);
+  if (err_code != NRF_SUCCESS)
+  {
+    return err_code;
+  }
+
   return NRF_SUCCESS;
 }
 
@@ -298,9 +401,6 @@ uint32_t ble_ess_pressure_send(ble_ess_t * p_ess, uint32_t pressure)
   {
     uint16_t len = sizeof(uint32_t);
 
-    // Save new value
-    p_ess->pressure_last = pressure;
-
     // Update database
     err_code = sd_ble_gatts_value_set(p_ess->pc_handles.value_handle,
                                       0,
@@ -312,7 +412,7 @@ uint32_t ble_ess_pressure_send(ble_ess_t * p_ess, uint32_t pressure)
     }
 
     // Send value if connected and notifying
-    if (p_ess->conn_handle != BLE_CONN_HANDLE_INVALID)
+    if ((p_ess->conn_handle != BLE_CONN_HANDLE_INVALID) && p_ess->is_notifying)
     {
       uint16_t		hvx_len;
       ble_gatts_hvx_params_t	hvx_params;
@@ -337,20 +437,25 @@ uint32_t ble_ess_pressure_send(ble_ess_t * p_ess, uint32_t pressure)
     {
       err_code = NRF_ERROR_INVALID_STATE;
     }
+
+    // Save new value, unless it needs to be sent again
+    if (err_code != BLE_ERROR_NO_TX_BUFFERS)
+    {
+      p_ess->pressure_last = pressure;
+    }
   }
 
   return err_code;
 }
-uint32_t ble_ess_temperature_send(ble_ess_t * p_ess, uint16_t temperature)
+
+
+uint32_t ble_ess_temperature_send(ble_ess_t * p_ess, int16_t temperature)
 {
   uint32_t err_code = NRF_SUCCESS;
 
   if (temperature != p_ess->temperature_last)
   {
-    uint16_t len = sizeof(uint16_t);
-
-    // Save new value
-    p_ess->temperature_last = temperature;
+    uint16_t len = sizeof(int16_t);
 
     // Update database
     err_code = sd_ble_gatts_value_set(p_ess->tc_handles.value_handle,
@@ -363,7 +468,7 @@ uint32_t ble_ess_temperature_send(ble_ess_t * p_ess, uint16_t temperature)
     }
 
     // Send value if connected and notifying
-    if (p_ess->conn_handle != BLE_CONN_HANDLE_INVALID)
+    if ((p_ess->conn_handle != BLE_CONN_HANDLE_INVALID) && p_ess->is_notifying)
     {
       uint16_t		hvx_len;
       ble_gatts_hvx_params_t	hvx_params;
@@ -388,6 +493,288 @@ uint32_t ble_ess_temperature_send(ble_ess_t * p_ess, uint16_t temperature)
     {
       err_code = NRF_ERROR_INVALID_STATE;
     }
+
+    // Save new value, unless it needs to be sent again
+    if (err_code != BLE_ERROR_NO_TX_BUFFERS)
+    {
+      p_ess->temperature_last = temperature;
+    }
+  }
+
+  return err_code;
+}
+
+
+uint32_t ble_ess_vario_send(ble_ess_t * p_ess, int32_t altitude, int16_t climb)
+{
+  uint32_t err_code = NRF_SUCCESS;
+
+  if ((altitude != p_ess->altitude_last) || (climb != p_ess->climb_last))
+  {
+    uint8_t encoded[BLE_ESS_VARIO_LEN];
+
+    (void)uint32_encode((uint32_t)altitude, &encoded[0]);
+    (void)uint16_encode((uint16_t)climb, &encoded[4]);
+
+    err_code = ble_ess_char_update(p_ess,
+                                   &p_ess->vc_handles,
+                                   encoded,
+                                   sizeof(encoded),
+                                   p_ess->is_notifying ? BLE_GATT_HVX_NOTIFICATION :
+                                                         BLE_GATT_HVX_INVALID);
+
+    // Stored but not sent, as for pressure and temperature
+    if ((err_code == NRF_SUCCESS) && !p_ess->is_notifying)
+    {
+      err_code = NRF_ERROR_INVALID_STATE;
+    }
+
+    // Save new values, unless they need to be sent again
+    if (err_code != BLE_ERROR_NO_TX_BUFFERS)
+    {
+      p_ess->altitude_last = altitude;
+      p_ess->climb_last    = climb;
+    }
+  }
+
+  return err_code;
+}
+
+
+void ble_ess_notify_set(ble_ess_t * p_ess, bool notify)
+{
+  p_ess->is_notifying = notify;
+}
+
+
+enum stage_result ble_ess_encode_stage(struct sample * s)
+{
+  s->pressure    *= 10; // Units 0.1Pa
+  s->temperature *= 10; // Units 0.01°C
+  s->flags       |= SAMPLE_FLAG_ENCODED;
+
+  return STAGE_PASS;
+}
+
+
+/**@brief Function for answering the pending read.
+ *
+ * @param[in]   p_ess       Environmental Sensing Service structure.
+ * @param[in]   p_data      Value to answer with, or NULL to use the value in the database.
+ * @param[in]   len         Length of the value.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+static uint32_t read_reply(ble_ess_t * p_ess, uint8_t * p_data, uint16_t len)
+{
+  ble_gatts_rw_authorize_reply_params_t reply;
+
+  if ((p_ess->read_pending_handle == BLE_GATT_HANDLE_INVALID) ||
+      (p_ess->conn_handle == BLE_CONN_HANDLE_INVALID))
+  {
+    return NRF_ERROR_INVALID_STATE;
+  }
+  p_ess->read_pending_handle = BLE_GATT_HANDLE_INVALID;
+
+  memset(&reply, 0, sizeof(reply));
+
+  reply.type                     = BLE_GATTS_AUTHORIZE_TYPE_READ;
+  reply.params.read.gatt_status  = BLE_GATT_STATUS_SUCCESS;
+  reply.params.read.update       = (p_data != NULL) ? 1 : 0;
+  reply.params.read.offset       = 0;
+  reply.params.read.len          = len;
+  reply.params.read.p_data       = p_data;
+
+  return sd_ble_gatts_rw_authorize_reply(p_ess->conn_handle, &reply);
+}
+
+
+uint32_t ble_ess_read_reply(ble_ess_t * p_ess, uint32_t pressure, int16_t temperature)
+{
+  uint32_t err_code;
+  uint16_t len;
+
+  // Keep both characteristics in step, the reply updates the one being read
+  if (p_ess->read_pending_handle == p_ess->pc_handles.value_handle)
+  {
+    len      = sizeof(int16_t);
+    err_code = sd_ble_gatts_value_set(p_ess->tc_handles.value_handle, 0, &len,
+                                      (uint8_t*)&temperature);
+    if (err_code != NRF_SUCCESS)
+    {
+      return err_code;
+    }
+
+    return read_reply(p_ess, (uint8_t*)&pressure, sizeof(uint32_t));
+  }
+  else
+  {
+    len      = sizeof(uint32_t);
+    err_code = sd_ble_gatts_value_set(p_ess->pc_handles.value_handle, 0, &len,
+                                      (uint8_t*)&pressure);
+    if (err_code != NRF_SUCCESS)
+    {
+      return err_code;
+    }
+
+    return read_reply(p_ess, (uint8_t*)&temperature, sizeof(int16_t));
+  }
+}
+
+
+uint32_t ble_ess_read_reply_stored(ble_ess_t * p_ess)
+{
+  return read_reply(p_ess, NULL, 0);
+}
+
+
+bool ble_ess_is_subscribed(ble_ess_t * p_ess)
+{
+  uint8_t  cccd[2];
+  uint16_t len;
+
+  if (p_ess->conn_handle == BLE_CONN_HANDLE_INVALID)
+  {
+    return false;
+  }
+
+  len = sizeof(cccd);
+  if ((sd_ble_gatts_value_get(p_ess->pc_handles.cccd_handle, 0, &len, cccd) == NRF_SUCCESS) &&
+      ble_srv_is_notification_enabled(cccd))
+  {
+    return true;
+  }
+
+  len = sizeof(cccd);
+  if ((sd_ble_gatts_value_get(p_ess->tc_handles.cccd_handle, 0, &len, cccd) == NRF_SUCCESS) &&
+      ble_srv_is_notification_enabled(cccd))
+  {
+    return true;
+  }
+
+  len = sizeof(cccd);
+  if ((sd_ble_gatts_value_get(p_ess->vc_handles.cccd_handle, 0, &len, cccd) == NRF_SUCCESS) &&
+      ble_srv_is_notification_enabled(cccd))
+  {
+    return true;
+  }
+
+  return false;
+}
+
+
+uint32_t ble_ess_char_add(ble_ess_t *                p_ess,
+                          uint16_t                   uuid,
+                          uint8_t                    props,
+                          uint8_t *                  p_value,
+                          uint16_t                   len,
+                          uint16_t                   max_len,
+                          ble_gatts_char_handles_t * p_handles)
+{
+  ble_gatts_char_md_t char_md;
+  ble_gatts_attr_md_t cccd_md;
+  ble_gatts_attr_t    attr_char_value;
+  ble_uuid_t          ble_uuid;
+  ble_gatts_attr_md_t attr_md;
+
+  memset(&cccd_md, 0, sizeof(cccd_md));
+
+  BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.read_perm);
+  BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.write_perm);
+  cccd_md.vloc       = BLE_GATTS_VLOC_STACK;
+
+  memset(&char_md, 0, sizeof(char_md));
+
+  char_md.char_props.read     = (props & BLE_ESS_CHAR_READ) ? 1 : 0;
+  char_md.char_props.write    = (props & BLE_ESS_CHAR_WRITE) ? 1 : 0;
+  char_md.char_props.notify   = (props & BLE_ESS_CHAR_NOTIFY) ? 1 : 0;
+  char_md.char_props.indicate = (props & BLE_ESS_CHAR_INDICATE) ? 1 : 0;
+  char_md.p_char_user_desc    = NULL;
+  char_md.p_char_pf           = NULL;
+  char_md.p_user_desc_md      = NULL;
+  char_md.p_cccd_md           = (props & (BLE_ESS_CHAR_NOTIFY | BLE_ESS_CHAR_INDICATE)) ?
+                                &cccd_md : NULL;
+  char_md.p_sccd_md           = NULL;
+
+  ble_uuid.type = p_ess->uuid_type;
+  ble_uuid.uuid = uuid;
+
+  memset(&attr_md, 0, sizeof(attr_md));
+
+  BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.read_perm);
+  if (props & BLE_ESS_CHAR_WRITE)
+  {
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.write_perm);
+  }
+  else
+  {
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&attr_md.write_perm);
+  }
+  attr_md.vloc       = (props & BLE_ESS_CHAR_USER_MEM) ? BLE_GATTS_VLOC_USER : BLE_GATTS_VLOC_STACK;
+  attr_md.rd_auth    = 0;
+  attr_md.wr_auth    = 0;
+  attr_md.vlen       = 1;
+
+  memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+  attr_char_value.p_uuid    = &ble_uuid;
+  attr_char_value.p_attr_md = &attr_md;
+  attr_char_value.init_len  = len;
+  attr_char_value.init_offs = 0;
+  attr_char_value.max_len   = max_len;
+  attr_char_value.p_value   = p_value;
+
+  return sd_ble_gatts_characteristic_add(p_ess->service_handle,
+                                         &char_md,
+                                         &attr_char_value,
+                                         p_handles);
+}
+
+
+uint32_t ble_ess_char_update(ble_ess_t *                p_ess,
+                             ble_gatts_char_handles_t * p_handles,
+                             uint8_t *                  p_data,
+                             uint16_t                   len,
+                             uint8_t                    hvx_type)
+{
+  uint32_t err_code;
+  uint16_t set_len = len;
+
+  // Update database
+  err_code = sd_ble_gatts_value_set(p_handles->value_handle,
+                                    0,
+                                    &set_len,
+                                    p_data);
+  if ((err_code != NRF_SUCCESS) || (hvx_type == BLE_GATT_HVX_INVALID))
+  {
+    return err_code;
+  }
+
+  // Send value if connected
+  if (p_ess->conn_handle != BLE_CONN_HANDLE_INVALID)
+  {
+    uint16_t		hvx_len;
+    ble_gatts_hvx_params_t	hvx_params;
+
+    hvx_len = len;
+
+    memset(&hvx_params, 0, sizeof(hvx_params));
+
+    hvx_params.handle = p_handles->value_handle;
+    hvx_params.type   = hvx_type;
+    hvx_params.offset = 0;
+    hvx_params.p_len  = &hvx_len;
+    hvx_params.p_data = p_data;
+
+    err_code = sd_ble_gatts_hvx(p_ess->conn_handle, &hvx_params);
+    if ((err_code == NRF_SUCCESS) && (hvx_len != len))
+    {
+      err_code = NRF_ERROR_DATA_SIZE;
+    }
+  }
+  else
+  {
+    err_code = NRF_ERROR_INVALID_STATE;
   }
 
   return err_code;
@@ -27,6 +27,8 @@
 
 #include "nrf.h"
 #include "twi_master.h"
+#include "telemetry.h"
+#include "validate.h"
 #include "bmp180.h"
 
 #define BMP180_ADDRESS		0xEE
@@ -43,22 +45,42 @@ typedef enum {
   PRESSURE_ULTRALOW		= 0x34, //  4500µS Delay
   PRESSURE_STANDARD		= 0x74, //  7500µS Delay
   PRESSURE_HIGHRES		= 0xB4, // 13500µS Delay
-  PRESSURE_ULTRAHIGHRES		= 0xF4  // 22500µS Delay
+  PRESSURE_ULTRAHIGHRES		= 0xF4  // 25500µS Delay
 } bmp085_command;
 
 /**
- * The mode of pressure measurement
+ * The mode of pressure measurement, indexed by oversampling setting
  */
-#define PRESSURE_MODE		PRESSURE_HIGHRES// PRESSURE_STANDARD
-#define PRESSURE_DELAY		13500//7500
+const bmp085_command pressure_mode[] = {
+  PRESSURE_ULTRALOW, PRESSURE_STANDARD, PRESSURE_HIGHRES, PRESSURE_ULTRAHIGHRES
+};
+const uint16_t pressure_delay[] = {
+  4500, 7500, 13500, 25500
+};
 
-#define TEMPERATURE_DELAY	4500
+/**
+ * The current oversampling setting
+ */
+static uint8_t oss = BMP180_OSS_DEFAULT;
+
+/**
+ * Temperature is converted once every this many samples taken by
+ * bmp180_acquire, and the last one is used in between
+ */
+static uint8_t temperature_decimation = 1;
+static uint8_t decimate;	/* Samples until the next temperature */
+static int32_t last_ut;
 
 /**
  * Barometer data structure
  */
 struct barometer barometer;
 
+/**
+ * Set when a transfer fails, until read by bmp180_twi_error
+ */
+static bool twi_error;
+
 /**
  * Calibration Values
  */
@@ -68,18 +90,28 @@ struct calibration {
 } calibration;
 
 /**
- * Lookup table for oversampling values.
+ * Returns the current oversampling setting.
  */
 uint8_t oversampling(void) {
-  switch(PRESSURE_MODE) {
-    case PRESSURE_ULTRALOW:
-      return 0;
-    case PRESSURE_HIGHRES:
-      return 2;
-    case PRESSURE_ULTRAHIGHRES:
-      return 3;
-    default: // PRESSURE_STANDARD
-      return 1;
+  return oss;
+}
+/**
+ * Sets the oversampling setting used for the next pressure measurement
+ */
+void bmp180_set_oss(uint8_t setting) {
+  if (setting <= BMP180_OSS_MAX) {
+    oss = setting;
+  }
+}
+
+/**
+ * Sets how many samples are taken for each temperature conversion.
+ * The next sample converts the temperature.
+ */
+void bmp180_set_temperature_decimation(uint8_t decimation) {
+  if (decimation >= 1 && decimation <= BMP180_TEMPERATURE_DECIMATION_MAX) {
+    temperature_decimation = decimation;
+    decimate = 0;
   }
 }
 
@@ -92,6 +124,33 @@ void delay_us(uint16_t microseconds) {
   while(i--);
 }
 
+/**
+ * Wraps twi_master_transfer, noting any failure. The bus is cleared
+ * after a failure so a stuck slave doesn't take the next transfer
+ * down with it.
+ */
+static bool transfer(uint8_t address, uint8_t *data, uint8_t length, bool stop) {
+  if (twi_master_transfer(address, data, length, stop)) {
+    return true;
+  }
+
+  twi_error = true;
+  telemetry_inc(TELEMETRY_TWI_ERRORS);
+  if (twi_master_init()) {
+    telemetry_inc(TELEMETRY_TWI_RECOVERIES);
+  }
+
+  return false;
+}
+/**
+ * Returns true if a transfer has failed since the last call
+ */
+bool bmp180_twi_error(void) {
+  bool error = twi_error;
+  twi_error = false;
+  return error;
+}
+
 /**
  * Utility function to read from a 8-bit register
  */
@@ -100,10 +159,10 @@ uint8_t read_8(char address) {
   buffer[0] = address;
 
   /* Set regsiter to read */
-  twi_master_transfer(BMP180_ADDRESS, buffer, 1, false);
+  transfer(BMP180_ADDRESS, buffer, 1, false);
 
   /* Read it */
-  twi_master_transfer(BMP180_ADDRESS | 1, buffer, 1, true);
+  transfer(BMP180_ADDRESS | 1, buffer, 1, true);
 
   return buffer[0];
 }
@@ -115,10 +174,10 @@ uint16_t read_16(char address) {
   buffer[0] = address;
 
   /* Set regsiter to read */
-  twi_master_transfer(BMP180_ADDRESS, buffer, 1, false);
+  transfer(BMP180_ADDRESS, buffer, 1, false);
 
   /* Read it */
-  twi_master_transfer(BMP180_ADDRESS | 1, buffer, 2, true);
+  transfer(BMP180_ADDRESS | 1, buffer, 2, true);
 
   return (buffer[0] << 8) | buffer[1];
 }
@@ -148,41 +207,73 @@ void write_command(bmp085_command command) {
   buffer[1] = command;
 
   /* Write to command register */
-  twi_master_transfer(BMP180_ADDRESS, buffer, 2, true);
+  transfer(BMP180_ADDRESS, buffer, 2, true);
 }
 
 
 /**
- * Takes a temperature measurement and returns the uncompensated value.
+ * Starts a temperature conversion. The result can be read after
+ * BMP180_TEMPERATURE_DELAY µs.
  */
-int32_t get_ut(void) {
+void bmp180_start_temperature(void) {
   write_command(TEMPERATURE);
-
-  delay_us(TEMPERATURE_DELAY);
-
+}
+/**
+ * Reads the uncompensated temperature from a finished conversion.
+ */
+int32_t bmp180_read_ut(void) {
   return read_16(BMP180_REG_DATA);
 }
 /**
- * Takes a pressure measurement and returns the uncompenstated value.
+ * Starts a pressure conversion. The result can be read after
+ * bmp180_pressure_delay(oss) µs.
  */
-int32_t get_up(void) {
+void bmp180_start_pressure(uint8_t oss) {
+  write_command(pressure_mode[oss]);
+}
+/**
+ * Returns the pressure conversion time in µs.
+ */
+uint16_t bmp180_pressure_delay(uint8_t oss) {
+  return pressure_delay[oss];
+}
+/**
+ * Reads the uncompensated pressure from a finished conversion.
+ */
+int32_t bmp180_read_up(uint8_t oss) {
   uint8_t buffer[3];
-  write_command(PRESSURE_MODE);
-
-  delay_us(PRESSURE_DELAY);
-
 
   buffer[0] = BMP180_REG_DATA;
 
   /* Set regsiter to read */
-  twi_master_transfer(BMP180_ADDRESS, buffer, 1, false);
+  transfer(BMP180_ADDRESS, buffer, 1, false);
 
   /* Read it */
-  twi_master_transfer(BMP180_ADDRESS | 1, buffer, 3, true);
+  transfer(BMP180_ADDRESS | 1, buffer, 3, true);
 
   return ((buffer[0] << 16) | (buffer[1] << 8) |
-          buffer[2]) >> (8 - oversampling());
+          buffer[2]) >> (8 - oss);
+}
+
+/**
+ * Takes a temperature measurement and returns the uncompensated value.
+ */
+int32_t get_ut(void) {
+  bmp180_start_temperature();
+
+  delay_us(BMP180_TEMPERATURE_DELAY);
 
+  return bmp180_read_ut();
+}
+/**
+ * Takes a pressure measurement and returns the uncompenstated value.
+ */
+int32_t get_up(uint8_t oss) {
+  bmp180_start_pressure(oss);
+
+  delay_us(pressure_delay[oss]);
+
+  return bmp180_read_up(oss);
 }
 
 /* -----------------------------------------------------------------------------
@@ -211,7 +302,7 @@ double get_temperature(int32_t B5) {
  * Returns the pressure in pascals using the calibration and variable
  * B5.
  */
-int32_t get_pressure(struct calibration *c, int32_t B5, int32_t up) {
+int32_t get_pressure(struct calibration *c, int32_t B5, int32_t up, uint8_t oss) {
   int64_t B6, X1, X2, X3, B3, pressure;
   uint64_t B4, B7;
 
@@ -219,12 +310,12 @@ int32_t get_pressure(struct calibration *c, int32_t B5, int32_t up) {
   X1 = (c->B2 * ((B6 * B6) >> 12)) >> 11;
   X2 = (c->AC2 * B6) >> 11;
   X3 = X1 + X2;
-  B3 = ((((((int64_t)(c->AC1) * 4) + X3) << oversampling()) + 2) >> 2);
+  B3 = ((((((int64_t)(c->AC1) * 4) + X3) << oss) + 2) >> 2);
   X1 = (c->AC3 * B6) >> 13;
   X2 = (c->B1 * ((B6 * B6) >> 12)) >> 16;
   X3 = ((X1 + X2) + 2) >> 2;
   B4 = (c->AC4 * (uint64_t)(X3 + 32768)) >> 15;
-  B7 = ((uint64_t)(up - B3) * (50000 >> oversampling()));
+  B7 = ((uint64_t)(up - B3) * (50000 >> oss));
 
   if (B7 < 0x80000000) {
     pressure = (B7 << 1) / B4;
@@ -241,27 +332,81 @@ int32_t get_pressure(struct calibration *c, int32_t B5, int32_t up) {
   return pressure;
 }
 
+/* -----------------------------------------------------------------------------
+ * Pipeline
+ */
+
+/**
+ * Takes raw temperature and pressure measurements into a sample. The
+ * temperature is only converted once every temperature_decimation
+ * samples, and again straight after a failed transfer.
+ */
+void bmp180_acquire(struct sample* s) {
+  (void)bmp180_twi_error();
+
+  if (decimate == 0) {
+    decimate = temperature_decimation;
+    last_ut = get_ut();
+  }
+  decimate--;
+
+  s->oss = oversampling();
+  s->ut = last_ut;
+  s->up = get_up(s->oss);
+  s->flags = bmp180_twi_error() ? SAMPLE_FLAG_TWI_ERROR : 0;
+
+  if (s->flags & SAMPLE_FLAG_TWI_ERROR) {
+    decimate = 0;
+  }
+
+  telemetry_inc(TELEMETRY_SAMPLES);
+}
+/**
+ * Pipeline stage that fills in the compensated pressure and
+ * temperature from the raw values.
+ */
+enum stage_result bmp180_compensate(struct sample* s) {
+  int32_t b5;
+
+  if (s->flags & SAMPLE_FLAG_COMPENSATED) { /* Already done, or synthetic */
+    return STAGE_PASS;
+  }
+
+  b5 = get_b5(&calibration, s->ut);
+
+  s->temperature = (b5 + 8) >> 4; /* 0.1°C */
+  s->pressure = get_pressure(&calibration, b5, s->up, s->oss);
+  s->flags |= SAMPLE_FLAG_COMPENSATED;
+
+  return STAGE_PASS;
+}
+
 struct barometer* get_barometer(void)
 {
-  int32_t ut = get_ut();
-  int32_t up = get_up();
-  int32_t b5 = get_b5(&calibration, ut);
+  struct sample s;
 
-  barometer.temperature = get_temperature(b5);
-  barometer.pressure = get_pressure(&calibration, b5, up);
+  bmp180_acquire(&s);
+  bmp180_compensate(&s);
+
+  barometer.temperature = (double)s.temperature / 10;
+  barometer.pressure = s.pressure;
+  barometer.valid = validate_check(&s) ? 0 : 1;
 
   return &barometer;
 }
 
 /**
- * Assume twi_master_init has already been called
+ * Assume twi_master_init has already been called. Returns false if
+ * the BMP180 isn't there.
  */
-void bmp180_init(void)
+bool bmp180_init(void)
 {
   /* Read and check id */
   uint8_t id = read_8(BMP180_REG_ID);
-  if (id != 0x55) while (1);
+  if (id != 0x55) return false;
 
   /* Get the calibration parameters */
   get_cal_param(&calibration);
+
+  return !bmp180_twi_error();
 }
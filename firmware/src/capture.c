@@ -0,0 +1,452 @@
+/*
+ * Burst capture
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Captures short transients at a high sample rate without paying for
+ * that rate all the time. Once armed, pressure is sampled continuously
+ * into a ring in RAM. A trigger (a fast change in pressure, a GATT
+ * command or a button) marks a sample, and once the post-trigger
+ * samples are in the window around it is frozen and sampling stops.
+ * The client uploads the window whenever it likes.
+ *
+ * Conversions are waited for with single-shot app_timers as in the
+ * stream, with temperature only converted now and then. The
+ * measurement tick carries on while sampling, but the pipeline is fed
+ * the latest capture sample rather than taking its own, so the sensor
+ * only has one user.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nrf.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "ble.h"
+#include "ble_ess.h"
+#include "bmp180.h"
+#include "convert.h"
+#include "pipeline.h"
+#include "control.h"
+#include "stream.h"
+#include "telemetry.h"
+#include "validate.h"
+#include "main.h"
+#include "capture.h"
+
+#define RING_MASK		(CAPTURE_RING_SIZE - 1)
+
+#if (CAPTURE_RING_SIZE & RING_MASK) != 0
+#error CAPTURE_RING_SIZE must be a power of two
+#endif
+
+static const struct capture_config defaults = {
+  .period	= 50,
+  .pre		= 128,
+  .post		= 64,
+  .threshold	= 50,
+};
+
+static struct capture_status status;
+static app_timer_id_t sample_timer_id;
+static app_timer_id_t conv_timer_id;
+
+static ble_ess_t* capture_ess;
+static ble_gatts_char_handles_t* status_handles;
+static ble_gatts_char_handles_t* data_handles;
+
+/* Conversions */
+static bool converting, converting_temperature;
+static uint8_t oss;
+static uint8_t decimate;
+static int32_t ut;
+
+/* Ring, indexed by samples since arming */
+static uint8_t ring[CAPTURE_RING_SIZE][3];
+static uint32_t written;
+static uint32_t window_start;
+static enum capture_source pending;	/* Trigger for the next sample */
+
+/* Handed on to the pipeline */
+static struct sample latest;
+static bool fresh;
+
+/* Upload */
+static bool uploading;
+static uint16_t upload_next;
+
+static void ring_put(uint32_t index, int32_t pressure) {
+  uint8_t* p = ring[index & RING_MASK];
+
+  p[0] = pressure & 0xFF;
+  p[1] = (pressure >> 8) & 0xFF;
+  p[2] = (pressure >> 16) & 0xFF;
+}
+static int32_t ring_get(uint32_t index) {
+  uint8_t* p = ring[index & RING_MASK];
+
+  return p[0] | (p[1] << 8) | (p[2] << 16);
+}
+
+/**
+ * Sets the status characteristic, and notifies it if the client has
+ * asked for that
+ */
+void capture_report(void) {
+  uint32_t err_code;
+
+  if (capture_ess == NULL) return;
+
+  err_code = ble_ess_char_update(capture_ess, status_handles,
+                                 (uint8_t*)&status, sizeof(status),
+                                 BLE_GATT_HVX_NOTIFICATION);
+  telemetry_hvx_result(err_code);
+
+  /* The value is set even if it can't be sent now */
+  if (err_code != NRF_SUCCESS &&
+      err_code != BLE_ERROR_NO_TX_BUFFERS &&
+      err_code != NRF_ERROR_INVALID_STATE &&
+      err_code != BLE_ERROR_INVALID_CONN_HANDLE &&
+      err_code != BLE_ERROR_GATTS_SYS_ATTR_MISSING) {
+    APP_ERROR_HANDLER(err_code);
+  }
+}
+
+/* -----------------------------------------------------------------------------
+ * Sampling
+ */
+
+static void sampling_stop(void) {
+  app_timer_stop(sample_timer_id);
+  app_timer_stop(conv_timer_id);
+  converting = false;
+  fresh = false;
+}
+/**
+ * Stops sampling and holds the window around the trigger
+ */
+static void freeze(void) {
+  sampling_stop();
+
+  status.state = CAPTURE_FROZEN;
+  capture_report();
+}
+/**
+ * Marks the sample at index as the trigger. Up to the configured
+ * number of samples before it go in the window, as many as there are.
+ */
+static void trigger(uint32_t index, const struct sample* s) {
+  uint32_t pre = (index < status.config.pre) ? index : status.config.pre;
+
+  window_start = index - pre;
+
+  status.state = CAPTURE_TRIGGERED;
+  status.source = pending;
+  status.count = pre + status.config.post;
+  status.temperature = s->temperature;
+  status.timestamp = s->timestamp;
+  status.triggers++;
+  pending = CAPTURE_SOURCE_NONE;
+
+  capture_report();
+}
+/**
+ * Adds a compensated sample to the ring
+ */
+static void sample_add(const struct sample* s) {
+  ring_put(written, s->pressure);
+
+  if (status.state == CAPTURE_ARMED) {
+    if (pending == CAPTURE_SOURCE_NONE && status.config.threshold &&
+        written >= CAPTURE_RATE_SPAN &&
+        abs(s->pressure - ring_get(written - CAPTURE_RATE_SPAN)) >= status.config.threshold) {
+      pending = CAPTURE_SOURCE_RATE;
+    }
+    if (pending != CAPTURE_SOURCE_NONE) {
+      trigger(written, s);
+    }
+  }
+  written++;
+
+  latest = *s;
+  fresh = true;
+
+  if (status.state == CAPTURE_TRIGGERED &&
+      written - window_start >= status.count) {
+    freeze();
+  }
+}
+
+/**
+ * Called when a conversion should have finished. Reads it, and starts
+ * the pressure conversion after a temperature one
+ */
+static void conv_timeout_handler(void* p_context) {
+  struct sample s;
+
+  if (!converting) return;
+
+  /* Disarmed while converting. The sensor is free now this one is done */
+  if (!capture_sampling()) {
+    converting = false;
+    stream_sensor_free();
+    return;
+  }
+
+  if (converting_temperature) {
+    ut = bmp180_read_ut();
+
+    converting_temperature = false;
+    bmp180_start_pressure(oss);
+    APP_ERROR_CHECK(app_timer_start(conv_timer_id,
+                                    APP_TIMER_US_TO_TICKS(bmp180_pressure_delay(oss)),
+                                    NULL));
+    return;
+  }
+
+  app_timer_cnt_get(&s.timestamp);
+  s.ut = ut;
+  s.up = bmp180_read_up(oss);
+  s.oss = oss;
+  s.flags = bmp180_twi_error() ? SAMPLE_FLAG_TWI_ERROR : 0;
+
+  bmp180_compensate(&s);
+  telemetry_inc(TELEMETRY_SAMPLES);
+
+  /* A bad read holds the last value, so the window keeps its timing.
+   * The pipeline still sees it as bad. */
+  if (validate_check(&s) && written) {
+    s.pressure = latest.pressure;
+    s.temperature = latest.temperature;
+  }
+
+  converting = false;
+  sample_add(&s);
+}
+/**
+ * Starts the conversions for the next sample. If the last one hasn't
+ * finished, or an on demand read has the sensor, this one is skipped.
+ */
+static void sample_timeout_handler(void* p_context) {
+  uint32_t delay;
+
+  if (converting || convert_busy()) return;
+
+  converting = true;
+  (void)bmp180_twi_error();
+
+  if (decimate == 0) {
+    decimate = CAPTURE_TEMPERATURE_DECIMATION;
+    converting_temperature = true;
+
+    bmp180_start_temperature();
+    delay = APP_TIMER_US_TO_TICKS(BMP180_TEMPERATURE_DELAY);
+  } else {
+    decimate--;
+    converting_temperature = false;
+
+    bmp180_start_pressure(oss);
+    delay = APP_TIMER_US_TO_TICKS(bmp180_pressure_delay(oss));
+  }
+
+  APP_ERROR_CHECK(app_timer_start(conv_timer_id, delay, NULL));
+}
+
+/* -----------------------------------------------------------------------------
+ * Control
+ */
+
+/**
+ * Starts sampling into an empty ring, with a new config if one is
+ * given. Any frozen window is dropped. Returns false if the config
+ * doesn't make sense or the stream has the sensor.
+ */
+bool capture_arm(const struct capture_config* p_config) {
+  if (stream_active()) return false;
+
+  if (p_config) {
+    if (p_config->period < CAPTURE_PERIOD_MIN || p_config->period > CAPTURE_PERIOD_MAX ||
+        p_config->post == 0 ||
+        (uint32_t)p_config->pre + p_config->post > CAPTURE_RING_SIZE) {
+      return false;
+    }
+    status.config = *p_config;
+  }
+
+  sampling_stop();
+  uploading = false;
+
+  oss = control_settings()->oss;
+  if (oss > CAPTURE_OSS_MAX) oss = CAPTURE_OSS_MAX;
+
+  written = 0;
+  pending = CAPTURE_SOURCE_NONE;
+  decimate = 0;			/* Start with a temperature */
+
+  status.state = CAPTURE_ARMED;
+  status.count = 0;
+
+  APP_ERROR_CHECK(app_timer_start(sample_timer_id,
+                                  APP_TIMER_TICKS(status.config.period, APP_TIMER_PRESCALER),
+                                  NULL));
+  capture_report();
+  return true;
+}
+/**
+ * Stops sampling without a trigger. A frozen window is kept. A
+ * conversion under way is left to finish, see capture_converting.
+ */
+void capture_disarm(void) {
+  if (!capture_sampling()) return;
+
+  app_timer_stop(sample_timer_id);
+  fresh = false;
+  status.state = CAPTURE_IDLE;
+  capture_report();
+}
+/**
+ * Triggers on the next sample, if armed
+ */
+void capture_trigger(enum capture_source source) {
+  if (status.state == CAPTURE_ARMED && pending == CAPTURE_SOURCE_NONE) {
+    pending = source;
+  }
+}
+bool capture_sampling(void) {
+  return (status.state == CAPTURE_ARMED || status.state == CAPTURE_TRIGGERED);
+}
+/**
+ * True while a conversion has the sensor, which can run on after
+ * disarming
+ */
+bool capture_converting(void) {
+  return converting;
+}
+/**
+ * Returns the newest sample, once, while sampling
+ */
+bool capture_latest(struct sample* s) {
+  if (!fresh) return false;
+
+  *s = latest;
+  fresh = false;
+  return true;
+}
+const struct capture_status* capture_status(void) {
+  return &status;
+}
+void capture_init(void) {
+  status.config = defaults;
+
+  APP_ERROR_CHECK(app_timer_create(&sample_timer_id,
+                                   APP_TIMER_MODE_REPEATED,
+                                   sample_timeout_handler));
+  APP_ERROR_CHECK(app_timer_create(&conv_timer_id,
+                                   APP_TIMER_MODE_SINGLE_SHOT,
+                                   conv_timeout_handler));
+}
+
+/* -----------------------------------------------------------------------------
+ * Upload
+ */
+
+/**
+ * Sends window packets while there are free TX buffers. The rest
+ * follow as buffers are freed.
+ */
+static void upload_flush(void) {
+  uint8_t packet[CAPTURE_PACKET_SIZE];
+  uint32_t err_code;
+  uint16_t n, i;
+  int32_t pressure;
+
+  while (uploading) {
+    n = status.count - upload_next;
+    if (n == 0) {
+      uploading = false;
+      break;
+    }
+    if (n > CAPTURE_SAMPLES_PER_PACKET) n = CAPTURE_SAMPLES_PER_PACKET;
+
+    packet[0] = upload_next & 0xFF;
+    packet[1] = upload_next >> 8;
+    for (i = 0; i < n; i++) {
+      pressure = ring_get(window_start + upload_next + i);
+      packet[2 + (3 * i)] = pressure & 0xFF;
+      packet[3 + (3 * i)] = (pressure >> 8) & 0xFF;
+      packet[4 + (3 * i)] = (pressure >> 16) & 0xFF;
+    }
+
+    err_code = ble_ess_char_update(capture_ess, data_handles, packet, 2 + (3 * n),
+                                   BLE_GATT_HVX_NOTIFICATION);
+    telemetry_hvx_result(err_code);
+
+    if (err_code == NRF_SUCCESS) {
+      upload_next += n;
+    } else if (err_code == BLE_ERROR_NO_TX_BUFFERS) {
+      break;
+    } else if (err_code == NRF_ERROR_INVALID_STATE ||
+               err_code == BLE_ERROR_INVALID_CONN_HANDLE ||
+               err_code == BLE_ERROR_GATTS_SYS_ATTR_MISSING) {
+      /* Nobody to send to */
+      uploading = false;
+    } else {
+      APP_ERROR_HANDLER(err_code);
+    }
+  }
+}
+/**
+ * Sends the frozen window, from the start. Returns false if there
+ * isn't one.
+ */
+bool capture_upload(void) {
+  if (status.state != CAPTURE_FROZEN || capture_ess == NULL) return false;
+
+  uploading = true;
+  upload_next = 0;
+  upload_flush();
+
+  return true;
+}
+
+void capture_on_ble_evt(ble_evt_t* p_ble_evt) {
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_DISCONNECTED:
+      uploading = false;
+      break;
+    case BLE_EVT_TX_COMPLETE:
+      upload_flush();
+      break;
+    default:
+      break;
+  }
+}
+void capture_gatt_init(ble_ess_t* p_ess, ble_gatts_char_handles_t* p_status_handles,
+                       ble_gatts_char_handles_t* p_data_handles) {
+  capture_ess = p_ess;
+  status_handles = p_status_handles;
+  data_handles = p_data_handles;
+}
@@ -0,0 +1,282 @@
+/*
+ * Persistent configuration
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Keeps the settings that can be tuned for each unit in flash, and
+ * loads them into RAM once at boot. Modules read them straight from
+ * there, so nothing is read from flash after that.
+ *
+ * There are two copies in flash, each with a sequence number and a
+ * CRC. A change is always written over the older copy, so if the
+ * write is cut short the newer one is still there to boot from. An
+ * update erases the whole page, so each copy is registered on its own
+ * to get a page to itself. The
+ * newest copy that checks out wins, and the defaults are used if
+ * neither does.
+ *
+ * Fields are only ever added to the end of struct config. A record
+ * from older firmware is read over the defaults, so the new fields
+ * start at their defaults, and newer firmware's extra fields are
+ * ignored. CONFIG_VERSION only goes up when a field changes meaning,
+ * and then the old records are left alone.
+ *
+ * Flash writes finish in the background. The record being written
+ * stays in RAM until they do, and a change made in the meantime is
+ * written once the first one is done.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_util.h"
+#include "ble.h"
+#include "pstorage.h"
+#include "crc16.h"
+#include "bmp180.h"
+#include "adapt.h"
+#include "advertising.h"
+#include "power.h"
+#include "telemetry.h"
+#include "config.h"
+
+/**
+ * Room for the record to grow into. Each copy gets a block, in a page
+ * of its own.
+ */
+#define CONFIG_BLOCK_SIZE	64
+#define CONFIG_COPIES		2
+
+/**
+ * Connection parameters to ask for by default
+ */
+#define DEFAULT_MIN_CONN_INTERVAL	MSEC_TO_UNITS(500, UNIT_1_25_MS)
+#define DEFAULT_MAX_CONN_INTERVAL	MSEC_TO_UNITS(1000, UNIT_1_25_MS)
+#define DEFAULT_SLAVE_LATENCY		0
+#define DEFAULT_CONN_SUP_TIMEOUT	MSEC_TO_UNITS(4000, UNIT_10_MS)
+
+/**
+ * As stored. The CRC covers the rest of the header, and size bytes of
+ * config, which can run on past the end of ours in a record from
+ * newer firmware.
+ */
+struct record {
+  uint16_t version;
+  uint16_t size;		/* Of the config that follows */
+  uint32_t sequence;		/* The newer copy has the higher */
+  uint16_t reserved;
+  uint16_t crc;
+  struct config config;
+};
+#define CONFIG_SIZE_MAX		(CONFIG_BLOCK_SIZE - offsetof(struct record, config))
+
+static struct config current;
+static struct record pending;	/* Until the write is done */
+static pstorage_handle_t blocks[CONFIG_COPIES];
+static uint32_t sequence;	/* Of the newest record */
+static uint8_t newest;		/* The copy holding it */
+static bool newest_valid;
+static uint8_t target;		/* The copy being written */
+static bool writing;
+static bool dirty;		/* Changed since the write started */
+
+static uint16_t record_crc(const struct record* r) {
+  uint16_t crc = crc16_compute((const uint8_t*)r, offsetof(struct record, crc), NULL);
+
+  return crc16_compute((const uint8_t*)&r->config, r->size, &crc);
+}
+
+/**
+ * Writes the current config over the older copy
+ */
+static void store(void) {
+  target = newest_valid ? (newest + 1) % CONFIG_COPIES : 0;
+
+  pending.version = CONFIG_VERSION;
+  pending.size = sizeof(struct config);
+  pending.sequence = newest_valid ? sequence + 1 : 0;
+  pending.reserved = 0;
+  pending.config = current;
+  pending.crc = record_crc(&pending);
+
+  APP_ERROR_CHECK(pstorage_update(&blocks[target], (uint8_t*)&pending, sizeof(pending), 0));
+  writing = true;
+  dirty = false;
+}
+static void pstorage_cb_handler(pstorage_handle_t* p_handle, uint8_t op_code,
+                                uint32_t result, uint8_t* p_data, uint32_t data_len) {
+  if (op_code != PSTORAGE_UPDATE_OP_CODE) return;
+
+  writing = false;
+  if (result == NRF_SUCCESS) {
+    sequence = pending.sequence;
+    newest = target;
+    newest_valid = true;
+    telemetry_inc(TELEMETRY_CONFIG_STORES);
+  } else {
+    /* The other copy is untouched, try again */
+    dirty = true;
+  }
+
+  if (dirty) store();
+}
+
+/**
+ * The build time settings, with the sampling and advertising from the
+ * build time power profile
+ */
+static void defaults(struct config* c) {
+  memset(c, 0, sizeof(*c));
+  c->power_profile = POWER_PROFILE;
+  power_preset(POWER_PROFILE, c);
+  c->adv_fast_interval = ADV_FAST_INTERVAL;
+  c->adv_fast_timeout = ADV_FAST_TIMEOUT;
+  c->min_conn_interval = DEFAULT_MIN_CONN_INTERVAL;
+  c->max_conn_interval = DEFAULT_MAX_CONN_INTERVAL;
+  c->slave_latency = DEFAULT_SLAVE_LATENCY;
+  c->conn_sup_timeout = DEFAULT_CONN_SUP_TIMEOUT;
+}
+
+/**
+ * Returns true if every field is in range for the stack and the
+ * modules that use it
+ */
+bool config_check(const struct config* c) {
+  if (c->power_profile >= POWER_PROFILE_COUNT ||
+      c->oss > BMP180_OSS_MAX) {
+    return false;
+  }
+  if (c->sample_period < ADAPT_PERIOD_MIN || c->sample_period > ADAPT_PERIOD_MAX ||
+      (c->sample_period_min != 0 &&
+       (c->sample_period_min < ADAPT_PERIOD_MIN || c->sample_period_min > c->sample_period))) {
+    return false;
+  }
+  if (c->adv_interval < BLE_GAP_ADV_INTERVAL_MIN || c->adv_interval > BLE_GAP_ADV_INTERVAL_MAX ||
+      c->adv_fast_interval < BLE_GAP_ADV_INTERVAL_MIN ||
+      c->adv_fast_interval > BLE_GAP_ADV_INTERVAL_MAX ||
+      c->adv_fast_timeout == 0 || c->adv_fast_timeout > BLE_GAP_ADV_TIMEOUT_LIMITED_MAX) {
+    return false;
+  }
+  /* The supervision timeout has to cover two missed intervals */
+  if (c->min_conn_interval < BLE_GAP_CP_MIN_CONN_INTVL_MIN ||
+      c->max_conn_interval > BLE_GAP_CP_MAX_CONN_INTVL_MAX ||
+      c->min_conn_interval > c->max_conn_interval ||
+      c->conn_sup_timeout < BLE_GAP_CP_CONN_SUP_TIMEOUT_MIN ||
+      c->conn_sup_timeout > BLE_GAP_CP_CONN_SUP_TIMEOUT_MAX ||
+      4 * (uint32_t)c->conn_sup_timeout <=
+      (1 + (uint32_t)c->slave_latency) * c->max_conn_interval) {
+    return false;
+  }
+
+  return true;
+}
+/**
+ * Takes a new config, and writes it to flash if it changed. Returns
+ * NRF_ERROR_INVALID_PARAM if it isn't valid, and then nothing
+ * changes. The modules pick it up from wherever they read it.
+ */
+uint32_t config_set(const struct config* c) {
+  if (!config_check(c)) return NRF_ERROR_INVALID_PARAM;
+  if (memcmp(c, &current, sizeof(current)) == 0) return NRF_SUCCESS;
+
+  current = *c;
+
+  if (writing) {
+    dirty = true;
+  } else {
+    store();
+  }
+
+  return NRF_SUCCESS;
+}
+const struct config* config(void) {
+  return &current;
+}
+/**
+ * The connection parameters to ask for
+ */
+void config_conn_params(ble_gap_conn_params_t* p_conn_params) {
+  p_conn_params->min_conn_interval = current.min_conn_interval;
+  p_conn_params->max_conn_interval = current.max_conn_interval;
+  p_conn_params->slave_latency = current.slave_latency;
+  p_conn_params->conn_sup_timeout = current.conn_sup_timeout;
+}
+
+/**
+ * Reads the newest good copy from flash, or goes back to the defaults
+ * if there isn't one. Flash is memory mapped, so this can be called
+ * before the SoftDevice is enabled.
+ */
+void config_load(void) {
+  union {
+    struct record r;
+    uint8_t raw[CONFIG_BLOCK_SIZE];
+  } block;
+  struct config c;
+  uint8_t i;
+
+  defaults(&current);
+  newest_valid = false;
+
+  for (i = 0; i < CONFIG_COPIES; i++) {
+    APP_ERROR_CHECK(pstorage_load(block.raw, &blocks[i], sizeof(block.raw), 0));
+
+    if (block.r.version != CONFIG_VERSION || block.r.size > CONFIG_SIZE_MAX ||
+        block.r.crc != record_crc(&block.r)) {
+      continue;
+    }
+    if (newest_valid && (int32_t)(block.r.sequence - sequence) <= 0) continue;
+
+    /* Anything past the end of ours is for newer firmware */
+    defaults(&c);
+    memcpy(&c, &block.r.config, (block.r.size < sizeof(c)) ? block.r.size : sizeof(c));
+    if (!config_check(&c)) continue;
+
+    current = c;
+    sequence = block.r.sequence;
+    newest = i;
+    newest_valid = true;
+  }
+}
+/**
+ * Registers the copies with pstorage, which has to have been
+ * initialised, and starts from the defaults. Each registration gets
+ * its own page.
+ */
+void config_init(void) {
+  pstorage_module_param_t param;
+  uint8_t i;
+
+  param.cb = pstorage_cb_handler;
+  param.block_size = CONFIG_BLOCK_SIZE;
+  param.block_count = 1;
+  for (i = 0; i < CONFIG_COPIES; i++) {
+    APP_ERROR_CHECK(pstorage_register(&param, &blocks[i]));
+  }
+
+  defaults(&current);
+}
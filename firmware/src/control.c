@@ -0,0 +1,304 @@
+/*
+ * Sampling control point
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Changes the sampling on the fly: the sample period, oversampling,
+ * how often the temperature is converted, the filter model and
+ * whether samples are notified. A client can switch between low
+ * power and high rate operation without touching the stored config.
+ * The flight detector's thresholds are set here too, and it can be
+ * made to wait for a launch again.
+ *
+ * Every command in a write is checked before any of it is applied,
+ * so a write either takes effect whole or not at all. Writes arrive
+ * from a SoftDevice event, at the same priority as the measurement
+ * tick, so they land between two samples. The oversampling and
+ * temperature settings are picked up by the next sample, the filter
+ * model by the next sample through the filter stage, and a new
+ * period re-arms the tick from when the last one was due, so no
+ * tick is lost or doubled. The adaptive sampler is only restarted if
+ * the period changed.
+ *
+ * Each write is answered with an indication holding the result and
+ * the settings then in effect. The settings and thresholds last until
+ * the config or power profile changes, which replaces them with the
+ * config's and the detector's defaults.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_util.h"
+#include "ble.h"
+#include "ble_ess.h"
+#include "bmp180.h"
+#include "adapt.h"
+#include "vario.h"
+#include "flight.h"
+#include "config.h"
+#include "control.h"
+
+/**
+ * Each command is an opcode and a length before its value
+ */
+#define COMMAND_HEADER		2
+
+/**
+ * What a write would change, built up one command at a time
+ */
+struct changes {
+  struct control_settings settings;
+  struct flight_config flight;
+  bool flight_reset;
+};
+
+static struct control_settings settings;
+static struct control_response response = { .result = CONTROL_RESULT_SUCCESS };
+static bool unreported;		/* response is waiting to be indicated */
+
+static ble_ess_t* control_ess;
+static ble_gatts_char_handles_t* control_handles;
+
+/**
+ * The settings from the config, and the defaults for the rest
+ */
+static void defaults(struct control_settings* s) {
+  const struct config* c = config();
+
+  s->sample_period = c->sample_period;
+  s->sample_period_min = c->sample_period_min;
+  s->oss = c->oss;
+  s->temperature_decimation = 1;
+  s->filter = VARIO_MODEL_BALLOON;
+  s->report = CONTROL_REPORT_NOTIFY;
+}
+/**
+ * Puts new settings into effect. They have already been checked.
+ */
+static void apply(const struct control_settings* s) {
+  struct adapt_config sampling;
+
+  bmp180_set_oss(s->oss);
+  bmp180_set_temperature_decimation(s->temperature_decimation);
+  vario_set_model((enum vario_model)s->filter);
+  if (control_ess) {
+    ble_ess_notify_set(control_ess, s->report == CONTROL_REPORT_NOTIFY);
+  }
+
+  if (s->sample_period != settings.sample_period ||
+      s->sample_period_min != settings.sample_period_min) {
+    sampling.min_period = s->sample_period_min;
+    sampling.max_period = s->sample_period;
+    (void)adapt_configure(&sampling);
+  }
+
+  settings = *s;
+}
+/**
+ * Applies a single command to c, returning a control_result
+ */
+static uint8_t command(struct changes* c, uint8_t opcode,
+                       const uint8_t* p_value, uint8_t len) {
+  struct control_settings* s = &c->settings;
+  struct flight_config* f = &c->flight;
+  struct adapt_config sampling;
+
+  switch (opcode) {
+    case CONTROL_OP_DEFAULTS:
+      if (len != 0) return CONTROL_RESULT_INVALID_PARAMETER;
+      defaults(s);
+      *f = *flight_defaults();
+      break;
+    case CONTROL_OP_SAMPLE_PERIOD:
+      if (len != 2 * sizeof(uint16_t)) return CONTROL_RESULT_INVALID_PARAMETER;
+      sampling.max_period = uint16_decode(&p_value[0]);
+      sampling.min_period = uint16_decode(&p_value[2]);
+      if (!adapt_check(&sampling)) return CONTROL_RESULT_INVALID_PARAMETER;
+      s->sample_period = sampling.max_period;
+      s->sample_period_min = sampling.min_period;
+      break;
+    case CONTROL_OP_OSS:
+      if (len != 1 || p_value[0] > BMP180_OSS_MAX) return CONTROL_RESULT_INVALID_PARAMETER;
+      s->oss = p_value[0];
+      break;
+    case CONTROL_OP_TEMPERATURE_DECIMATION:
+      if (len != 1 || p_value[0] == 0 || p_value[0] > BMP180_TEMPERATURE_DECIMATION_MAX) {
+        return CONTROL_RESULT_INVALID_PARAMETER;
+      }
+      s->temperature_decimation = p_value[0];
+      break;
+    case CONTROL_OP_FILTER:
+      if (len != 1 || p_value[0] >= VARIO_MODEL_COUNT) return CONTROL_RESULT_INVALID_PARAMETER;
+      s->filter = p_value[0];
+      break;
+    case CONTROL_OP_REPORT:
+      if (len != 1 || p_value[0] >= CONTROL_REPORT_COUNT) return CONTROL_RESULT_INVALID_PARAMETER;
+      s->report = p_value[0];
+      break;
+    case CONTROL_OP_FLIGHT_LAUNCH:
+      if (len != 3 * sizeof(uint16_t)) return CONTROL_RESULT_INVALID_PARAMETER;
+      f->launch_climb = (int16_t)uint16_decode(&p_value[0]);
+      f->launch_height = uint16_decode(&p_value[2]);
+      f->launch_hold = uint16_decode(&p_value[4]);
+      break;
+    case CONTROL_OP_FLIGHT_APOGEE:
+      if (len != 2 * sizeof(uint16_t)) return CONTROL_RESULT_INVALID_PARAMETER;
+      f->apogee_drop = uint16_decode(&p_value[0]);
+      f->apogee_hold = uint16_decode(&p_value[2]);
+      break;
+    case CONTROL_OP_FLIGHT_DESCENT:
+      if (len != 3 * sizeof(uint16_t)) return CONTROL_RESULT_INVALID_PARAMETER;
+      f->descent_min = (int16_t)uint16_decode(&p_value[0]);
+      f->descent_max = (int16_t)uint16_decode(&p_value[2]);
+      f->descent_hold = uint16_decode(&p_value[4]);
+      break;
+    case CONTROL_OP_FLIGHT_LANDING:
+      if (len != 2 * sizeof(uint16_t)) return CONTROL_RESULT_INVALID_PARAMETER;
+      f->landing_climb = (int16_t)uint16_decode(&p_value[0]);
+      f->landing_hold = uint16_decode(&p_value[2]);
+      break;
+    case CONTROL_OP_FLIGHT_RESET:
+      if (len != 0) return CONTROL_RESULT_INVALID_PARAMETER;
+      c->flight_reset = true;
+      break;
+    default:
+      return CONTROL_RESULT_OPCODE_UNSUPPORTED;
+  }
+
+  /* Each threshold alone may be fine, but not with the others */
+  if (!flight_check(f)) return CONTROL_RESULT_INVALID_PARAMETER;
+
+  return CONTROL_RESULT_SUCCESS;
+}
+
+/**
+ * Replaces the settings with the config's, and the thresholds with the
+ * detector's defaults. Called whenever the config or power profile is
+ * applied.
+ */
+void control_reset(void) {
+  struct control_settings s;
+
+  defaults(&s);
+  settings.sample_period = 0;	/* So the sampling always starts afresh */
+  apply(&s);
+  (void)flight_configure(flight_defaults());
+
+  response.settings = settings;
+}
+const struct control_settings* control_settings(void) {
+  return &settings;
+}
+/**
+ * Handles a write to the control point. The commands are tried on a
+ * copy of the settings and thresholds, which is only applied if all
+ * of them work.
+ */
+void control_write(const uint8_t* p_data, uint16_t len) {
+  struct changes c = { .settings = settings, .flight = *flight_config(), .flight_reset = false };
+  uint8_t result = CONTROL_RESULT_SUCCESS;
+  uint8_t opcode = 0;
+  uint16_t i = 0;
+
+  while (i < len) {
+    opcode = p_data[i];
+
+    if (i + COMMAND_HEADER > len ||
+        i + COMMAND_HEADER + p_data[i + 1] > len) {
+      result = CONTROL_RESULT_INVALID_PARAMETER;
+      break;
+    }
+
+    result = command(&c, opcode, &p_data[i + COMMAND_HEADER], p_data[i + 1]);
+    if (result != CONTROL_RESULT_SUCCESS) break;
+
+    i += COMMAND_HEADER + p_data[i + 1];
+  }
+
+  if (result == CONTROL_RESULT_SUCCESS) {
+    apply(&c.settings);
+    (void)flight_configure(&c.flight);
+    if (c.flight_reset) flight_reset();
+    opcode = 0;
+  }
+
+  response.result = result;
+  response.opcode = opcode;
+  response.settings = settings;
+  unreported = true;
+
+  control_report();
+}
+
+/* -----------------------------------------------------------------------------
+ * GATT
+ */
+
+const struct control_response* control_response(void) {
+  return &response;
+}
+/**
+ * Indicates the answer to the last write, if it hasn't been already
+ */
+void control_report(void) {
+  uint32_t err_code;
+
+  if (control_ess == NULL || !unreported) return;
+
+  err_code = ble_ess_char_update(control_ess, control_handles,
+                                 (uint8_t*)&response, sizeof(response),
+                                 BLE_GATT_HVX_INDICATION);
+
+  if (err_code == NRF_SUCCESS) {
+    unreported = false;
+  } else if (err_code != NRF_ERROR_BUSY &&
+             err_code != NRF_ERROR_INVALID_STATE &&
+             err_code != BLE_ERROR_INVALID_CONN_HANDLE &&
+             err_code != BLE_ERROR_GATTS_SYS_ATTR_MISSING) {
+    APP_ERROR_HANDLER(err_code);
+  }
+  /* Otherwise try again once the last indication is confirmed, or the
+   * client subscribes */
+}
+void control_on_ble_evt(ble_evt_t* p_ble_evt) {
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GATTS_EVT_HVC:
+      control_report();
+      break;
+    case BLE_GAP_EVT_DISCONNECTED:
+      /* The answer was for the client that wrote */
+      unreported = false;
+      break;
+    default:
+      break;
+  }
+}
+void control_gatt_init(ble_ess_t* p_ess, ble_gatts_char_handles_t* p_handles) {
+  control_ess = p_ess;
+  control_handles = p_handles;
+
+  ble_ess_notify_set(control_ess, settings.report == CONTROL_REPORT_NOTIFY);
+}
@@ -0,0 +1,107 @@
+/*
+ * Asynchronous BMP180 conversion
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Takes a single temperature and pressure measurement without busy
+ * waiting. Each conversion is waited for with a single-shot app_timer,
+ * and the handler is called from the timer context with the
+ * compensated sample. A stream waiting for the sensor starts once the
+ * handler has answered.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "bmp180.h"
+#include "pipeline.h"
+#include "stream.h"
+#include "telemetry.h"
+#include "main.h"
+#include "convert.h"
+
+static app_timer_id_t conv_timer_id;
+static convert_handler_t conv_handler;
+static struct sample conv_sample;
+static bool converting_temperature;
+
+static void conv_timeout_handler(void* p_context) {
+  convert_handler_t handler;
+
+  if (converting_temperature) {
+    conv_sample.ut = bmp180_read_ut();
+
+    converting_temperature = false;
+    bmp180_start_pressure(conv_sample.oss);
+    APP_ERROR_CHECK(app_timer_start(conv_timer_id,
+                                    APP_TIMER_US_TO_TICKS(bmp180_pressure_delay(conv_sample.oss)),
+                                    NULL));
+  } else {
+    conv_sample.up = bmp180_read_up(conv_sample.oss);
+    if (bmp180_twi_error()) {
+      conv_sample.flags |= SAMPLE_FLAG_TWI_ERROR;
+    }
+    bmp180_compensate(&conv_sample);
+    telemetry_inc(TELEMETRY_SAMPLES);
+
+    /* Free for another conversion before the handler runs */
+    handler = conv_handler;
+    conv_handler = NULL;
+    handler(&conv_sample);
+
+    /* A stream may have been waiting for the sensor */
+    stream_sensor_free();
+  }
+}
+
+/**
+ * Starts a measurement. Returns false if one is already running
+ */
+bool convert_start(uint8_t oss, convert_handler_t handler) {
+  if (conv_handler) return false;
+
+  conv_handler = handler;
+  app_timer_cnt_get(&conv_sample.timestamp);
+  conv_sample.oss = oss;
+  conv_sample.flags = 0;
+  (void)bmp180_twi_error();
+
+  converting_temperature = true;
+  bmp180_start_temperature();
+  APP_ERROR_CHECK(app_timer_start(conv_timer_id,
+                                  APP_TIMER_US_TO_TICKS(BMP180_TEMPERATURE_DELAY),
+                                  NULL));
+  return true;
+}
+bool convert_busy(void) {
+  return (conv_handler != NULL);
+}
+
+void convert_init(void) {
+  APP_ERROR_CHECK(app_timer_create(&conv_timer_id,
+                                   APP_TIMER_MODE_SINGLE_SHOT,
+                                   conv_timeout_handler));
+}
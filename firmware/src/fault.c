@@ -0,0 +1,260 @@
+/*
+ * Fault records and fast recovery
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * On an error or hard fault we note what happened in a small ring in
+ * .noinit and reset straight away, rather than waiting for someone to
+ * power cycle the unit. The ring survives the reset and is reported
+ * over GATT once a client subscribes to it.
+ *
+ * If the unit keeps faulting soon after boot it comes up in safe
+ * mode, with the build-time power profile and without the sensor, so
+ * there is still a chance to connect and find out why. Staying up for
+ * FAULT_STABLE_TIMEOUT clears the count again.
+ *
+ * Nothing in the fault path calls into the SoftDevice, an SVC from
+ * the hard fault handler would lock up.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nrf.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "ble.h"
+#include "ble_ess.h"
+#include "telemetry.h"
+#include "main.h"
+#include "fault.h"
+
+#define FAULT_MAGIC		0x464C5452U /* 'FLTR' */
+
+/**
+ * A fault this soon after boot counts towards safe mode
+ */
+#define FAULT_QUICK_UPTIME	10	/* s */
+#define FAULT_QUICK_LIMIT	3
+#define FAULT_STABLE_TIMEOUT	APP_TIMER_TICKS(30000, APP_TIMER_PRESCALER)
+
+/**
+ * Kept over soft resets
+ */
+static struct {
+  uint32_t magic;
+  struct fault_record ring[FAULT_RING_SIZE];
+  uint8_t head;			/* Next record to write */
+  uint8_t count;
+  uint8_t unreported;
+  uint8_t quick;		/* Quick faults in a row */
+  uint32_t magic_inv;
+} retained __attribute__((section(".noinit")));
+
+static bool safe_mode;
+static app_timer_id_t stable_timer_id;
+static ble_ess_t* fault_ess;
+static ble_gatts_char_handles_t* fault_handles;
+
+/**
+ * Clears the ring if it doesn't look like ours
+ */
+static void ring_check(bool power_on) {
+  if (power_on ||
+      retained.magic != FAULT_MAGIC ||
+      retained.magic_inv != ~FAULT_MAGIC ||
+      retained.head >= FAULT_RING_SIZE ||
+      retained.count > FAULT_RING_SIZE ||
+      retained.unreported > retained.count) {
+    memset(&retained, 0, sizeof(retained));
+    retained.magic = FAULT_MAGIC;
+    retained.magic_inv = ~FAULT_MAGIC;
+  }
+}
+/**
+ * 32-bit FNV-1a, so the file can be looked up from a hash of the
+ * same path on the host
+ */
+static uint32_t fnv1a(const uint8_t* s) {
+  uint32_t hash = 2166136261U;
+
+  if (s == NULL) return 0;
+
+  while (*s) {
+    hash ^= *s++;
+    hash *= 16777619U;
+  }
+
+  return hash;
+}
+static void fault_record(uint32_t code, uint32_t line, uint32_t file_hash,
+                         uint32_t pc, uint32_t lr) {
+  struct fault_record* r;
+
+  ring_check(false);
+
+  r = &retained.ring[retained.head];
+  r->code = (uint16_t)code;
+  r->line = (uint16_t)line;
+  r->file_hash = file_hash;
+  r->pc = pc;
+  r->lr = lr;
+  r->uptime = telemetry_uptime();
+
+  retained.head = (retained.head + 1) % FAULT_RING_SIZE;
+  if (retained.count < FAULT_RING_SIZE) retained.count++;
+  if (retained.unreported < FAULT_RING_SIZE) retained.unreported++;
+
+  if (r->uptime < FAULT_QUICK_UPTIME) {
+    if (retained.quick < UINT8_MAX) retained.quick++;
+  } else {
+    retained.quick = 0;
+  }
+}
+
+/**
+ * Records an error and resets. Called from app_error_handler with the
+ * address it was called from.
+ */
+void fault_error(uint32_t error_code, uint32_t line_num,
+                 const uint8_t* p_file_name, uint32_t pc) {
+  fault_record(error_code, line_num, fnv1a(p_file_name), pc, 0);
+
+  NVIC_SystemReset();
+}
+/**
+ * Records a hard fault from the stacked exception frame and resets
+ */
+void fault_hardfault(uint32_t* frame) __attribute__((used));
+void fault_hardfault(uint32_t* frame) {
+  fault_record(FAULT_CODE_HARDFAULT, 0, 0, frame[6], frame[5]);
+
+  NVIC_SystemReset();
+}
+#ifdef __arm__
+/**
+ * Finds the stack the exception frame was pushed to and hands it to
+ * fault_hardfault
+ */
+void HardFault_Handler(void) __attribute__((naked));
+void HardFault_Handler(void) {
+  __asm volatile(
+    "  movs r0, #4           \n"
+    "  mov r1, lr            \n"
+    "  tst r0, r1            \n"
+    "  beq 1f                \n"
+    "  mrs r0, psp           \n"
+    "  b 2f                  \n"
+    "1:                      \n"
+    "  mrs r0, msp           \n"
+    "2:                      \n"
+    "  ldr r1, 3f            \n"
+    "  bx r1                 \n"
+    "  .align 2              \n"
+    "3:                      \n"
+    "  .word fault_hardfault \n");
+}
+#endif
+
+bool fault_safe_mode(void) {
+  return safe_mode;
+}
+/**
+ * Returns the most recent record, or NULL if there isn't one
+ */
+const struct fault_record* fault_latest(void) {
+  if (retained.count == 0) return NULL;
+
+  return &retained.ring[(retained.head + FAULT_RING_SIZE - 1) % FAULT_RING_SIZE];
+}
+
+/**
+ * Notifies any records the client hasn't seen yet, oldest first
+ */
+void fault_report(void) {
+  uint32_t err_code;
+  uint8_t index;
+
+  if (fault_ess == NULL) return;
+
+  while (retained.unreported) {
+    index = (retained.head + FAULT_RING_SIZE - retained.unreported) % FAULT_RING_SIZE;
+
+    err_code = ble_ess_char_update(fault_ess, fault_handles,
+                                   (uint8_t*)&retained.ring[index],
+                                   sizeof(struct fault_record),
+                                   BLE_GATT_HVX_NOTIFICATION);
+    telemetry_hvx_result(err_code);
+
+    if (err_code == NRF_SUCCESS) {
+      retained.unreported--;
+    } else if (err_code == BLE_ERROR_NO_TX_BUFFERS ||
+               err_code == NRF_ERROR_INVALID_STATE ||
+               err_code == BLE_ERROR_GATTS_SYS_ATTR_MISSING) {
+      /* Try again later */
+      break;
+    } else {
+      APP_ERROR_HANDLER(err_code);
+    }
+  }
+}
+
+void fault_on_ble_evt(ble_evt_t* p_ble_evt) {
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_EVT_TX_COMPLETE:
+      fault_report();
+      break;
+    default:
+      break;
+  }
+}
+
+static void stable_timeout_handler(void* p_context) {
+  (void)p_context;
+  retained.quick = 0;
+}
+
+/**
+ * Checks the ring and decides on safe mode. Call after
+ * telemetry_init, which has the reset reason.
+ */
+void fault_init(void) {
+  ring_check(telemetry_table()[TELEMETRY_RESET_REASON] == 0);
+
+  safe_mode = (retained.quick >= FAULT_QUICK_LIMIT);
+
+  APP_ERROR_CHECK(app_timer_create(&stable_timer_id,
+                                   APP_TIMER_MODE_SINGLE_SHOT,
+                                   stable_timeout_handler));
+}
+void fault_gatt_init(ble_ess_t* p_ess, ble_gatts_char_handles_t* p_handles) {
+  fault_ess = p_ess;
+  fault_handles = p_handles;
+}
+/**
+ * Starts timing a stable boot. Needs the low frequency clock running.
+ */
+void fault_start(void) {
+  APP_ERROR_CHECK(app_timer_start(stable_timer_id, FAULT_STABLE_TIMEOUT, NULL));
+}
@@ -0,0 +1,317 @@
+/*
+ * Flight events
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Spots launch, apogee, steady descent and landing in the altitude
+ * and climb rate from the variometer. It runs as the detect stage of
+ * the pipeline, straight after the filter, so an event is known as
+ * soon as the sample that completes it arrives.
+ *
+ * The detectors are a state machine, only looking for the events that
+ * can come next. Each has a threshold with some hysteresis built in,
+ * as a height above the pad or a drop below the highest point, and a
+ * hold time it must be met for. The pad altitude follows the ground
+ * slowly until something starts to move.
+ *
+ * Events are indicated on their characteristic immediately, oldest
+ * first, whatever the sample rate or stream are doing. One not yet
+ * confirmed when the client subscribes is sent then.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "ble_ess.h"
+#include "main.h"
+#include "flight.h"
+
+#define TICKS_PER_SECOND	APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER)
+#define RTC_COUNTER_MASK	0xFFFFFF
+
+/**
+ * Samples for the pad altitude to follow the ground, roughly
+ */
+#define GROUND_FOLLOW		8
+
+static const struct flight_config defaults = {
+  .launch_climb		= 200,
+  .launch_height	= 1000,
+  .launch_hold		= 1000,
+  .apogee_drop		= 1000,
+  .apogee_hold		= 1000,
+  .descent_min		= 200,
+  .descent_max		= 1500,
+  .descent_hold		= 3000,
+  .landing_climb	= 100,
+  .landing_hold		= 10000,
+};
+
+static struct flight_config config;
+static enum flight_state state;
+static flight_event_handler_t event_handler;
+
+static bool ground_set;
+static int32_t ground;			/* cm */
+static int32_t max_altitude;		/* cm */
+
+/**
+ * When each detector's condition started to hold
+ */
+static struct {
+  bool running;
+  uint32_t start;
+} holds[FLIGHT_EVENT_COUNT];
+
+static struct flight_record records[FLIGHT_EVENT_COUNT];
+static uint8_t unreported;		/* Bit for each event */
+static uint8_t indicated = FLIGHT_EVENT_NONE; /* Waiting for its confirmation */
+
+static ble_ess_t* flight_ess;
+static ble_gatts_char_handles_t* flight_handles;
+
+/* -----------------------------------------------------------------------------
+ * Detectors
+ */
+
+/**
+ * Returns true once condition has held for hold_ms up to timestamp
+ */
+static bool held(enum flight_event event, bool condition, uint32_t timestamp, uint16_t hold_ms) {
+  if (!condition) {
+    holds[event].running = false;
+    return false;
+  }
+  if (!holds[event].running) {
+    holds[event].running = true;
+    holds[event].start = timestamp;
+  }
+
+  return ((timestamp - holds[event].start) & RTC_COUNTER_MASK) >=
+    ((uint32_t)hold_ms * TICKS_PER_SECOND) / 1000;
+}
+static void fire(enum flight_event event, enum flight_state next, const struct sample* s) {
+  struct flight_record* r = &records[event];
+
+  state = next;
+  memset(holds, 0, sizeof(holds));
+
+  r->event = event;
+  r->state = next;
+  r->sequence = s->sequence;
+  r->altitude = s->altitude;
+  r->max_altitude = max_altitude;
+  r->climb = s->climb;
+  r->reserved = 0;
+  unreported |= (1 << event);
+
+  if (event_handler) event_handler(r);
+  flight_report();
+}
+/**
+ * Pipeline stage that runs the detectors on a filtered sample.
+ * Synthetic samples aren't flights.
+ */
+enum stage_result flight_detect_stage(struct sample* s) {
+  const struct flight_config* c = &config;
+  bool landed, descending;
+
+  if (!(s->flags & SAMPLE_FLAG_FILTERED) || (s->flags & SAMPLE_FLAG_SYNTHETIC)) {
+    return STAGE_PASS;
+  }
+
+  if (s->altitude > max_altitude) max_altitude = s->altitude;
+
+  switch (state) {
+    case FLIGHT_PAD:
+      if (!ground_set) {
+        ground = s->altitude;
+        ground_set = true;
+      }
+      if (held(FLIGHT_EVENT_LAUNCH,
+               (s->climb > c->launch_climb) &&
+               (s->altitude - ground > c->launch_height),
+               s->timestamp, c->launch_hold)) {
+        fire(FLIGHT_EVENT_LAUNCH, FLIGHT_ASCENT, s);
+      } else if (abs(s->climb) < c->launch_climb) {
+        ground += (s->altitude - ground) / GROUND_FOLLOW;
+        max_altitude = s->altitude;
+      }
+      break;
+
+    case FLIGHT_ASCENT:
+      if (held(FLIGHT_EVENT_APOGEE,
+               (s->climb < 0) &&
+               (s->altitude < max_altitude - c->apogee_drop),
+               s->timestamp, c->apogee_hold)) {
+        fire(FLIGHT_EVENT_APOGEE, FLIGHT_FALLING, s);
+      }
+      break;
+
+    case FLIGHT_FALLING:
+    case FLIGHT_DESCENT:
+      /* A fast descent may land without ever settling */
+      landed = held(FLIGHT_EVENT_LANDING, abs(s->climb) < c->landing_climb,
+                    s->timestamp, c->landing_hold);
+      descending = (state == FLIGHT_FALLING) &&
+        held(FLIGHT_EVENT_DESCENT,
+             (s->climb <= -c->descent_min) && (s->climb >= -c->descent_max),
+             s->timestamp, c->descent_hold);
+
+      if (landed) {
+        fire(FLIGHT_EVENT_LANDING, FLIGHT_LANDED, s);
+      } else if (descending) {
+        fire(FLIGHT_EVENT_DESCENT, FLIGHT_DESCENT, s);
+      }
+      break;
+
+    case FLIGHT_LANDED:
+      break;
+  }
+
+  return STAGE_PASS;
+}
+
+/* -----------------------------------------------------------------------------
+ * Configuration
+ */
+
+/**
+ * Waits for a launch from wherever we are now
+ */
+void flight_reset(void) {
+  state = FLIGHT_PAD;
+  ground_set = false;
+  max_altitude = INT32_MIN;
+  unreported = 0;
+  indicated = FLIGHT_EVENT_NONE;
+  memset(holds, 0, sizeof(holds));
+  memset(records, 0, sizeof(records));
+}
+const struct flight_config* flight_config(void) {
+  return &config;
+}
+const struct flight_config* flight_defaults(void) {
+  return &defaults;
+}
+/**
+ * True if the thresholds make sense
+ */
+bool flight_check(const struct flight_config* c) {
+  return c->launch_climb > 0 && c->descent_min > 0 &&
+    c->descent_max > c->descent_min && c->landing_climb > 0;
+}
+/**
+ * Replaces the thresholds, unless they don't make sense. Takes effect
+ * from the next sample.
+ */
+bool flight_configure(const struct flight_config* c) {
+  if (!flight_check(c)) return false;
+
+  config = *c;
+  return true;
+}
+enum flight_state flight_state(void) {
+  return state;
+}
+void flight_init(flight_event_handler_t handler) {
+  config = defaults;
+  event_handler = handler;
+  flight_reset();
+}
+
+/* -----------------------------------------------------------------------------
+ * GATT
+ */
+
+/**
+ * Indicates the oldest event the client hasn't confirmed. The rest
+ * follow as each is confirmed. An event only counts as reported once
+ * its confirmation arrives, so one lost with the link goes again.
+ */
+void flight_report(void) {
+  uint32_t err_code;
+  uint8_t event;
+
+  if (flight_ess == NULL || unreported == 0 || indicated != FLIGHT_EVENT_NONE) return;
+
+  for (event = 0; !(unreported & (1 << event)); event++);
+
+  err_code = ble_ess_char_update(flight_ess, flight_handles,
+                                 (uint8_t*)&records[event],
+                                 sizeof(struct flight_record),
+                                 BLE_GATT_HVX_INDICATION);
+
+  if (err_code == NRF_SUCCESS) {
+    indicated = event;
+  } else if (err_code != NRF_ERROR_BUSY &&
+             err_code != NRF_ERROR_INVALID_STATE &&
+             err_code != BLE_ERROR_INVALID_CONN_HANDLE &&
+             err_code != BLE_ERROR_GATTS_SYS_ATTR_MISSING) {
+    APP_ERROR_HANDLER(err_code);
+  }
+  /* Otherwise try again once the last indication is confirmed, or the
+   * client subscribes */
+}
+/**
+ * True if the connected client has subscribed to the events, so the
+ * detectors need the samples even if nothing else does
+ */
+bool flight_subscribed(void) {
+  uint8_t cccd[2];
+  uint16_t len = sizeof(cccd);
+
+  if (flight_ess == NULL || flight_ess->conn_handle == BLE_CONN_HANDLE_INVALID) {
+    return false;
+  }
+
+  return (sd_ble_gatts_value_get(flight_handles->cccd_handle, 0, &len, cccd) == NRF_SUCCESS) &&
+    ble_srv_is_indication_enabled(cccd);
+}
+void flight_on_ble_evt(ble_evt_t* p_ble_evt) {
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GATTS_EVT_HVC:
+      if (flight_handles != NULL && indicated != FLIGHT_EVENT_NONE &&
+          p_ble_evt->evt.gatts_evt.params.hvc.handle == flight_handles->value_handle) {
+        unreported &= ~(1 << indicated);
+        indicated = FLIGHT_EVENT_NONE;
+      }
+      flight_report();
+      break;
+    case BLE_GAP_EVT_DISCONNECTED:
+      /* Never confirmed, so it goes again to the next client */
+      indicated = FLIGHT_EVENT_NONE;
+      break;
+    default:
+      break;
+  }
+}
+void flight_gatt_init(ble_ess_t* p_ess, ble_gatts_char_handles_t* p_handles) {
+  flight_ess = p_ess;
+  flight_handles = p_handles;
+}
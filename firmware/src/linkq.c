@@ -0,0 +1,179 @@
+/*
+ * Link quality manager
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Steps the TX power down while the link has margin to spare, and
+ * back up as it fades.
+ *
+ * We can only measure the central's signal, so the path loss is taken
+ * to be the same in both directions and the central is assumed to
+ * transmit at ASSUMED_CENTRAL_TX. The margin the central sees is
+ * then roughly
+ *
+ *   tx_power - (ASSUMED_CENTRAL_TX - rssi) - SENSITIVITY
+ *
+ * The TX power is raised when this drops below TARGET_MARGIN, and only
+ * lowered when a step down would still leave HYSTERESIS above it. The
+ * RSSI is averaged, and each step waits for the average to settle.
+ *
+ * The TX power never goes above the ceiling set by the power profile,
+ * and returns to it on a disconnect so advertising keeps its range.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nrf.h"
+#include "app_error.h"
+#include "ble.h"
+#include "linkq.h"
+
+#define ASSUMED_CENTRAL_TX	0	/* dBm */
+#define SENSITIVITY		(-90)	/* dBm, nRF51 at 1Mbps with some slack */
+#define TARGET_MARGIN		20	/* dB */
+#define HYSTERESIS		6	/* dB */
+
+/**
+ * RSSI average is an EWMA with weight 1/(1 << RSSI_SHIFT), kept in
+ * 1/16 dB
+ */
+#define RSSI_SHIFT		3
+#define RSSI_FRAC		4
+/**
+ * RSSI samples to wait after a change for the average to catch up
+ */
+#define SETTLE_SAMPLES		16
+
+/**
+ * TX power levels supported by the S110
+ */
+static const int8_t tx_levels[] = { -20, -16, -12, -8, -4, 0, 4 };
+#define TX_LEVEL_COUNT		(sizeof(tx_levels) / sizeof(tx_levels[0]))
+
+static struct linkq_stats stats;
+static int8_t ceiling = 0;
+static uint8_t level;		/* Index into tx_levels */
+static int32_t rssi_avg;	/* 1/16 dB */
+static uint8_t settle;
+static uint16_t conn_handle = BLE_CONN_HANDLE_INVALID;
+
+/**
+ * Highest level that isn't above the ceiling
+ */
+static uint8_t ceiling_level(void) {
+  uint8_t i;
+
+  for (i = TX_LEVEL_COUNT - 1; i > 0 && tx_levels[i] > ceiling; i--);
+
+  return i;
+}
+static void level_set(uint8_t new_level) {
+  if (new_level != level) {
+    stats.tx_changes++;
+  }
+
+  level = new_level;
+  stats.tx_power = tx_levels[level];
+  settle = SETTLE_SAMPLES;
+
+  APP_ERROR_CHECK(sd_ble_gap_tx_power_set(tx_levels[level]));
+}
+
+/**
+ * Margin at the central if we transmit at a given level
+ */
+static int32_t margin(uint8_t at_level) {
+  int32_t rssi = rssi_avg >> RSSI_FRAC;
+
+  return tx_levels[at_level] - (ASSUMED_CENTRAL_TX - rssi) - SENSITIVITY;
+}
+/**
+ * Takes a new RSSI sample and adjusts the TX power
+ */
+static void rssi_update(int8_t rssi) {
+  if (stats.rssi_samples == 0) {
+    rssi_avg = (int32_t)rssi << RSSI_FRAC;
+    stats.rssi_min = stats.rssi_max = rssi;
+  } else {
+    rssi_avg += (((int32_t)rssi << RSSI_FRAC) - rssi_avg) >> RSSI_SHIFT;
+    if (rssi < stats.rssi_min) stats.rssi_min = rssi;
+    if (rssi > stats.rssi_max) stats.rssi_max = rssi;
+  }
+  if (stats.rssi_samples < UINT16_MAX) {
+    stats.rssi_samples++;
+  }
+  stats.rssi_avg = (int8_t)(rssi_avg >> RSSI_FRAC);
+
+  if (settle) {
+    settle--;
+    return;
+  }
+
+  if (margin(level) < TARGET_MARGIN && level < ceiling_level()) {
+    level_set(level + 1);
+  } else if (level > 0 &&
+             margin(level - 1) >= TARGET_MARGIN + HYSTERESIS) {
+    level_set(level - 1);
+  }
+}
+
+/**
+ * Sets the highest TX power that can be used. Takes effect straight
+ * away
+ */
+void linkq_tx_ceiling_set(int8_t new_ceiling) {
+  ceiling = new_ceiling;
+
+  if (conn_handle == BLE_CONN_HANDLE_INVALID || level > ceiling_level()) {
+    level_set(ceiling_level());
+  }
+}
+struct linkq_stats* linkq_stats(void) {
+  return &stats;
+}
+
+void linkq_on_ble_evt(ble_evt_t* p_ble_evt) {
+  ble_gap_evt_t* p_gap_evt = &p_ble_evt->evt.gap_evt;
+
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+      conn_handle = p_gap_evt->conn_handle;
+      memset(&stats, 0, sizeof(stats));
+      level_set(ceiling_level());
+      stats.tx_changes = 0;
+
+      APP_ERROR_CHECK(sd_ble_gap_rssi_start(conn_handle));
+      break;
+    case BLE_GAP_EVT_DISCONNECTED:
+      conn_handle = BLE_CONN_HANDLE_INVALID;
+      level_set(ceiling_level());
+      break;
+    case BLE_GAP_EVT_RSSI_CHANGED:
+      rssi_update(p_gap_evt->params.rssi_changed.rssi);
+      break;
+    default:
+      break;
+  }
+}
@@ -23,6 +23,7 @@
  */
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include "nordic_common.h"
 #include "nrf.h"
@@ -49,40 +50,50 @@
 #include "app_trace.h"
 #include "twi_master.h"
 #include "bmp180.h"
+#include "pipeline.h"
+#include "sched.h"
+#include "power.h"
+#include "advertising.h"
+#include "linkq.h"
+#include "stream.h"
+#include "convert.h"
+#include "prof.h"
+#include "telemetry.h"
+#include "fault.h"
+#include "synth.h"
+#include "vario.h"
+#include "flight.h"
+#include "capture.h"
+#include "adapt.h"
+#include "validate.h"
+#include "stats.h"
+#include "weather.h"
+#include "config.h"
+#include "control.h"
+#include "main.h"
 
 
 
 #define IS_SRVC_CHANGED_CHARACT_PRESENT      0                                          /**< Include or not the service_changed characteristic. if not enabled, the server's database cannot be changed for the lifetime of the device*/
 
-#define HR_INC_BUTTON_PIN_NO                 BUTTON_0                                   /**< Button used to increment heart rate. */
-#define HR_DEC_BUTTON_PIN_NO                 BUTTON_1                                   /**< Button used to decrement heart rate. */
-#define BOND_DELETE_ALL_BUTTON_ID            HR_DEC_BUTTON_PIN_NO                       /**< Button used for deleting all bonded centrals during startup. */
+#define ADV_BOOST_BUTTON_PIN_NO              BUTTON_0                                   /**< Button used to return to fast advertising. */
+#define BOND_DELETE_ALL_BUTTON_ID            BUTTON_1                                   /**< Button used for deleting all bonded centrals during startup. Also returns to fast advertising. */
 
 #define DEVICE_NAME                          "pressure"                                 /**< Name of device. Will be included in the advertising data. */
+#define ESS_LAZY_READ                        true                                       /**< Reads of pressure and temperature take a fresh measurement when no client is subscribed. */
 #define MANUFACTURER_NAME                    "ubseds"                                   /**< Manufacturer. Will be passed to Device Information Service. */
-#define APP_ADV_INTERVAL                     40                                         /**< The advertising interval (in units of 0.625 ms. This value corresponds to 25 ms). */
-#define APP_ADV_TIMEOUT_IN_SECONDS           180                                        /**< The advertising timeout in units of seconds. */
 
-#define APP_TIMER_PRESCALER                  0                                          /**< Value of the RTC1 PRESCALER register. */
-#define APP_TIMER_MAX_TIMERS                 5                                          /**< Maximum number of simultaneously created timers. */
+#define APP_TIMER_MAX_TIMERS                 12                                         /**< Maximum number of simultaneously created timers. */
 #define APP_TIMER_OP_QUEUE_SIZE              5                                          /**< Size of timer operation queues. */
 
-#define BATTERY_LEVEL_MEAS_INTERVAL          APP_TIMER_TICKS(2000, APP_TIMER_PRESCALER) /**< Battery level measurement interval (ticks). */
+#define ADV_BOOST_PRESSURE_CHANGE            1000                                       /**< Change between samples (in units of 0.1 Pa) that returns to fast advertising when not connected. */
 
-#define HEART_RATE_MEAS_INTERVAL             APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER) /**< Heart rate measurement interval (ticks). */
-#define MIN_HEART_RATE                       60                                         /**< Minimum heart rate as returned by the simulated measurement function. */
-#define MAX_HEART_RATE                       300                                        /**< Maximum heart rate as returned by the simulated measurement function. */
-#define HEART_RATE_CHANGE                    2                                          /**< Value by which the heart rate is incremented/decremented during button press. */
+#define ADV_COMPANY_IDENTIFIER               0xFFFF                                     /**< Company identifier for the manufacturer specific advertising data, the Bluetooth SIG one for testing. */
 
 #define APP_GPIOTE_MAX_USERS                 1                                          /**< Maximum number of users of the GPIOTE handler. */
 
 #define BUTTON_DETECTION_DELAY               APP_TIMER_TICKS(50, APP_TIMER_PRESCALER)   /**< Delay from a GPIOTE event until a button is reported as pushed (in number of timer ticks). */
 
-#define MIN_CONN_INTERVAL                    MSEC_TO_UNITS(500, UNIT_1_25_MS)           /**< Minimum acceptable connection interval (0.5 seconds). */
-#define MAX_CONN_INTERVAL                    MSEC_TO_UNITS(1000, UNIT_1_25_MS)          /**< Maximum acceptable connection interval (1 second). */
-#define SLAVE_LATENCY                        0                                          /**< Slave latency. */
-#define CONN_SUP_TIMEOUT                     MSEC_TO_UNITS(4000, UNIT_10_MS)            /**< Connection supervisory timeout (4 seconds). */
-
 #define FIRST_CONN_PARAMS_UPDATE_DELAY       APP_TIMER_TICKS(5000, APP_TIMER_PRESCALER) /**< Time from initiating event (connect or start of notification) to first time sd_ble_gap_conn_param_update is called (5 seconds). */
 #define NEXT_CONN_PARAMS_UPDATE_DELAY        APP_TIMER_TICKS(30000, APP_TIMER_PRESCALER)/**< Time between each call to sd_ble_gap_conn_param_update after the first call (30 seconds). */
 #define MAX_CONN_PARAMS_UPDATE_COUNT         3                                          /**< Number of attempts before giving up the connection parameter negotiation. */
@@ -99,19 +110,39 @@
 
 
 
-static ble_gap_adv_params_t                  m_adv_params;                              /**< Parameters to be passed to the stack when starting advertising. */
 ble_bas_t                                    bas;                                       /**< Structure used to identify the battery service. */
 static ble_ess_t                             m_ess;                                     /**< Structure used to identify the heart rate service. */
-static volatile uint16_t                     m_cur_heart_rate;                          /**< Current heart rate value. */
+static ble_gatts_char_handles_t              m_power_profile_handles;                   /**< Handles of the power profile characteristic. */
+static ble_gatts_char_handles_t              m_link_quality_handles;                    /**< Handles of the link quality characteristic. */
+static ble_gatts_char_handles_t              m_stream_handles;                          /**< Handles of the pressure stream characteristic. */
+static ble_gatts_char_handles_t              m_stream_stats_handles;                    /**< Handles of the pressure stream statistics characteristic. */
+static ble_gatts_char_handles_t              m_telemetry_handles;                       /**< Handles of the runtime telemetry characteristic. */
+static ble_gatts_char_handles_t              m_fault_handles;                           /**< Handles of the crash history characteristic. */
+static ble_gatts_char_handles_t              m_flight_handles;                          /**< Handles of the flight events characteristic. */
+static ble_gatts_char_handles_t              m_capture_status_handles;                  /**< Handles of the burst capture status characteristic. */
+static ble_gatts_char_handles_t              m_capture_data_handles;                    /**< Handles of the burst capture upload characteristic. */
+static ble_gatts_char_handles_t              m_stats_config_handles;                    /**< Handles of the windowed statistics config characteristic. */
+static ble_gatts_char_handles_t              m_stats_summary_handles;                   /**< Handles of the windowed statistics summary characteristic. */
+static ble_gatts_char_handles_t              m_weather_handles;                         /**< Handles of the pressure tendency and forecast characteristic. */
+static ble_gatts_char_handles_t              m_weather_history_handles;                 /**< Handles of the pressure history characteristic. */
+static ble_gatts_char_handles_t              m_config_handles;                          /**< Handles of the persistent configuration characteristic. */
+static ble_gatts_char_handles_t              m_control_handles;                         /**< Handles of the sampling control point characteristic. */
+#ifdef PROF_ENABLED
+static ble_gatts_char_handles_t              m_profiling_handles;                       /**< Handles of the execution time profiling characteristic. */
+#endif
+#ifdef SYNTH_ENABLED
+static ble_gatts_char_handles_t              m_synth_handles;                           /**< Handles of the synthetic data source characteristic. */
+#endif
+static bool                                  m_sensor_ok;                               /**< False if running without the barometer. */
+static int32_t                               m_last_pressure;                           /**< Last pressure sent, for spotting sensor events. */
 
-static app_timer_id_t                        m_battery_timer_id;                        /**< Battery timer. */
-static app_timer_id_t                        m_heart_rate_timer_id;                     /**< Heart rate measurement timer. */
-static bool                                  m_memory_access_in_progress = false;       /**< Flag to keep track of ongoing operations on persistent memory. */
 static dm_application_instance_t             m_app_handle;                              /**< Application identifier allocated by device manager */
 static void ble_evt_dispatch(ble_evt_t * p_ble_evt);
 
 static void sys_evt_dispatch(uint32_t sys_evt);
 
+static void advertising_data_set(void);
+
 
 /*****************************************************************************
  * Error Handling Functions
@@ -120,8 +151,8 @@ static void sys_evt_dispatch(uint32_t sys_evt);
 
 /**@brief Function for error handling, which is called when an error has occurred.
  *
- * @warning This handler is an example only and does not fit a final product. You need to analyze
- *          how your product is supposed to react in case of error.
+ * @details The error is recorded in the crash ring and the chip reset straight away, so a
+ *          transient fault costs milliseconds rather than the rest of the flight.
  *
  * @param[in] error_code  Error code supplied to the handler.
  * @param[in] line_num    Line number where the handler is called.
@@ -138,10 +169,8 @@ void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t * p
   //                Use with care. Un-comment the line below to use.
   // ble_debug_assert_handler(error_code, line_num, p_file_name);
 
-  while (1);
-
   // On assert, the system can only recover with a reset.
-  NVIC_SystemReset();
+  fault_error(error_code, line_num, p_file_name, (uint32_t)(uintptr_t)__builtin_return_address(0));
 }
 
 
@@ -178,70 +207,228 @@ static void conn_params_error_handler(uint32_t nrf_error)
  * Static Timeout Handling Functions
  *****************************************************************************/
 
-/**@brief Function for handling the Battery measurement timer timeout.
- *
- * @details This function will be called each time the battery level measurement timer expires.
- *          This function will start the ADC.
+/**@brief Function for checking if anyone wants the scheduled samples.
  *
- * @param[in]   p_context   Pointer used for passing some arbitrary information (context) from the
- *                          app_start_timer() call to the timeout handler.
+ * @details Always while disconnected, so the filter, detectors, statistics and weather history
+ *          keep up. While connected, only if the client has subscribed to the measurements, the
+ *          summaries, the flight events or the weather.
  */
-static void battery_level_meas_timeout_handler(void * p_context)
+static bool samples_wanted(void)
 {
-  UNUSED_PARAMETER(p_context);
-  battery_start();
+  return (m_ess.conn_handle == BLE_CONN_HANDLE_INVALID) || ble_ess_is_subscribed(&m_ess) ||
+         stats_subscribed() || flight_subscribed() || weather_subscribed();
 }
 
 
-/**@brief Function for handling the Heart rate measurement timer timeout.
+/**@brief Function for handling the measurement work from the scheduler.
+ *
+ * @details This function will be called once per measurement interval, lined up with the
+ *          connection events when connected. It takes a raw measurement from the barometer and
+ *          feeds it into the pipeline, and starts the ADC for a battery measurement when one is
+ *          due. The rest of the work is done by the pipeline stages from the main loop.
  *
- * @details This function will be called each time the heart rate measurement timer expires.
- *          It will exclude RR Interval data from every third measurement.
+ *          While a client is connected but not subscribed to anything that needs samples the
+ *          barometer is left idle, and reads take a measurement on demand instead. While a burst
+ *          capture is sampling it has the barometer, and its latest sample goes into the pipeline
+ *          instead.
  *
- * @param[in]   p_context   Pointer used for passing some arbitrary information (context) from the
- *                          app_start_timer() call to the timeout handler.
+ * @param[in]   work   Bitmask of SCHED_WORK_* items that are due.
  */
-static void heart_rate_meas_timeout_handler(void * p_context)
+static void measurement_handler(uint8_t work)
 {
-  uint32_t err_code;
+  uint32_t      err_code;
+  struct sample s;
 
-  UNUSED_PARAMETER(p_context);
+  // The synthetic source feeds the pipeline itself while it runs
+  if ((work & SCHED_WORK_SAMPLE) && m_sensor_ok && !synth_active() && samples_wanted())
+  {
+    if (capture_sampling())
+    {
+      if (capture_latest(&s))
+      {
+        pipeline_acquire(&s);
+      }
+    }
+    else if (!convert_busy() && !capture_converting())
+    {
+      err_code = app_timer_cnt_get(&s.timestamp);
+      APP_ERROR_CHECK(err_code);
 
-  struct barometer* b_ptr = get_barometer();
+      PROF_ENTER(ACQUIRE);
+      bmp180_acquire(&s);
+      PROF_EXIT(ACQUIRE);
 
-  err_code = ble_ess_pressure_send(&m_ess, b_ptr->pressure * 10); // Units 0.1Pa
+      pipeline_acquire(&s);
+    }
+  }
 
-  if (
-    (err_code != NRF_SUCCESS)
-    &&
-    (err_code != NRF_ERROR_INVALID_STATE)
-    &&
-    (err_code != BLE_ERROR_NO_TX_BUFFERS)
-    &&
-    (err_code != BLE_ERROR_GATTS_SYS_ATTR_MISSING)
-    )
+  if (work & SCHED_WORK_BATTERY)
   {
-    APP_ERROR_HANDLER(err_code);
+    battery_start();
   }
+}
 
-  err_code = ble_ess_temperature_send(&m_ess, (uint16_t)(b_ptr->temperature * 100)); // Units 0.01°C
 
+/*****************************************************************************
+ * Pipeline Stages
+ *****************************************************************************/
+
+/**@brief Function for handling the result of sending a notification.
+ *
+ * @param[in]   err_code   Result from the send.
+ *
+ * @return      True if the stack had no free TX buffers, and the send has to be tried again.
+ */
+static bool hvx_retry(uint32_t err_code)
+{
+  telemetry_hvx_result(err_code);
+  if (err_code == BLE_ERROR_NO_TX_BUFFERS)
+  {
+    return true;
+  }
   if (
     (err_code != NRF_SUCCESS)
     &&
     (err_code != NRF_ERROR_INVALID_STATE)
     &&
-    (err_code != BLE_ERROR_NO_TX_BUFFERS)
+    (err_code != BLE_ERROR_INVALID_CONN_HANDLE)
     &&
     (err_code != BLE_ERROR_GATTS_SYS_ATTR_MISSING)
     )
   {
     APP_ERROR_HANDLER(err_code);
   }
+
+  return false;
+}
+
+
+/**@brief Pipeline stage for sending a sample to the Environmental Sensing Service.
+ *
+ * @details If the stack has no free TX buffers the sample is left in the pipeline and sent
+ *          again on a later poll. A link that has dropped before its disconnect event arrives
+ *          is not an error.
+ *
+ * @param[in]   s   Sample to send.
+ */
+static enum stage_result ess_transmit_stage(struct sample * s)
+{
+  // A sudden change in pressure is worth being quick to find for
+  if ((m_last_pressure != 0) &&
+      (abs(s->pressure - m_last_pressure) > ADV_BOOST_PRESSURE_CHANGE))
+  {
+    advertising_boost();
+  }
+  m_last_pressure = s->pressure;
+
+  if (hvx_retry(ble_ess_pressure_send(&m_ess, s->pressure)) ||
+      hvx_retry(ble_ess_temperature_send(&m_ess, s->temperature)))
+  {
+    return STAGE_RETRY;
+  }
+  if ((s->flags & SAMPLE_FLAG_FILTERED) &&
+      hvx_retry(ble_ess_vario_send(&m_ess, s->altitude, s->climb)))
+  {
+    return STAGE_RETRY;
+  }
+
+  synth_check(s);
+
+  return STAGE_PASS;
+}
+
+
+/**@brief Function for handling flight events.
+ *
+ * @details The event is already on its way to a subscribed client. If nobody is connected, fast
+ *          advertising gets one connected sooner.
+ *
+ * @param[in]   p_record   The event.
+ */
+static void flight_event_handler(const struct flight_record * p_record)
+{
+  (void)p_record;
+
+  advertising_boost();
+}
+
+
+/**@brief Function for handling a change in the pressure tendency or forecast.
+ *
+ * @details The advertising data carries them, so a scanner can pick them up without connecting.
+ *
+ * @param[in]   p_status   The new tendency and forecast.
+ */
+static void weather_handler(const struct weather_status * p_status)
+{
+  (void)p_status;
+
+  advertising_data_set();
+}
+
+
+/**@brief Function for asking for the connection parameters in the configuration.
+ *
+ * @details Only while disconnected, so as not to upset a stream or fast sampling. They are asked
+ *          for again on every disconnect, which also hands them to the connection parameters
+ *          module for the next connection. If the last connection's parameters were outside them
+ *          the module tries an update on the link that has gone, after it has taken them, so that
+ *          error is expected.
+ */
+static void conn_params_update(void)
+{
+  uint32_t              err_code;
+  ble_gap_conn_params_t conn_params;
+
+  if (m_ess.conn_handle == BLE_CONN_HANDLE_INVALID)
+  {
+    config_conn_params(&conn_params);
+    err_code = ble_conn_params_change_conn_params(&conn_params);
+    if ((err_code != NRF_SUCCESS) && (err_code != BLE_ERROR_INVALID_CONN_HANDLE))
+    {
+      APP_ERROR_HANDLER(err_code);
+    }
+  }
+}
+
+
+/**@brief Function for setting the characteristics that show the configuration.
+ */
+static void config_report(void)
+{
+  uint32_t err_code;
+  uint8_t  profile;
+
+  err_code = ble_ess_char_update(&m_ess, &m_config_handles,
+                                 (uint8_t *)config(), sizeof(struct config),
+                                 BLE_GATT_HVX_INVALID);
+  APP_ERROR_CHECK(err_code);
+
+  profile  = power_profile_id();
+  err_code = ble_ess_char_update(&m_ess, &m_power_profile_handles,
+                                 &profile, sizeof(profile), BLE_GATT_HVX_INVALID);
+  APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for applying a new configuration.
+ *
+ * @details The sampling and power profile take effect straight away, replacing any sampling set
+ *          through the control point, advertising from when it next starts, and the connection
+ *          parameters from the next connection.
+ */
+static void config_apply(void)
+{
+  power_apply();
+  conn_params_update();
+  weather_set_altitude(config()->altitude);
 }
 
 
 /**@brief Function for handling button events.
+ *
+ * @details Either button returns to fast advertising, and triggers a burst capture if one is
+ *          armed.
  *
  * @param[in]   pin_no   The pin number of the button pressed.
  */
@@ -251,28 +438,326 @@ static void button_event_handler(uint8_t pin_no, uint8_t button_action)
   {
     switch (pin_no)
     {
-    case HR_INC_BUTTON_PIN_NO:
-      // Increase Heart Rate measurement
-      m_cur_heart_rate += HEART_RATE_CHANGE;
-      if (m_cur_heart_rate > MAX_HEART_RATE)
+    case ADV_BOOST_BUTTON_PIN_NO:
+    case BOND_DELETE_ALL_BUTTON_ID:
+      capture_trigger(CAPTURE_SOURCE_BUTTON);
+      advertising_boost();
+      break;
+
+    default:
+      APP_ERROR_HANDLER(pin_no);
+      break;
+    }
+  }
+}
+
+
+/**@brief Function for answering a read with a measurement taken on demand.
+ *
+ * @details A bad read is answered with the stored values instead.
+ *
+ * @param[in]   s   Compensated sample.
+ */
+static void read_conversion_handler(struct sample * s)
+{
+  uint32_t err_code;
+
+  if (validate_check(s))
+  {
+    err_code = ble_ess_read_reply_stored(&m_ess);
+  }
+  else
+  {
+    (void)ble_ess_encode_stage(s);
+    err_code = ble_ess_read_reply(&m_ess, s->pressure, s->temperature);
+  }
+
+  // The client may have gone away in the meantime
+  if ((err_code != NRF_SUCCESS) && (err_code != NRF_ERROR_INVALID_STATE))
+  {
+    APP_ERROR_HANDLER(err_code);
+  }
+}
+
+
+/**@brief Function for feeding the first sample after boot into the pipeline.
+ *
+ * @details With profiling enabled the boot timings are dumped once the first sample is in.
+ *
+ * @param[in]   s   Compensated sample.
+ */
+static void first_sample_handler(struct sample * s)
+{
+  pipeline_acquire(s);
+
+  PROF_MILESTONE(FIRST_SAMPLE);
+  prof_dump();
+}
+
+
+/**@brief Function for feeding a sample taken in place of a bad one into the pipeline.
+ *
+ * @param[in]   s   Compensated sample.
+ */
+static void retry_conversion_handler(struct sample * s)
+{
+  s->flags |= SAMPLE_FLAG_RETRY;
+  pipeline_acquire(s);
+}
+
+
+/**@brief Function for taking another sample when the validate stage has thrown one away.
+ *
+ * @details Only if the barometer is free, and a sample would have been taken anyway.
+ */
+static void sample_retry(void)
+{
+  if (m_sensor_ok && !synth_active() && !capture_sampling() && !capture_converting() &&
+      !stream_active() && samples_wanted())
+  {
+    (void)convert_start(control_settings()->oss, retry_conversion_handler);
+  }
+}
+
+
+/**@brief Function for handling the Environmental Sensing Service events.
+ *
+ * @details Writes to the power profile characteristic select a new profile. The characteristic
+ *          is then set back to the profile in use, so an invalid write reads back unchanged.
+ *          Enabling notifications on the stream characteristic starts streaming, taking the sensor
+ *          from a burst capture that is still sampling, once any conversion under way is done. A
+ *          read of pressure or temperature takes a fresh measurement, unless a subscribed client,
+ *          a stream or a burst capture is already keeping the sensor busy. Writes to the burst
+ *          capture status characteristic are commands, see capture.h. Writes to the statistics
+ *          config characteristic restart the windows, and it is set back to the config in use.
+ *          Writes to the weather characteristic set the station altitude, which is kept in the
+ *          configuration. A whole configuration written to the configuration characteristic is
+ *          applied and stored if it is valid. Writes to the control point change the sampling
+ *          until the configuration next changes, see control.h, and are answered by indication.
+ *
+ * @param[in]   p_ess   Environmental Sensing Service structure.
+ * @param[in]   p_evt   Event received from the Environmental Sensing Service.
+ */
+static void ess_evt_handler(ble_ess_t * p_ess, ble_ess_evt_t * p_evt)
+{
+  uint32_t              err_code;
+  struct capture_config capture_config;
+  struct stats_config   stats_request;
+  struct config         config_request;
+
+  if (p_evt->evt_type == BLE_ESS_EVT_READ_REQUEST)
+  {
+    if (!m_sensor_ok || ble_ess_is_subscribed(p_ess) || stream_active() || capture_sampling() ||
+        capture_converting() || !convert_start(control_settings()->oss, read_conversion_handler))
+    {
+      err_code = ble_ess_read_reply_stored(p_ess);
+      if ((err_code != NRF_SUCCESS) && (err_code != NRF_ERROR_INVALID_STATE))
       {
-        m_cur_heart_rate = MIN_HEART_RATE; // Loop back
+        APP_ERROR_HANDLER(err_code);
       }
-      break;
+    }
+  }
+
+  if ((p_evt->evt_type == BLE_ESS_EVT_WRITE) &&
+      (p_evt->handle == m_power_profile_handles.value_handle))
+  {
+    if (p_evt->len == sizeof(uint8_t))
+    {
+      // An out of range profile is ignored
+      (void)power_select((enum power_profile_id)p_evt->p_data[0]);
+    }
 
-    case HR_DEC_BUTTON_PIN_NO:
-      // Decrease Heart Rate measurement
-      m_cur_heart_rate -= HEART_RATE_CHANGE;
-      if (m_cur_heart_rate < MIN_HEART_RATE)
+    config_report();
+  }
+
+  // Writing a whole configuration applies it and stores it for the next boot. An invalid one is
+  // ignored, and the characteristic is set back to the one in use.
+  if ((p_evt->evt_type == BLE_ESS_EVT_WRITE) &&
+      (p_evt->handle == m_config_handles.value_handle))
+  {
+    if (p_evt->len == sizeof(struct config))
+    {
+      memcpy(&config_request, p_evt->p_data, sizeof(config_request));
+      if (config_set(&config_request) == NRF_SUCCESS)
       {
-        m_cur_heart_rate = MAX_HEART_RATE; // Loop back
+        config_apply();
       }
-      break;
+    }
 
-    default:
-      APP_ERROR_HANDLER(pin_no);
-      break;
+    config_report();
+  }
+
+  // Writing a list of commands to the control point changes the sampling, all at once or not at
+  // all. The answer is indicated.
+  if ((p_evt->evt_type == BLE_ESS_EVT_WRITE) &&
+      (p_evt->handle == m_control_handles.value_handle))
+  {
+    control_write(p_evt->p_data, p_evt->len);
+  }
+
+  // Subscribing to the control point sends an answer not yet confirmed
+  if ((p_evt->evt_type == BLE_ESS_EVT_WRITE) &&
+      (p_evt->handle == m_control_handles.cccd_handle) &&
+      (p_evt->len == 2) &&
+      ble_srv_is_indication_enabled(p_evt->p_data))
+  {
+    control_report();
+  }
+
+#ifdef PROF_ENABLED
+  // Any write to the profiling characteristic dumps the table over app_trace and clears it
+  if ((p_evt->evt_type == BLE_ESS_EVT_WRITE) &&
+      (p_evt->handle == m_profiling_handles.value_handle))
+  {
+    prof_dump();
+    prof_reset();
+  }
+#endif
+
+#ifdef SYNTH_ENABLED
+  // Writing [profile, 0, rate] starts the synthetic source, profile 0 stops it
+  if ((p_evt->evt_type == BLE_ESS_EVT_WRITE) &&
+      (p_evt->handle == m_synth_handles.value_handle))
+  {
+    if (p_evt->len >= 4)
+    {
+      // An out of range profile or rate is ignored
+      (void)synth_start((enum synth_profile)p_evt->p_data[0], uint16_decode(&p_evt->p_data[2]));
+    }
+
+    err_code = ble_ess_char_update(p_ess, &m_synth_handles,
+                                   (uint8_t *)synth_status(), sizeof(struct synth_status),
+                                   BLE_GATT_HVX_INVALID);
+    APP_ERROR_CHECK(err_code);
+  }
+#endif
+
+  if ((p_evt->evt_type == BLE_ESS_EVT_WRITE) &&
+      (p_evt->handle == m_stream_handles.cccd_handle) &&
+      (p_evt->len == 2))
+  {
+    if (ble_srv_is_notification_enabled(p_evt->p_data))
+    {
+      if (m_sensor_ok)
+      {
+        capture_disarm();
+        stream_start();
+      }
+    }
+    else
+    {
+      stream_stop();
+    }
+  }
+
+  // Writing [opcode, 0, period, pre, post, threshold] controls the burst capture. The config is
+  // optional when arming. The characteristic is then set back to the capture status.
+  if ((p_evt->evt_type == BLE_ESS_EVT_WRITE) &&
+      (p_evt->handle == m_capture_status_handles.value_handle))
+  {
+    if (p_evt->len >= 1)
+    {
+      switch (p_evt->p_data[0])
+      {
+      case CAPTURE_OP_DISARM:
+        capture_disarm();
+        break;
+
+      case CAPTURE_OP_ARM:
+        if (!m_sensor_ok)
+        {
+          break;
+        }
+        if (p_evt->len >= 2 + sizeof(struct capture_config))
+        {
+          capture_config.period    = uint16_decode(&p_evt->p_data[2]);
+          capture_config.pre       = uint16_decode(&p_evt->p_data[4]);
+          capture_config.post      = uint16_decode(&p_evt->p_data[6]);
+          capture_config.threshold = uint16_decode(&p_evt->p_data[8]);
+
+          // An invalid config is ignored
+          (void)capture_arm(&capture_config);
+        }
+        else
+        {
+          (void)capture_arm(NULL);
+        }
+        break;
+
+      case CAPTURE_OP_TRIGGER:
+        capture_trigger(CAPTURE_SOURCE_GATT);
+        break;
+
+      case CAPTURE_OP_UPLOAD:
+        (void)capture_upload();
+        break;
+
+      default:
+        break;
+      }
+    }
+
+    capture_report();
+  }
+
+  // Writing the 4 byte struct stats_config, [period lo, period hi, buckets, 0] with the period in
+  // seconds, sets up the windowed statistics. An invalid config is ignored.
+  if ((p_evt->evt_type == BLE_ESS_EVT_WRITE) &&
+      (p_evt->handle == m_stats_config_handles.value_handle))
+  {
+    if (p_evt->len == sizeof(struct stats_config))
+    {
+      stats_request.period   = uint16_decode(&p_evt->p_data[0]);
+      stats_request.buckets  = p_evt->p_data[2];
+      stats_request.reserved = 0;
+      (void)stats_configure(&stats_request);
+    }
+
+    err_code = ble_ess_char_update(p_ess, &m_stats_config_handles,
+                                   (uint8_t *)stats_config(), sizeof(struct stats_config),
+                                   BLE_GATT_HVX_INVALID);
+    APP_ERROR_CHECK(err_code);
+  }
+
+  // Writing an altitude sets the station altitude for the forecast, and the characteristic is set
+  // back to the status
+  if ((p_evt->evt_type == BLE_ESS_EVT_WRITE) &&
+      (p_evt->handle == m_weather_handles.value_handle))
+  {
+    if (p_evt->len == sizeof(int16_t))
+    {
+      config_request          = *config();
+      config_request.altitude = (int16_t)uint16_decode(p_evt->p_data);
+      if (config_set(&config_request) == NRF_SUCCESS)
+      {
+        // Only the altitude has changed, so the sampling carries on as it is
+        weather_set_altitude(config()->altitude);
+        config_report();
+      }
     }
+
+    err_code = ble_ess_char_update(p_ess, &m_weather_handles,
+                                   (uint8_t *)weather_status(), sizeof(struct weather_status),
+                                   BLE_GATT_HVX_INVALID);
+    APP_ERROR_CHECK(err_code);
+  }
+
+  // Subscribing to flight events sends any not yet confirmed
+  if ((p_evt->evt_type == BLE_ESS_EVT_WRITE) &&
+      (p_evt->handle == m_flight_handles.cccd_handle) &&
+      (p_evt->len == 2) &&
+      ble_srv_is_indication_enabled(p_evt->p_data))
+  {
+    flight_report();
+  }
+
+  // Subscribing to the crash history sends anything not yet reported
+  if ((p_evt->evt_type == BLE_ESS_EVT_WRITE) &&
+      (p_evt->handle == m_fault_handles.cccd_handle) &&
+      (p_evt->len == 2) &&
+      ble_srv_is_notification_enabled(p_evt->p_data))
+  {
+    fault_report();
   }
 }
 
@@ -283,25 +768,28 @@ static void button_event_handler(uint8_t pin_no, uint8_t button_action)
 
 /**@brief Function for the Timer initialization.
  *
- * @details Initializes the timer module. This creates and starts application timers.
+ * @details Initializes the timer module.
  */
 static void timers_init(void)
 {
-  uint32_t err_code;
-
   // Initialize timer module.
   APP_TIMER_INIT(APP_TIMER_PRESCALER, APP_TIMER_MAX_TIMERS, APP_TIMER_OP_QUEUE_SIZE, false);
+}
 
-  // Create timers.
-  err_code = app_timer_create(&m_battery_timer_id,
-                              APP_TIMER_MODE_REPEATED,
-                              battery_level_meas_timeout_handler);
-  APP_ERROR_CHECK(err_code);
 
-  err_code = app_timer_create(&m_heart_rate_timer_id,
-                              APP_TIMER_MODE_REPEATED,
-                              heart_rate_meas_timeout_handler);
-  APP_ERROR_CHECK(err_code);
+/**@brief Function for registering the pipeline stages.
+ */
+static void pipeline_init(void)
+{
+  pipeline_register(STAGE_COMPENSATE, bmp180_compensate);
+  pipeline_register(STAGE_VALIDATE,   validate_stage);
+  pipeline_register(STAGE_FILTER,     vario_filter_stage);
+  pipeline_register(STAGE_DETECT,     flight_detect_stage);
+  pipeline_register(STAGE_ADAPT,      adapt_stage);
+  pipeline_register(STAGE_STATS,      stats_stage);
+  pipeline_register(STAGE_WEATHER,    weather_stage);
+  pipeline_register(STAGE_ENCODE,     ble_ess_encode_stage);
+  pipeline_register(STAGE_TRANSMIT,   ess_transmit_stage);
 }
 
 
@@ -328,26 +816,27 @@ static void gap_params_init(void)
 
   memset(&gap_conn_params, 0, sizeof(gap_conn_params));
 
-  gap_conn_params.min_conn_interval = MIN_CONN_INTERVAL;
-  gap_conn_params.max_conn_interval = MAX_CONN_INTERVAL;
-  gap_conn_params.slave_latency     = SLAVE_LATENCY;
-  gap_conn_params.conn_sup_timeout  = CONN_SUP_TIMEOUT;
+  config_conn_params(&gap_conn_params);
 
   err_code = sd_ble_gap_ppcp_set(&gap_conn_params);
   APP_ERROR_CHECK(err_code);
 }
 
 
-/**@brief Function for initializing the Advertising functionality.
+/**@brief Function for setting the advertising data.
  *
- * @details Encodes the required advertising data and passes it to the stack.
- *          Also builds a structure to be passed to the stack when starting advertising.
+ * @details Encodes the required advertising data and passes it to the stack. The advertising
+ *          parameters for each phase are chosen by the advertising manager. The pressure tendency
+ *          and forecast go in the manufacturer specific data, and it is set again whenever they
+ *          change. That fills the 31 bytes.
  */
-static void advertising_init(void)
+static void advertising_data_set(void)
 {
-  uint32_t      err_code;
-  ble_advdata_t advdata;
-  uint8_t       flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+  uint32_t                 err_code;
+  ble_advdata_t            advdata;
+  ble_advdata_manuf_data_t manuf_data;
+  uint8_t                  flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+  uint8_t                  weather[2];
 
   ble_uuid_t adv_uuids[] =
     {
@@ -366,17 +855,16 @@ static void advertising_init(void)
   advdata.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
   advdata.uuids_complete.p_uuids  = adv_uuids;
 
-  err_code = ble_advdata_set(&advdata, NULL);
-  APP_ERROR_CHECK(err_code);
+  weather[0] = weather_status()->tendency;
+  weather[1] = weather_status()->forecast;
 
-  // Initialize advertising parameters (used when starting advertising).
-  memset(&m_adv_params, 0, sizeof(m_adv_params));
+  manuf_data.company_identifier = ADV_COMPANY_IDENTIFIER;
+  manuf_data.data.p_data        = weather;
+  manuf_data.data.size          = sizeof(weather);
+  advdata.p_manuf_specific_data = &manuf_data;
 
-  m_adv_params.type        = BLE_GAP_ADV_TYPE_ADV_IND;
-  m_adv_params.p_peer_addr = NULL;                           // Undirected advertisement.
-  m_adv_params.fp          = BLE_GAP_ADV_FP_ANY;
-  m_adv_params.interval    = APP_ADV_INTERVAL;
-  m_adv_params.timeout     = APP_ADV_TIMEOUT_IN_SECONDS;
+  err_code = ble_advdata_set(&advdata, NULL);
+  APP_ERROR_CHECK(err_code);
 }
 
 
@@ -391,12 +879,17 @@ static void services_init(void)
   ble_bas_init_t bas_init;
   ble_dis_init_t dis_init;
   uint8_t        body_sensor_location;
+  uint8_t        profile;
+  struct fault_record fault;
+  struct flight_record flight;
 
   // Initialize Heart Rate Service.
   body_sensor_location = BLE_ESS_BODY_SENSOR_LOCATION_FINGER;
 
   memset(&ess_init, 0, sizeof(ess_init));
 
+  ess_init.evt_handler                 = ess_evt_handler;
+  ess_init.lazy_read                   = ESS_LAZY_READ;
   ess_init.is_sensor_contact_supported = false;
   ess_init.p_body_sensor_location      = &body_sensor_location;
 
@@ -412,6 +905,156 @@ static void services_init(void)
   err_code = ble_ess_init(&m_ess, &ess_init);
   APP_ERROR_CHECK(err_code);
 
+  // Add the power profile characteristic
+  profile  = power_profile_id();
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_POWER_PROFILE_CHAR,
+                              BLE_ESS_CHAR_READ | BLE_ESS_CHAR_WRITE,
+                              &profile, sizeof(profile), sizeof(profile),
+                              &m_power_profile_handles);
+  APP_ERROR_CHECK(err_code);
+
+  // Add the link quality characteristic. It is read straight from the link quality manager.
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_LINK_QUALITY_CHAR,
+                              BLE_ESS_CHAR_READ | BLE_ESS_CHAR_USER_MEM,
+                              (uint8_t *)linkq_stats(), sizeof(struct linkq_stats),
+                              sizeof(struct linkq_stats), &m_link_quality_handles);
+  APP_ERROR_CHECK(err_code);
+
+  // Add the pressure stream characteristics
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_STREAM_CHAR,
+                              BLE_ESS_CHAR_NOTIFY,
+                              NULL, 0, STREAM_PACKET_SIZE, &m_stream_handles);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_STREAM_STATS_CHAR,
+                              BLE_ESS_CHAR_READ | BLE_ESS_CHAR_USER_MEM,
+                              (uint8_t *)stream_stats(), sizeof(struct stream_stats),
+                              sizeof(struct stream_stats), &m_stream_stats_handles);
+  APP_ERROR_CHECK(err_code);
+
+  stream_init(&m_ess, &m_stream_handles);
+
+  // Add the telemetry characteristic. The counters are read straight from RAM with a long read.
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_TELEMETRY_CHAR,
+                              BLE_ESS_CHAR_READ | BLE_ESS_CHAR_USER_MEM,
+                              (uint8_t *)telemetry_table(),
+                              TELEMETRY_COUNT * sizeof(uint32_t),
+                              TELEMETRY_COUNT * sizeof(uint32_t),
+                              &m_telemetry_handles);
+  APP_ERROR_CHECK(err_code);
+
+  // Add the crash history characteristic, holding the most recent crash record
+  memset(&fault, 0, sizeof(fault));
+  if (fault_latest() != NULL)
+  {
+    fault = *fault_latest();
+  }
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_CRASH_HISTORY_CHAR,
+                              BLE_ESS_CHAR_READ | BLE_ESS_CHAR_NOTIFY,
+                              (uint8_t *)&fault, sizeof(fault), sizeof(fault),
+                              &m_fault_handles);
+  APP_ERROR_CHECK(err_code);
+
+  fault_gatt_init(&m_ess, &m_fault_handles);
+
+  // Add the flight events characteristic, indicated as each event is detected
+  memset(&flight, 0, sizeof(flight));
+  flight.event = FLIGHT_EVENT_NONE;
+  flight.state = flight_state();
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_FLIGHT_EVENT_CHAR,
+                              BLE_ESS_CHAR_READ | BLE_ESS_CHAR_INDICATE,
+                              (uint8_t *)&flight, sizeof(flight), sizeof(flight),
+                              &m_flight_handles);
+  APP_ERROR_CHECK(err_code);
+
+  flight_gatt_init(&m_ess, &m_flight_handles);
+
+  // Add the burst capture characteristics. The status is notified as the capture moves on, and
+  // the frozen window is uploaded as notifications on the data characteristic.
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_CAPTURE_STATUS_CHAR,
+                              BLE_ESS_CHAR_READ | BLE_ESS_CHAR_WRITE | BLE_ESS_CHAR_NOTIFY,
+                              (uint8_t *)capture_status(), sizeof(struct capture_status),
+                              sizeof(struct capture_status), &m_capture_status_handles);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_CAPTURE_DATA_CHAR,
+                              BLE_ESS_CHAR_NOTIFY,
+                              NULL, 0, CAPTURE_PACKET_SIZE, &m_capture_data_handles);
+  APP_ERROR_CHECK(err_code);
+
+  capture_gatt_init(&m_ess, &m_capture_status_handles, &m_capture_data_handles);
+
+  // Add the windowed statistics characteristics. A summary is notified as each window closes.
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_STATS_CONFIG_CHAR,
+                              BLE_ESS_CHAR_READ | BLE_ESS_CHAR_WRITE,
+                              (uint8_t *)stats_config(), sizeof(struct stats_config),
+                              sizeof(struct stats_config), &m_stats_config_handles);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_STATS_SUMMARY_CHAR,
+                              BLE_ESS_CHAR_READ | BLE_ESS_CHAR_NOTIFY,
+                              NULL, 0, STATS_SUMMARY_SIZE, &m_stats_summary_handles);
+  APP_ERROR_CHECK(err_code);
+
+  stats_gatt_init(&m_ess, &m_stats_summary_handles);
+
+  // Add the weather characteristics. The status is notified as each point of history is added,
+  // and the history itself is read straight from RAM with a long read.
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_WEATHER_CHAR,
+                              BLE_ESS_CHAR_READ | BLE_ESS_CHAR_WRITE | BLE_ESS_CHAR_NOTIFY,
+                              (uint8_t *)weather_status(), sizeof(struct weather_status),
+                              sizeof(struct weather_status), &m_weather_handles);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_WEATHER_HISTORY_CHAR,
+                              BLE_ESS_CHAR_READ | BLE_ESS_CHAR_USER_MEM,
+                              (uint8_t *)weather_history(),
+                              WEATHER_POINTS * sizeof(uint16_t),
+                              WEATHER_POINTS * sizeof(uint16_t),
+                              &m_weather_history_handles);
+  APP_ERROR_CHECK(err_code);
+
+  weather_gatt_init(&m_ess, &m_weather_handles);
+
+  // Add the configuration characteristic
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_CONFIG_CHAR,
+                              BLE_ESS_CHAR_READ | BLE_ESS_CHAR_WRITE,
+                              (uint8_t *)config(), sizeof(struct config),
+                              sizeof(struct config), &m_config_handles);
+  APP_ERROR_CHECK(err_code);
+
+  // Add the sampling control point. Each write is answered with the sampling then in effect.
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_CONTROL_POINT_CHAR,
+                              BLE_ESS_CHAR_READ | BLE_ESS_CHAR_WRITE | BLE_ESS_CHAR_INDICATE,
+                              (uint8_t *)control_response(), sizeof(struct control_response),
+                              CONTROL_WRITE_MAX, &m_control_handles);
+  APP_ERROR_CHECK(err_code);
+
+  control_gatt_init(&m_ess, &m_control_handles);
+
+#ifdef PROF_ENABLED
+  // Add the profiling characteristic. The whole table, boot timings included, is read straight
+  // from RAM with a long read.
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_PROFILING_CHAR,
+                              BLE_ESS_CHAR_READ | BLE_ESS_CHAR_WRITE | BLE_ESS_CHAR_USER_MEM,
+                              (uint8_t *)prof_table(),
+                              sizeof(struct prof_table),
+                              sizeof(struct prof_table),
+                              &m_profiling_handles);
+  APP_ERROR_CHECK(err_code);
+#endif
+
+#ifdef SYNTH_ENABLED
+  // Add the synthetic data source characteristic. The counters are read straight from RAM.
+  err_code = ble_ess_char_add(&m_ess, BLE_ESS_UUID_SYNTH_CHAR,
+                              BLE_ESS_CHAR_READ | BLE_ESS_CHAR_WRITE | BLE_ESS_CHAR_USER_MEM,
+                              (uint8_t *)synth_status(),
+                              sizeof(struct synth_status),
+                              sizeof(struct synth_status),
+                              &m_synth_handles);
+  APP_ERROR_CHECK(err_code);
+#endif
+
   // Initialize Battery Service.
   memset(&bas_init, 0, sizeof(bas_init));
 
@@ -477,6 +1120,13 @@ static uint32_t device_manager_evt_handler(dm_handle_t const    * p_handle,
                                            api_result_t           event_result)
 {
   APP_ERROR_CHECK(event_result);
+
+  // Advertise directly to this central if it disconnects
+  if (p_event->event_id == DM_EVT_LINK_SECURED)
+  {
+    advertising_peer_set(p_handle);
+  }
+
   return NRF_SUCCESS;
 }
 
@@ -489,10 +1139,6 @@ static void device_manager_init(void)
   dm_init_param_t         init_data;
   dm_application_param_t  register_param;
 
-  // Initialize persistent storage module.
-  err_code = pstorage_init();
-  APP_ERROR_CHECK(err_code);
-
   // Clear all bonded centrals if the Bonds Delete button is pushed.
   init_data.clear_persistent_data = (nrf_gpio_pin_read(BOND_DELETE_ALL_BUTTON_ID) == 0);
 
@@ -525,7 +1171,8 @@ static void ble_stack_init(void)
   uint32_t err_code;
 
   // Initialize the SoftDevice handler module.
-  SOFTDEVICE_HANDLER_INIT(NRF_CLOCK_LFCLKSRC_RC_250_PPM_1000MS_CALIBRATION, false);
+  // The LFCLK source comes from the power profile.
+  SOFTDEVICE_HANDLER_INIT(power_profile()->lfclk, false);
 
   // Enable BLE stack
   ble_enable_params_t ble_enable_params;
@@ -556,13 +1203,12 @@ static void gpiote_init(void)
  */
 static void buttons_init(void)
 {
-  // Configure HR_INC_BUTTON_PIN_NO and HR_DEC_BUTTON_PIN_NO as wake up buttons and also configure
-  // for 'pull up' because the eval board does not have external pull up resistors connected to
-  // the buttons.
+  // Configure for 'pull up' because the eval board does not have external pull up resistors
+  // connected to the buttons.
   static app_button_cfg_t buttons[] =
     {
-      {HR_INC_BUTTON_PIN_NO, false, BUTTON_PULL, button_event_handler},
-      {HR_DEC_BUTTON_PIN_NO, false, BUTTON_PULL, button_event_handler}  // Note: This pin is also BONDMNGR_DELETE_BUTTON_PIN_NO
+      {ADV_BOOST_BUTTON_PIN_NO,   false, BUTTON_PULL, button_event_handler},
+      {BOND_DELETE_ALL_BUTTON_ID, false, BUTTON_PULL, button_event_handler}
     };
 
   APP_BUTTON_INIT(buttons, sizeof(buttons) / sizeof(buttons[0]), BUTTON_DETECTION_DELAY, false);
@@ -577,50 +1223,17 @@ static void buttons_init(void)
  */
 static void application_timers_start(void)
 {
-  uint32_t err_code;
-
-  // Start application timers
-  err_code = app_timer_start(m_battery_timer_id, BATTERY_LEVEL_MEAS_INTERVAL, NULL);
-  APP_ERROR_CHECK(err_code);
-
-  err_code = app_timer_start(m_heart_rate_timer_id, HEART_RATE_MEAS_INTERVAL, NULL);
-  APP_ERROR_CHECK(err_code);
-}
-
-
-/**@brief Function for starting advertising.
- */
-static void advertising_start(void)
-{
-  uint32_t err_code;
-
-  err_code = sd_ble_gap_adv_start(&m_adv_params);
-  APP_ERROR_CHECK(err_code);
-
-  led_start();
-}
-
-
-/**@brief Function for putting the chip in System OFF Mode
- */
-static void system_off_mode_enter(void)
-{
-  uint32_t err_code;
-  uint32_t count;
+  // Start the measurement tick, the period comes from the power profile
+  sched_start();
 
-  // Verify if there is any flash access pending, if yes delay starting advertising until
-  // it's complete.
-  err_code = pstorage_access_status_get(&count);
-  APP_ERROR_CHECK(err_code);
+  // Start counting time spent connected and advertising
+  telemetry_start();
 
-  if (count != 0)
-  {
-    m_memory_access_in_progress = true;
-    return;
-  }
+  // Start timing a stable boot
+  fault_start();
 
-  err_code = sd_power_system_off();
-  APP_ERROR_CHECK(err_code);
+  // Start building the pressure history
+  weather_start();
 }
 
 
@@ -634,78 +1247,15 @@ static void system_off_mode_enter(void)
  */
 static void on_ble_evt(ble_evt_t * p_ble_evt)
 {
-  uint32_t        err_code;
-
   switch (p_ble_evt->header.evt_id)
   {
-  case BLE_GAP_EVT_CONNECTED:
-    led_stop();
-
-    // Initialize the current heart rate to the average of max and min values. So that
-    // everytime a new connection is made, the heart rate starts from the same value.
-    m_cur_heart_rate = (MAX_HEART_RATE + MIN_HEART_RATE) / 2;
-
-    // Start timers used to generate battery and HR measurements.
-    application_timers_start();
-
-    // Start handling button presses
-    err_code = app_button_enable();
-    APP_ERROR_CHECK(err_code);
-    break;
-
-  case BLE_GAP_EVT_DISCONNECTED:
-    // @note Flash access may not be complete on return of this API. System attributes are now
-    // stored to flash when they are updated to ensure flash access on disconnect does not
-    // result in system powering off before data was successfully written.
-
-    // Go to system-off mode, should not return from this function, wakeup will trigger
-    // a reset.
-    system_off_mode_enter();
-    break;
-
-  case BLE_GAP_EVT_TIMEOUT:
-    if (p_ble_evt->evt.gap_evt.params.timeout.src == BLE_GAP_TIMEOUT_SRC_ADVERTISEMENT)
-    {
-      led_stop();
-
-      nrf_gpio_cfg_sense_input(HR_INC_BUTTON_PIN_NO,
-                               BUTTON_PULL,
-                               NRF_GPIO_PIN_SENSE_LOW);
-
-      nrf_gpio_cfg_sense_input(HR_DEC_BUTTON_PIN_NO,
-                               BUTTON_PULL,
-                               NRF_GPIO_PIN_SENSE_LOW);
-
-      system_off_mode_enter();
-    }
-    break;
-
-  default:
-    // No implementation needed.
-    break;
-  }
-}
-
+    case BLE_GAP_EVT_DISCONNECTED:
+      // Pick up any change to the connection parameters for the next connection
+      conn_params_update();
+      break;
 
-/**@brief Function for handling the Application's system events.
- *
- * @param[in]   sys_evt   system event.
- */
-static void on_sys_evt(uint32_t sys_evt)
-{
-  switch(sys_evt)
-  {
-  case NRF_EVT_FLASH_OPERATION_SUCCESS:
-  case NRF_EVT_FLASH_OPERATION_ERROR:
-    if (m_memory_access_in_progress)
-    {
-      m_memory_access_in_progress = false;
-      system_off_mode_enter();
-    }
-    break;
-  default:
-    // No implementation needed.
-    break;
+    default:
+      break;
   }
 }
 
@@ -719,11 +1269,25 @@ static void on_sys_evt(uint32_t sys_evt)
  */
 static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
 {
+  PROF_ENTER(BLE_DISPATCH);
+
   dm_ble_evt_handler(p_ble_evt);
   ble_ess_on_ble_evt(&m_ess, p_ble_evt);
   ble_bas_on_ble_evt(&bas, p_ble_evt);
   ble_conn_params_on_ble_evt(p_ble_evt);
+  sched_on_ble_evt(p_ble_evt);
+  linkq_on_ble_evt(p_ble_evt);
+  stream_on_ble_evt(p_ble_evt);
+  advertising_on_ble_evt(p_ble_evt);
+  telemetry_on_ble_evt(p_ble_evt);
+  fault_on_ble_evt(p_ble_evt);
+  flight_on_ble_evt(p_ble_evt);
+  control_on_ble_evt(p_ble_evt);
+  capture_on_ble_evt(p_ble_evt);
+  adapt_on_ble_evt(p_ble_evt);
   on_ble_evt(p_ble_evt);
+
+  PROF_EXIT(BLE_DISPATCH);
 }
 
 
@@ -737,7 +1301,6 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
 static void sys_evt_dispatch(uint32_t sys_evt)
 {
   pstorage_sys_event_handler(sys_evt);
-  on_sys_evt(sys_evt);
 }
 
 
@@ -751,28 +1314,79 @@ int main(void)
 {
   uint32_t err_code;
 
+  prof_init();
   timers_init();
+  telemetry_init();
+  fault_init();
+
+  // Load the configuration before anything reads it. Safe mode boots with the defaults, and so the
+  // build-time power profile. Its pages have to be registered ahead of the device manager's, to
+  // keep the bonds where older firmware wrote them.
+  err_code = pstorage_init();
+  APP_ERROR_CHECK(err_code);
+  config_init();
+  if (!fault_safe_mode())
+  {
+    config_load();
+  }
+  power_init();
+
+  pipeline_init();
+  validate_init(sample_retry);
+  flight_init(flight_event_handler);
+  convert_init();
+  capture_init();
+  stats_init();
+  weather_init(weather_handler);
+  synth_init();
   gpiote_init();
-  buttons_init();
+  PROF_BOOT_PHASE(INIT);
+
   ble_stack_init();
-  device_manager_init();
+  sched_init(measurement_handler);
+  power_apply();
+  PROF_BOOT_PHASE(STACK);
 
-  // Initialize Bluetooth Stack parameters.
+  // Initialize Bluetooth Stack parameters. The device manager and connection parameters are
+  // needed as soon as a connection can arrive, so they go before advertising.
+  device_manager_init();
   gap_params_init();
-  advertising_init();
+  advertising_data_set();
   services_init();
   conn_params_init();
+  PROF_BOOT_PHASE(GATT);
 
   // Start advertising.
   advertising_start();
+  PROF_MILESTONE(FIRST_ADV);
+
+  // Configure sensor. Without it we carry on in degraded mode, so the crash history and telemetry
+  // can still be read. The BMP180 needs 10ms from power up, which the stack has given it by now.
+  m_sensor_ok = !fault_safe_mode() && twi_master_init() && bmp180_init();
+
+  // Take the first sample straight away rather than waiting a whole measurement interval. The
+  // conversion runs while we finish starting up.
+  if (m_sensor_ok)
+  {
+    (void)convert_start(control_settings()->oss, first_sample_handler);
+  }
+  PROF_BOOT_PHASE(SENSOR);
 
-  // Configure sensor
-  if (!twi_master_init()) while(1);
-  bmp180_init();
+  // Nothing needs the buttons until the device is up
+  buttons_init();
+  err_code = app_button_enable();
+  APP_ERROR_CHECK(err_code);
+
+  // Start sampling, connected or not.
+  application_timers_start();
+  PROF_BOOT_PHASE(DEFERRED);
 
   // Enter main loop.
   for (;;)
   {
+    // Run any pipeline stages that have input
+    pipeline_poll();
+
     // Switch to a low power state until an event is available for the application
     err_code = sd_app_evt_wait();
     APP_ERROR_CHECK(err_code);
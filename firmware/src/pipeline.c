@@ -0,0 +1,186 @@
+/*
+ * Staged sample pipeline
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf.h"
+#include "pipeline.h"
+#include "prof.h"
+
+#define RING_MASK	(PIPELINE_RING_SIZE - 1)
+
+#if (PIPELINE_RING_SIZE & RING_MASK) != 0
+#error PIPELINE_RING_SIZE must be a power of two
+#endif
+
+/**
+ * Single-producer, single-consumer ring of samples. head is only
+ * written by the producer and tail only by the consumer, so no
+ * locking is needed as long as each ring has one of each.
+ */
+struct ring {
+  struct sample buffer[PIPELINE_RING_SIZE];
+  volatile uint8_t head;
+  volatile uint8_t tail;
+};
+
+static struct ring rings[STAGE_COUNT];
+static stage_fn stage_fns[STAGE_COUNT];
+static struct stage_stats stats[STAGE_COUNT];
+static volatile uint32_t overflows;
+static uint16_t next_sequence;
+
+/* -----------------------------------------------------------------------------
+ * Ring buffers
+ */
+
+static uint8_t ring_count(struct ring* r) {
+  return (uint8_t)(r->head - r->tail);
+}
+/**
+ * Called from the producer only. Returns false if the ring is full.
+ */
+static bool ring_push(enum pipeline_stage stage, struct sample* s) {
+  struct ring* r = &rings[stage];
+  uint8_t count = ring_count(r);
+
+  if (count >= PIPELINE_RING_SIZE) return false;
+
+  r->buffer[r->head & RING_MASK] = *s;
+  __DMB(); /* Sample must be written before it's published */
+  r->head++;
+
+  if (count + 1 > stats[stage].high_water) {
+    stats[stage].high_water = count + 1;
+  }
+
+  return true;
+}
+/**
+ * Called from the consumer only. Returns NULL if the ring is empty.
+ */
+static struct sample* ring_peek(struct ring* r) {
+  if (ring_count(r) == 0) return 0;
+
+  return &r->buffer[r->tail & RING_MASK];
+}
+static void ring_pop(struct ring* r) {
+  __DMB(); /* Finish reading before the slot is handed back */
+  r->tail++;
+}
+
+/* -----------------------------------------------------------------------------
+ * Pipeline
+ */
+
+/**
+ * Feeds a freshly acquired sample into the pipeline. This is the
+ * producer side of the first ring, and so should only be called from
+ * one context. Every sample is numbered, even if it is then lost to
+ * an overflow, so gaps can be found further down.
+ */
+bool pipeline_acquire(struct sample* s) {
+  s->sequence = next_sequence++;
+
+  if (!ring_push(STAGE_COMPENSATE, s)) {
+    overflows++;
+    return false;
+  }
+
+  return true;
+}
+/**
+ * Sets the function for a stage. Stages without a function pass
+ * samples straight through.
+ */
+void pipeline_register(enum pipeline_stage stage, stage_fn fn) {
+  stage_fns[stage] = fn;
+}
+/**
+ * Runs a single stage until its input is empty, its output is full or
+ * it asks to retry. Returns true if any samples were consumed.
+ */
+bool pipeline_run_stage(enum pipeline_stage stage) {
+  struct ring* in = &rings[stage];
+  struct sample* head;
+  struct sample s;
+  enum stage_result result;
+  bool consumed = false;
+
+  while ((head = ring_peek(in))) {
+    /* Don't start on a sample we have nowhere to put */
+    if ((stage + 1 < STAGE_COUNT) &&
+        (ring_count(&rings[stage + 1]) >= PIPELINE_RING_SIZE)) {
+      break;
+    }
+
+    s = *head;
+
+    PROF_ENTER(STAGE);
+    result = stage_fns[stage] ? stage_fns[stage](&s) : STAGE_PASS;
+    PROF_EXIT_AT(STAGE, stage);
+
+    if (result == STAGE_RETRY) break;
+
+    if (result == STAGE_PASS) {
+      if (stage + 1 < STAGE_COUNT) {
+        ring_push(stage + 1, &s);
+      }
+      stats[stage].processed++;
+    } else {
+      stats[stage].dropped++;
+    }
+
+    ring_pop(in);
+    consumed = true;
+  }
+
+  return consumed;
+}
+/**
+ * Runs every stage that has input, in order
+ */
+void pipeline_poll(void) {
+  enum pipeline_stage stage;
+
+  for (stage = 0; stage < STAGE_COUNT; stage++) {
+    pipeline_run_stage(stage);
+  }
+}
+const struct stage_stats* pipeline_stats(enum pipeline_stage stage) {
+  return &stats[stage];
+}
+/**
+ * Number of acquired samples lost because the first stage was full
+ */
+uint32_t pipeline_overflows(void) {
+  return overflows;
+}
+/**
+ * The sequence number the next acquired sample will get
+ */
+uint16_t pipeline_sequence(void) {
+  return next_sequence;
+}
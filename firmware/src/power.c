@@ -0,0 +1,158 @@
+/*
+ * Power profiles
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Each profile sets the DC/DC converter, LFCLK source, TX power,
+ * advertising interval, sample period and BMP180 oversampling
+ * together. The sample period is either fixed, or bounds for the
+ * adaptive sampler. Selecting a profile copies the last four into the
+ * config, where they can be tuned for the unit, and they are applied
+ * from there.
+ *
+ * A new profile is applied from a SoftDevice event, which runs at the
+ * same priority as the measurement tick. So it can't land in the
+ * middle of taking a sample, and each sample records the OSS it was
+ * taken with for the compensation stage.
+ *
+ * The LFCLK source can only be changed by restarting the SoftDevice,
+ * so it comes from the profile in the config loaded at boot.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "nrf_sdm.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "ble.h"
+#include "linkq.h"
+#include "config.h"
+#include "control.h"
+#include "main.h"
+#include "power.h"
+
+static const struct power_profile profiles[POWER_PROFILE_COUNT] = {
+  [POWER_PROFILE_FLIGHT] = {
+    .name		= "flight",
+    .dcdc		= NRF_POWER_DCDC_MODE_AUTOMATIC,
+    /* Temperature changes quickly in flight, calibrate the RC often */
+    .lfclk		= NRF_CLOCK_LFCLKSRC_RC_250_PPM_250MS_CALIBRATION,
+    .tx_power		= 4,
+    .adv_interval	= 1600,	/* 1s */
+    /* Never slower than 1Hz, faster when it matters */
+    .sample_period	= 1000,
+    .sample_period_min	= 50,
+    .oss		= 3,
+  },
+  [POWER_PROFILE_BENCH] = {
+    .name		= "bench",
+    .dcdc		= NRF_POWER_DCDC_MODE_OFF,
+    .lfclk		= NRF_CLOCK_LFCLKSRC_RC_250_PPM_4000MS_CALIBRATION,
+    .tx_power		= -12,
+    .adv_interval	= 800,	/* 500ms */
+    /* Mostly sitting on a desk */
+    .sample_period	= 10000,
+    .sample_period_min	= 50,
+    .oss		= 1,
+  },
+  [POWER_PROFILE_STORAGE] = {
+    .name		= "storage",
+    .dcdc		= NRF_POWER_DCDC_MODE_AUTOMATIC,
+    .lfclk		= NRF_CLOCK_LFCLKSRC_RC_250_PPM_8000MS_CALIBRATION,
+    .tx_power		= -16,
+    .adv_interval	= 3200,	/* 2s */
+    .sample_period	= 60000,
+    .sample_period_min	= 0,
+    .oss		= 0,
+  },
+};
+
+static enum power_profile_id current = POWER_PROFILE;
+
+/**
+ * Picks the profile to boot with from the config. Call before the
+ * SoftDevice is enabled, so that the LFCLK source is known.
+ */
+void power_init(void) {
+  current = (enum power_profile_id)config()->power_profile;
+}
+/**
+ * Applies the profile in the config, and the sampling from the config,
+ * except the LFCLK source. Call after the SoftDevice is enabled, and
+ * again whenever the config changes. Any sampling set through the
+ * control point is replaced.
+ */
+void power_apply(void) {
+  /* The LFCLK source stays as it was at boot */
+  current = (enum power_profile_id)config()->power_profile;
+  APP_ERROR_CHECK(sd_power_dcdc_mode_set(profiles[current].dcdc));
+  linkq_tx_ceiling_set(profiles[current].tx_power);
+
+  control_reset();
+
+  /* The advertising interval is read when advertising next starts */
+}
+/**
+ * Copies a profile's presets into a config
+ */
+void power_preset(enum power_profile_id id, struct config* c) {
+  const struct power_profile* p = &profiles[id];
+
+  c->oss = p->oss;
+  c->sample_period = p->sample_period;
+  c->sample_period_min = p->sample_period_min;
+  c->adv_interval = p->adv_interval;
+}
+/**
+ * Switches to a new profile, and its presets, and keeps it in the
+ * config for the next boot
+ */
+uint32_t power_select(enum power_profile_id id) {
+  struct config c;
+  uint32_t err_code;
+
+  if (id >= POWER_PROFILE_COUNT) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+
+  c = *config();
+  c.power_profile = id;
+  power_preset(id, &c);
+
+  err_code = config_set(&c);
+  if (err_code != NRF_SUCCESS) return err_code;
+
+  power_apply();
+
+  return NRF_SUCCESS;
+}
+
+enum power_profile_id power_profile_id(void) {
+  return current;
+}
+const struct power_profile* power_profile(void) {
+  return &profiles[current];
+}
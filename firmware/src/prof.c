@@ -0,0 +1,229 @@
+/*
+ * Execution time profiling
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Times regions of code against TIMER2, free-running at 1MHz. The
+ * Cortex-M0 has no cycle counter, and TIMER0 belongs to the
+ * SoftDevice.
+ *
+ * TIMER2 is only 16 bits wide, so regions longer than 65ms wrap.
+ * Thread mode and interrupts capture into different CC registers so
+ * an interrupt can't clobber a capture the main loop is about to
+ * read. All the application's interrupts run at the same priority, so
+ * they never nest.
+ *
+ * The boot is timed from prof_init at the top of main. Starting the
+ * stack and waiting for the first sample both take longer than 65ms,
+ * so while the boot is timed TIMER2's wraps are counted in an
+ * interrupt to make it 32 bits wide. Each phase and milestone is
+ * recorded once, and isn't cleared by prof_reset. Once they all have
+ * been the interrupt is turned off again.
+ *
+ * Keeping TIMER2 running holds the HFCLK on, so this is only built in
+ * with PROF_ENABLED.
+ */
+
+#ifdef PROF_ENABLED
+
+#include <stdint.h>
+#include <string.h>
+
+#include "nrf.h"
+#include "nrf51_bitfields.h"
+#include "app_trace.h"
+#include "app_util_platform.h"
+#include "prof.h"
+
+#define PROF_TIMER		NRF_TIMER2
+#define PROF_TIMER_IRQn		TIMER2_IRQn
+#define PROF_PRESCALER		4	/* 16MHz / 2^4 = 1MHz */
+#define PROF_WRAP_CC		2	/* Compares at 0, so on every wrap */
+
+static struct prof_table table;
+static uint32_t boot_start, phase_start;
+static volatile uint16_t wraps;
+static uint8_t boot_left = PROF_BOOT_COUNT;
+
+static const char* const region_names[PROF_REGION_COUNT] = {
+  [PROF_ACQUIRE]	= "acquire",
+  [PROF_STAGE + STAGE_COMPENSATE] = "compensate",
+  [PROF_STAGE + STAGE_VALIDATE]	= "validate",
+  [PROF_STAGE + STAGE_FILTER]	= "filter",
+  [PROF_STAGE + STAGE_DETECT]	= "detect",
+  [PROF_STAGE + STAGE_ADAPT]	= "adapt",
+  [PROF_STAGE + STAGE_STATS]	= "stats",
+  [PROF_STAGE + STAGE_WEATHER]	= "weather",
+  [PROF_STAGE + STAGE_ENCODE]	= "encode",
+  [PROF_STAGE + STAGE_TRANSMIT] = "transmit",
+  [PROF_ADC_IRQ]	= "adc_irq",
+  [PROF_BLE_DISPATCH]	= "ble_dispatch",
+  [PROF_RADIO_NOTIFY]	= "radio_notify",
+};
+static const char* const boot_names[PROF_BOOT_COUNT] = {
+  [PROF_BOOT_INIT]	= "init",
+  [PROF_BOOT_STACK]	= "stack",
+  [PROF_BOOT_GATT]	= "gatt",
+  [PROF_BOOT_SENSOR]	= "sensor",
+  [PROF_BOOT_DEFERRED]	= "deferred",
+  [PROF_BOOT_FIRST_ADV]	= "first_adv",
+  [PROF_BOOT_FIRST_SAMPLE] = "first_sample",
+};
+
+/**
+ * Returns the current time in µs, modulo 2^16
+ */
+uint16_t prof_now(void) {
+  /* CC[0] for thread mode, CC[1] for interrupts */
+  uint32_t cc = (__get_IPSR() != 0) ? 1 : 0;
+
+  PROF_TIMER->TASKS_CAPTURE[cc] = 1;
+  return (uint16_t)PROF_TIMER->CC[cc];
+}
+/**
+ * Returns the current time in µs since TIMER2 started, modulo 2^32.
+ * Only valid while the wraps are being counted.
+ */
+static uint32_t boot_now(void) {
+  uint32_t high;
+  uint16_t now;
+
+  CRITICAL_REGION_ENTER();
+  now = prof_now();
+  high = wraps;
+  /* A wrap that came before the capture but hasn't been counted yet */
+  if (PROF_TIMER->EVENTS_COMPARE[PROF_WRAP_CC] && now < 0x8000) high++;
+  CRITICAL_REGION_EXIT();
+
+  return (high << 16) | now;
+}
+/**
+ * Counts TIMER2's wraps while the boot is timed
+ */
+void TIMER2_IRQHandler(void) {
+  if (PROF_TIMER->EVENTS_COMPARE[PROF_WRAP_CC]) {
+    PROF_TIMER->EVENTS_COMPARE[PROF_WRAP_CC] = 0;
+    wraps++;
+  }
+}
+/**
+ * Stops counting wraps once every phase and milestone is in
+ */
+static void boot_recorded(void) {
+  if (--boot_left == 0) {
+    PROF_TIMER->INTENCLR = TIMER_INTENSET_COMPARE2_Msk;
+  }
+}
+/**
+ * Records the end of a region
+ */
+void prof_record(enum prof_region region, uint16_t start) {
+  struct prof_entry* e = &table.regions[region];
+  uint16_t elapsed = prof_now() - start;
+  uint8_t bin;
+
+  if (e->count == 0 || elapsed < e->min) e->min = elapsed;
+  if (elapsed > e->max) e->max = elapsed;
+  e->count++;
+  e->total = (e->total > UINT32_MAX - elapsed) ? UINT32_MAX : e->total + elapsed;
+
+  /* floor(log4(elapsed)) */
+  for (bin = 0; (elapsed >> (2 * (bin + 1))) && bin < PROF_HIST_BINS - 1; bin++);
+  if (e->hist[bin] < UINT16_MAX) e->hist[bin]++;
+}
+/**
+ * Ends a boot phase and starts the next
+ */
+void prof_boot_phase(enum prof_boot phase) {
+  uint32_t now = boot_now();
+
+  table.boot[phase] = now - phase_start;
+  phase_start = now;
+  boot_recorded();
+}
+/**
+ * Marks a point in the boot, the first time it's reached
+ */
+void prof_milestone(enum prof_boot milestone) {
+  if (table.boot[milestone] == 0) {
+    table.boot[milestone] = boot_now() - boot_start;
+    boot_recorded();
+  }
+}
+struct prof_table* prof_table(void) {
+  return &table;
+}
+/**
+ * Prints the table over app_trace
+ */
+void prof_dump(void) {
+  uint8_t i, bin;
+  struct prof_entry* e;
+
+  app_trace_log("region        count    min    max   mean\r\n");
+  for (i = 0; i < PROF_REGION_COUNT; i++) {
+    e = &table.regions[i];
+    if (e->count == 0) continue;
+
+    app_trace_log("%-12s %6lu %6u %6u %6lu  ", region_names[i],
+                  (unsigned long)e->count, e->min, e->max,
+                  (unsigned long)(e->total / e->count));
+    for (bin = 0; bin < PROF_HIST_BINS; bin++) {
+      app_trace_log(" %u", e->hist[bin]);
+    }
+    app_trace_log("\r\n");
+  }
+
+  app_trace_log("boot           us\r\n");
+  for (i = 0; i < PROF_BOOT_COUNT; i++) {
+    app_trace_log("%-12s %8lu\r\n", boot_names[i], (unsigned long)table.boot[i]);
+  }
+}
+
+void prof_reset(void) {
+  memset(table.regions, 0, sizeof(table.regions));
+}
+
+void prof_init(void) {
+  app_trace_init();
+  prof_reset();
+
+  PROF_TIMER->MODE = TIMER_MODE_MODE_Timer;
+  PROF_TIMER->BITMODE = TIMER_BITMODE_BITMODE_16Bit;
+  PROF_TIMER->PRESCALER = PROF_PRESCALER;
+
+  /* Ahead of the SoftDevice, so the NVIC is still ours */
+  PROF_TIMER->CC[PROF_WRAP_CC] = 0;
+  PROF_TIMER->EVENTS_COMPARE[PROF_WRAP_CC] = 0;
+  PROF_TIMER->INTENSET = TIMER_INTENSET_COMPARE2_Msk;
+  NVIC_ClearPendingIRQ(PROF_TIMER_IRQn);
+  NVIC_SetPriority(PROF_TIMER_IRQn, NRF_APP_PRIORITY_LOW);
+  NVIC_EnableIRQ(PROF_TIMER_IRQn);
+
+  PROF_TIMER->TASKS_CLEAR = 1;
+  PROF_TIMER->TASKS_START = 1;
+
+  boot_start = phase_start = boot_now();
+}
+
+#endif /* PROF_ENABLED */
@@ -0,0 +1,282 @@
+/*
+ * Radio-aligned measurement scheduler
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * The battery and sensor share a single tick. While connected the
+ * work for a tick isn't done straight away, but is placed so that it
+ * finishes just before the next connection event. This keeps the TWI
+ * and ADC clear of the radio, and means the fresh sample goes out in
+ * the very next connection event.
+ *
+ * The start of each connection event is found from the SoftDevice's
+ * radio notification, which fires a fixed distance before the radio
+ * goes active. The next one is expected one connection interval
+ * later, and the work is started early enough that it finishes a
+ * guard time before then.
+ *
+ * The tick timer is re-armed on every tick against a deadline, the
+ * time the last tick was due plus the period, rather than from the
+ * time the handler got to run. Handler latency doesn't accumulate, and
+ * a change of period takes effect one new period after the last tick,
+ * so the adaptive sampler can move it as often as it likes without
+ * the ticks drifting.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "ble.h"
+#include "main.h"
+#include "sched.h"
+#include "prof.h"
+
+/**
+ * Radio notification comes this long before the radio is active
+ */
+#define RADIO_NOTIFICATION_DISTANCE	NRF_RADIO_NOTIFICATION_DISTANCE_800US
+/**
+ * Time to leave between the end of the work and the radio notification
+ */
+#define GUARD_TICKS			APP_TIMER_TICKS(2, APP_TIMER_PRESCALER)
+/**
+ * RTC1 is a 24-bit counter
+ */
+#define RTC_COUNTER_MASK		0xFFFFFF
+/**
+ * Converts a connection interval in 1.25ms units to timer ticks. One
+ * unit is exactly 1024/25 ticks, which keeps the product well inside
+ * 32 bits for the longest interval.
+ */
+#define CONN_INTERVAL_TICKS(interval)					\
+  (((uint32_t)(interval) * 1024) / (25 * (APP_TIMER_PRESCALER + 1)))
+
+static app_timer_id_t tick_timer_id;
+static app_timer_id_t align_timer_id;
+static sched_handler_t sched_handler;
+
+static uint32_t period_ticks;
+static uint32_t last_tick;	/* When the last tick was due */
+static bool running;
+static uint8_t work_due;
+static bool align_pending;
+static uint32_t battery_ticks;	/* Since the last battery measurement */
+static bool connected;
+static uint32_t conn_interval_ticks;
+static uint32_t work_ticks;	/* Longest the work has taken so far */
+
+/**
+ * Does the due work, and keeps track of how long it takes
+ */
+static void do_work(void) {
+  uint32_t start, end, diff;
+  uint8_t work = work_due;
+
+  if (!work) return;
+  work_due = 0;
+
+  app_timer_cnt_get(&start);
+  sched_handler(work);
+  app_timer_cnt_get(&end);
+
+  app_timer_cnt_diff_compute(end, start, &diff);
+  if (diff > work_ticks) {
+    work_ticks = diff;
+  }
+}
+
+/**
+ * Starts the tick timer for one period after the last tick. If that
+ * has already passed, the tick happens as soon as it can.
+ */
+static void tick_timer_start(void) {
+  uint32_t now, elapsed, timeout;
+
+  app_timer_cnt_get(&now);
+  app_timer_cnt_diff_compute(now, last_tick, &elapsed);
+
+  if (elapsed + APP_TIMER_MIN_TIMEOUT_TICKS < period_ticks) {
+    timeout = period_ticks - elapsed;
+  } else {
+    timeout = APP_TIMER_MIN_TIMEOUT_TICKS;
+  }
+
+  APP_ERROR_CHECK(app_timer_start(tick_timer_id, timeout, NULL));
+}
+
+/**
+ * Called once per period
+ */
+static void tick_timeout_handler(void* p_context) {
+  uint32_t now, late;
+
+  app_timer_cnt_get(&now);
+  last_tick = (last_tick + period_ticks) & RTC_COUNTER_MASK;
+  app_timer_cnt_diff_compute(now, last_tick, &late);
+  if (late >= period_ticks) {
+    /* A whole period behind, most likely as the period just got
+     * shorter. Start again from now rather than catch up */
+    last_tick = now;
+  }
+  tick_timer_start();
+
+  if (work_due) {
+    /* Work from the last tick never found a slot. Maybe there's slave
+     * latency, or the radio notifications stopped. Don't wait any more */
+    do_work();
+  }
+
+  work_due |= SCHED_WORK_SAMPLE;
+  battery_ticks += period_ticks;
+  if (battery_ticks >= APP_TIMER_TICKS(SCHED_BATTERY_INTERVAL, APP_TIMER_PRESCALER)) {
+    battery_ticks = 0;
+    work_due |= SCHED_WORK_BATTERY;
+  }
+
+  /* Nothing to line up with */
+  if (!connected) {
+    do_work();
+  }
+}
+/**
+ * Fires just early enough for the work to finish before the next
+ * connection event
+ */
+static void align_timeout_handler(void* p_context) {
+  align_pending = false;
+  do_work();
+}
+
+/**
+ * Radio notification interrupt. Fires before every radio event.
+ */
+static void radio_notification(void) {
+  uint32_t lead, delay;
+
+  if (!connected || !work_due || align_pending) return;
+
+  lead = work_ticks + GUARD_TICKS;
+
+  if (conn_interval_ticks > lead + APP_TIMER_MIN_TIMEOUT_TICKS) {
+    delay = conn_interval_ticks - lead;
+
+    APP_ERROR_CHECK(app_timer_start(align_timer_id, delay, NULL));
+    align_pending = true;
+  }
+  /* Otherwise the connection interval is shorter than the work, so it
+   * can't be kept clear of the radio. Leave it for the next tick */
+}
+void SWI1_IRQHandler(void) {
+  PROF_ENTER(RADIO_NOTIFY);
+  radio_notification();
+  PROF_EXIT(RADIO_NOTIFY);
+}
+
+/**
+ * Keeps track of the connection state and interval
+ */
+void sched_on_ble_evt(ble_evt_t* p_ble_evt) {
+  ble_gap_evt_t* p_gap_evt = &p_ble_evt->evt.gap_evt;
+
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+      connected = true;
+      conn_interval_ticks =
+        CONN_INTERVAL_TICKS(p_gap_evt->params.connected.conn_params.max_conn_interval);
+      break;
+    case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+      conn_interval_ticks =
+        CONN_INTERVAL_TICKS(p_gap_evt->params.conn_param_update.conn_params.max_conn_interval);
+      break;
+    case BLE_GAP_EVT_DISCONNECTED:
+      connected = false;
+      app_timer_stop(align_timer_id);
+      align_pending = false;
+      break;
+    default:
+      break;
+  }
+}
+
+void sched_init(sched_handler_t handler) {
+  uint32_t err_code;
+
+  sched_handler = handler;
+
+  err_code = app_timer_create(&tick_timer_id,
+                              APP_TIMER_MODE_SINGLE_SHOT,
+                              tick_timeout_handler);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = app_timer_create(&align_timer_id,
+                              APP_TIMER_MODE_SINGLE_SHOT,
+                              align_timeout_handler);
+  APP_ERROR_CHECK(err_code);
+
+  /* Radio notifications, same priority as the app_timer handlers */
+  err_code = sd_radio_notification_cfg_set(NRF_RADIO_NOTIFICATION_TYPE_INT_ON_ACTIVE,
+                                           RADIO_NOTIFICATION_DISTANCE);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = sd_nvic_ClearPendingIRQ(SWI1_IRQn);
+  APP_ERROR_CHECK(err_code);
+  err_code = sd_nvic_SetPriority(SWI1_IRQn, NRF_APP_PRIORITY_LOW);
+  APP_ERROR_CHECK(err_code);
+  err_code = sd_nvic_EnableIRQ(SWI1_IRQn);
+  APP_ERROR_CHECK(err_code);
+}
+/**
+ * Sets the tick period. If the scheduler is running the next tick
+ * comes one new period after the last, or straight away if that has
+ * passed.
+ */
+void sched_set_period(uint32_t ticks) {
+  if (ticks == period_ticks) return;
+
+  period_ticks = ticks;
+
+  if (running) {
+    app_timer_stop(tick_timer_id);
+    tick_timer_start();
+  }
+}
+void sched_start(void) {
+  battery_ticks = 0;
+  work_due = 0;
+  running = true;
+
+  app_timer_stop(tick_timer_id);
+  app_timer_cnt_get(&last_tick);
+  tick_timer_start();
+}
+void sched_stop(void) {
+  running = false;
+  app_timer_stop(tick_timer_id);
+  app_timer_stop(align_timer_id);
+  align_pending = false;
+  work_due = 0;
+}
@@ -0,0 +1,316 @@
+/*
+ * Windowed statistics
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Summarises the samples over windows, so a client that only wants
+ * the minimum, maximum, mean and spread every so often doesn't have
+ * to take every sample. Runs as a pipeline stage.
+ *
+ * Each period's samples go into a bucket. When a period closes, the
+ * last config.buckets buckets are combined and the summary notified.
+ * With one bucket the windows tumble, with more they slide along a
+ * period at a time.
+ *
+ * Sums are kept from a reference, the first value in each bucket, so
+ * they stay small and exact in integers. Buckets are combined by
+ * moving them onto a common reference, and the reference is moved to
+ * the mean before the variance is taken. Nothing is lost to rounding
+ * until the final divisions.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "ble.h"
+#include "ble_srv_common.h"
+#include "telemetry.h"
+#include "main.h"
+#include "stats.h"
+
+struct moments {
+  uint32_t count;
+  int32_t min, max;
+  int32_t ref;
+  int64_t sum;			/* Of value - ref */
+  int64_t sum_sq;		/* Of (value - ref)^2 */
+};
+
+struct bucket {
+  struct moments pressure;	/* Pa */
+  struct moments temperature;	/* 0.1°C */
+};
+
+static struct stats_config config = { 0, 1, 0 };
+static struct bucket buckets[STATS_BUCKETS_MAX];
+static uint8_t current;		/* Bucket being filled */
+static uint8_t filled;		/* Complete buckets, up to config.buckets */
+static uint32_t elapsed;	/* Ticks into the current period */
+static uint32_t last_timestamp;
+static bool running;		/* last_timestamp is set */
+
+static ble_ess_t* stats_ess;
+static ble_gatts_char_handles_t* summary_handles;
+
+/* -----------------------------------------------------------------------------
+ * Moments
+ */
+
+static void moments_add(struct moments* m, int32_t value) {
+  int32_t d;
+
+  if (m->count == 0) {
+    m->min = m->max = m->ref = value;
+  }
+  if (value < m->min) m->min = value;
+  if (value > m->max) m->max = value;
+
+  d = value - m->ref;
+  m->count++;
+  m->sum += d;
+  m->sum_sq += (int64_t)d * d;
+}
+/**
+ * Adds b into a, moving b's sums onto a's reference
+ */
+static void moments_merge(struct moments* a, const struct moments* b) {
+  int64_t d;
+
+  if (b->count == 0) return;
+  if (a->count == 0) {
+    *a = *b;
+    return;
+  }
+
+  d = b->ref - a->ref;
+  a->sum_sq += b->sum_sq + 2 * d * b->sum + (int64_t)b->count * d * d;
+  a->sum += b->sum + (int64_t)b->count * d;
+  a->count += b->count;
+  if (b->min < a->min) a->min = b->min;
+  if (b->max > a->max) a->max = b->max;
+}
+static int64_t div_round(int64_t n, int64_t d) {
+  return (n >= 0) ? (n + d / 2) / d : (n - d / 2) / d;
+}
+/**
+ * Returns the mean in tenths of a unit, and sets the variance in
+ * hundredths of a unit squared. There must be at least one value.
+ */
+static int32_t moments_result(const struct moments* m, uint64_t* variance) {
+  int64_t n = m->count;
+  int64_t q, sum, sum_sq, m2;
+
+  /* Move the reference to the whole unit nearest the mean */
+  q = div_round(m->sum, n);
+  sum = m->sum - n * q;
+  sum_sq = m->sum_sq - 2 * q * m->sum + n * q * q;
+
+  m2 = 100 * sum_sq - div_round(100 * sum * sum, n);
+  *variance = (m2 > 0) ? (uint64_t)(m2 / n) : 0;
+
+  return (int32_t)(10 * (m->ref + q) + div_round(10 * sum, n));
+}
+static uint32_t isqrt(uint64_t x) {
+  uint64_t root = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+
+  while (bit > x) bit >>= 2;
+  while (bit) {
+    if (x >= root + bit) {
+      x -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+
+  return (uint32_t)root;
+}
+static uint32_t saturate(uint32_t value, uint32_t max) {
+  return (value > max) ? max : value;
+}
+static void uint24_encode(uint32_t value, uint8_t* p) {
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+}
+
+/* -----------------------------------------------------------------------------
+ * Windows
+ */
+
+/**
+ * Combines the complete buckets into a summary and notifies it
+ */
+static void summary_send(void) {
+  struct bucket window;
+  uint8_t summary[STATS_SUMMARY_SIZE];
+  uint64_t variance;
+  int32_t mean;
+  uint8_t i;
+  uint32_t err_code;
+
+  memset(&window, 0, sizeof(window));
+  for (i = 0; i < filled; i++) {
+    const struct bucket* b = &buckets[(current + config.buckets - i) % config.buckets];
+
+    moments_merge(&window.pressure, &b->pressure);
+    moments_merge(&window.temperature, &b->temperature);
+  }
+  if (window.pressure.count == 0) return;
+
+  uint16_encode(saturate(window.pressure.count, UINT16_MAX), &summary[0]);
+
+  mean = moments_result(&window.pressure, &variance);
+  uint24_encode(window.pressure.min * 10, &summary[2]);
+  uint24_encode(window.pressure.max * 10, &summary[5]);
+  uint24_encode(mean, &summary[8]);
+  uint16_encode(saturate(isqrt(variance), UINT16_MAX), &summary[11]);
+
+  mean = moments_result(&window.temperature, &variance);
+  uint16_encode((uint16_t)(window.temperature.min * 10), &summary[13]);
+  uint16_encode((uint16_t)(window.temperature.max * 10), &summary[15]);
+  uint16_encode((uint16_t)mean, &summary[17]);
+  summary[19] = saturate(isqrt(variance) / 10, UINT8_MAX);
+
+  if (stats_ess == NULL) return;
+
+  err_code = ble_ess_char_update(stats_ess, summary_handles, summary, sizeof(summary),
+                                 BLE_GATT_HVX_NOTIFICATION);
+  telemetry_hvx_result(err_code);
+
+  /* The value is set even if it can't be sent now */
+  if (err_code != NRF_SUCCESS &&
+      err_code != BLE_ERROR_NO_TX_BUFFERS &&
+      err_code != NRF_ERROR_INVALID_STATE &&
+      err_code != BLE_ERROR_INVALID_CONN_HANDLE &&
+      err_code != BLE_ERROR_GATTS_SYS_ATTR_MISSING) {
+    APP_ERROR_HANDLER(err_code);
+  }
+}
+/**
+ * Closes the current period, and starts the next bucket
+ */
+static void period_close(void) {
+  if (filled < config.buckets) filled++;
+  summary_send();
+
+  current = (current + 1) % config.buckets;
+  memset(&buckets[current], 0, sizeof(buckets[current]));
+}
+
+/* -----------------------------------------------------------------------------
+ * API
+ */
+
+/**
+ * Replaces the config and starts again with empty windows. Returns
+ * false, leaving things as they were, if it is out of range.
+ */
+bool stats_configure(const struct stats_config* c) {
+  if (c->period != 0 &&
+      (c->period < STATS_PERIOD_MIN || c->period > STATS_PERIOD_MAX ||
+       c->buckets < 1 || c->buckets > STATS_BUCKETS_MAX)) {
+    return false;
+  }
+
+  config = *c;
+  config.reserved = 0;
+  if (config.period == 0) config.buckets = 1;
+
+  memset(buckets, 0, sizeof(buckets));
+  current = 0;
+  filled = 0;
+  elapsed = 0;
+  running = false;
+
+  return true;
+}
+const struct stats_config* stats_config(void) {
+  return &config;
+}
+/**
+ * Returns true if a client is waiting for summaries, so samples have
+ * to be taken for them
+ */
+bool stats_subscribed(void) {
+  uint8_t cccd[2];
+  uint16_t len = sizeof(cccd);
+
+  if (config.period == 0 || stats_ess == NULL ||
+      stats_ess->conn_handle == BLE_CONN_HANDLE_INVALID) {
+    return false;
+  }
+
+  return (sd_ble_gatts_value_get(summary_handles->cccd_handle, 0, &len, cccd) == NRF_SUCCESS) &&
+    ble_srv_is_notification_enabled(cccd);
+}
+
+/**
+ * Pipeline stage that adds each sample to the current bucket, closing
+ * any periods that have ended first. The sample is passed on
+ * untouched. Synthetic samples aren't summarised.
+ */
+enum stage_result stats_stage(struct sample* s) {
+  uint32_t period_ticks, dt;
+  uint8_t closes = 0;
+
+  if (s->flags & SAMPLE_FLAG_SYNTHETIC) return STAGE_PASS;
+  if (config.period == 0) return STAGE_PASS;
+
+  period_ticks = APP_TIMER_TICKS((uint32_t)config.period * 1000, APP_TIMER_PRESCALER);
+
+  if (running) {
+    app_timer_cnt_diff_compute(s->timestamp, last_timestamp, &dt);
+    elapsed += dt;
+  }
+  last_timestamp = s->timestamp;
+  running = true;
+
+  /* After a long gap only the last window's worth are closed */
+  while (elapsed >= period_ticks) {
+    elapsed -= period_ticks;
+    if (closes++ <= config.buckets) period_close();
+  }
+
+  moments_add(&buckets[current].pressure, s->pressure);
+  moments_add(&buckets[current].temperature, s->temperature);
+
+  return STAGE_PASS;
+}
+
+void stats_gatt_init(ble_ess_t* p_ess, ble_gatts_char_handles_t* p_summary_handles) {
+  stats_ess = p_ess;
+  summary_handles = p_summary_handles;
+}
+void stats_init(void) {
+  struct stats_config off = { 0, 1, 0 };
+
+  (void)stats_configure(&off);
+}
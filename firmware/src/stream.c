@@ -0,0 +1,369 @@
+/*
+ * High-rate pressure streaming
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Runs back to back BMP180 conversions at a low oversampling setting,
+ * and packs the results into notifications.
+ *
+ * Each conversion is waited for with a single-shot app_timer instead
+ * of a busy wait. Temperature changes slowly, so it is only converted
+ * once every STREAM_TEMPERATURE_DECIMATION pressure samples. At
+ * ULTRALOW this gives around 200 samples/s.
+ *
+ * Full packets are queued, and sent as soon as the SoftDevice has a
+ * free TX buffer, so every buffer is in use at each connection
+ * event. A short connection interval is requested while streaming.
+ *
+ * The measurement tick is stopped while streaming, so nothing else
+ * uses the sensor. A conversion already under way for an on demand
+ * read or a burst capture is left to finish first, and the stream
+ * starts from its completion.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nrf.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "ble.h"
+#include "ble_ess.h"
+#include "ble_conn_params.h"
+#include "bmp180.h"
+#include "pipeline.h"
+#include "capture.h"
+#include "control.h"
+#include "convert.h"
+#include "sched.h"
+#include "telemetry.h"
+#include "validate.h"
+#include "main.h"
+#include "stream.h"
+
+#define QUEUE_MASK		(STREAM_QUEUE_SIZE - 1)
+
+#if (STREAM_QUEUE_SIZE & QUEUE_MASK) != 0
+#error STREAM_QUEUE_SIZE must be a power of two
+#endif
+
+/**
+ * Ticks in a second, for working out rates
+ */
+#define RATE_WINDOW_TICKS	APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER)
+
+/**
+ * Connection interval requested while streaming
+ */
+#define STREAM_MIN_CONN_INTERVAL	MSEC_TO_UNITS(7.5, UNIT_1_25_MS)
+#define STREAM_MAX_CONN_INTERVAL	MSEC_TO_UNITS(20, UNIT_1_25_MS)
+#define STREAM_CONN_SUP_TIMEOUT		MSEC_TO_UNITS(4000, UNIT_10_MS)
+
+static ble_ess_t* stream_ess;
+static ble_gatts_char_handles_t* stream_handles;
+static app_timer_id_t conv_timer_id;
+
+static bool streaming;
+static bool pending;		/* Waiting for the sensor */
+static uint16_t conn_handle = BLE_CONN_HANDLE_INVALID;
+static ble_gap_conn_params_t saved_conn_params;
+
+/* Conversions */
+static bool converting_temperature;
+static uint8_t oss;
+static uint8_t decimate;
+static int32_t ut;
+static struct sample last_good;
+
+/* Packet queue. Only touched from the timer and SoftDevice event
+ * handlers, which run at the same priority */
+static uint8_t queue[STREAM_QUEUE_SIZE][STREAM_PACKET_SIZE];
+static uint8_t head, tail;
+static uint8_t fill;		/* Samples in the packet at head */
+static uint16_t seq;
+static uint8_t tx_buffers;
+static uint8_t tx_free;
+
+/* Statistics */
+static struct stream_stats stats;
+static uint32_t window_start;
+static uint16_t window_samples, window_packets;
+
+/**
+ * Sends queued packets while there are free TX buffers
+ */
+static void queue_flush(void) {
+  uint32_t err_code;
+
+  while (tx_free && tail != head) {
+    err_code = ble_ess_char_update(stream_ess, stream_handles, queue[tail & QUEUE_MASK],
+                                   STREAM_PACKET_SIZE, BLE_GATT_HVX_NOTIFICATION);
+    telemetry_hvx_result(err_code);
+
+    if (err_code == BLE_ERROR_NO_TX_BUFFERS) {
+      /* Someone else got there first */
+      tx_free = 0;
+      break;
+    } else if (err_code == NRF_SUCCESS) {
+      tx_free--;
+      window_packets++;
+    } else if (err_code != NRF_ERROR_INVALID_STATE &&
+               err_code != BLE_ERROR_GATTS_SYS_ATTR_MISSING) {
+      APP_ERROR_HANDLER(err_code);
+    }
+
+    tail++;
+  }
+}
+/**
+ * Updates the sample and packet rates once a second
+ */
+static void rates_update(uint32_t now) {
+  uint32_t diff;
+
+  app_timer_cnt_diff_compute(now, window_start, &diff);
+
+  if (diff >= RATE_WINDOW_TICKS) {
+    stats.sample_rate = ((uint32_t)window_samples * RATE_WINDOW_TICKS) / diff;
+    stats.packet_rate = ((uint32_t)window_packets * RATE_WINDOW_TICKS) / diff;
+
+    window_start = now;
+    window_samples = window_packets = 0;
+  }
+}
+/**
+ * Adds a compensated sample to the packet being built
+ */
+static void sample_add(struct sample* s) {
+  uint8_t* packet = queue[head & QUEUE_MASK];
+  uint8_t* p;
+
+  if (fill == 0) {
+    packet[0] = seq & 0xFF;
+    packet[1] = seq >> 8;
+  }
+  packet[2] = s->temperature & 0xFF;
+  packet[3] = (uint16_t)s->temperature >> 8;
+
+  p = &packet[5 + (3 * fill)];
+  p[0] = s->pressure & 0xFF;
+  p[1] = (s->pressure >> 8) & 0xFF;
+  p[2] = (s->pressure >> 16) & 0xFF;
+
+  packet[4] = ++fill;
+  seq++;
+  stats.samples++;
+  window_samples++;
+
+  if (fill == STREAM_SAMPLES_PER_PACKET) {
+    fill = 0;
+
+    if ((uint8_t)(head - tail) < STREAM_QUEUE_SIZE - 1) {
+      head++;
+    } else {
+      /* Queue full, this packet is overwritten by the next */
+      stats.dropped += STREAM_SAMPLES_PER_PACKET;
+    }
+
+    queue_flush();
+  }
+
+  rates_update(s->timestamp);
+}
+
+/**
+ * Called when a conversion should have finished. Reads it and starts
+ * the next one
+ */
+static void conv_timeout_handler(void* p_context) {
+  struct sample s;
+  uint32_t delay;
+
+  if (!streaming) return;
+
+  if (converting_temperature) {
+    ut = bmp180_read_ut();
+  } else {
+    app_timer_cnt_get(&s.timestamp);
+    s.ut = ut;
+    s.up = bmp180_read_up(oss);
+    s.oss = oss;
+    s.flags = bmp180_twi_error() ? SAMPLE_FLAG_TWI_ERROR : 0;
+
+    bmp180_compensate(&s);
+    telemetry_inc(TELEMETRY_SAMPLES);
+
+    /* A bad read goes out as the last good one, or zero before there
+     * has been one, so the timing of the rest isn't lost */
+    if (validate_check(&s)) {
+      s.pressure = last_good.pressure;
+      s.temperature = last_good.temperature;
+    } else {
+      last_good = s;
+    }
+    sample_add(&s);
+  }
+
+  if (decimate == 0) {
+    decimate = STREAM_TEMPERATURE_DECIMATION;
+    converting_temperature = true;
+
+    bmp180_start_temperature();
+    delay = APP_TIMER_US_TO_TICKS(BMP180_TEMPERATURE_DELAY);
+  } else {
+    decimate--;
+    converting_temperature = false;
+
+    bmp180_start_pressure(oss);
+    delay = APP_TIMER_US_TO_TICKS(bmp180_pressure_delay(oss));
+  }
+
+  APP_ERROR_CHECK(app_timer_start(conv_timer_id, delay, NULL));
+}
+
+/**
+ * Takes the sensor, which has to be free
+ */
+static void begin(void) {
+  ble_gap_conn_params_t conn_params;
+
+  oss = control_settings()->oss;
+  if (oss > STREAM_OSS_MAX) oss = STREAM_OSS_MAX;
+
+  head = tail = fill = 0;
+  memset(&stats, 0, sizeof(stats));
+  window_samples = window_packets = 0;
+  app_timer_cnt_get(&window_start);
+
+  APP_ERROR_CHECK(sd_ble_tx_buffer_count_get(&tx_buffers));
+  tx_free = tx_buffers;
+
+  /* Ask for a short connection interval */
+  APP_ERROR_CHECK(sd_ble_gap_ppcp_get(&saved_conn_params));
+  conn_params.min_conn_interval = STREAM_MIN_CONN_INTERVAL;
+  conn_params.max_conn_interval = STREAM_MAX_CONN_INTERVAL;
+  conn_params.slave_latency = 0;
+  conn_params.conn_sup_timeout = STREAM_CONN_SUP_TIMEOUT;
+  APP_ERROR_CHECK(ble_conn_params_change_conn_params(&conn_params));
+
+  streaming = true;
+
+  /* Start with a temperature conversion */
+  converting_temperature = true;
+  decimate = STREAM_TEMPERATURE_DECIMATION;
+  bmp180_start_temperature();
+  APP_ERROR_CHECK(app_timer_start(conv_timer_id,
+                                  APP_TIMER_US_TO_TICKS(BMP180_TEMPERATURE_DELAY), NULL));
+}
+/**
+ * Starts streaming. Called when the stream characteristic's
+ * notifications are enabled. If a conversion is under way the stream
+ * waits for stream_sensor_free.
+ */
+void stream_start(void) {
+  if (streaming || pending || conn_handle == BLE_CONN_HANDLE_INVALID) return;
+
+  /* Keep the sensor to ourselves */
+  sched_stop();
+
+  if (convert_busy() || capture_converting()) {
+    pending = true;
+    return;
+  }
+
+  begin();
+}
+/**
+ * Called when a conversion for someone else has finished, to start a
+ * stream that was waiting for it
+ */
+void stream_sensor_free(void) {
+  if (!pending || convert_busy() || capture_converting()) return;
+
+  pending = false;
+  begin();
+}
+/**
+ * Stops streaming and goes back to the measurement tick. Once the
+ * link has gone the usual connection parameters are only put back for
+ * the next connection, as there's nothing left to update.
+ */
+void stream_stop(void) {
+  if (pending) {
+    pending = false;
+    sched_start();
+    return;
+  }
+  if (!streaming) return;
+
+  streaming = false;
+  app_timer_stop(conv_timer_id);
+
+  /* Back to the usual connection interval */
+  if (conn_handle != BLE_CONN_HANDLE_INVALID) {
+    APP_ERROR_CHECK(ble_conn_params_change_conn_params(&saved_conn_params));
+  } else {
+    APP_ERROR_CHECK(sd_ble_gap_ppcp_set(&saved_conn_params));
+  }
+
+  sched_start();
+}
+/**
+ * True from the start, including while waiting for the sensor
+ */
+bool stream_active(void) {
+  return streaming || pending;
+}
+struct stream_stats* stream_stats(void) {
+  return &stats;
+}
+
+void stream_on_ble_evt(ble_evt_t* p_ble_evt) {
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+      conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+      break;
+    case BLE_GAP_EVT_DISCONNECTED:
+      conn_handle = BLE_CONN_HANDLE_INVALID;
+      stream_stop();
+      break;
+    case BLE_EVT_TX_COMPLETE:
+      tx_free += p_ble_evt->evt.common_evt.params.tx_complete.count;
+      if (tx_free > tx_buffers) tx_free = tx_buffers;
+
+      if (streaming) queue_flush();
+      break;
+    default:
+      break;
+  }
+}
+
+void stream_init(ble_ess_t* p_ess, ble_gatts_char_handles_t* p_handles) {
+  stream_ess = p_ess;
+  stream_handles = p_handles;
+
+  APP_ERROR_CHECK(app_timer_create(&conv_timer_id,
+                                   APP_TIMER_MODE_SINGLE_SHOT,
+                                   conv_timeout_handler));
+}
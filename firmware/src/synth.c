@@ -0,0 +1,338 @@
+/*
+ * Synthetic data source
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Generates samples in place of the BMP180, so the path from the
+ * pipeline to the client can be loaded harder and more predictably
+ * than the sensor allows.
+ *
+ * Samples are made already compensated and enter the pipeline like
+ * any other, so compensation passes them through and they are
+ * encoded and sent to ble_ess as normal. They can be made at any
+ * rate: the timer runs at up to 200Hz, and each timeout makes however
+ * many samples are due.
+ *
+ * At the transmit stage each sample is checked against a second copy
+ * of the generator. The pipeline numbers every sample it accepts or
+ * drops, so a jump in the sequence is counted as a gap, the copy is
+ * moved on by the same amount, and the value must then match.
+ *
+ * Only built in with SYNTH_ENABLED.
+ */
+
+#ifdef SYNTH_ENABLED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nrf.h"
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "ble_sensorsim.h"
+#include "ble_ess.h"
+#include "pipeline.h"
+#include "main.h"
+#include "synth.h"
+
+#define TICKS_PER_SECOND	APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER)
+#define MIN_PERIOD_TICKS	APP_TIMER_TICKS(5, APP_TIMER_PRESCALER)
+
+/**
+ * Ramp, in Pa and 0.1°C. The sensor simulator only counts up from
+ * zero, so temperature is offset.
+ */
+#define RAMP_PRESSURE_MIN	30000
+#define RAMP_PRESSURE_MAX	110000
+#define RAMP_PRESSURE_STEP	10
+#define RAMP_TEMPERATURE_MIN	-400
+#define RAMP_TEMPERATURE_MAX	850
+#define RAMP_TEMPERATURE_STEP	1
+
+#define SINE_PRESSURE		100000
+#define SINE_TEMPERATURE	200
+#define SINE_PERIOD		64	/* Samples */
+
+#define STEP_PRESSURE		100000
+#define STEP_PRESSURE_CHANGE	1000
+#define STEP_TEMPERATURE	200
+#define STEP_TEMPERATURE_CHANGE	50
+#define STEP_LENGTH		32	/* Samples */
+
+#define REPLAY_STEPS		32	/* Samples between table entries */
+
+/**
+ * A quarter of a sine wave, amplitude 1000
+ */
+static const int16_t quarter_sine[SINE_PERIOD / 4 + 1] = {
+  0, 98, 195, 290, 383, 471, 556, 634, 707, 773, 831, 882, 924, 957, 981, 995, 1000
+};
+
+/**
+ * The International Standard Atmosphere at each km up to 30km, about
+ * where a latex balloon bursts. Replayed on the way up and back down.
+ * A recorded flight can be dropped in here in the same units.
+ */
+static const struct {
+  int32_t pressure;		/* Pa */
+  int16_t temperature;		/* 0.1°C */
+} flight[] = {
+  { 101325,  150 },	/*  0 km */
+  {  89875,   85 },
+  {  79495,   20 },
+  {  70109,  -45 },
+  {  61640, -110 },
+  {  54020, -175 },	/*  5 km */
+  {  47181, -240 },
+  {  41061, -305 },
+  {  35600, -370 },
+  {  30742, -435 },
+  {  26436, -500 },	/* 10 km */
+  {  22632, -565 },
+  {  19330, -565 },
+  {  16511, -565 },
+  {  14102, -565 },
+  {  12045, -565 },	/* 15 km */
+  {  10288, -565 },
+  {   8787, -565 },
+  {   7505, -565 },
+  {   6410, -565 },
+  {   5475, -565 },	/* 20 km */
+  {   4678, -555 },
+  {   4000, -545 },
+  {   3422, -535 },
+  {   2930, -525 },
+  {   2511, -515 },	/* 25 km */
+  {   2153, -505 },
+  {   1847, -495 },
+  {   1586, -485 },
+  {   1363, -475 },
+  {   1172, -465 },	/* 30 km */
+};
+#define FLIGHT_SEGMENTS		(sizeof(flight) / sizeof(flight[0]) - 1)
+
+static const ble_sensorsim_cfg_t ramp_pressure_cfg = {
+  .min = RAMP_PRESSURE_MIN,
+  .max = RAMP_PRESSURE_MAX,
+  .incr = RAMP_PRESSURE_STEP,
+  .start_at_max = true,
+};
+static const ble_sensorsim_cfg_t ramp_temperature_cfg = {
+  .min = 0,
+  .max = RAMP_TEMPERATURE_MAX - RAMP_TEMPERATURE_MIN,
+  .incr = RAMP_TEMPERATURE_STEP,
+  .start_at_max = true,
+};
+
+struct generator {
+  enum synth_profile profile;
+  uint32_t n;
+  ble_sensorsim_state_t pressure_state;
+  ble_sensorsim_state_t temperature_state;
+};
+
+static enum synth_profile profile;
+static uint16_t rate;
+static struct generator source;	/* Feeds the pipeline */
+static struct generator mirror;	/* Follows the samples out of it */
+static uint16_t expected;	/* Sequence of the next sample out */
+static uint32_t period_ticks;
+static uint32_t due;		/* Samples owed, in 1/TICKS_PER_SECOND */
+static app_timer_id_t timer_id;
+static struct synth_status status;	/* Read straight from RAM, and written */
+
+/* -----------------------------------------------------------------------------
+ * Profiles
+ */
+
+static int16_t sine(uint32_t n) {
+  uint8_t i = n % SINE_PERIOD;
+
+  if (i <= SINE_PERIOD / 4)	return quarter_sine[i];
+  if (i <= SINE_PERIOD / 2)	return quarter_sine[SINE_PERIOD / 2 - i];
+  if (i <= SINE_PERIOD * 3 / 4)	return -quarter_sine[i - SINE_PERIOD / 2];
+  return -quarter_sine[SINE_PERIOD - i];
+}
+/**
+ * Up the table and back down again, linear in between
+ */
+static void replay(uint32_t n, int32_t* p_pressure, int16_t* p_temperature) {
+  uint32_t segment = (n / REPLAY_STEPS) % (2 * FLIGHT_SEGMENTS);
+  int32_t step = n % REPLAY_STEPS;
+  uint8_t from, to;
+
+  if (segment < FLIGHT_SEGMENTS) {
+    from = segment;
+    to = segment + 1;
+  } else {
+    from = 2 * FLIGHT_SEGMENTS - segment;
+    to = from - 1;
+  }
+
+  *p_pressure = flight[from].pressure +
+    ((flight[to].pressure - flight[from].pressure) * step) / REPLAY_STEPS;
+  *p_temperature = flight[from].temperature +
+    ((flight[to].temperature - flight[from].temperature) * step) / REPLAY_STEPS;
+}
+
+static void generator_init(struct generator* g, enum synth_profile profile) {
+  g->profile = profile;
+  g->n = 0;
+  ble_sensorsim_init(&g->pressure_state, &ramp_pressure_cfg);
+  ble_sensorsim_init(&g->temperature_state, &ramp_temperature_cfg);
+}
+/**
+ * Produces the next values, in Pa and 0.1°C
+ */
+static void generator_next(struct generator* g, int32_t* p_pressure, int16_t* p_temperature) {
+  switch (g->profile) {
+    case SYNTH_RAMP:
+      *p_pressure = ble_sensorsim_measure(&g->pressure_state, &ramp_pressure_cfg);
+      *p_temperature = RAMP_TEMPERATURE_MIN +
+        (int16_t)ble_sensorsim_measure(&g->temperature_state, &ramp_temperature_cfg);
+      break;
+    case SYNTH_SINE:
+      *p_pressure = SINE_PRESSURE + sine(g->n);
+      *p_temperature = SINE_TEMPERATURE + sine(g->n + SINE_PERIOD / 4) / 20;
+      break;
+    case SYNTH_STEP:
+      *p_pressure = STEP_PRESSURE + ((g->n / STEP_LENGTH) & 1) * STEP_PRESSURE_CHANGE;
+      *p_temperature = STEP_TEMPERATURE - ((g->n / STEP_LENGTH) & 1) * STEP_TEMPERATURE_CHANGE;
+      break;
+    case SYNTH_REPLAY:
+      replay(g->n, p_pressure, p_temperature);
+      break;
+    default:
+      *p_pressure = 0;
+      *p_temperature = 0;
+      break;
+  }
+
+  g->n++;
+}
+
+/* -----------------------------------------------------------------------------
+ * Source
+ */
+
+static void generate(void) {
+  struct sample s;
+
+  memset(&s, 0, sizeof(s));
+  APP_ERROR_CHECK(app_timer_cnt_get(&s.timestamp));
+  generator_next(&source, &s.pressure, &s.temperature);
+  s.flags = SAMPLE_FLAG_COMPENSATED | SAMPLE_FLAG_SYNTHETIC;
+
+  status.generated++;
+  (void)pipeline_acquire(&s);	/* Numbered even if it's dropped */
+}
+static void timeout_handler(void* p_context) {
+  (void)p_context;
+
+  due += rate * period_ticks;
+  while (due >= TICKS_PER_SECOND) {
+    due -= TICKS_PER_SECOND;
+    generate();
+  }
+}
+
+/**
+ * Starts a profile at a rate in samples/s, from the beginning. SYNTH_OFF
+ * returns to the sensor.
+ */
+uint32_t synth_start(enum synth_profile new_profile, uint16_t new_rate) {
+  if (new_profile >= SYNTH_PROFILE_COUNT) return NRF_ERROR_INVALID_PARAM;
+  if (new_profile != SYNTH_OFF && (new_rate == 0 || new_rate > SYNTH_RATE_MAX)) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+
+  APP_ERROR_CHECK(app_timer_stop(timer_id));
+
+  memset(&status, 0, sizeof(status));
+  profile = new_profile;
+  rate = (profile == SYNTH_OFF) ? 0 : new_rate;
+  if (profile == SYNTH_OFF) return NRF_SUCCESS;
+
+  generator_init(&source, profile);
+  generator_init(&mirror, profile);
+  expected = pipeline_sequence();
+  due = 0;
+
+  period_ticks = TICKS_PER_SECOND / rate;
+  if (period_ticks < MIN_PERIOD_TICKS) period_ticks = MIN_PERIOD_TICKS;
+
+  APP_ERROR_CHECK(app_timer_start(timer_id, period_ticks, NULL));
+  return NRF_SUCCESS;
+}
+bool synth_active(void) {
+  return (profile != SYNTH_OFF);
+}
+
+/**
+ * Checks a sample on its way out. Samples from before the last start
+ * are ignored.
+ */
+void synth_check(const struct sample* s) {
+  struct sample e;
+  int16_t ahead;
+
+  if (!(s->flags & SAMPLE_FLAG_SYNTHETIC) || !synth_active()) return;
+
+  ahead = (int16_t)(s->sequence - expected);
+  if (ahead < 0) return;
+
+  /* Catch up over anything dropped */
+  status.gaps += ahead;
+  memset(&e, 0, sizeof(e));
+  while (ahead-- >= 0) {
+    generator_next(&mirror, &e.pressure, &e.temperature);
+  }
+  expected = s->sequence + 1;
+
+  (void)ble_ess_encode_stage(&e);
+  if (s->pressure == e.pressure && s->temperature == e.temperature) {
+    status.checked++;
+  } else {
+    status.mismatches++;
+  }
+}
+/**
+ * Returns the status. A client write lands straight in it, so the
+ * profile and rate are put back as they really are.
+ */
+struct synth_status* synth_status(void) {
+  status.profile = profile;
+  status.reserved = 0;
+  status.rate = rate;
+  return &status;
+}
+
+void synth_init(void) {
+  APP_ERROR_CHECK(app_timer_create(&timer_id,
+                                   APP_TIMER_MODE_REPEATED,
+                                   timeout_handler));
+}
+
+#endif /* SYNTH_ENABLED */
@@ -0,0 +1,199 @@
+/*
+ * Runtime telemetry counters
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Counts the things that would otherwise go unnoticed in the field:
+ * notifications that didn't make it, TWI errors, resets and where the
+ * time goes.
+ *
+ * The counters live in .noinit so they survive a soft reset, and are
+ * only cleared on power on or if they look corrupt. They are exposed
+ * directly as a characteristic value, so reading them costs nothing
+ * but a long read.
+ *
+ * Counters are bumped from thread mode and from interrupts, and the
+ * M0 has no exclusive access instructions, so each update is done in
+ * a critical region.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nrf.h"
+#include "nrf51_bitfields.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "ble.h"
+#include "main.h"
+#include "telemetry.h"
+
+#define TELEMETRY_MAGIC		0x54454C4DU /* 'TELM' */
+
+/**
+ * How often time spent is folded into the counters. Has to be less
+ * than the 24-bit RTC wraps in, 512 seconds.
+ */
+#define TELEMETRY_UPDATE_INTERVAL	APP_TIMER_TICKS(60000, APP_TIMER_PRESCALER)
+#define TICKS_PER_SECOND		APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER)
+
+/**
+ * Kept over soft resets. The magic and its complement have to match
+ * for the counters to be trusted.
+ */
+static struct {
+  uint32_t magic;
+  uint32_t counters[TELEMETRY_COUNT];
+  uint32_t magic_inv;
+} retained __attribute__((section(".noinit")));
+
+static app_timer_id_t update_timer_id;
+static uint32_t last_ticks;
+static uint32_t part_ticks;	/* Less than a second, not yet counted */
+static uint32_t boot_seconds;	/* Time counted before this boot */
+static bool connected;
+
+/**
+ * Adds to a counter
+ */
+static void telemetry_add(enum telemetry_counter counter, uint32_t n) {
+  CRITICAL_REGION_ENTER();
+  retained.counters[counter] += n;
+  CRITICAL_REGION_EXIT();
+}
+void telemetry_inc(enum telemetry_counter counter) {
+  telemetry_add(counter, 1);
+}
+/**
+ * Counts the result of a notification or indication. NRF_ERROR_INVALID_STATE
+ * just means there was no one to send to, so isn't counted.
+ */
+void telemetry_hvx_result(uint32_t err_code) {
+  switch (err_code) {
+    case NRF_SUCCESS:
+      telemetry_inc(TELEMETRY_NOTIFY_SENT);
+      break;
+    case BLE_ERROR_NO_TX_BUFFERS:
+      telemetry_inc(TELEMETRY_NOTIFY_DEFERRED);
+      break;
+    case BLE_ERROR_GATTS_SYS_ATTR_MISSING:
+      telemetry_inc(TELEMETRY_NOTIFY_DROPPED);
+      break;
+    default:
+      break;
+  }
+}
+uint32_t* telemetry_table(void) {
+  return retained.counters;
+}
+
+/**
+ * Folds the time since the last update into the connected or
+ * advertising count.
+ */
+static void time_update(void) {
+  uint32_t now, diff, seconds;
+
+  APP_ERROR_CHECK(app_timer_cnt_get(&now));
+  APP_ERROR_CHECK(app_timer_cnt_diff_compute(now, last_ticks, &diff));
+  last_ticks = now;
+
+  part_ticks += diff;
+  seconds = part_ticks / TICKS_PER_SECOND;
+  part_ticks -= seconds * TICKS_PER_SECOND;
+
+  telemetry_add(connected ? TELEMETRY_CONNECTED_S : TELEMETRY_ADVERTISING_S,
+                seconds);
+}
+/**
+ * Returns the seconds since boot. Doesn't touch the SoftDevice, so it
+ * can be used from the fault handlers.
+ */
+uint32_t telemetry_uptime(void) {
+  uint32_t now, diff;
+
+  (void)app_timer_cnt_get(&now);
+  (void)app_timer_cnt_diff_compute(now, last_ticks, &diff);
+
+  return retained.counters[TELEMETRY_CONNECTED_S] +
+    retained.counters[TELEMETRY_ADVERTISING_S] - boot_seconds +
+    (part_ticks + diff) / TICKS_PER_SECOND;
+}
+static void update_timeout_handler(void* p_context) {
+  (void)p_context;
+  time_update();
+}
+
+void telemetry_on_ble_evt(ble_evt_t* p_ble_evt) {
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+      time_update();
+      connected = true;
+      break;
+    case BLE_GAP_EVT_DISCONNECTED:
+      time_update();
+      connected = false;
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * Checks the retained counters and notes the reset. Must be called
+ * before the softdevice is enabled, while RESETREAS can still be
+ * accessed directly.
+ */
+void telemetry_init(void) {
+  uint32_t reason = NRF_POWER->RESETREAS;
+
+  /* Clear it so the next reset reads back on its own */
+  NRF_POWER->RESETREAS = reason;
+
+  if (reason == 0 ||		/* Power on or brownout */
+      retained.magic != TELEMETRY_MAGIC ||
+      retained.magic_inv != ~TELEMETRY_MAGIC) {
+    memset(retained.counters, 0, sizeof(retained.counters));
+    retained.magic = TELEMETRY_MAGIC;
+    retained.magic_inv = ~TELEMETRY_MAGIC;
+  } else {
+    retained.counters[TELEMETRY_RESETS]++;
+  }
+  retained.counters[TELEMETRY_RESET_REASON] = reason;
+  boot_seconds = retained.counters[TELEMETRY_CONNECTED_S] +
+    retained.counters[TELEMETRY_ADVERTISING_S];
+
+  APP_ERROR_CHECK(app_timer_create(&update_timer_id,
+                                   APP_TIMER_MODE_REPEATED,
+                                   update_timeout_handler));
+}
+/**
+ * Starts counting time. Needs the low frequency clock running.
+ */
+void telemetry_start(void) {
+  APP_ERROR_CHECK(app_timer_cnt_get(&last_ticks));
+  APP_ERROR_CHECK(app_timer_start(update_timer_id,
+                                  TELEMETRY_UPDATE_INTERVAL, NULL));
+}
@@ -0,0 +1,174 @@
+/*
+ * Sample validation
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Keeps bad reads out of everything downstream. Runs as the pipeline
+ * stage straight after compensation.
+ *
+ * A sample is invalid if a TWI transfer failed while it was taken, or
+ * if either value is outside what the BMP180 can measure.
+ *
+ * Single sample spikes are caught with a three sample running median
+ * of each value. Only a value further from the median than the step
+ * limit counts, so ordinary noise passes untouched, and a real step
+ * gets through on the sample after. A pressure spike is rejected
+ * outright, as the median is a sample old and would look like a
+ * stall to the filter. The temperature changes slowly enough for the
+ * median to stand in.
+ *
+ * Rejected samples are dropped, so they don't use airtime or upset the
+ * filter, and another is asked for in their place, once. What was
+ * found in the rest is left in their quality bits.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "app_timer.h"
+#include "telemetry.h"
+#include "main.h"
+#include "validate.h"
+
+#define TICKS_PER_SECOND	APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER)
+
+/**
+ * The last two raw values that were in range, oldest first
+ */
+struct track {
+  int32_t history[2];
+  uint8_t count;
+};
+
+static struct track pressure_track, temperature_track;
+static uint32_t last_timestamp;
+static validate_retry_t retry_fn;
+
+static int32_t median3(int32_t a, int32_t b, int32_t c) {
+  int32_t lo = (a < b) ? a : b;
+  int32_t hi = (a < b) ? b : a;
+
+  if (c < lo) return lo;
+  if (c > hi) return hi;
+  return c;
+}
+/**
+ * Adds a value to a track, and sets it to the median if it is further
+ * than limit from it. Returns true if it was.
+ */
+static bool track_update(struct track* t, int32_t* value, int32_t limit) {
+  int32_t raw = *value;
+  int32_t median;
+  bool spike = false;
+
+  if (t->count == 2) {
+    median = median3(t->history[0], t->history[1], raw);
+    if (abs(raw - median) > limit) {
+      *value = median;
+      spike = true;
+    }
+  } else {
+    t->count++;
+  }
+
+  t->history[0] = t->history[1];
+  t->history[1] = raw;
+
+  return spike;
+}
+
+/**
+ * Returns the SAMPLE_QUALITY_INVALID bits for a compensated sample.
+ * Doesn't look at anything that came before it.
+ */
+uint8_t validate_check(const struct sample* s) {
+  uint8_t quality = 0;
+
+  if (s->flags & SAMPLE_FLAG_TWI_ERROR) {
+    quality |= SAMPLE_QUALITY_TWI;
+  }
+  if (s->pressure < VALIDATE_PRESSURE_MIN || s->pressure > VALIDATE_PRESSURE_MAX) {
+    quality |= SAMPLE_QUALITY_PRESSURE_RANGE;
+  }
+  if (s->temperature < VALIDATE_TEMPERATURE_MIN || s->temperature > VALIDATE_TEMPERATURE_MAX) {
+    quality |= SAMPLE_QUALITY_TEMPERATURE_RANGE;
+  }
+
+  return quality;
+}
+/**
+ * Throws away a sample, and asks for another in its place. Just the
+ * once, so a sensor that keeps failing only gets slower.
+ */
+static enum stage_result reject(const struct sample* s) {
+  telemetry_inc(TELEMETRY_SAMPLES_REJECTED);
+
+  if (retry_fn && !(s->flags & SAMPLE_FLAG_RETRY)) {
+    retry_fn();
+  }
+
+  return STAGE_DROP;
+}
+/**
+ * Pipeline stage that sets the quality bits, and rejects or corrects
+ * bad samples. Synthetic samples are passed as they are, as synth.c
+ * checks them for exact values.
+ */
+enum stage_result validate_stage(struct sample* s) {
+  uint32_t dt, ms;
+  int32_t pressure, temperature;
+
+  s->quality = 0;
+  s->flags |= SAMPLE_FLAG_VALIDATED;
+  if (s->flags & SAMPLE_FLAG_SYNTHETIC) return STAGE_PASS;
+
+  s->quality = validate_check(s);
+  if (s->quality & SAMPLE_QUALITY_INVALID) return reject(s);
+
+  app_timer_cnt_diff_compute(s->timestamp, last_timestamp, &dt);
+  ms = ((uint64_t)dt * 1000) / TICKS_PER_SECOND;
+  last_timestamp = s->timestamp;
+
+  pressure = s->pressure;
+  if (track_update(&pressure_track, &pressure,
+                   VALIDATE_PRESSURE_STEP + (VALIDATE_PRESSURE_SLEW * ms) / 1000)) {
+    s->quality |= SAMPLE_QUALITY_PRESSURE_SPIKE;
+  }
+
+  temperature = s->temperature;
+  if (track_update(&temperature_track, &temperature,
+                   VALIDATE_TEMPERATURE_STEP + (VALIDATE_TEMPERATURE_SLEW * ms) / 1000)) {
+    s->temperature = temperature;
+    s->quality |= SAMPLE_QUALITY_TEMPERATURE_SPIKE;
+    telemetry_inc(TELEMETRY_SAMPLES_CORRECTED);
+  }
+
+  if (s->quality & SAMPLE_QUALITY_REJECT) return reject(s);
+
+  return STAGE_PASS;
+}
+
+void validate_init(validate_retry_t retry) {
+  retry_fn = retry;
+}
@@ -0,0 +1,399 @@
+/*
+ * Variometer
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Altitude and vertical speed from pressure, by a two state Kalman
+ * filter in fixed point. It runs as the filter stage of the pipeline,
+ * once for every sample, and fills in the altitude and climb of the
+ * sample for ble_ess.
+ *
+ * Pressure is turned into altitude through the International
+ * Standard Atmosphere, from a table indexed by log2 of the pressure.
+ * That keeps the steps even in altitude, from the ground to where a
+ * balloon bursts. The measurement noise follows from the noise of
+ * the BMP180 at the oversampling setting used, scaled by how much
+ * altitude a pascal is worth there: a few tens of centimetres on the
+ * ground, a few tens of metres at 30km.
+ *
+ * The state is altitude and vertical speed in 1/32 mm and mm/s, fine
+ * enough that slow movement still adds up at 20Hz. The time step
+ * comes from the sample timestamps, so the filter follows any change
+ * in the sample rate. The model is constant speed with white noise
+ * acceleration, of VARIO_ACCEL_SIGMA for a balloon or
+ * VARIO_ROCKET_ACCEL_SIGMA for a rocket. A new model is picked up at
+ * the start of the next sample, so it never lands half way through
+ * an update, and the filter starts again from there.
+ *
+ * Covariances are Q16, in m², m²/s and m²/s². Products are taken in
+ * 64 bits and saturated back into 32, and nothing here needs a
+ * floating point library on the M0.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_timer.h"
+#include "main.h"
+#include "bmp180.h"
+#include "pipeline.h"
+#include "vario.h"
+
+#define TICKS_PER_SECOND	APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER)
+#define RTC_COUNTER_MASK	0xFFFFFF
+
+#define LOG2_ENTRIES		129
+#define ALTITUDE_ENTRIES	233
+#define ALTITUDE_STEP_SHIFT	11	/* 1/32 octave, Q16 */
+#define ALTITUDE_L_MIN		-16384	/* -0.25 octave, Q16 */
+#define LOG2_P0			1089774	/* log2(101325Pa) as log2_q16() has it */
+
+/**
+ * 1/ln(2), Q16
+ */
+#define INV_LN2			94548
+
+/**
+ * State resolution, Q5. Leaves room for about ±67km.
+ */
+#define STATE_SHIFT		5
+#define STATE_PER_CM		(10 << STATE_SHIFT)
+
+/**
+ * mm² to Q16 m², by multiplying and shifting down 16
+ */
+#define MM2_TO_Q16		4295
+
+/**
+ * Process noise, Q16 (m/s²)²
+ */
+#define ACCEL_Q16(sigma)	((int64_t)(sigma) * (sigma) * MM2_TO_Q16 >> 16)
+#define CLIMB_Q16		((int64_t)VARIO_CLIMB_SIGMA * VARIO_CLIMB_SIGMA * MM2_TO_Q16 >> 16)
+
+/**
+ * BMP180 pressure noise, Pa RMS, by oversampling setting
+ */
+static const uint8_t pressure_sigma[BMP180_OSS_MAX + 1] = { 6, 5, 4, 3 };
+
+/**
+ * log2(1 + i/128), Q16
+ */
+static const uint32_t log2_mantissa[LOG2_ENTRIES] = {
+  0, 736, 1466, 2190, 2909, 3623, 4331, 5034,
+  5732, 6425, 7112, 7795, 8473, 9146, 9814, 10477,
+  11136, 11791, 12440, 13086, 13727, 14363, 14996, 15624,
+  16248, 16868, 17484, 18096, 18704, 19308, 19909, 20505,
+  21098, 21687, 22272, 22854, 23433, 24007, 24579, 25146,
+  25711, 26272, 26830, 27384, 27936, 28484, 29029, 29571,
+  30109, 30645, 31178, 31707, 32234, 32758, 33279, 33797,
+  34312, 34825, 35334, 35841, 36346, 36847, 37346, 37842,
+  38336, 38827, 39316, 39802, 40286, 40767, 41246, 41722,
+  42196, 42667, 43137, 43603, 44068, 44530, 44990, 45448,
+  45904, 46357, 46809, 47258, 47705, 48150, 48593, 49034,
+  49472, 49909, 50344, 50776, 51207, 51636, 52063, 52488,
+  52911, 53332, 53751, 54169, 54584, 54998, 55410, 55820,
+  56229, 56635, 57040, 57443, 57845, 58245, 58643, 59039,
+  59434, 59827, 60219, 60609, 60997, 61384, 61769, 62152,
+  62534, 62915, 63294, 63671, 64047, 64421, 64794, 65166,
+  65536,
+};
+/**
+ * ISA altitude, mm, every 1/32 octave of pressure below 1.19 x P0
+ * down to P0 / 128: about -1.5km to 32.6km.
+ */
+static const int32_t altitude_table[ALTITUDE_ENTRIES] = {
+  -1485950, -1297516, -1109857, -922970, -736851, -551498, -366907, -183076,
+  0, 182323, 363895, 544721, 724804, 904145, 1082749, 1260619,
+  1437757, 1614166, 1789850, 1964811, 2139053, 2312578, 2485390, 2657490,
+  2828883, 2999571, 3169557, 3338844, 3507435, 3675332, 3842539, 4009058,
+  4174892, 4340045, 4504517, 4668314, 4831437, 4993889, 5155673, 5316791,
+  5477247, 5637043, 5796182, 5954666, 6112498, 6269681, 6426218, 6582111,
+  6737363, 6891976, 7045954, 7199298, 7352011, 7504097, 7655557, 7806394,
+  7956610, 8106209, 8255193, 8403563, 8551324, 8698477, 8845025, 8990970,
+  9136314, 9281061, 9425213, 9568772, 9711740, 9854120, 9995915, 10137127,
+  10277758, 10417810, 10557287, 10696189, 10834521, 10972284, 11109671, 11247036,
+  11384401, 11521767, 11659132, 11796497, 11933862, 12071227, 12208593, 12345958,
+  12483323, 12620688, 12758054, 12895419, 13032784, 13170149, 13307515, 13444880,
+  13582245, 13719610, 13856976, 13994341, 14131706, 14269071, 14406436, 14543802,
+  14681167, 14818532, 14955897, 15093263, 15230628, 15367993, 15505358, 15642724,
+  15780089, 15917454, 16054819, 16192185, 16329550, 16466915, 16604280, 16741645,
+  16879011, 17016376, 17153741, 17291106, 17428472, 17565837, 17703202, 17840567,
+  17977933, 18115298, 18252663, 18390028, 18527394, 18664759, 18802124, 18939489,
+  19076855, 19214220, 19351585, 19488950, 19626315, 19763681, 19901046, 20038392,
+  20175825, 20313345, 20450952, 20588647, 20726428, 20864298, 21002254, 21140298,
+  21278430, 21416649, 21554956, 21693351, 21831833, 21970403, 22109061, 22247807,
+  22386642, 22525564, 22664574, 22803672, 22942859, 23082134, 23221497, 23360949,
+  23500489, 23640117, 23779834, 23919640, 24059535, 24199518, 24339590, 24479750,
+  24620000, 24760339, 24900766, 25041283, 25181889, 25322584, 25463368, 25604241,
+  25745204, 25886257, 26027398, 26168629, 26309950, 26451361, 26592861, 26734451,
+  26876130, 27017900, 27159759, 27301709, 27443748, 27585878, 27728098, 27870407,
+  28012808, 28155298, 28297879, 28440550, 28583312, 28726164, 28869107, 29012141,
+  29155265, 29298480, 29441786, 29585183, 29728670, 29872249, 30015919, 30159680,
+  30303532, 30447475, 30591510, 30735636, 30879853, 31024162, 31168563, 31313055,
+  31457638, 31602314, 31747081, 31891940, 32036890, 32181933, 32327068, 32472294,
+  32617613,
+};
+
+static volatile enum vario_model requested = VARIO_MODEL_BALLOON;
+static enum vario_model model = VARIO_MODEL_BALLOON;
+static int64_t accel_q16 = ACCEL_Q16(VARIO_ACCEL_SIGMA);
+
+static struct {
+  bool running;
+  bool synthetic;		/* Tracking synthetic samples */
+  uint32_t timestamp;		/* Of the last update */
+  int32_t h;			/* mm, Q5 */
+  int32_t v;			/* mm/s, Q5 */
+  int32_t p00, p01, p11;
+} kf;
+
+/* -----------------------------------------------------------------------------
+ * Fixed point
+ */
+
+static int32_t saturate(int64_t x) {
+  if (x > INT32_MAX) return INT32_MAX;
+  if (x < INT32_MIN) return INT32_MIN;
+  return (int32_t)x;
+}
+/**
+ * Q16 product, rounded
+ */
+static int64_t mul_q16(int64_t a, int64_t b) {
+  return (a * b + 0x8000) >> 16;
+}
+/**
+ * log2(x), Q16. The Cortex-M0 has no count leading zeros, so x is
+ * normalised by halves.
+ */
+static int32_t log2_q16(uint32_t x) {
+  int32_t n = 31;
+  uint32_t i, frac;
+  uint8_t shift;
+
+  for (shift = 16; shift; shift >>= 1) {
+    if (x < (1UL << (32 - shift))) {
+      x <<= shift;
+      n -= shift;
+    }
+  }
+
+  /* x is now 1.31, take the top 7 bits of the mantissa and
+   * interpolate on the next 16 */
+  i = (x >> 24) & 0x7F;
+  frac = (x >> 8) & 0xFFFF;
+
+  return (n << 16) + log2_mantissa[i] +
+    (((log2_mantissa[i + 1] - log2_mantissa[i]) * frac) >> 16);
+}
+
+/* -----------------------------------------------------------------------------
+ * Measurement
+ */
+
+/**
+ * Returns the ISA altitude for a pressure in Pa, in mm. If slope
+ * isn't NULL it's set to the altitude per octave of pressure there.
+ */
+static int32_t altitude(int32_t pressure, int32_t* slope) {
+  int32_t l, d;
+  uint32_t i, frac;
+
+  if (pressure < 1) pressure = 1;
+
+  /* Octaves below P0, from the start of the table */
+  l = LOG2_P0 - log2_q16(pressure) - ALTITUDE_L_MIN;
+  if (l < 0) l = 0;
+  if (l >= ((ALTITUDE_ENTRIES - 1) << ALTITUDE_STEP_SHIFT)) {
+    l = ((ALTITUDE_ENTRIES - 1) << ALTITUDE_STEP_SHIFT) - 1;
+  }
+
+  i = l >> ALTITUDE_STEP_SHIFT;
+  frac = l & ((1 << ALTITUDE_STEP_SHIFT) - 1);
+  d = altitude_table[i + 1] - altitude_table[i];
+
+  if (slope) *slope = d << (16 - ALTITUDE_STEP_SHIFT);
+  return altitude_table[i] + ((d * (int32_t)frac) >> ALTITUDE_STEP_SHIFT);
+}
+/**
+ * Returns the variance of an altitude measurement, Q16 m². The
+ * altitude changes by slope / (p ln2) for each pascal.
+ */
+static int32_t measurement_noise(int32_t pressure, uint8_t oss, int32_t slope) {
+  int64_t sigma;		/* mm */
+
+  if (oss > BMP180_OSS_MAX) oss = BMP180_OSS_MAX;
+  if (pressure < 1) pressure = 1;
+
+  sigma = ((int64_t)pressure_sigma[oss] * slope * INV_LN2) /
+    ((int64_t)pressure << 16);
+
+  return saturate(mul_q16(sigma * sigma, MM2_TO_Q16));
+}
+
+/* -----------------------------------------------------------------------------
+ * Filter
+ */
+
+/**
+ * Starts again from a single measurement, at rest
+ */
+static void start(int32_t z, int32_t r) {
+  kf.h = z << STATE_SHIFT;
+  kf.v = 0;
+  kf.p00 = r;
+  kf.p01 = 0;
+  kf.p11 = saturate(CLIMB_Q16);
+  kf.running = true;
+}
+/**
+ * Moves the state on by dt, Q16 seconds. For white noise
+ * acceleration of variance q the process noise is
+ *
+ *   q [ dt⁴/4  dt³/2 ]
+ *     [ dt³/2  dt²   ]
+ */
+static void predict(int32_t dt) {
+  int64_t dt2, qdt2, p11dt;
+
+  dt2 = mul_q16(dt, dt);
+  qdt2 = saturate(mul_q16(accel_q16, dt2));
+  p11dt = mul_q16(kf.p11, dt);
+
+  kf.h = saturate(kf.h + mul_q16(kf.v, dt));
+
+  kf.p00 = saturate(kf.p00 + mul_q16(dt, 2 * (int64_t)kf.p01 + p11dt) +
+                    (mul_q16(qdt2, dt2) >> 2));
+  kf.p01 = saturate(kf.p01 + p11dt + (mul_q16(qdt2, dt) >> 1));
+  kf.p11 = saturate(kf.p11 + qdt2);
+}
+/**
+ * Corrects the state with an altitude z, mm, of variance r
+ */
+static void update(int32_t z, int32_t r) {
+  int64_t s, k0, k1, y;
+
+  s = (int64_t)kf.p00 + r;
+  if (s < 1) s = 1;
+
+  k0 = ((int64_t)kf.p00 << 16) / s;	/* Q16 */
+  k1 = ((int64_t)kf.p01 << 16) / s;	/* Q16 /s */
+  y = ((int64_t)z << STATE_SHIFT) - kf.h;
+
+  kf.h = saturate(kf.h + mul_q16(k0, y));
+  kf.v = saturate(kf.v + mul_q16(k1, y));
+
+  /* P = (I - KH) P, with p11 first as it needs the old p01 */
+  kf.p11 = saturate(kf.p11 - mul_q16(k1, kf.p01));
+  kf.p01 = saturate(kf.p01 - mul_q16(k0, kf.p01));
+  kf.p00 = saturate(kf.p00 - mul_q16(k0, kf.p00));
+
+  /* Rounding mustn't leave a variance negative */
+  if (kf.p00 < 1) kf.p00 = 1;
+  if (kf.p11 < 1) kf.p11 = 1;
+}
+
+/* -----------------------------------------------------------------------------
+ * Pipeline
+ */
+
+/**
+ * Starts the filter again from the next sample
+ */
+void vario_reset(void) {
+  kf.running = false;
+}
+/**
+ * Selects the filter model from the next sample on
+ */
+void vario_set_model(enum vario_model m) {
+  if (m < VARIO_MODEL_COUNT) {
+    requested = m;
+  }
+}
+enum vario_model vario_model(void) {
+  return requested;
+}
+/**
+ * Returns the ISA altitude for a pressure in Pa, in mm
+ */
+int32_t vario_pressure_altitude(int32_t pressure) {
+  return altitude(pressure, NULL);
+}
+/**
+ * Pipeline stage that runs the filter on a compensated sample. A
+ * sample that couldn't be read is passed on unfiltered and leaves the
+ * filter as it was. With the filter off every sample is passed on
+ * unfiltered.
+ *
+ * The filter starts again whenever the samples switch between the
+ * synthetic source and the sensor, so a load test never leaves a false
+ * climb for the flight detector. That covers samples still in the
+ * pipeline when the source is started or stopped.
+ */
+enum stage_result vario_filter_stage(struct sample* s) {
+  int32_t z, r, slope, v;
+  uint32_t ticks;
+
+  if (requested != model) {
+    model = requested;
+    accel_q16 = ACCEL_Q16((model == VARIO_MODEL_ROCKET) ?
+                          VARIO_ROCKET_ACCEL_SIGMA : VARIO_ACCEL_SIGMA);
+    kf.running = false;
+  }
+
+  if (model == VARIO_MODEL_OFF ||
+      !(s->flags & SAMPLE_FLAG_COMPENSATED) ||
+      (s->flags & SAMPLE_FLAG_TWI_ERROR)) {
+    return STAGE_PASS;
+  }
+
+  if (((s->flags & SAMPLE_FLAG_SYNTHETIC) != 0) != kf.synthetic) {
+    kf.synthetic = !kf.synthetic;
+    kf.running = false;
+  }
+
+  z = altitude(s->pressure, &slope);
+  r = measurement_noise(s->pressure, s->oss, slope);
+  ticks = (s->timestamp - kf.timestamp) & RTC_COUNTER_MASK;
+
+  if (!kf.running || ticks > VARIO_DT_MAX * TICKS_PER_SECOND) {
+    start(z, r);
+  } else {
+    if (ticks) {
+      predict((int32_t)(((uint64_t)ticks << 16) / TICKS_PER_SECOND));
+    }
+    update(z, r);
+  }
+  kf.timestamp = s->timestamp;
+
+  v = kf.v / STATE_PER_CM;
+  if (v > INT16_MAX) v = INT16_MAX;
+  if (v < INT16_MIN) v = INT16_MIN;
+
+  s->altitude = kf.h / STATE_PER_CM;
+  s->climb = (int16_t)v;
+  s->flags |= SAMPLE_FLAG_FILTERED;
+
+  return STAGE_PASS;
+}
@@ -0,0 +1,320 @@
+/*
+ * Pressure tendency and forecast
+ * Copyright (C) 2015  Richard Meadows <richardeoin>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Keeps a day of pressure history for fixed installs, and works out
+ * the 3 hour pressure tendency and a Zambretti forecast from it, so a
+ * gateway doesn't have to download raw data to get the trend.
+ *
+ * Samples are summed as they pass through the pipeline. Every
+ * WEATHER_POINT_MINUTES a minute timer closes the sum off into a
+ * point of history, the mean in units of 2Pa so a day fits in 16 bits
+ * a point. A point with no samples behind it is left as zero, and
+ * nothing is worked out across it.
+ *
+ * The tendency compares the two halves of the last 3 hours, giving
+ * the WMO code. The forecast is the simple Zambretti one: the pressure
+ * reduced to sea level, and whether it is rising, steady or falling,
+ * pick one of 26 letters. Seasons and wind are left out.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "ble.h"
+#include "ble_srv_common.h"
+#include "telemetry.h"
+#include "config.h"
+#include "main.h"
+#include "weather.h"
+
+#define MINUTE_INTERVAL		APP_TIMER_TICKS(60000, APP_TIMER_PRESCALER)
+
+/**
+ * Scale height for reducing to sea level, m
+ */
+#define SCALE_HEIGHT		8434
+
+/**
+ * Zambretti letters, 0 for A, by the number from the formulae below.
+ * 1-9 are for falling pressure, 10-19 steady and 20-32 rising.
+ */
+#define Z_FALLING_MIN		1
+#define Z_STEADY_MIN		10
+#define Z_RISING_MIN		20
+#define Z_MAX			32
+static const uint8_t zambretti_letters[Z_MAX + 1] = {
+  0,
+  'A', 'B', 'D', 'H', 'O', 'R', 'U', 'X', 'Z',
+  'A', 'B', 'E', 'K', 'N', 'P', 'S', 'W', 'X', 'Z',
+  'A', 'B', 'C', 'F', 'G', 'I', 'J', 'L', 'M', 'Q', 'T', 'Y', 'Z',
+};
+
+static uint16_t history[WEATHER_POINTS];	/* 2Pa, or 0 for none */
+static struct weather_status status;
+static uint32_t point_sum;	/* Pa */
+static uint32_t point_count;
+static uint8_t minutes;
+
+static app_timer_id_t minute_timer_id;
+static weather_handler_t weather_handler;
+static ble_ess_t* weather_ess;
+static ble_gatts_char_handles_t* status_handles;
+
+/**
+ * Returns a point back from the newest, in Pa, or 0 if there isn't one
+ */
+static int32_t point_get(uint8_t back) {
+  if (back >= status.points) return 0;
+
+  return 2 * history[(status.newest + WEATHER_POINTS - back) % WEATHER_POINTS];
+}
+static void point_add(uint16_t point) {
+  if (status.points) {
+    status.newest = (status.newest + 1) % WEATHER_POINTS;
+  }
+  if (status.points < WEATHER_POINTS) status.points++;
+
+  history[status.newest] = point;
+}
+
+static int8_t direction(int32_t change) {
+  if (change > WEATHER_STEADY) return 1;
+  if (change < -WEATHER_STEADY) return -1;
+  return 0;
+}
+/**
+ * The WMO tendency code from the change over each half of the 3 hours
+ */
+static enum weather_tendency tendency(int32_t first, int32_t second) {
+  int8_t d1 = direction(first);
+  int8_t d2 = direction(second);
+  int8_t d = direction(first + second);
+
+  if (d > 0) {
+    if (d1 > 0 && d2 < 0) return WEATHER_RISING_FALLING;
+    if (d1 > 0 && (d2 == 0 || 2 * second < first)) return WEATHER_RISING_STEADY;
+    if (d1 <= 0 || second > 2 * first) return WEATHER_FALLING_RISING_FASTER;
+    return WEATHER_RISING;
+  }
+  if (d < 0) {
+    if (d1 < 0 && d2 > 0) return WEATHER_FALLING_RISING;
+    if (d1 < 0 && (d2 == 0 || 2 * second > first)) return WEATHER_FALLING_STEADY;
+    if (d1 >= 0 || second < 2 * first) return WEATHER_RISING_FALLING_FASTER;
+    return WEATHER_FALLING;
+  }
+
+  if (d1 > 0 && d2 < 0) return WEATHER_RISING_FALLING;
+  if (d1 < 0 && d2 > 0) return WEATHER_FALLING_RISING;
+  return WEATHER_STEADY_SAME;
+}
+/**
+ * Reduces a pressure at the station altitude to sea level, Pa. The
+ * exponential is taken to second order, good to a few Pa below 1000m.
+ */
+static int32_t sea_level(int32_t pressure) {
+  int64_t h = status.altitude;
+
+  return pressure + (int32_t)(((int64_t)pressure * h) / SCALE_HEIGHT +
+                              ((int64_t)pressure * h * h) /
+                              (2LL * SCALE_HEIGHT * SCALE_HEIGHT));
+}
+/**
+ * The Zambretti letter for a sea level pressure in Pa, and the change
+ * over the last 3 hours
+ */
+static uint8_t zambretti(int32_t pressure, int32_t change) {
+  int32_t z, min, max;
+
+  if (change < -WEATHER_TREND) {
+    z = (1270000 - 12 * pressure + 5000) / 10000;
+    min = Z_FALLING_MIN;
+    max = Z_STEADY_MIN - 1;
+  } else if (change > WEATHER_TREND) {
+    z = (1850000 - 16 * pressure + 5000) / 10000;
+    min = Z_RISING_MIN;
+    max = Z_MAX;
+  } else {
+    z = (1440000 - 13 * pressure + 5000) / 10000;
+    min = Z_STEADY_MIN;
+    max = Z_RISING_MIN - 1;
+  }
+  if (z < min) z = min;
+  if (z > max) z = max;
+
+  return zambretti_letters[z] - 'A';
+}
+/**
+ * Works the status out again from the history. Returns true if the
+ * tendency or forecast changed.
+ */
+static bool status_update(void) {
+  int32_t now = point_get(0);
+  int32_t middle = point_get(WEATHER_TENDENCY_POINTS / 2);
+  int32_t then = point_get(WEATHER_TENDENCY_POINTS);
+  uint8_t last_tendency = status.tendency;
+  uint8_t last_forecast = status.forecast;
+
+  status.sea_level = now ? (sea_level(now) + 5) / 10 : 0;
+
+  if (now && middle && then) {
+    status.change = now - then;
+    status.tendency = tendency(middle - then, now - middle);
+    status.forecast = zambretti(sea_level(now), status.change);
+  } else {
+    status.change = 0;
+    status.tendency = WEATHER_UNKNOWN;
+    status.forecast = WEATHER_UNKNOWN;
+  }
+
+  return (status.tendency != last_tendency) || (status.forecast != last_forecast);
+}
+
+/**
+ * Notifies the status, and sets it for reads
+ */
+void weather_report(void) {
+  uint32_t err_code;
+
+  if (weather_ess == NULL) return;
+
+  err_code = ble_ess_char_update(weather_ess, status_handles,
+                                 (uint8_t*)&status, sizeof(status),
+                                 BLE_GATT_HVX_NOTIFICATION);
+  telemetry_hvx_result(err_code);
+
+  /* The value is set even if it can't be sent now */
+  if (err_code != NRF_SUCCESS &&
+      err_code != BLE_ERROR_NO_TX_BUFFERS &&
+      err_code != NRF_ERROR_INVALID_STATE &&
+      err_code != BLE_ERROR_INVALID_CONN_HANDLE &&
+      err_code != BLE_ERROR_GATTS_SYS_ATTR_MISSING) {
+    APP_ERROR_HANDLER(err_code);
+  }
+}
+static void changed(bool forecast_changed) {
+  weather_report();
+  if (forecast_changed && weather_handler) weather_handler(&status);
+}
+
+/**
+ * Closes off a point every WEATHER_POINT_MINUTES
+ */
+static void minute_timeout_handler(void* p_context) {
+  uint32_t sum, count;
+
+  if (++minutes < WEATHER_POINT_MINUTES) return;
+  minutes = 0;
+
+  /* The pipeline adds to these from thread mode */
+  CRITICAL_REGION_ENTER();
+  sum = point_sum;
+  count = point_count;
+  point_sum = 0;
+  point_count = 0;
+  CRITICAL_REGION_EXIT();
+
+  point_add(count ? (uint16_t)(((sum / count) + 1) / 2) : 0);
+  changed(status_update());
+}
+
+/**
+ * Pipeline stage that adds each sample to the point being built.
+ * Synthetic samples aren't weather.
+ */
+enum stage_result weather_stage(struct sample* s) {
+  if (s->flags & SAMPLE_FLAG_SYNTHETIC) return STAGE_PASS;
+
+  CRITICAL_REGION_ENTER();
+  point_sum += s->pressure;
+  point_count++;
+  CRITICAL_REGION_EXIT();
+
+  return STAGE_PASS;
+}
+
+/**
+ * Sets the station altitude, m, and works the forecast out again
+ */
+void weather_set_altitude(int16_t altitude) {
+  bool forecast_changed;
+
+  /* The minute timer updates the status too */
+  CRITICAL_REGION_ENTER();
+  status.altitude = altitude;
+  forecast_changed = status_update();
+  CRITICAL_REGION_EXIT();
+
+  changed(forecast_changed);
+}
+const struct weather_status* weather_status(void) {
+  return &status;
+}
+/**
+ * Returns true if a client is waiting for the status, so samples have
+ * to be taken for the history
+ */
+bool weather_subscribed(void) {
+  uint8_t cccd[2];
+  uint16_t len = sizeof(cccd);
+
+  if (weather_ess == NULL || weather_ess->conn_handle == BLE_CONN_HANDLE_INVALID) {
+    return false;
+  }
+
+  return (sd_ble_gatts_value_get(status_handles->cccd_handle, 0, &len, cccd) == NRF_SUCCESS) &&
+    ble_srv_is_notification_enabled(cccd);
+}
+/**
+ * The history, oldest first from just after status.newest once it's
+ * full. In units of 2Pa, 0 where there were no samples.
+ */
+const uint16_t* weather_history(void) {
+  return history;
+}
+
+void weather_gatt_init(ble_ess_t* p_ess, ble_gatts_char_handles_t* p_status_handles) {
+  weather_ess = p_ess;
+  status_handles = p_status_handles;
+}
+void weather_init(weather_handler_t handler) {
+  weather_handler = handler;
+
+  memset(&status, 0, sizeof(status));
+  status.altitude = config()->altitude;
+  status.tendency = WEATHER_UNKNOWN;
+  status.forecast = WEATHER_UNKNOWN;
+
+  APP_ERROR_CHECK(app_timer_create(&minute_timer_id,
+                                   APP_TIMER_MODE_REPEATED,
+                                   minute_timeout_handler));
+}
+void weather_start(void) {
+  APP_ERROR_CHECK(app_timer_start(minute_timer_id, MINUTE_INTERVAL, NULL));
+}